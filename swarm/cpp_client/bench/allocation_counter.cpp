@@ -0,0 +1,105 @@
+#include "allocation_counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// operator new / delete を一式 (通常・配列・nothrow・サイズ付き・align_val_t)
+// 置き換え、new の回数を数える。確保は malloc / aligned_alloc、解放はすべて
+// free で、標準ライブラリの既定の実装には頼らない。GCC が呼び出し側に malloc
+// を見て new / delete の組を誤って警告しないよう、別の翻訳単位に置く。
+
+namespace {
+
+std::atomic<std::uint64_t> g_allocations{0};
+
+void *allocate(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *allocate(std::size_t size, std::align_val_t align) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  const auto alignment = static_cast<std::size_t>(align);
+  // aligned_alloc はサイズが alignment の倍数であることを求める。
+  const auto rounded =
+      (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+  if (void *p = std::aligned_alloc(alignment, rounded)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+template <typename... Args>
+void *allocate_nothrow(std::size_t size, Args... args) noexcept {
+  try {
+    return allocate(size, args...);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return allocate(size); }
+void *operator new[](std::size_t size) { return allocate(size); }
+void *operator new(std::size_t size, std::align_val_t align) {
+  return allocate(size, align);
+}
+void *operator new[](std::size_t size, std::align_val_t align) {
+  return allocate(size, align);
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate_nothrow(size);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocate_nothrow(size);
+}
+void *operator new(std::size_t size, std::align_val_t align,
+                   const std::nothrow_t &) noexcept {
+  return allocate_nothrow(size, align);
+}
+void *operator new[](std::size_t size, std::align_val_t align,
+                     const std::nothrow_t &) noexcept {
+  return allocate_nothrow(size, align);
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  std::free(p);
+}
+void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  std::free(p);
+}
+
+namespace toio::bench {
+
+std::uint64_t allocation_count() {
+  return g_allocations.load();
+}
+
+} // namespace toio::bench
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+namespace toio::bench {
+
+// toio_bench の中で operator new (全種類) が呼ばれた回数 (全スレッド)。
+std::uint64_t allocation_count();
+
+} // namespace toio::bench
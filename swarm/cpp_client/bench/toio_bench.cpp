@@ -0,0 +1,853 @@
+// toio_bench: 通信・状態管理・制御・プランナーのホットパスの計測。
+//   ./toio_bench --benchmark_out=bench.json --benchmark_out_format=json
+//   ./toio_bench --benchmark_filter=Planner
+
+#include "allocation_counter.hpp"
+
+#include "toio/api/fleet_control.hpp"
+#include "toio/control/goal_controller.hpp"
+#include "toio/fault/fault_injector.hpp"
+#include "toio/middleware/fleet_manager.hpp"
+#include "toio/middleware/server_session.hpp"
+#include "toio/planning/assignment.hpp"
+#include "toio/planning/behavior.hpp"
+#include "toio/planning/choreography.hpp"
+#include "toio/planning/flock.hpp"
+#include "toio/planning/flow_field.hpp"
+#include "toio/planning/motion_planner.hpp"
+#include "toio/planning/orca.hpp"
+#include "toio/planning/themes.hpp"
+#include "toio/record/session_recorder.hpp"
+#include "toio/runtime/clock.hpp"
+#include "toio/sim/relay_emulator_server.hpp"
+#include "toio/sim/simulation.hpp"
+#include "toio/transport/connection.hpp"
+#include "toio/transport/toio_client.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace {
+
+using toio::middleware::CubeState;
+using toio::middleware::FleetManager;
+using toio::middleware::Position;
+using toio::middleware::ServerConfig;
+using toio::middleware::ServerSession;
+
+std::vector<std::string> make_cube_ids(std::size_t count) {
+  std::vector<std::string> ids;
+  ids.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    char id[24];
+    std::snprintf(id, sizeof(id), "S%04zu", i);
+    ids.emplace_back(id);
+  }
+  return ids;
+}
+
+ServerConfig make_server_config(const std::string &server_id,
+                                const std::vector<std::string> &cube_ids) {
+  ServerConfig config;
+  config.id = server_id;
+  config.host = std::string("127.0.0.1");
+  config.port = std::string("0");
+  for (const auto &id : cube_ids) {
+    toio::middleware::CubeConfig cube;
+    cube.id = id;
+    config.cubes.push_back(std::move(cube));
+  }
+  return config;
+}
+
+// リレーの位置応答 (通知) と同じ形のテキスト。
+std::string position_message(const std::string &cube_id, int x, int y,
+                             int angle) {
+  return nlohmann::json{
+      {"type", "response"},
+      {"payload",
+       {{"info", "position"},
+        {"target", cube_id},
+        {"notify", true},
+        {"position",
+         {{"x", x},
+          {"y", y},
+          {"angle", angle},
+          {"on_mat", true},
+          {"timestamp_ms", 1700000000000ULL}}}}}}
+      .dump();
+}
+
+// マット上に格子状に並べ、少しずらした位置。
+std::vector<Position> grid_positions(std::size_t count, std::uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> jitter(-5.0, 5.0);
+  std::uniform_int_distribution<int> angle(0, 359);
+  const double min_x = 34.0, max_x = 949.0, min_y = 35.0, max_y = 898.0;
+  std::size_t columns = 1;
+  while (columns * columns < count) {
+    ++columns;
+  }
+  const double step_x = (max_x - min_x) / static_cast<double>(columns + 1);
+  const double step_y = (max_y - min_y) / static_cast<double>(columns + 1);
+  std::vector<Position> positions(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    auto &position = positions[i];
+    position.x = static_cast<int>(min_x + step_x * (i % columns + 1) +
+                                  jitter(rng));
+    position.y = static_cast<int>(min_y + step_y * (i / columns + 1) +
+                                  jitter(rng));
+    position.angle = angle(rng);
+    position.on_mat = true;
+  }
+  return positions;
+}
+
+// 送信は捨て、受信は deliver で呼び出し側のスレッドから直接流し込む。
+class NullConnection : public toio::transport::Connection {
+public:
+  void open(ReceiveHandler on_message, LogHandler) override {
+    on_message_ = std::move(on_message);
+    open_ = true;
+  }
+  void close() override { open_ = false; }
+  bool is_open() const override { return open_; }
+  void write(const std::string &text) override {
+    bytes_.fetch_add(text.size(), std::memory_order_relaxed);
+  }
+
+  void deliver(const std::string &text) const { on_message_(text); }
+  std::uint64_t bytes() const { return bytes_.load(); }
+
+private:
+  ReceiveHandler on_message_;
+  std::atomic<bool> open_{false};
+  std::atomic<std::uint64_t> bytes_{0};
+};
+
+// ConnectionFactory が作った NullConnection を server_id 順に覚えておく。
+struct NullConnections {
+  toio::middleware::ConnectionFactory factory() {
+    return [this](const ServerConfig &) {
+      auto connection = std::make_unique<NullConnection>();
+      created.push_back(connection.get());
+      return connection;
+    };
+  }
+  std::vector<NullConnection *> created;
+};
+
+// 作ってから finish までの確保を allocations に出し、1 回でもあればエラーに
+// する。reserve したあとの step はメモリを確保しない約束を計測ループで確かめる。
+class AllocationCheck {
+public:
+  explicit AllocationCheck(benchmark::State &state)
+      : state_(state), start_(toio::bench::allocation_count()) {}
+
+  void finish() {
+    const auto count = toio::bench::allocation_count() - start_;
+    state_.counters["allocations"] = static_cast<double>(count);
+    if (count > 0) {
+      state_.SkipWithError("allocated memory inside the timed loop");
+    }
+  }
+
+private:
+  benchmark::State &state_;
+  std::uint64_t start_;
+};
+
+// ---- JSON codec ------------------------------------------------------------
+
+void BM_EncodeMove(benchmark::State &state) {
+  auto connection = std::make_unique<NullConnection>();
+  const auto *raw = connection.get();
+  toio::transport::ToioClient client(std::move(connection));
+  client.connect();
+  int speed = 0;
+  for (auto _ : state) {
+    client.send_move("S0000", speed, -speed);
+    speed = (speed + 1) % 100;
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<std::int64_t>(raw->bytes()));
+}
+BENCHMARK(BM_EncodeMove);
+
+void BM_EncodeMoveToMulti(benchmark::State &state) {
+  auto connection = std::make_unique<NullConnection>();
+  const auto *raw = connection.get();
+  toio::transport::ToioClient client(std::move(connection));
+  client.connect();
+  std::vector<toio::transport::MoveTarget> goals;
+  for (const auto &position : grid_positions(29, 1)) {
+    goals.push_back({position.x, position.y, std::nullopt});
+  }
+  int request_id = 0;
+  for (auto _ : state) {
+    client.send_move_to_multi("S0000", goals, 80,
+                              toio::transport::MoveType::Curve, false,
+                              ++request_id);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<std::int64_t>(raw->bytes()));
+}
+BENCHMARK(BM_EncodeMoveToMulti);
+
+void BM_DecodePosition(benchmark::State &state) {
+  const auto text = position_message("S0000", 480, 460, 90);
+  for (auto _ : state) {
+    auto json = nlohmann::json::parse(text);
+    benchmark::DoNotOptimize(json);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(
+      static_cast<std::int64_t>(state.iterations() * text.size()));
+}
+BENCHMARK(BM_DecodePosition);
+
+// ---- ServerSession ----------------------------------------------------------
+
+constexpr std::size_t kCubesPerThread = 64;
+
+struct SessionFixture {
+  NullConnections connections;
+  std::unique_ptr<ServerSession> session;
+  // スレッドごとに別の Cube への位置通知。
+  std::vector<std::vector<std::string>> messages;
+  std::vector<std::vector<std::string>> cube_ids;
+};
+SessionFixture *g_session = nullptr;
+
+void setup_session(const benchmark::State &state) {
+  g_session = new SessionFixture;
+  const auto threads = static_cast<std::size_t>(state.threads());
+  const auto ids = make_cube_ids(threads * kCubesPerThread);
+  g_session->session = std::make_unique<ServerSession>(
+      make_server_config("bench", ids), toio::runtime::Runtime{},
+      g_session->connections.factory());
+  g_session->session->start();
+  g_session->messages.resize(threads);
+  g_session->cube_ids.resize(threads);
+  const auto positions = grid_positions(ids.size(), 2);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    const auto thread = i / kCubesPerThread;
+    g_session->cube_ids[thread].push_back(ids[i]);
+    g_session->messages[thread].push_back(position_message(
+        ids[i], positions[i].x, positions[i].y, positions[i].angle));
+    g_session->connections.created.front()->deliver(
+        g_session->messages[thread].back());
+  }
+}
+
+void teardown_session(const benchmark::State &) {
+  g_session->session->stop();
+  delete g_session;
+  g_session = nullptr;
+}
+
+// 受信スレッド相当: 位置通知の解析と update_state。全スレッドが書き込む。
+void BM_SessionUpdateContention(benchmark::State &state) {
+  const auto &connection = *g_session->connections.created.front();
+  const auto &messages = g_session->messages[state.thread_index()];
+  std::size_t i = 0;
+  for (auto _ : state) {
+    connection.deliver(messages[i]);
+    i = (i + 1) % messages.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SessionUpdateContention)
+    ->Setup(setup_session)
+    ->Teardown(teardown_session)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+// スレッド 0 が通知を書き込み、残りは GoalController のタスクと同じく
+// find_state で 1 台分を読む。
+void BM_SessionReadWriteMix(benchmark::State &state) {
+  const auto &connection = *g_session->connections.created.front();
+  const auto thread = static_cast<std::size_t>(state.thread_index());
+  const auto &messages = g_session->messages[thread];
+  const auto &ids = g_session->cube_ids[thread];
+  std::size_t i = 0;
+  for (auto _ : state) {
+    if (thread == 0) {
+      connection.deliver(messages[i]);
+    } else {
+      benchmark::DoNotOptimize(g_session->session->find_state(ids[i]));
+    }
+    i = (i + 1) % messages.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SessionReadWriteMix)
+    ->Setup(setup_session)
+    ->Teardown(teardown_session)
+    ->ThreadRange(2, 8)
+    ->UseRealTime();
+
+// ---- SessionRecorder ------------------------------------------------------------
+
+// 制御側が払う record のコスト (キューに積むだけ)。dropped はキューあふれ。
+void BM_RecorderRecord(benchmark::State &state) {
+  const auto path =
+      (std::filesystem::temp_directory_path() / "toio_bench.toiolog").string();
+  auto recorder = std::make_shared<toio::record::SessionRecorder>(path);
+  const auto server = recorder->register_server("bench");
+  const auto text = position_message("S0000", 480, 460, 90);
+  for (auto _ : state) {
+    recorder->record(toio::record::RecordKind::Inbound, server, text);
+  }
+  recorder->close();
+  const auto stats = recorder->stats();
+  state.SetItemsProcessed(state.iterations());
+  state.counters["dropped"] = static_cast<double>(stats.dropped);
+  state.counters["bytes_per_record"] =
+      stats.recorded ? static_cast<double>(stats.bytes) / stats.recorded : 0.0;
+  std::filesystem::remove(path);
+}
+// キューの上限 (65536) に収まる件数で、捨てずに積む経路を測る。
+BENCHMARK(BM_RecorderRecord)->Iterations(50000);
+
+// ---- FleetManager -------------------------------------------------------------
+
+struct FleetFixture {
+  explicit FleetFixture(std::size_t cubes) : ids(make_cube_ids(cubes)) {
+    manager = std::make_unique<FleetManager>(
+        std::vector<ServerConfig>{make_server_config("bench", ids)},
+        toio::runtime::Runtime{}, connections.factory());
+    manager->start();
+    const auto positions = grid_positions(ids.size(), 3);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      connections.created.front()->deliver(position_message(
+          ids[i], positions[i].x, positions[i].y, positions[i].angle));
+    }
+  }
+  ~FleetFixture() { manager->stop(); }
+
+  std::vector<std::string> ids;
+  NullConnections connections;
+  std::unique_ptr<FleetManager> manager;
+};
+
+void BM_FleetSnapshot(benchmark::State &state) {
+  FleetFixture fleet(static_cast<std::size_t>(state.range(0)));
+  for (auto _ : state) {
+    auto snapshot = fleet.manager->snapshot();
+    benchmark::DoNotOptimize(snapshot);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FleetSnapshot)->Arg(30)->Arg(300)->Arg(3000);
+
+void BM_FleetCubeState(benchmark::State &state) {
+  FleetFixture fleet(static_cast<std::size_t>(state.range(0)));
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fleet.manager->cube_state("bench", fleet.ids[i]));
+    i = (i + 1) % fleet.ids.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FleetCubeState)->Arg(30)->Arg(300)->Arg(3000);
+
+// ---- Control --------------------------------------------------------------------
+
+void BM_ComputeGoalMove(benchmark::State &state) {
+  const auto positions = grid_positions(1024, 4);
+  toio::control::GoalOptions options;
+  options.goal_x = 480;
+  options.goal_y = 460;
+  double direction = 1.0;
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        toio::control::compute_goal_move(positions[i], options, direction));
+    i = (i + 1) % positions.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ComputeGoalMove);
+
+// ---- MotionPlanner --------------------------------------------------------------
+
+constexpr double kPlannerDt = 0.12;
+
+void BM_PlannerStep(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  toio::planning::MotionPlannerParameters params;
+  params.seed = 5;
+  toio::planning::MotionPlanner planner(params);
+  planner.reserve(cubes);
+  auto positions = grid_positions(cubes, 5);
+  planner.step(positions, kPlannerDt);
+  AllocationCheck allocations(state);
+  for (auto _ : state) {
+    const auto &targets = planner.step(positions, kPlannerDt);
+    benchmark::DoNotOptimize(targets.data());
+  }
+  allocations.finish();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PlannerStep)
+    ->Arg(30)
+    ->Arg(300)
+    ->Arg(3000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 密度を 1 台 / 100x100 に保ったまま cubes 台を散らす。
+struct ScaledField {
+  double side = 0.0;
+  std::vector<Position> positions;
+};
+
+ScaledField scaled_field(std::size_t cubes) {
+  ScaledField field;
+  field.side = 100.0 * std::sqrt(static_cast<double>(cubes));
+  std::mt19937 rng(6);
+  std::uniform_real_distribution<double> coordinate(0.0, field.side);
+  field.positions.resize(cubes);
+  for (auto &position : field.positions) {
+    position.x = static_cast<int>(coordinate(rng));
+    position.y = static_cast<int>(coordinate(rng));
+    position.on_mat = true;
+  }
+  return field;
+}
+
+toio::planning::MotionPlannerParameters scaled_parameters(double side) {
+  toio::planning::MotionPlannerParameters params;
+  params.seed = 6;
+  params.field_min_x = 0.0;
+  params.field_min_y = 0.0;
+  params.field_max_x = side;
+  params.field_max_y = side;
+  return params;
+}
+
+// 密度を保ったままフィールドを広げる。近傍の数が一定なので台数に比例して
+// 伸びるはず。
+void BM_PlannerStepScaled(benchmark::State &state) {
+  const auto field = scaled_field(static_cast<std::size_t>(state.range(0)));
+  toio::planning::MotionPlanner planner(scaled_parameters(field.side));
+  planner.step(field.positions, kPlannerDt);
+  for (auto _ : state) {
+    const auto &targets = planner.step(field.positions, kPlannerDt);
+    benchmark::DoNotOptimize(targets.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PlannerStepScaled)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+// BM_PlannerStepScaled を threads 本 (第 2 引数) で回す。出力はスレッド数に
+// よらず同じなので、差はそのまま分けた効果 (と ThreadPool の手間)。
+void BM_PlannerStepThreads(benchmark::State &state) {
+  const auto field = scaled_field(static_cast<std::size_t>(state.range(0)));
+  auto params = scaled_parameters(field.side);
+  params.threads = static_cast<std::size_t>(state.range(1));
+  toio::planning::MotionPlanner planner(params);
+  planner.reserve(field.positions.size());
+  planner.step(field.positions, kPlannerDt);
+  AllocationCheck allocations(state);
+  for (auto _ : state) {
+    const auto &targets = planner.step(field.positions, kPlannerDt);
+    benchmark::DoNotOptimize(targets.data());
+  }
+  allocations.finish();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PlannerStepThreads)
+    ->ArgsProduct({{10000, 100000}, {1, 2, 4, 8, 16}})
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+// 2 グループに分けてゴールを与えた Flock。1 枚のマットに並べる。
+void BM_FlockStep(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  toio::planning::FlockParameters params;
+  params.seed = 7;
+  toio::planning::Flock flock(params);
+  const auto positions = grid_positions(cubes, 7);
+  flock.step(positions, kPlannerDt);
+  flock.split(0, 1, 0.0);
+  flock.set_goal(0, {250.0, 466.0});
+  flock.set_goal(1, {730.0, 466.0});
+  AllocationCheck allocations(state);
+  for (auto _ : state) {
+    const auto &targets = flock.step(positions, kPlannerDt);
+    benchmark::DoNotOptimize(targets.data());
+  }
+  allocations.finish();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FlockStep)
+    ->Arg(100)
+    ->Arg(300)
+    ->Arg(1000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 1 枚のマットに並べた N 台が、それぞれ中心を挟んだ反対側へ向かう (最も混む形)。
+void BM_OrcaSolve(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  toio::planning::Orca orca;
+  const auto positions = grid_positions(cubes, 8);
+  std::vector<toio::planning::OrcaAgent> agents(cubes);
+  for (std::size_t i = 0; i < cubes; ++i) {
+    auto &agent = agents[i];
+    agent.position = {static_cast<double>(positions[i].x),
+                      static_cast<double>(positions[i].y)};
+    agent.preferred = {(491.0 - agent.position.x) * 0.5,
+                       (466.0 - agent.position.y) * 0.5};
+    agent.velocity = agent.preferred;
+  }
+  orca.reserve(cubes);
+  orca.solve(agents, kPlannerDt);
+  AllocationCheck allocations(state);
+  for (auto _ : state) {
+    const auto &velocities = orca.solve(agents, kPlannerDt);
+    benchmark::DoNotOptimize(velocities.data());
+  }
+  allocations.finish();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_OrcaSolve)
+    ->Arg(30)
+    ->Arg(300)
+    ->Arg(3000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 渦と風を半分ずつ混ぜた流れを N 台の位置で引く (crossfade の途中と同じ形)。
+void BM_FlowSample(benchmark::State &state) {
+  namespace flow = toio::planning::flow;
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  const auto positions = grid_positions(cubes, 9);
+  toio::planning::FlowBlender blender;
+  blender.add(std::make_shared<toio::planning::FlowField>(
+      toio::planning::FlowField::bake(
+          flow::vortex({491.0, 466.0}, 120.0, 250.0))));
+  blender.add(std::make_shared<toio::planning::FlowField>(
+      toio::planning::FlowField::bake(flow::wave(0.0, 90.0, 60.0, 300.0))));
+  blender.set_weight(0, 0.5);
+  blender.set_weight(1, 0.5);
+  for (auto _ : state) {
+    double sum = 0.0;
+    for (const auto &position : positions) {
+      const auto velocity = blender.sample(position.x, position.y);
+      sum += velocity.x + velocity.y;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FlowSample)
+    ->Arg(30)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 格子に並んだ N 台を、マット中央の円周上の N 点へ割り当てる (隊形の切り替え)。
+std::vector<toio::planning::TargetPoint> ring_targets(std::size_t count) {
+  std::vector<toio::planning::TargetPoint> targets(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const double angle =
+        6.283185307179586 * static_cast<double>(i) / static_cast<double>(count);
+    targets[i] = {491.0 + 400.0 * std::cos(angle), 466.0 + 400.0 * std::sin(angle)};
+  }
+  return targets;
+}
+
+// Args: {台数, AssignmentMethod (1 Hungarian, 2 Auction, 3 Greedy)}。
+// total は移動距離の合計。
+void BM_Assign(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  const auto positions = grid_positions(cubes, 10);
+  const auto targets = ring_targets(cubes);
+  toio::planning::AssignmentOptions options;
+  options.method = static_cast<toio::planning::AssignmentMethod>(state.range(1));
+  toio::planning::TargetAssigner assigner(options);
+  double total = 0.0;
+  for (auto _ : state) {
+    assigner.reset();
+    total = assigner.assign(positions, targets).total_distance;
+  }
+  state.counters["total"] = total;
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Assign)
+    ->Args({100, 1})
+    ->Args({300, 1})
+    ->Args({1000, 1})
+    ->Args({100, 2})
+    ->Args({300, 2})
+    ->Args({1000, 2})
+    ->Args({100, 3})
+    ->Args({1000, 3})
+    ->Args({10000, 3})
+    ->Unit(benchmark::kMicrosecond);
+
+// 前回の価格から始める Auction。Cube が少しずつ動いたあとに同じ隊形へ
+// 割り当て直す (回るたびに位置を 2 通りで入れ替える)。
+void BM_AssignAuctionWarm(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  const std::vector<Position> positions[2] = {grid_positions(cubes, 10),
+                                              grid_positions(cubes, 11)};
+  const auto targets = ring_targets(cubes);
+  toio::planning::AssignmentOptions options;
+  options.method = toio::planning::AssignmentMethod::Auction;
+  toio::planning::TargetAssigner assigner(options);
+  assigner.assign(positions[0], targets);
+  std::size_t turn = 1;
+  for (auto _ : state) {
+    const auto &assignment = assigner.assign(positions[turn ^= 1], targets);
+    benchmark::DoNotOptimize(assignment.target_of.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AssignAuctionWarm)
+    ->Arg(100)
+    ->Arg(300)
+    ->Arg(1000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 60 秒・1 秒おきのキーフレームを 50 Hz で表にし、tick ごとに N 台分の
+// いまのコマを引く (ChoreographyPlayer の 1 tick から送信を除いたもの)。
+void BM_ChoreographyFrame(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  const auto positions = grid_positions(cubes, 12);
+  std::vector<toio::planning::ChoreographyTrack> tracks(cubes);
+  for (std::size_t i = 0; i < cubes; ++i) {
+    for (int k = 0; k <= 60; ++k) {
+      toio::planning::Keyframe key;
+      key.t = k;
+      key.x = positions[i].x + (k % 2) * 40.0;
+      key.y = positions[i].y;
+      key.led = {static_cast<std::uint8_t>(k * 4), 0, 0};
+      tracks[i].keyframes.push_back(key);
+    }
+  }
+  const auto table = toio::planning::Choreography(std::move(tracks)).compile();
+  double t = 0.0;
+  for (auto _ : state) {
+    const auto *poses = table.frame(table.frame_at(t));
+    double sum = 0.0;
+    for (std::size_t i = 0; i < cubes; ++i) {
+      sum += poses[i].x + poses[i].y + poses[i].led.r;
+    }
+    benchmark::DoNotOptimize(sum);
+    t = t < 60.0 ? t + 0.1 : 0.0;
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ChoreographyFrame)
+    ->Arg(30)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 全テーマを積んだ BehaviorRuntime の 1 step。range(1) がテーマの番号、
+// テーマの数なら medaka と star の間を 2 秒ごとに crossfade し続ける
+// (両方を step する最も重い tick)。
+void BM_BehaviorRuntime(benchmark::State &state) {
+  const auto cubes = static_cast<std::size_t>(state.range(0));
+  const auto theme = static_cast<std::size_t>(state.range(1));
+  const auto names = toio::planning::theme_names();
+  toio::planning::BehaviorRuntime runtime;
+  for (const auto name : names) {
+    runtime.add(toio::planning::make_theme(name));
+  }
+  runtime.reserve(cubes);
+  const bool crossfade = theme >= names.size();
+  runtime.switch_to(crossfade ? 0 : theme, 0.0);
+  state.SetLabel(crossfade ? "crossfade" : std::string(names[theme]));
+  const auto positions = grid_positions(cubes, 13);
+  runtime.step(positions, kPlannerDt);
+  std::size_t steps = 0;
+  AllocationCheck allocations(state);
+  for (auto _ : state) {
+    if (crossfade && ++steps % 16 == 0) {
+      runtime.switch_to(runtime.current() == 0 ? 3 : 0, 2.0);
+    }
+    const auto &targets = runtime.step(positions, kPlannerDt);
+    benchmark::DoNotOptimize(targets.data());
+  }
+  allocations.finish();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BehaviorRuntime)
+    ->ArgsProduct({{100, 1000}, {0, 1, 2, 3, 4}})
+    ->Unit(benchmark::kMicrosecond);
+
+// ---- End to end -------------------------------------------------------------------
+
+// ローカルのエミュレータへ WebSocket で query_position を送り、全 Cube の
+// 応答が ServerSession の状態に反映されるまで。BLE 遅延は 0 にしてあるので、
+// クライアントとリレーのスタック (JSON・WebSocket・スレッド間の受け渡し) と
+// エミュレータの tick だけが乗る。
+void BM_LoopbackRoundTrip(benchmark::State &state) {
+  const auto ids = make_cube_ids(static_cast<std::size_t>(state.range(0)));
+  toio::sim::EmulatorConfig emulator;
+  emulator.cube_ids = ids;
+  emulator.connected_at_start = true;
+  emulator.ble.latency = std::chrono::microseconds(0);
+  emulator.ble.jitter = std::chrono::microseconds(0);
+  emulator.ble.interval = std::chrono::microseconds(0);
+  emulator.ble.queue_limit = ids.size() * 4;
+  toio::sim::RelayEmulatorOptions options;
+  options.port = 0;
+  options.tick = std::chrono::milliseconds(1);
+  toio::sim::RelayEmulatorServer server(emulator, options);
+  server.start();
+
+  auto config = make_server_config("bench", ids);
+  config.port = std::to_string(server.port());
+  FleetManager manager(std::vector<ServerConfig>{config});
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::uint64_t responses = 0;
+  manager.set_state_callback([&](const CubeState &) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      ++responses;
+    }
+    cv.notify_all();
+  });
+  manager.start();
+
+  for (auto _ : state) {
+    std::uint64_t expected = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      expected = responses + ids.size();
+    }
+    for (const auto &id : ids) {
+      manager.query_position("bench", id, false);
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!cv.wait_for(lock, std::chrono::seconds(5),
+                     [&] { return responses >= expected; })) {
+      state.SkipWithError("timed out waiting for position responses");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  manager.stop();
+  server.stop();
+}
+BENCHMARK(BM_LoopbackRoundTrip)
+    ->Arg(1)
+    ->Arg(30)
+    ->Arg(300)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// 仮想時間のシミュレーションで N 台のゴール追従を 10 秒分回す。
+// sim_seconds は 1 実秒あたりに進んだ仮想時間。
+void BM_HeadlessGoalRun(benchmark::State &state) {
+  const auto ids = make_cube_ids(static_cast<std::size_t>(state.range(0)));
+  const auto targets = grid_positions(ids.size(), 6);
+  constexpr auto kShow = std::chrono::seconds(10);
+  for (auto _ : state) {
+    toio::sim::SimulationConfig config;
+    config.relay.cube_ids = ids;
+    toio::sim::Simulation sim(config);
+    auto &control = sim.control();
+    control.set_goal_logger([](const std::string &, const std::string &) {});
+    control.start();
+    sim.run_for(std::chrono::seconds(1));
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      toio::control::GoalOptions goal;
+      goal.goal_x = targets[i].x;
+      goal.goal_y = targets[i].y;
+      control.start_goal(ids[i], goal);
+    }
+    sim.run_for(kShow);
+    control.stop_all_goals();
+  }
+  state.counters["sim_seconds"] = benchmark::Counter(
+      static_cast<double>(state.iterations()) *
+          std::chrono::duration<double>(kShow).count(),
+      benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_HeadlessGoalRun)
+    ->Arg(30)
+    ->Arg(100)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// 回線の遅延・欠落を入れて同じゴール追従を回し、制御の劣化を見る。
+// Args: {台数, 片道遅延 ms, 欠落率 (千分率)}。goal_error は 10 秒後の
+// 目標までの平均距離、arrived は 10 以内に着いた割合。
+void BM_FaultyGoalRun(benchmark::State &state) {
+  const auto ids = make_cube_ids(static_cast<std::size_t>(state.range(0)));
+  const auto targets = grid_positions(ids.size(), 6);
+  constexpr auto kShow = std::chrono::seconds(10);
+  toio::fault::FaultConfig faults;
+  faults.uplink.latency = faults.downlink.latency =
+      std::chrono::milliseconds(state.range(1));
+  faults.uplink.jitter = faults.downlink.jitter =
+      std::chrono::milliseconds(state.range(1) / 2);
+  faults.uplink.drop_rate = faults.downlink.drop_rate =
+      static_cast<double>(state.range(2)) / 1000.0;
+  double goal_error = 0.0;
+  double arrived = 0.0;
+  for (auto _ : state) {
+    toio::sim::SimulationConfig config;
+    config.relay.cube_ids = ids;
+    config.faults = faults;
+    toio::sim::Simulation sim(config);
+    auto &control = sim.control();
+    control.set_goal_logger([](const std::string &, const std::string &) {});
+    control.start();
+    sim.run_for(std::chrono::seconds(1));
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      toio::control::GoalOptions goal;
+      goal.goal_x = targets[i].x;
+      goal.goal_y = targets[i].y;
+      control.start_goal(ids[i], goal);
+    }
+    sim.run_for(kShow);
+    control.stop_all_goals();
+    const auto &cubes = sim.relay().cubes();
+    goal_error = 0.0;
+    arrived = 0.0;
+    for (std::size_t i = 0; i < cubes.size(); ++i) {
+      const auto &pose = cubes[i].pose();
+      const double error =
+          std::hypot(pose.x - targets[i].x, pose.y - targets[i].y);
+      goal_error += error / static_cast<double>(cubes.size());
+      arrived += error < 10.0 ? 1.0 / static_cast<double>(cubes.size()) : 0.0;
+    }
+  }
+  state.counters["goal_error"] = goal_error;
+  state.counters["arrived"] = arrived;
+}
+BENCHMARK(BM_FaultyGoalRun)
+    ->Args({30, 0, 0})
+    ->Args({30, 50, 0})
+    ->Args({30, 50, 50})
+    ->Args({30, 150, 50})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "toio/api/fleet_control.hpp"
+#include "toio/control/obstacle_tracker.hpp"
+#include "toio/planning/behavior.hpp"
+#include "toio/runtime/runtime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace toio::api {
+
+struct BehaviorOptions {
+  // BehaviorRuntime を進めて目標を送る固定の周期。step の dt もこの長さ。
+  std::chrono::milliseconds tick{120};
+  // switch_to で fade を省略したときの切り替え時間。
+  std::chrono::milliseconds fade{4000};
+  // 目標。goal_x / goal_y は BehaviorRuntime の出力で上書きする。
+  control::GoalOptions goal;
+  // あれば tick ごとに snapshot して Behavior に渡す。
+  std::shared_ptr<const control::ObstacleTracker> obstacles;
+};
+
+// BehaviorRuntime を固定周期のタスクで回し、目標を update_goal で流す。
+// テーマの切り替えは次の tick で BehaviorRuntime::switch_to に渡すだけなので、
+// 接続もゴールのタスクもそのまま続き、start 後はメモリを確保しない
+// (FleetControl::snapshot を除く)。
+class BehaviorPlayer {
+public:
+  // runtime は control と同じものを渡す。behaviors が空なら std::invalid_argument。
+  BehaviorPlayer(FleetControl &control, planning::BehaviorRuntime behaviors,
+                 BehaviorOptions options = {}, runtime::Runtime runtime = {});
+  ~BehaviorPlayer();
+
+  BehaviorPlayer(const BehaviorPlayer &) = delete;
+  BehaviorPlayer &operator=(const BehaviorPlayer &) = delete;
+
+  // cubes を、いまの位置をゴールにして動かし始める。実行中に呼ぶとやり直す。
+  void start(std::vector<CubeHandle> cubes);
+  // タスクを止め、ゴールも止める。
+  void stop();
+  bool running() const;
+
+  // 次の tick から index (name) の Behavior へ fade かけて切り替える。
+  // どのスレッドから呼んでもよい。範囲外や知らない名前は std::out_of_range。
+  void switch_to(std::size_t index,
+                 std::optional<std::chrono::milliseconds> fade = std::nullopt);
+  void switch_to(std::string_view name,
+                 std::optional<std::chrono::milliseconds> fade = std::nullopt);
+  // 最後の tick で目標を出していた Behavior。
+  std::size_t current() const;
+
+  // 目標を送った回数と、そのうち予定より tick 以上遅れて起きた回数。
+  std::uint64_t ticks() const;
+  std::uint64_t late_ticks() const;
+  // 送った update_goal の数 (目標が変わった Cube だけ送る)。
+  std::uint64_t goals_sent() const;
+
+private:
+  struct SwitchRequest {
+    std::size_t index = 0;
+    double fade = 0.0;
+  };
+
+  void run(std::shared_ptr<std::atomic<bool>> cancel);
+  void tick();
+  void read_positions();
+  control::GoalOptions goal_for(const planning::TargetPoint &target) const;
+
+  FleetControl &control_;
+  planning::BehaviorRuntime behaviors_;
+  BehaviorOptions options_;
+  runtime::Runtime runtime_;
+  std::vector<CubeHandle> cubes_;
+  // tick ごとに使い回す作業領域。
+  std::vector<middleware::Position> positions_;
+  std::vector<control::Obstacle> obstacles_;
+  // 最後に送った目標。変わったときだけ送る。
+  std::vector<transport::MoveTarget> sent_goals_;
+  mutable std::mutex switch_mutex_;
+  std::optional<SwitchRequest> pending_switch_;
+  std::atomic<std::size_t> current_{0};
+  std::atomic<std::uint64_t> ticks_{0};
+  std::atomic<std::uint64_t> late_ticks_{0};
+  std::atomic<std::uint64_t> goals_sent_{0};
+  std::atomic<bool> running_{false};
+  std::shared_ptr<std::atomic<bool>> cancel_;
+  std::future<void> worker_;
+};
+
+} // namespace toio::api
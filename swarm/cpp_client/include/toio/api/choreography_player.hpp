@@ -0,0 +1,104 @@
+#pragma once
+
+#include "toio/api/fleet_control.hpp"
+#include "toio/planning/choreography.hpp"
+#include "toio/runtime/runtime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace toio::api {
+
+enum class ChoreographyMode {
+  // tick ごとに表のいまのコマを update_goal で流す (PC 側の閉ループ)。
+  Goal,
+  // 開始時刻に各トラックのキーフレームを send_trajectory でまとめて送る。
+  // 点の間の速さはキューブ任せなので、揃うのは開始の瞬間だけ。loop なら
+  // 周の始まりごとに送り直して揃え直す。
+  Trajectory,
+};
+
+struct ChoreographyOptions {
+  ChoreographyMode mode = ChoreographyMode::Goal;
+  // start で全 Cube に最初の姿勢を指示してから、再生を始めるまでの時間。
+  std::chrono::milliseconds lead{3000};
+  // 表を引いて送る間隔。
+  std::chrono::milliseconds tick{100};
+  // Goal の目標。goal_x / goal_y / goal_angle は表の値で上書きする。
+  control::GoalOptions goal;
+  control::TrajectoryOptions trajectory;
+  bool leds = true;
+  // 最後のコマのあと最初から繰り返す。
+  bool loop = false;
+};
+
+// Choreography を表にコンパイルし、全 Cube で同じ開始時刻から再生する。
+// コマは開始時刻からの経過時間で引くので、tick が遅れても時刻はずれない。
+// 再生は runtime の Executor のタスクで回り、呼び出し側は待つだけでよい。
+class ChoreographyPlayer {
+public:
+  // runtime は control と同じものを渡す。表が大きすぎれば
+  // std::invalid_argument (Choreography::compile)。
+  ChoreographyPlayer(FleetControl &control,
+                     const planning::Choreography &choreography,
+                     ChoreographyOptions options = {},
+                     runtime::Runtime runtime = {});
+  ~ChoreographyPlayer();
+
+  ChoreographyPlayer(const ChoreographyPlayer &) = delete;
+  ChoreographyPlayer &operator=(const ChoreographyPlayer &) = delete;
+
+  // cubes[i] がトラック i を踊る。空なら各トラックの cube を
+  // resolve_cube で引く。足りなければ std::invalid_argument。
+  // 再生中に呼ぶと最初からやり直す。
+  void start(std::vector<CubeHandle> cubes = {});
+  // 再生を止め、ゴールも止める。
+  void stop();
+  bool running() const;
+
+  const planning::ChoreographyTable &table() const;
+  // 再生の開始時刻 (start から lead 後)。
+  runtime::Clock::time_point start_time() const;
+  // 最後に送ったコマ。
+  std::size_t frame() const;
+  // 表を引いて送った回数と、そのうち予定より tick 以上遅れて起きた回数。
+  std::uint64_t ticks() const;
+  std::uint64_t late_ticks() const;
+  // 再生が終わる (loop でなければ最後のコマを送る) まで待つ。
+  void wait();
+
+private:
+  void run(std::shared_ptr<std::atomic<bool>> cancel);
+  void send_frame(std::size_t frame, bool goals);
+  // restart なら loop の 2 周目以降 (最後の点から先頭へ戻る)。
+  void send_trajectories(bool restart);
+  control::GoalOptions goal_for(const planning::ChoreographyPose &pose) const;
+
+  FleetControl &control_;
+  ChoreographyOptions options_;
+  runtime::Runtime runtime_;
+  planning::ChoreographyTable table_;
+  // start で cubes を省略したときに引く名前。
+  std::vector<std::string> track_cubes_;
+  // Trajectory で送る各トラックのキーフレーム (連続する同じ点は除く)。
+  std::vector<std::vector<transport::MoveTarget>> keyframes_;
+  std::vector<CubeHandle> cubes_;
+  // 最後に送った目標と色。変わったときだけ送る。
+  std::vector<transport::MoveTarget> sent_goals_;
+  std::vector<middleware::LedColor> sent_leds_;
+  runtime::Clock::time_point start_time_{};
+  std::atomic<std::size_t> frame_{0};
+  std::atomic<std::uint64_t> ticks_{0};
+  std::atomic<std::uint64_t> late_ticks_{0};
+  std::atomic<bool> running_{false};
+  std::shared_ptr<std::atomic<bool>> cancel_;
+  std::future<void> worker_;
+};
+
+} // namespace toio::api
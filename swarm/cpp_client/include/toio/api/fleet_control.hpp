@@ -5,6 +5,7 @@
 
 #include <future>
 #include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <shared_mutex>
@@ -24,7 +25,10 @@ struct CubeHandle {
 
 class FleetControl {
 public:
-  explicit FleetControl(std::vector<middleware::ServerConfig> configs);
+  // runtime / connect はシミュレーション用の差し替え口 (FleetManager と同じ)。
+  explicit FleetControl(std::vector<middleware::ServerConfig> configs,
+                        runtime::Runtime runtime = {},
+                        middleware::ConnectionFactory connect = {});
   ~FleetControl();
 
   FleetControl(const FleetControl &) = delete;
@@ -39,9 +43,13 @@ public:
   void set_state_callback(middleware::ServerSession::StateCallback callback);
   void set_message_callback(middleware::ServerSession::MessageCallback callback);
   void set_goal_logger(control::GoalController::Logger logger);
+  // GoalController::set_obstacles と同じ。
+  void set_obstacles(std::shared_ptr<const control::ObstacleTracker> obstacles);
 
   std::vector<CubeHandle> cubes() const;
   std::vector<middleware::CubeSnapshot> snapshot() const;
+  std::unordered_map<std::string, middleware::RateLimitStats>
+  rate_limit_stats() const;
 
   CubeHandle resolve_cube(const std::string &cube_id) const;
 
@@ -78,6 +86,30 @@ public:
             int right_speed,
             std::optional<bool> require_result = std::nullopt);
 
+  bool move_for(const std::string &cube_id,
+                int left_speed,
+                int right_speed,
+                std::chrono::milliseconds duration,
+                std::optional<bool> require_result = std::nullopt);
+  bool move_for(const CubeHandle &handle,
+                int left_speed,
+                int right_speed,
+                std::chrono::milliseconds duration,
+                std::optional<bool> require_result = std::nullopt);
+
+  std::optional<int> move_to(const std::string &cube_id,
+                             const transport::MoveTarget &goal,
+                             int max_speed = 80,
+                             transport::MoveType move_type =
+                                 transport::MoveType::Curve,
+                             std::optional<bool> require_result = std::nullopt);
+  std::optional<int> move_to(const CubeHandle &handle,
+                             const transport::MoveTarget &goal,
+                             int max_speed = 80,
+                             transport::MoveType move_type =
+                                 transport::MoveType::Curve,
+                             std::optional<bool> require_result = std::nullopt);
+
   bool start_goal(const std::string &cube_id,
                   control::GoalOptions options = {});
   bool start_goal(const CubeHandle &handle,
@@ -87,9 +119,37 @@ public:
   bool update_goal(const CubeHandle &handle,
                    control::GoalOptions options);
 
+  control::PathHandle start_path(const std::string &cube_id,
+                                 std::vector<control::Waypoint> waypoints,
+                                 control::GoalOptions options = {});
+  control::PathHandle start_path(const CubeHandle &handle,
+                                 std::vector<control::Waypoint> waypoints,
+                                 control::GoalOptions options = {});
+  std::optional<control::PathHandle>
+  append_waypoints(const std::string &cube_id,
+                   std::vector<control::Waypoint> waypoints);
+  std::optional<control::PathHandle>
+  append_waypoints(const CubeHandle &handle,
+                   std::vector<control::Waypoint> waypoints);
+
+  control::TrajectoryHandle
+  send_trajectory(const std::string &cube_id,
+                  std::vector<transport::MoveTarget> points,
+                  control::TrajectoryOptions options = {});
+  control::TrajectoryHandle
+  send_trajectory(const CubeHandle &handle,
+                  std::vector<transport::MoveTarget> points,
+                  control::TrajectoryOptions options = {});
+
   bool stop_goal(const std::string &cube_id);
   bool stop_goal(const CubeHandle &handle);
   std::size_t stop_all_goals();
+  // 全ゴールをキャンセルし、各サーバーへ stop_all を優先レーンで 1 フレーム送る。
+  middleware::EmergencyStopReport emergency_stop();
+
+  control::LoopMetricsSnapshot loop_metrics() const;
+  void reset_loop_metrics();
+  void set_loop_metrics_dump(const std::string &path);
 
 private:
   struct CommandResult {
@@ -121,6 +181,8 @@ private:
                      std::shared_ptr<std::promise<struct CommandResult>>>
       pending_commands_;
   std::mutex pending_mutex_;
+  // promise を解決したあとに通知する (Clock::wait_until 用)。
+  std::condition_variable pending_cv_;
   mutable std::shared_mutex message_callback_mutex_;
   middleware::ServerSession::MessageCallback user_message_callback_;
   bool started_ = false;
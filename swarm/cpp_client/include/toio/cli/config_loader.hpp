@@ -10,6 +10,8 @@ namespace toio::cli {
 
 struct Options {
   std::string fleet_config_path;
+  // 空でなければ送受信をセッションログに記録する。
+  std::string record_path;
 };
 
 struct FleetPlan {
@@ -1,9 +1,16 @@
 #pragma once
 
+#include "toio/control/loop_metrics.hpp"
+#include "toio/control/obstacle_tracker.hpp"
+#include "toio/control/spatial_grid.hpp"
 #include "toio/middleware/fleet_manager.hpp"
+#include "toio/runtime/runtime.hpp"
+#include "toio/transport/move_target.hpp"
 
 #include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <deque>
 #include <functional>
 #include <future>
 #include <memory>
@@ -11,9 +18,35 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace toio::control {
 
+enum class GoalStatus {
+  Reached,
+  Cancelled,
+  Failed,
+};
+
+// 制御周期ごとに近くの Cube を見て、進行方向にいれば減速し、
+// 避ける向きに旋回を加える。距離はマット座標 (Cube 中心間)。
+struct AvoidanceOptions {
+  bool enabled = false;
+  // この距離より近い Cube を考慮する。障害物 (set_obstacles) は縁から測る。
+  double influence_radius = 120.0;
+  // この距離以下で進行方向の正面にいる場合は並進を min_scale まで落とす。
+  double stop_distance = 50.0;
+  double min_scale = 0.0;
+  // 旋回の上乗せ量 (wmax に対する比)。
+  double deflect_gain = 0.8;
+  // 進行方向との cos がこれ以下の Cube (横・後ろ) は無視する。
+  double min_ahead_cos = 0.0;
+  // 近傍インデックスを作り直す間隔。全タスクで共有する。障害物が更新された
+  // ときはこの間隔を待たずに作り直す。
+  std::chrono::milliseconds refresh_interval{20};
+};
+
 struct GoalOptions {
   int goal_x = 0;
   int goal_y = 0;
@@ -25,6 +58,73 @@ struct GoalOptions {
   double reverse_threshold_deg = 100.0;
   double reverse_hysteresis_deg = 15.0;
   std::chrono::milliseconds poll_interval{100};
+
+  // 0 より大きい場合、move を duration_ms 付きで送り、速度が変わったときか
+  // リースが切れる直前にだけ再送する。コントローラが落ちてもキューブは
+  // command_lease 以内に停止する (toio の上限は 2550ms)。
+  std::chrono::milliseconds command_lease{0};
+  std::chrono::milliseconds lease_margin{50};
+
+  // true の場合は PC 側で閉ループを回さず、キューブの目標指定付きモーター制御
+  // (move_to) に到達判定まで委ねる。stop_dist とゲインは使われない。
+  bool firmware_target = false;
+  std::optional<int> goal_angle;
+  int firmware_max_speed = 80;
+  transport::MoveType firmware_move_type = transport::MoveType::Curve;
+
+  // PC 側の閉ループ (firmware_target = false) でのみ有効。
+  AvoidanceOptions avoidance;
+};
+
+// 現在位置からゴールへ向かう (left, right)。stop_dist 以内なら std::nullopt。
+// direction_state は前進 (1) / 後退 (-1) のヒステリシスで、呼び出し間で保持する。
+std::optional<std::pair<int, int>>
+compute_goal_move(const toio::middleware::Position &current,
+                  const GoalOptions &params,
+                  double &direction_state);
+
+struct Waypoint {
+  int x = 0;
+  int y = 0;
+  double stop_dist = 10.0;
+  std::chrono::milliseconds dwell{0};
+};
+
+// waypoints[i] は i 番目の地点への到達時に、path はキューが空になった時点
+// (最後の dwell 完了後) に解決される。
+struct PathHandle {
+  std::vector<std::shared_future<GoalStatus>> waypoints;
+  std::shared_future<GoalStatus> path;
+};
+
+struct TrajectoryOptions {
+  int max_speed = 80;
+  transport::MoveType move_type = transport::MoveType::Curve;
+  // toio の複数目標指定付きモーター制御は 1 コマンドあたり最大 29 点。
+  std::size_t chunk_size = 29;
+  // 実行中のチャンクの後ろに追加書き込みで先送りしておくチャンク数。
+  // 完了待ちのチャンクは最大 pipeline_depth + 1 個 (実行中の 1 個を含む)。
+  std::size_t pipeline_depth = 1;
+  std::chrono::milliseconds poll_interval{50};
+  // キューブが 1 点に使える時間 (timeout 0 で送るときの toio の既定 10 秒)。
+  // 実行中のチャンクの結果が点数 x point_timeout を過ぎても届かなければ、
+  // 結果を失ったとみなしてそのチャンクの先頭から上書きで送り直す。
+  std::chrono::milliseconds point_timeout{10000};
+  // 進みのないまま送り直してよい回数。超えたら GoalStatus::Failed。
+  std::size_t max_resends = 2;
+};
+
+struct TrajectoryProgress {
+  std::atomic<std::size_t> total_points{0};
+  std::atomic<std::size_t> completed_points{0};
+  std::atomic<std::size_t> total_chunks{0};
+  std::atomic<std::size_t> sent_chunks{0};
+  std::atomic<std::size_t> completed_chunks{0};
+};
+
+struct TrajectoryHandle {
+  std::shared_future<GoalStatus> done;
+  std::shared_ptr<const TrajectoryProgress> progress;
 };
 
 class GoalController {
@@ -39,6 +139,9 @@ public:
   GoalController &operator=(const GoalController &) = delete;
 
   void set_logger(Logger logger);
+  // avoidance.enabled のタスクが Cube と同じように避ける障害物 (人など)。
+  // nullptr で外す。
+  void set_obstacles(std::shared_ptr<const ObstacleTracker> obstacles);
 
   bool start_goal(const std::string &server_id,
                   const std::string &cube_id,
@@ -47,27 +150,88 @@ public:
                    const std::string &cube_id,
                    GoalOptions options);
 
+  PathHandle start_path(const std::string &server_id,
+                        const std::string &cube_id,
+                        std::vector<Waypoint> waypoints,
+                        GoalOptions options = {});
+  std::optional<PathHandle> append_waypoints(const std::string &server_id,
+                                             const std::string &cube_id,
+                                             std::vector<Waypoint> waypoints);
+
+  TrajectoryHandle start_trajectory(const std::string &server_id,
+                                    const std::string &cube_id,
+                                    std::vector<transport::MoveTarget> points,
+                                    TrajectoryOptions options = {});
+
+  // stop_goal / stop_all はキャンセル後すぐに優先レーンで停止を送り、
+  // その後でタスクの終了を待つ。
   bool stop_goal(const std::string &server_id, const std::string &cube_id);
   std::size_t stop_all();
+  // キャンセルフラグを立てるだけで終了は待たない (emergency_stop 用)。
+  std::size_t cancel_all();
   bool has_goal(const std::string &server_id,
                 const std::string &cube_id) const;
 
+  // 全タスク共通の制御周期の計測値 (周期開始の遅れ・計算時間・位置の古さ・
+  // 周期あたりのコマンド数)。set_loop_metrics_dump で周期ごとの値を
+  // JSON Lines に追記できる (空文字列で停止)。
+  LoopMetricsSnapshot loop_metrics() const;
+  void reset_loop_metrics();
+  void set_loop_metrics_dump(const std::string &path);
+
 private:
+  struct QueuedWaypoint {
+    Waypoint waypoint;
+    std::promise<GoalStatus> done;
+  };
+
   struct SharedGoal {
     GoalOptions options;
     mutable std::mutex mutex;
     std::atomic<bool> auto_stop_on_goal{true};
+    bool path_mode = false;
+    bool trajectory_mode = false;
+    bool finished = false;
+    std::deque<QueuedWaypoint> waypoints;
+    std::promise<GoalStatus> path_done;
+    std::shared_future<GoalStatus> path_future;
+    std::vector<transport::MoveTarget> trajectory;
+    TrajectoryOptions trajectory_options;
+    std::shared_ptr<TrajectoryProgress> progress;
+  };
+
+  struct SettleGuard;
+
+  // 全 Cube の位置を一様グリッドに載せたスナップショット。
+  // id が keys.size() 以上の要素は obstacles[id - keys.size()]。
+  struct NeighborIndex {
+    runtime::Clock::time_point built_at;
+    std::vector<std::string> keys;
+    SpatialGrid grid;
+    std::vector<Obstacle> obstacles;
+    std::uint64_t obstacle_version = 0;
+    // obstacles の最大半径。近傍探索の半径に足す。
+    double obstacle_reach = 0.0;
   };
 
   struct GoalTask {
+    std::string server_id;
+    std::string cube_id;
     std::shared_ptr<SharedGoal> shared_goal;
     std::shared_ptr<std::atomic<bool>> cancel_flag;
     std::future<void> worker;
   };
 
   toio::middleware::FleetManager &manager_;
+  // 待機と起動は FleetManager と同じ時計・Executor で行う。
+  runtime::Runtime runtime_;
   Logger logger_;
   mutable std::mutex log_mutex_;
+  LoopMetrics metrics_;
+
+  std::mutex neighbor_mutex_;
+  std::shared_ptr<const NeighborIndex> neighbor_index_;
+  std::shared_ptr<const ObstacleTracker> obstacles_;
 
   mutable std::mutex tasks_mutex_;
   std::unordered_map<std::string, GoalTask> tasks_;
@@ -77,6 +241,22 @@ private:
 
   void log(const std::string &key, const std::string &message) const;
 
+  void send_priority_stop(const std::string &server_id,
+                          const std::string &cube_id);
+  void launch_task(const std::string &server_id,
+                   const std::string &cube_id,
+                   std::shared_ptr<SharedGoal> shared_goal);
+  static std::vector<std::shared_future<GoalStatus>>
+  enqueue_waypoints(SharedGoal &goal, std::vector<Waypoint> waypoints);
+  static void settle_path(SharedGoal &goal, GoalStatus status);
+  bool ensure_connected(const std::string &server_id,
+                        const std::string &cube_id,
+                        const std::atomic<bool> &cancel_flag);
+
+  // refresh_interval より古ければ作り直す。radius はグリッドのセル幅。
+  std::shared_ptr<const NeighborIndex>
+  neighbor_index(std::chrono::milliseconds refresh_interval, double radius);
+
   std::optional<toio::middleware::CubeState>
   find_cube_state(const std::string &server_id,
                   const std::string &cube_id) const;
@@ -85,6 +265,10 @@ private:
                      const std::string &cube_id,
                      std::shared_ptr<SharedGoal> shared_goal,
                      std::shared_ptr<std::atomic<bool>> cancel_flag);
+  void run_trajectory_task(const std::string &server_id,
+                           const std::string &cube_id,
+                           std::shared_ptr<SharedGoal> shared_goal,
+                           std::shared_ptr<std::atomic<bool>> cancel_flag);
 };
 
 } // namespace toio::control
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "toio/middleware/fleet_manager.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace toio::control {
+
+struct LatencyCalibrationOptions {
+  // Cube ごとのステップ回数。
+  std::size_t trials = 10;
+  // ステップ指令の速度 (両輪)。奇数回目は逆向きにして元の位置へ戻す。
+  int speed = 40;
+  // move を duration 付きで送り、指令が残っても Cube 側で止まるようにする。
+  // 10〜2550 ms に丸める。
+  std::chrono::milliseconds step_duration{300};
+  // 動き出しが見えなければ取りこぼしとして数える。
+  std::chrono::milliseconds timeout{1500};
+  // 止めてから次のステップまでの待ち。
+  std::chrono::milliseconds settle{500};
+  // 位置の変化がこの距離 (マット座標) か角度 (度) を超えたら動き出しとみなす。
+  double onset_distance = 3.0;
+  int onset_angle = 3;
+  // 位置がまだない Cube には通知を要求し、この時間まで届くのを待つ。
+  std::chrono::milliseconds subscribe_wait{2000};
+  // cube_state を見直す間隔。通知の間隔 (10〜30 ms) より十分短くする。
+  std::chrono::milliseconds poll_interval{2};
+};
+
+// 1 回のステップの結果。
+struct LatencySample {
+  std::string server_id;
+  std::string cube_id;
+  std::size_t trial = 0;
+  bool detected = false;
+  // 動いた位置に Position::timestamp_ms があったか。古いリレーや最初の通知の
+  // 前は 0 なので、motion_ms と report_age_ms は測れない。
+  bool has_timestamp = false;
+  // 指令の送信から、動いた位置の Position::timestamp_ms まで。PC の送信時刻と
+  // リレーの時刻の差なので、両者の壁時計のずれがそのまま足される (リレーが
+  // 進んでいれば長く、遅れていれば短く出る)。ずれは測って引いていない。
+  double motion_ms = 0.0;
+  // 指令の送信から、その位置を受信して状態に反映するまで。
+  double observed_ms = 0.0;
+  // observed_ms - motion_ms。位置が PC に届くまでの時間 (時計のずれを含む)。
+  double report_age_ms = 0.0;
+};
+
+struct LatencyDistribution {
+  std::size_t count = 0;
+  double min = 0.0;
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p90 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+// Cube 単位・サーバー (リレー) 単位・全体の集計。cube_id が空なら集計行。
+struct LatencyGroup {
+  std::string server_id;
+  std::string cube_id;
+  std::size_t misses = 0;
+  LatencyDistribution motion;
+  LatencyDistribution observed;
+  LatencyDistribution report_age;
+};
+
+struct LatencyReport {
+  std::vector<LatencySample> samples;
+  std::vector<LatencyGroup> cubes;
+  std::vector<LatencyGroup> servers;
+  LatencyGroup overall;
+
+  // 推奨値。MotionPlannerParameters::lookahead_time には観測までの中央値、
+  // GoalOptions::lease_margin には動き出しまでの p99 を使う。timestamp_ms の
+  // ある標本がなければ lease_margin は観測までの p99 (報告の遅れを含む分だけ
+  // 長め) で代える。motion_ms から出した lease_margin には PC とリレーの
+  // 時計のずれが入るので、両方を NTP などでそろえてから測る。
+  double suggested_lookahead_s = 0.0;
+  std::chrono::milliseconds suggested_lease_margin{0};
+};
+
+// ステップ指令を送り、位置の流れから動き出しを見つけて指令からの遅れを測る。
+// 選んだ Cube には同時に指令を出す (実運用と同じくリレーを共有した状態で測る)。
+// Cube がマット上で止まっていること。時刻と待機は FleetManager の Runtime を
+// 使うので Simulation でも動く。
+class LatencyCalibrator {
+public:
+  explicit LatencyCalibrator(middleware::FleetManager &manager);
+
+  LatencyReport
+  run(const std::vector<std::pair<std::string, std::string>> &cubes,
+      const LatencyCalibrationOptions &options = {});
+
+private:
+  middleware::FleetManager &manager_;
+};
+
+void to_json(nlohmann::json &json, const LatencyDistribution &distribution);
+void to_json(nlohmann::json &json, const LatencyGroup &group);
+void to_json(nlohmann::json &json, const LatencyReport &report);
+
+} // namespace toio::control
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace toio::control {
+
+// 2 のべき乗区切りのヒストグラム。bucket 0 は値 0、bucket i (i>=1) は
+// [2^(i-1), 2^i) を数える。record はロックを取らない。
+class Histogram {
+public:
+  static constexpr std::size_t kBucketCount = 40;
+
+  struct Snapshot {
+    std::array<std::uint64_t, kBucketCount> buckets{};
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    double mean() const;
+    // q (0..1) を含む bucket の上限値。観測なしなら 0。
+    std::uint64_t percentile(double q) const;
+  };
+
+  void record(std::uint64_t value);
+  Snapshot snapshot() const;
+  void reset();
+
+  static std::size_t bucket_for(std::uint64_t value);
+  static std::uint64_t bucket_upper_bound(std::size_t bucket);
+
+private:
+  std::array<std::atomic<std::uint64_t>, kBucketCount> buckets_{};
+  std::atomic<std::uint64_t> count_{0};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+};
+
+// GoalController の 1 周期分の計測値。
+struct TickSample {
+  // 予定していた周期開始時刻からの遅れ (sleep_for のずれ)。
+  std::chrono::microseconds start_jitter{0};
+  // find_cube_state 単体の所要時間。
+  std::chrono::microseconds state_lookup{0};
+  // 状態取得から送信までの所要時間 (sleep を除く)。
+  std::chrono::microseconds compute{0};
+  // 判断に使った位置の古さ。位置がない周期では負値。
+  std::chrono::milliseconds state_age{-1};
+  int commands = 0;
+  bool has_jitter = false;
+  // 周期の開始時刻 (Clock::wall_now)。ダンプの t_us に使う。
+  std::chrono::system_clock::time_point started_at{};
+};
+
+struct LoopMetricsSnapshot {
+  std::uint64_t ticks = 0;
+  Histogram::Snapshot start_jitter_us;
+  Histogram::Snapshot state_lookup_us;
+  Histogram::Snapshot compute_us;
+  Histogram::Snapshot state_age_ms;
+  Histogram::Snapshot commands_per_tick;
+};
+
+class LoopMetrics {
+public:
+  void record(const std::string &key, const TickSample &sample);
+  LoopMetricsSnapshot snapshot() const;
+  void reset();
+
+  // path を指定すると、周期ごとの計測値を JSON Lines で追記する。
+  // 空文字列で停止。開けなければ std::runtime_error。
+  void set_dump_path(const std::string &path);
+
+private:
+  void dump(const std::string &key, const TickSample &sample);
+
+  std::atomic<std::uint64_t> ticks_{0};
+  Histogram start_jitter_us_;
+  Histogram state_lookup_us_;
+  Histogram compute_us_;
+  Histogram state_age_ms_;
+  Histogram commands_per_tick_;
+
+  std::atomic<bool> dump_enabled_{false};
+  std::mutex dump_mutex_;
+  std::ofstream dump_stream_;
+};
+
+void to_json(nlohmann::json &json, const Histogram::Snapshot &snapshot);
+void to_json(nlohmann::json &json, const LoopMetricsSnapshot &snapshot);
+
+} // namespace toio::control
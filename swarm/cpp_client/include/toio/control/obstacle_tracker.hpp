@@ -0,0 +1,74 @@
+#pragma once
+
+#include "toio/runtime/clock.hpp"
+#include "toio/transport/obstacle_message.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace toio::control {
+
+// 外部のトラッカーが見つけた人などの動く障害物。座標と速度はマット座標
+// (速度は 1 秒あたり)。
+struct Obstacle {
+  std::uint32_t id = 0;
+  double x = 0.0;
+  double y = 0.0;
+  double radius = 0.0;
+  double vx = 0.0;
+  double vy = 0.0;
+};
+
+// update が受け付ける範囲 (マット座標)。座標は Position ID の範囲、半径は
+// 人の集まり程度、速さは走る人より十分大きく取る。外れた値はグリッドのセルの
+// 計算をあふれさせたり、探索のたびにグリッド全体を見させたりする。
+inline constexpr double kMaxObstacleCoordinate = 65535.0;
+inline constexpr double kMaxObstacleRadius = 300.0;
+inline constexpr double kMaxObstacleSpeed = 5000.0;
+
+// 受信スレッドから update し、制御側は snapshot で読む。ttl のあいだ更新の
+// ない障害物は消えたものとして扱う (トラッカーが見失ったとき)。
+class ObstacleTracker {
+public:
+  explicit ObstacleTracker(
+      std::shared_ptr<runtime::Clock> clock = runtime::system_clock(),
+      std::chrono::milliseconds ttl = std::chrono::milliseconds(500));
+
+  // 同じ id があれば置き換える。有限でない値、|x| / |y| が
+  // kMaxObstacleCoordinate を超える、radius が 0〜kMaxObstacleRadius の外、
+  // 速さが kMaxObstacleSpeed を超える場合は std::invalid_argument。
+  void update(const Obstacle &obstacle);
+  bool remove(std::uint32_t id);
+  void clear();
+  // ObstacleReceiver などで受けた通知を反映する。
+  void apply(const transport::ObstacleMessage &message);
+
+  // ttl 内の障害物の数。
+  std::size_t size() const;
+  // update / remove / clear のたびに増える。
+  std::uint64_t version() const;
+
+  // ttl 内の障害物を id の昇順で返す。位置は最後の更新からの経過時間だけ
+  // 速度で進める。out は使い回せる。
+  void snapshot(std::vector<Obstacle> &out) const;
+  std::vector<Obstacle> snapshot() const;
+
+private:
+  struct Entry {
+    Obstacle obstacle;
+    runtime::Clock::time_point updated;
+  };
+
+  std::shared_ptr<runtime::Clock> clock_;
+  std::chrono::milliseconds ttl_;
+  mutable std::mutex mutex_;
+  std::map<std::uint32_t, Entry> entries_;
+  std::uint64_t version_ = 0;
+};
+
+} // namespace toio::control
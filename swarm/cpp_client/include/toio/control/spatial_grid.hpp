@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace toio::control {
+
+// 既定はプレイマットの座標範囲。
+struct GridBounds {
+  double min_x = 34.0;
+  double min_y = 35.0;
+  double max_x = 949.0;
+  double max_y = 898.0;
+};
+
+// マット座標上の一様グリッド。cell_size を相互作用半径程度にすると、
+// 近傍探索は周囲のセルだけを見ればよく、全体のコストは台数にほぼ比例する。
+// id は 0 から始まる連番を想定する。update / remove で位置を書き、rebuild で
+// セルごとに id の昇順に並べた 1 本の配列 (計数ソート) を作り直してから探索する。
+// 探索の順は位置を書いた順によらない。reserve(n) しておけば n 未満の id だけを
+// 使う限り、update / rebuild はメモリを確保しない。
+class SpatialGrid {
+public:
+  using Bounds = GridBounds;
+
+  struct Item {
+    std::size_t id = 0;
+    double x = 0.0;
+    double y = 0.0;
+  };
+
+  explicit SpatialGrid(double cell_size, Bounds bounds = {});
+
+  void reserve(std::size_t ids);
+  void clear();
+  // id の位置を書く。探索に反映されるのは rebuild のあと。
+  void update(std::size_t id, double x, double y);
+  void remove(std::size_t id);
+  void rebuild();
+  bool contains(std::size_t id) const;
+  std::size_t size() const;
+
+  double cell_size() const;
+  const Bounds &bounds() const;
+
+  // (x, y) から radius 以内に入りうるセルの要素を、セルの行ごとに列挙する。
+  // 距離の判定は呼び出し側で行う。fn(const Item &)。update / remove のあと
+  // rebuild していなければ std::logic_error。
+  template <typename Fn>
+  void for_each_candidate(double x, double y, double radius, Fn &&fn) const {
+    if (dirty_) {
+      throw std::logic_error("SpatialGrid: rebuild() before querying");
+    }
+    const int col_begin = column(x - radius);
+    const int col_end = column(x + radius);
+    const int row_begin = row(y - radius);
+    const int row_end = row(y + radius);
+    for (int r = row_begin; r <= row_end; ++r) {
+      // 同じ行のセルは items_ の上で続いている。
+      const auto first = static_cast<std::size_t>(r * columns_ + col_begin);
+      const auto last = static_cast<std::size_t>(r * columns_ + col_end);
+      const std::size_t begin = first == 0 ? 0 : cell_end_[first - 1];
+      const std::size_t end = cell_end_[last];
+      for (std::size_t k = begin; k < end; ++k) {
+        fn(items_[k]);
+      }
+    }
+  }
+
+  // radius 以内の要素だけを列挙する。
+  template <typename Fn>
+  void for_each_within(double x, double y, double radius, Fn &&fn) const {
+    const double radius_sq = radius * radius;
+    for_each_candidate(x, y, radius, [&](const Item &item) {
+      const double dx = item.x - x;
+      const double dy = item.y - y;
+      if (dx * dx + dy * dy <= radius_sq) {
+        fn(item);
+      }
+    });
+  }
+
+private:
+  static constexpr std::uint32_t kNoCell = 0xFFFFFFFFu;
+
+  struct Slot {
+    std::uint32_t cell = kNoCell;
+    double x = 0.0;
+    double y = 0.0;
+  };
+
+  int column(double x) const;
+  int row(double y) const;
+  std::uint32_t cell_of(double x, double y) const;
+
+  double cell_size_;
+  Bounds bounds_;
+  int columns_ = 1;
+  int rows_ = 1;
+  // id ごとの位置とセル。
+  std::vector<Slot> slots_;
+  // セル c の要素は items_[cell_end_[c - 1], cell_end_[c])。
+  std::vector<std::uint32_t> cell_end_;
+  std::vector<Item> items_;
+  std::size_t size_ = 0;
+  bool dirty_ = false;
+};
+
+} // namespace toio::control
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "toio/middleware/server_session.hpp"
+#include "toio/runtime/runtime.hpp"
+#include "toio/transport/connection.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace toio::fault {
+
+// 遅延のばらつき方。latency を下限に jitter をどう足すか。
+enum class LatencyDistribution {
+  Uniform,     // [0, jitter) の一様乱数
+  Normal,      // |N(0, jitter)|
+  Exponential, // 平均 jitter の指数分布 (まれに大きく遅れる)
+};
+
+// 障害中のメッセージの扱い。
+enum class OutageMode {
+  Drop, // 捨てる (UDP 的)
+  Hold, // 障害が明けるまで溜めて一気に流す (TCP の再送に近い)
+};
+
+// 片方向 (送信または受信) の回線の性質。既定値は素通し。
+struct LinkProfile {
+  std::chrono::microseconds latency{0};
+  std::chrono::microseconds jitter{0};
+  LatencyDistribution distribution = LatencyDistribution::Uniform;
+  // false なら jitter で追い越しが起きる。true なら送った順に届ける。
+  bool keep_order = false;
+  // メッセージごとの独立な欠落率。
+  double drop_rate = 0.0;
+  // バースト欠落 (Gilbert-Elliott)。メッセージごとに burst_enter の確率で
+  // 欠落状態に入り、burst_exit の確率で抜ける。欠落状態では全部捨てる。
+  double burst_enter = 0.0;
+  double burst_exit = 0.3;
+  // 帯域 [byte/s]。0 なら無制限。超えた分は順番待ちで遅れる。
+  double bandwidth = 0.0;
+
+  bool active() const;
+};
+
+struct FaultConfig {
+  // クライアント → リレー (write)。
+  LinkProfile uplink;
+  // リレー → クライアント (受信)。
+  LinkProfile downlink;
+  // 両方向が止まる障害。平均 outage_interval (指数分布) ごとに
+  // outage_duration だけ続く。0 なら起こさない。
+  std::chrono::milliseconds outage_interval{0};
+  std::chrono::milliseconds outage_duration{0};
+  OutageMode outage_mode = OutageMode::Drop;
+  std::uint64_t seed = 1;
+
+  bool active() const;
+};
+
+struct LinkStats {
+  std::uint64_t messages = 0;
+  std::uint64_t delivered = 0;
+  std::uint64_t dropped = 0;
+  std::uint64_t burst_dropped = 0;
+  std::uint64_t outage_dropped = 0;
+  std::uint64_t bytes = 0;
+  // 付けた遅延 (捨てたものは含まない)。
+  double delay_ms_total = 0.0;
+  double delay_ms_max = 0.0;
+};
+
+struct FaultStats {
+  LinkStats uplink;
+  LinkStats downlink;
+  std::uint64_t outages = 0;
+};
+
+// 遅延・欠落・障害・帯域を決める共有の状態。同じ injector から作った
+// FaultyConnection は障害のタイミングと乱数列を共有する (会場の Wi-Fi が
+// まとめて止まる想定)。設定は走らせながら set_config / start_outage で変えられる。
+// 時刻と遅延配送は runtime の Clock / Executor を使うので、Simulation の
+// VirtualClock 上でも決定的に動く。
+class FaultInjector {
+public:
+  enum class Direction { Uplink, Downlink };
+
+  // 1 本の接続の片方向ぶんの状態。
+  struct LinkState {
+    runtime::Clock::time_point free_at{};
+    runtime::Clock::time_point last_due{};
+    bool in_burst = false;
+  };
+
+  explicit FaultInjector(FaultConfig config = {}, runtime::Runtime runtime = {});
+
+  FaultInjector(const FaultInjector &) = delete;
+  FaultInjector &operator=(const FaultInjector &) = delete;
+
+  // 乱数列と障害の予定は引き継ぐ (seed は最初の 1 回だけ使う)。
+  void set_config(const FaultConfig &config);
+  FaultConfig config() const;
+  bool active(Direction direction) const;
+  // 今から duration だけ両方向を止める (シナリオからの明示的な障害)。
+  void start_outage(std::chrono::milliseconds duration);
+  bool in_outage() const;
+
+  FaultStats stats() const;
+  const runtime::Runtime &runtime() const;
+
+  // bytes のメッセージの配送時刻を決める。捨てるなら nullopt。
+  std::optional<runtime::Clock::time_point>
+  schedule(Direction direction, std::size_t bytes, LinkState &state);
+  void mark_delivered(Direction direction);
+
+private:
+  LinkStats &stats_for(Direction direction);
+  void advance_outages(runtime::Clock::time_point now);
+  runtime::Clock::duration sample_delay(const LinkProfile &profile);
+  runtime::Clock::duration sample_outage_gap();
+
+  runtime::Runtime runtime_;
+  mutable std::mutex mutex_;
+  FaultConfig config_;
+  std::mt19937_64 rng_;
+  bool outage_scheduled_ = false;
+  runtime::Clock::time_point next_outage_{};
+  runtime::Clock::time_point outage_end_{};
+  FaultStats stats_;
+};
+
+// inner の送受信を FaultInjector の決めた時刻まで遅らせ、欠落させる Connection。
+// 遅延中のメッセージは runtime の Executor で起こした配送タスクが順に流す。
+// injector が素通し設定で、待ちがなければそのまま inner に渡す。
+class FaultyConnection : public transport::Connection {
+public:
+  FaultyConnection(std::unique_ptr<transport::Connection> inner,
+                   std::shared_ptr<FaultInjector> injector);
+  ~FaultyConnection() override;
+
+  void open(ReceiveHandler on_message, LogHandler on_log) override;
+  void close() override;
+  bool is_open() const override;
+  void write(const std::string &text) override;
+
+private:
+  using Direction = FaultInjector::Direction;
+
+  struct Pending {
+    runtime::Clock::time_point due;
+    std::uint64_t order = 0;
+    Direction direction = Direction::Uplink;
+    std::string text;
+  };
+  struct Later {
+    bool operator()(const Pending &a, const Pending &b) const {
+      return a.due != b.due ? a.due > b.due : a.order > b.order;
+    }
+  };
+
+  void enqueue(Direction direction, std::string text);
+  void deliver(Pending &item);
+  void pump();
+  void stop_pump();
+
+  std::unique_ptr<transport::Connection> inner_;
+  std::shared_ptr<FaultInjector> injector_;
+  ReceiveHandler on_message_;
+  LogHandler on_log_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<Pending, std::vector<Pending>, Later> queue_;
+  FaultInjector::LinkState uplink_;
+  FaultInjector::LinkState downlink_;
+  std::uint64_t next_order_ = 0;
+  std::uint64_t generation_ = 0;
+  bool stopping_ = false;
+  std::future<void> pump_;
+  std::thread::id pump_thread_;
+};
+
+// inner (空なら WebSocket) が作る Connection を FaultyConnection で包む。
+middleware::ConnectionFactory
+fault_injection_factory(std::shared_ptr<FaultInjector> injector,
+                        middleware::ConnectionFactory inner = {});
+
+} // namespace toio::fault
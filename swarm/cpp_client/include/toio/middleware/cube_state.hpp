@@ -21,6 +21,13 @@ struct LedColor {
   std::uint8_t b = 0;
 };
 
+// move_to など目標指定コマンドの完了 result。
+struct TargetResult {
+  int request_id = -1;
+  bool success = false;
+  std::string message;
+};
+
 struct CubeState {
   std::string server_id;
   std::string cube_id;
@@ -28,6 +35,7 @@ struct CubeState {
   std::optional<Position> position;
   std::optional<int> battery_percent;
   LedColor led{};
+  std::optional<TargetResult> target_result;
   std::chrono::steady_clock::time_point last_update{};
 };
 
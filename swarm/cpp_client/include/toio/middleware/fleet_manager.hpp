@@ -2,6 +2,7 @@
 
 #include "toio/middleware/server_session.hpp"
 
+#include <chrono>
 #include <cstddef>
 #include <memory>
 #include <optional>
@@ -12,10 +13,29 @@
 
 namespace toio::middleware {
 
+struct StopLatency {
+  std::string server_id;
+  bool sent = false;
+  std::string error;
+  // emergency_stop() 呼び出しから、そのサーバーへの write 完了まで。
+  std::chrono::microseconds latency{0};
+};
+
+struct EmergencyStopReport {
+  std::size_t cubes = 0;
+  std::vector<StopLatency> servers;
+  std::chrono::microseconds total{0};
+};
+
 class FleetManager {
 public:
-  FleetManager();
-  explicit FleetManager(std::vector<ServerConfig> configs);
+  // runtime は全セッションと GoalController が共有する時計とタスク実行。
+  // connect を渡すと WebSocket の代わりにその Connection を使う。
+  explicit FleetManager(runtime::Runtime runtime = {},
+                        ConnectionFactory connect = {});
+  explicit FleetManager(std::vector<ServerConfig> configs,
+                        runtime::Runtime runtime = {},
+                        ConnectionFactory connect = {});
   ~FleetManager();
 
   FleetManager(const FleetManager &) = delete;
@@ -24,6 +44,7 @@ public:
   void apply_config(std::vector<ServerConfig> configs);
   void start();
   void stop();
+  const runtime::Runtime &runtime() const;
 
   std::vector<std::string> server_ids() const;
   bool has_server(const std::string &server_id) const;
@@ -45,9 +66,31 @@ public:
             int left_speed,
             int right_speed,
             std::optional<bool> require_result = std::nullopt);
+  bool move_for(const std::string &server_id,
+                const std::string &cube_id,
+                int left_speed,
+                int right_speed,
+                std::chrono::milliseconds duration,
+                std::optional<bool> require_result = std::nullopt);
+  std::optional<int> move_to(const std::string &server_id,
+                             const std::string &cube_id,
+                             const transport::MoveTarget &goal,
+                             int max_speed,
+                             transport::MoveType move_type,
+                             std::optional<bool> require_result = std::nullopt);
+  std::optional<int>
+  move_to_multi(const std::string &server_id,
+                const std::string &cube_id,
+                const std::vector<transport::MoveTarget> &goals,
+                int max_speed,
+                transport::MoveType move_type,
+                bool append,
+                std::optional<bool> require_result = std::nullopt);
   std::size_t move_all(int left_speed,
                        int right_speed,
                        std::optional<bool> require_result = std::nullopt);
+  bool stop_cube(const std::string &server_id, const std::string &cube_id);
+  EmergencyStopReport emergency_stop();
   bool set_led(const std::string &server_id,
                const std::string &cube_id,
                const LedColor &color,
@@ -67,6 +110,11 @@ public:
   std::size_t toggle_subscription_all(bool enable);
 
   std::vector<CubeSnapshot> snapshot() const;
+  // 1 台分の状態。サーバーまたは Cube が未登録なら std::nullopt。
+  std::optional<CubeState> cube_state(const std::string &server_id,
+                                      const std::string &cube_id) const;
+  // server_id ごとのレート制限カウンタ。
+  std::unordered_map<std::string, RateLimitStats> rate_limit_stats() const;
 
   void set_state_callback(ServerSession::StateCallback callback);
   void set_message_callback(ServerSession::MessageCallback callback);
@@ -75,6 +123,8 @@ private:
   ServerSession *find_session(const std::string &server_id);
   const ServerSession *find_session(const std::string &server_id) const;
 
+  runtime::Runtime runtime_;
+  ConnectionFactory connect_;
   std::unordered_map<std::string, std::unique_ptr<ServerSession>> sessions_;
   std::optional<std::pair<std::string, std::string>> active_target_;
   ServerSession::StateCallback state_callback_;
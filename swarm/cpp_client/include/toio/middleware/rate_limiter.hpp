@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace toio::middleware {
+
+// Cube ごとの送信レート制限。BLE は 1 接続インターバルに 1 write しか
+// 届けられないため、それより速い送信はリレー側のキューを伸ばすだけになる。
+struct RateLimitConfig {
+  bool enabled = false;
+  // トークンの補充間隔。BLE の接続インターバルに合わせる。
+  std::chrono::milliseconds interval{50};
+  // 連続して即時送信できる最大数。
+  int burst = 1;
+};
+
+struct RateLimitStats {
+  std::uint64_t sent = 0;     // トークンがあり即時送信した数
+  std::uint64_t deferred = 0; // 保留後、トークン補充時に送信した数
+  std::uint64_t merged = 0;   // 保留中の値を新しい値で上書きした数
+  std::uint64_t dropped = 0;  // 停止や move_to などで送信せず破棄した数
+};
+
+class TokenBucket {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TokenBucket(std::chrono::milliseconds interval,
+              int burst,
+              Clock::time_point now = Clock::now());
+
+  bool try_consume(Clock::time_point now);
+  // 次のトークンが使えるようになる時刻 (すでに使えれば now)。
+  Clock::time_point next_available(Clock::time_point now);
+
+private:
+  void refill(Clock::time_point now);
+
+  Clock::duration interval_;
+  double capacity_;
+  double tokens_;
+  Clock::time_point last_refill_;
+};
+
+} // namespace toio::middleware
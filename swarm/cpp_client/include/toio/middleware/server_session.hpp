@@ -1,9 +1,18 @@
 #pragma once
 
 #include "toio/middleware/cube_state.hpp"
-
+#include "toio/middleware/rate_limiter.hpp"
+#include "toio/runtime/runtime.hpp"
+#include "toio/transport/move_target.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <shared_mutex>
 #include <string>
@@ -13,7 +22,9 @@
 #include <nlohmann/json.hpp>
 
 namespace toio::transport {
+class Connection;
 class ToioClient;
+struct PriorityStats;
 }
 
 namespace toio::middleware {
@@ -31,16 +42,23 @@ struct ServerConfig {
   std::string port;
   std::string endpoint = "/ws";
   bool default_require_result = false;
+  RateLimitConfig rate_limit;
   std::vector<CubeConfig> cubes;
 };
 
+// ServerConfig に対応する Connection を作る。空なら host/port への WebSocket。
+using ConnectionFactory =
+    std::function<std::unique_ptr<transport::Connection>(const ServerConfig &)>;
+
 class ServerSession {
 public:
   using StateCallback = std::function<void(const CubeState &)>;
   using MessageCallback =
       std::function<void(const std::string &, const nlohmann::json &)>;
 
-  explicit ServerSession(ServerConfig config);
+  explicit ServerSession(ServerConfig config,
+                         runtime::Runtime runtime = {},
+                         const ConnectionFactory &connect = {});
   ~ServerSession();
 
   ServerSession(const ServerSession &) = delete;
@@ -58,6 +76,22 @@ public:
                  int left_speed,
                  int right_speed,
                  std::optional<bool> require_result = std::nullopt);
+  void send_move_for(const std::string &cube_id,
+                     int left_speed,
+                     int right_speed,
+                     std::chrono::milliseconds duration,
+                     std::optional<bool> require_result = std::nullopt);
+  int send_move_to(const std::string &cube_id,
+                   const transport::MoveTarget &goal,
+                   int max_speed,
+                   transport::MoveType move_type,
+                   std::optional<bool> require_result = std::nullopt);
+  int send_move_to_multi(const std::string &cube_id,
+                         const std::vector<transport::MoveTarget> &goals,
+                         int max_speed,
+                         transport::MoveType move_type,
+                         bool append,
+                         std::optional<bool> require_result = std::nullopt);
   void set_led(const std::string &cube_id,
                const LedColor &color,
                std::optional<bool> require_result = std::nullopt);
@@ -65,8 +99,18 @@ public:
   void query_position(const std::string &cube_id,
                       std::optional<bool> notify);
 
+  // 優先レーン経由の停止。emergency_stop は管理下の全 Cube を 1 フレームで止める。
+  void stop_cube(const std::string &cube_id);
+  void emergency_stop();
+  transport::PriorityStats priority_stats() const;
+  // rate_limit 有効時、move / led は Cube ごとのトークンバケットを通り、
+  // トークン切れの間は最新値だけを保留して補充時に送る。
+  RateLimitStats rate_limit_stats() const;
+
   bool has_cube(const std::string &cube_id) const;
   CubeState get_state(const std::string &cube_id) const;
+  // 未登録なら std::nullopt (全体の snapshot を作らずに 1 台分だけ引く)。
+  std::optional<CubeState> find_state(const std::string &cube_id) const;
   std::vector<std::string> cube_ids() const;
   std::vector<CubeSnapshot> snapshot() const;
 
@@ -77,14 +121,52 @@ private:
   void handle_message(const nlohmann::json &json);
   void update_state(const std::string &cube_id,
                     const std::function<void(CubeState &)> &mutator);
+  int next_request_id();
+  // 新しい move_to を送る前に、前のコマンドの完了 result を捨てる。
+  // request_id は 1 byte で一巡するため、残しておくと新しい要求と取り違える。
+  void clear_target_result(const std::string &cube_id);
+
+  enum class Channel { Motion, Led };
+  struct CubeLimiter {
+    CubeLimiter(const RateLimitConfig &config,
+                TokenBucket::Clock::time_point now)
+        : bucket(config.interval, config.burst, now) {}
+    TokenBucket bucket;
+    std::function<void()> pending_motion;
+    std::function<void()> pending_led;
+    // 停止などで保留中の motion を破棄するたびに進める。
+    std::uint64_t motion_generation = 0;
+  };
+
+  void submit_limited(const std::string &cube_id,
+                      Channel channel,
+                      std::function<void()> send);
+  // 保留中の motion を破棄し、トークンを 1 つ消費する (あれば)。
+  void bypass_limited_motion(const std::string &cube_id);
+  void discard_pending_motion(const std::string &cube_id);
+  CubeLimiter &limiter_for(const std::string &cube_id);
+  void flush_loop();
+  void stop_flusher();
 
   ServerConfig config_;
+  runtime::Runtime runtime_;
   std::unique_ptr<transport::ToioClient> client_;
   StateCallback state_callback_;
   MessageCallback message_callback_;
 
   mutable std::shared_mutex state_mutex_;
   std::unordered_map<std::string, CubeState> states_;
+  std::atomic<int> request_counter_{0};
+
+  mutable std::mutex limiter_mutex_;
+  std::condition_variable limiter_cv_;
+  std::unordered_map<std::string, CubeLimiter> limiters_;
+  RateLimitStats limit_stats_;
+  bool flusher_stopping_ = false;
+  bool flush_requested_ = false;
+  // フラッシャーの送信と停止の順序を揃える。
+  std::mutex flush_mutex_;
+  std::future<void> flusher_;
 };
 
 } // namespace toio::middleware
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "toio/planning/motion_planner.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace toio::planning {
+
+enum class AssignmentMethod {
+  // 台数で選ぶ (hungarian_limit 以下は Hungarian、auction_limit 以下は
+  // Auction、それより多ければ Greedy)。
+  Auto,
+  // 厳密解。O(N^2 M)。
+  Hungarian,
+  // Bertsekas のオークション。前回の価格から始めると少しだけ変わった
+  // 割り当てをすぐに解き直せる。解は最適から tolerance 以内。
+  Auction,
+  // 近い組から順に決め、近所どうしの入れ替えで直す。最適の保証はない。
+  Greedy,
+};
+
+enum class AssignmentObjective {
+  // 移動距離の合計。
+  TotalDistance,
+  // 移動距離の 2 乗の合計。直線で動くなら経路同士が交差しない。
+  TotalSquared,
+  // 最も遠くまで動く Cube の距離 (変形の所要時間) を最小にし、その中で
+  // 2 乗の合計を最小にする。Greedy では TotalSquared と同じ。
+  MaxDistance,
+};
+
+struct AssignmentOptions {
+  AssignmentMethod method = AssignmentMethod::Auto;
+  AssignmentObjective objective = AssignmentObjective::TotalSquared;
+  std::size_t hungarian_limit = 300;
+  std::size_t auction_limit = 3000;
+  // Auction の打ち切り。コストの合計が最適から tolerance * (最大コスト)
+  // 以内に入るまで ε を縮める。
+  double auction_tolerance = 1e-3;
+  // Greedy の入れ替えを繰り返す回数。
+  std::size_t greedy_passes = 2;
+};
+
+struct Assignment {
+  // agents[i] が向かう targets の添字。
+  std::vector<std::size_t> target_of;
+  double total_distance = 0.0;
+  double max_distance = 0.0;
+  // Auto のときは実際に使った方法。
+  AssignmentMethod method = AssignmentMethod::Auto;
+  // Hungarian は増加路、Auction は入札、Greedy は入れ替えの回数。
+  std::uint64_t iterations = 0;
+};
+
+// 隊形の目標点を Cube に割り当てる。添字の順に割り当てると隊形の
+// 切り替えで Cube がマットを横切って互いの経路を切るので、移動距離が
+// 最小になる組を選ぶ。
+class TargetAssigner {
+public:
+  explicit TargetAssigner(AssignmentOptions options = {});
+
+  const AssignmentOptions &options() const;
+  void set_options(const AssignmentOptions &options);
+
+  // agents[i] ごとに targets の 1 点を重ならないように選ぶ。agents が
+  // targets より多ければ std::invalid_argument。参照は次の assign まで有効。
+  const Assignment &assign(std::span<const TargetPoint> agents,
+                           std::span<const TargetPoint> targets);
+  // 位置から直接割り当てる。
+  const Assignment &assign(std::span<const middleware::Position> agents,
+                           std::span<const TargetPoint> targets);
+
+  // Auction の前回の価格を捨てる (次は最初から解く)。
+  void reset();
+
+private:
+  AssignmentMethod choose(std::size_t agents) const;
+  void solve_hungarian(double limit_sq);
+  void solve_auction(double limit_sq);
+  void solve_greedy();
+  double bottleneck_sq();
+  bool has_matching(double limit_sq);
+  double cost(std::size_t agent, std::size_t target) const;
+  void finish();
+
+  AssignmentOptions options_;
+  std::vector<TargetPoint> agents_;
+  std::vector<TargetPoint> targets_;
+  std::vector<TargetPoint> positions_;
+  Assignment result_;
+  // Auction の価格。次の assign で targets の数が同じなら引き継ぐ。
+  std::vector<double> prices_;
+  // 作業領域。
+  std::vector<double> scratch_;
+  std::vector<std::size_t> owner_;
+  std::vector<std::size_t> queue_;
+};
+
+} // namespace toio::planning
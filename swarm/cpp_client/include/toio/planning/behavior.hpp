@@ -0,0 +1,107 @@
+#pragma once
+
+#include "toio/control/obstacle_tracker.hpp"
+#include "toio/middleware/cube_state.hpp"
+#include "toio/planning/motion_planner.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace toio::planning {
+
+// BehaviorRuntime が step ごとに Behavior へ渡す入力。座標と速度は Cube ごとの
+// 配列 (SoA) で、速度は前の step の位置との差から求めたもの。positions は
+// 既存のプランナーに渡す用の同じ位置。
+struct BehaviorFrame {
+  std::span<const middleware::Position> positions;
+  std::span<const double> x;
+  std::span<const double> y;
+  std::span<const double> vx;
+  std::span<const double> vy;
+  std::span<const control::Obstacle> obstacles;
+  // BehaviorRuntime の最初の step からの秒。
+  double time = 0.0;
+  double dt = 0.0;
+};
+
+// テーマごとの群れの振る舞い (プラグイン)。状態は reserve で確保し、enter と
+// step ではメモリを確保しない。時刻は持たず、BehaviorRuntime の step で進む。
+class Behavior {
+public:
+  virtual ~Behavior() = default;
+
+  virtual std::string_view name() const = 0;
+  // count 台分の状態と作業領域を確保する。
+  virtual void reserve(std::size_t count) = 0;
+  // 切り替えで動き始める直前に呼ぶ。いまの位置と速度から状態を作り直す。
+  virtual void enter(const BehaviorFrame &frame) = 0;
+  // frame.x.size() 台分の目標を target_x / target_y に書く。
+  virtual void step(const BehaviorFrame &frame, std::span<double> target_x,
+                    std::span<double> target_y) = 0;
+};
+
+// 複数の Behavior を持ち、1 つを動かす。switch_to で次の Behavior を始め、
+// fade 秒かけて目標を前の Behavior から移す (その間は両方を step する)。
+// reserve のあとは、switch_to と step でメモリを確保しない。
+class BehaviorRuntime {
+public:
+  // 追加した順の番号を返す。最初に追加したものが動いている状態から始まる。
+  // 名前が重複していれば std::invalid_argument。
+  std::size_t add(std::unique_ptr<Behavior> behavior);
+  std::size_t size() const;
+  Behavior &behavior(std::size_t index);
+  // name の番号。なければ std::out_of_range。
+  std::size_t find(std::string_view name) const;
+
+  // 全 Behavior と作業領域を count 台分確保する。
+  void reserve(std::size_t count);
+
+  // index へ fade 秒かけて切り替える。fade <= 0 ならすぐに切り替える。
+  // 重みは smoothstep で移す。切り替え中に呼ぶと、重みの大きいほうを
+  // 切り替え元として新しい切り替えを始める。
+  void switch_to(std::size_t index, double fade);
+  // いま目標を出している (切り替え先がいればそちらの) Behavior。
+  std::size_t current() const;
+  bool fading() const;
+  // 切り替え先の重み (0..1)。切り替え中でなければ 1。
+  double fade_weight() const;
+
+  // dt 秒進めて positions[i] ごとの目標を返す。参照は次の step まで有効。
+  // reserve より多い台数は std::invalid_argument、dt <= 0 も同じ。
+  const std::vector<TargetPoint> &
+  step(std::span<const middleware::Position> positions, double dt,
+       std::span<const control::Obstacle> obstacles = {});
+
+  std::uint64_t steps() const;
+
+private:
+  std::vector<std::unique_ptr<Behavior>> behaviors_;
+  std::size_t capacity_ = 0;
+  std::size_t current_ = 0;
+  // 切り替え元。切り替え中でなければ current_ と同じ。
+  std::size_t previous_ = 0;
+  double fade_elapsed_ = 0.0;
+  double fade_duration_ = 0.0;
+  // current_ の enter を次の step で呼ぶ。
+  bool needs_enter_ = true;
+  double time_ = 0.0;
+  std::uint64_t steps_ = 0;
+  // Cube ごとの入力と出力 (SoA)。
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> vx_;
+  std::vector<double> vy_;
+  std::vector<double> current_x_;
+  std::vector<double> current_y_;
+  std::vector<double> previous_x_;
+  std::vector<double> previous_y_;
+  std::vector<TargetPoint> targets_;
+  std::size_t count_ = 0;
+};
+
+} // namespace toio::planning
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "toio/middleware/cube_state.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace toio::planning {
+
+// キーフレームから次のキーフレームまでの補間。
+enum class Ease {
+  Linear,
+  // 次のキーフレームまで値を保つ。
+  Step,
+  // 両端で速度 0 (smoothstep)。
+  Smooth,
+};
+
+struct Keyframe {
+  // ショーの開始からの秒。
+  double t = 0.0;
+  double x = 0.0;
+  double y = 0.0;
+  // 度。補間は近い向きに回る。
+  double angle = 0.0;
+  middleware::LedColor led{};
+  // この点から次の点までの補間。
+  Ease ease = Ease::Linear;
+};
+
+// 1 台分のキーフレーム列。cube が空なら再生側で添字順の Cube に割り当てる。
+struct ChoreographyTrack {
+  std::string cube;
+  std::vector<Keyframe> keyframes;
+};
+
+// コンパイル済みの 1 コマ分の姿勢と LED。
+struct ChoreographyPose {
+  float x = 0.0f;
+  float y = 0.0f;
+  float angle = 0.0f;
+  middleware::LedColor led{};
+};
+
+// frame_rate の刻みで全コマを前もって補間した表。frame_at(t) も pose も
+// O(1) で、再生中に補間や探索をしない。1 コマの全 Cube が連続して並ぶ。
+class ChoreographyTable {
+public:
+  ChoreographyTable() = default;
+  ChoreographyTable(double frame_rate, std::size_t frames, std::size_t tracks,
+                    std::vector<ChoreographyPose> poses);
+
+  double frame_rate() const;
+  std::size_t frames() const;
+  std::size_t tracks() const;
+  // 最後のコマの時刻 [s]。
+  double duration() const;
+
+  // t 秒に最も近いコマ。範囲の外は最初 / 最後のコマ。
+  std::size_t frame_at(double t) const;
+  const ChoreographyPose &pose(std::size_t frame, std::size_t track) const;
+  // frame の全トラック分 (tracks() 個)。
+  const ChoreographyPose *frame(std::size_t frame) const;
+
+private:
+  double frame_rate_ = 1.0;
+  std::size_t frames_ = 0;
+  std::size_t tracks_ = 0;
+  std::vector<ChoreographyPose> poses_;
+};
+
+// キーフレームで書いた振り付け。
+//   {"frame_rate": 50,
+//    "tracks": [{"cube": "A01",
+//                "keyframes": [{"t": 0, "x": 200, "y": 300, "angle": 0,
+//                               "led": [255, 0, 0], "ease": "linear"}, ...]}]}
+// frame_rate (既定 50 Hz)、cube、angle、led、ease は省略できる。angle と
+// led を省略したキーフレームは前のキーフレームの値を引き継ぐ。
+class Choreography {
+public:
+  Choreography() = default;
+  // トラックごとに keyframes を時刻順に並べ直す。時刻が負・有限でない、
+  // キーフレームのないトラックがあれば std::invalid_argument。
+  explicit Choreography(std::vector<ChoreographyTrack> tracks,
+                        double frame_rate = 50.0);
+
+  // 形式が違えば std::invalid_argument。
+  static Choreography from_json(const nlohmann::json &json);
+  // 読めなければ std::runtime_error。
+  static Choreography load(const std::string &path);
+
+  const std::vector<ChoreographyTrack> &tracks() const;
+  double frame_rate() const;
+  // 最も遅いキーフレームの時刻 [s]。
+  double duration() const;
+
+  // frame_rate の刻みで補間した表を作る。最初のキーフレームより前は
+  // その姿勢、最後より後は最後の姿勢を保つ。表が大きすぎれば
+  // std::invalid_argument。
+  ChoreographyTable compile() const;
+
+private:
+  std::vector<ChoreographyTrack> tracks_;
+  double frame_rate_ = 50.0;
+};
+
+} // namespace toio::planning
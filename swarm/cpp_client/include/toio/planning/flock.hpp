@@ -0,0 +1,146 @@
+#pragma once
+
+#include "toio/control/spatial_grid.hpp"
+#include "toio/middleware/cube_state.hpp"
+#include "toio/planning/flow_field.hpp"
+#include "toio/planning/motion_planner.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace toio::planning {
+
+// 加速度の係数は マット座標/s^2 (速度差や距離に掛けるものは 1/s, 1/s^2)。
+struct FlockParameters {
+  double field_min_x = 34.0;
+  double field_min_y = 35.0;
+  double field_max_x = 949.0;
+  double field_max_y = 898.0;
+  // 目標をフィールドの端からこれだけ内側に収める。
+  double safety_margin = 40.0;
+
+  // 同じグループの Cube を仲間として見る半径。
+  double neighbor_radius = 160.0;
+  // これより近い Cube からはグループに関係なく離れる。
+  double separation_radius = 70.0;
+  double separation_gain = 450.0;
+  // 仲間の平均速度に合わせる強さ [1/s]。
+  double alignment_gain = 1.0;
+  // 仲間の重心に寄る強さ [1/s^2]。
+  double cohesion_gain = 0.6;
+
+  // 他のグループの Cube をこの半径で避ける。分かれたグループを引き離す。
+  double group_separation_radius = 180.0;
+  double group_separation_gain = 250.0;
+  // 0 より大きければ、ゴールのないグループ同士の重心がこの距離に入ったら
+  // 1 つにまとめる (番号の小さい方に寄せる)。
+  double auto_merge_distance = 0.0;
+
+  // ゴールへは cruise_speed で向かい、arrival_radius の内側で減速する。
+  double goal_gain = 1.2;
+  double cruise_speed = 110.0;
+  double arrival_radius = 150.0;
+
+  double boundary_margin = 90.0;
+  double boundary_gain = 600.0;
+  // 加速度に足す正規乱数の標準偏差。ゴールのない群れをさまよわせる。
+  double wander_sigma = 60.0;
+  // set_flow の流れの速度に合わせる強さ [1/s]。
+  double flow_gain = 0.8;
+
+  double max_accel = 500.0;
+  double max_speed = 150.0;
+  double lookahead_time = 0.35;
+
+  std::uint32_t seed = 1;
+};
+
+// Boids (分離・整列・結合) にグループごとのゴールと分裂・合流を足した群れ。
+// Cube の状態は SoA で持ち、近傍探索は SpatialGrid を使う。MotionPlanner と
+// 同じく時刻を持たず step(dt) で進め、同じ種と入力なら出力は一致する。
+class Flock {
+public:
+  using GroupId = std::uint32_t;
+
+  explicit Flock(FlockParameters params = {});
+
+  const FlockParameters &parameters() const;
+  // 係数だけを差し替える。フィールドと近傍半径はグリッドを作り直す。
+  void set_parameters(const FlockParameters &params);
+
+  // 台数を変える。増えた Cube はグループ 0・速度 0 から始まる。
+  void resize(std::size_t count);
+  std::size_t size() const;
+
+  void set_group(std::size_t agent, GroupId group);
+  GroupId group(std::size_t agent) const;
+  // group に属する台数。
+  std::size_t group_size(GroupId group) const;
+
+  void set_goal(GroupId group, TargetPoint goal);
+  void clear_goal(GroupId group);
+  std::optional<TargetPoint> goal(GroupId group) const;
+
+  // group を直前の step の重心を通る直線で 2 つに分け、direction (rad) の向きに
+  // ある半分を new_group に移す。移した台数を返す。
+  std::size_t split(GroupId group, GroupId new_group, double direction);
+  // from の Cube をすべて into に移す。from のゴールは消す。
+  void merge(GroupId from, GroupId into);
+
+  // 各 Cube の位置の流れの速度に flow_gain で寄せる。nullptr で外す。
+  void set_flow(std::shared_ptr<const FlowBlender> flow);
+
+  // 乱数列を seed からやり直し、速度を 0 に戻す。グループとゴールは残す。
+  void reset(std::uint32_t seed);
+
+  // dt 秒進めて positions[i] ごとの目標を返す。参照は次の step まで有効。
+  // positions の台数が size() と違えば resize する。dt <= 0 は std::invalid_argument。
+  const std::vector<TargetPoint> &
+  step(std::span<const middleware::Position> positions, double dt);
+
+  std::uint64_t steps() const;
+
+private:
+  struct GroupState {
+    std::optional<TargetPoint> goal;
+    std::size_t count = 0;
+    double sum_x = 0.0;
+    double sum_y = 0.0;
+  };
+
+  void ensure_group(GroupId group);
+  void rebuild_grid();
+  void update_centroids();
+  void auto_merge();
+  void accumulate(std::size_t i);
+  void add_boundary(std::size_t i);
+  double min_x() const;
+  double max_x() const;
+  double min_y() const;
+  double max_y() const;
+
+  FlockParameters params_;
+  control::SpatialGrid grid_;
+  // Cube ごとの状態 (SoA)。
+  std::vector<double> x_;
+  std::vector<double> y_;
+  std::vector<double> vx_;
+  std::vector<double> vy_;
+  std::vector<GroupId> group_;
+  // step ごとに使い回す作業領域。
+  std::vector<double> ax_;
+  std::vector<double> ay_;
+  std::vector<TargetPoint> targets_;
+  std::vector<GroupState> groups_;
+  std::shared_ptr<const FlowBlender> flow_;
+  std::mt19937 rng_;
+  std::normal_distribution<double> normal_dist_;
+  std::uint64_t steps_ = 0;
+};
+
+} // namespace toio::planning
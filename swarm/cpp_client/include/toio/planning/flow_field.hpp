@@ -0,0 +1,113 @@
+#pragma once
+
+#include "toio/control/spatial_grid.hpp"
+#include "toio/planning/orca.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace toio::planning {
+
+// マット上の格子点に速度 (マット座標/s) を焼いたベクトル場。格子点は
+// bounds の四隅を含む columns x rows 点で、sample は周囲 4 点の双線形補間
+// なので 1 点あたり O(1)。範囲の外は縁の値を使う。
+class FlowField {
+public:
+  using Function = std::function<Vec2(double x, double y)>;
+
+  // 全点 0 の場。cell_size は格子点の間隔の目安 (実際は範囲を割り切る値)。
+  explicit FlowField(control::GridBounds bounds = {}, double cell_size = 25.0);
+  // columns x rows 点の値を行優先 (y が外側) で渡す。点数が合わなければ
+  // std::invalid_argument。
+  FlowField(control::GridBounds bounds, std::size_t columns, std::size_t rows,
+            std::vector<Vec2> vectors);
+
+  // fn を各格子点で評価して焼く。
+  static FlowField bake(const Function &fn, control::GridBounds bounds = {},
+                        double cell_size = 25.0);
+  // {"bounds": {"min_x", "min_y", "max_x", "max_y"}, "columns": C, "rows": R,
+  //  "vectors": [[vx, vy], ...], "scale": 1.0}。bounds と scale は省略できる。
+  // 形式が違えば std::invalid_argument。
+  static FlowField from_json(const nlohmann::json &json);
+  // 拡張子で読み分ける。.json は from_json、.ppm (P6) は画素の R / G を
+  // x / y 成分として 0..255 を -scale..scale に割り当て、画像の左上を
+  // bounds の (min_x, min_y) に合わせる。読めなければ std::runtime_error。
+  static FlowField load(const std::string &path, double scale = 100.0,
+                        control::GridBounds bounds = {});
+
+  const control::GridBounds &bounds() const;
+  std::size_t columns() const;
+  std::size_t rows() const;
+  // 格子点 (column, row) の値。
+  const Vec2 &at(std::size_t column, std::size_t row) const;
+  Vec2 &at(std::size_t column, std::size_t row);
+
+  Vec2 sample(double x, double y) const;
+
+private:
+  control::GridBounds bounds_;
+  std::size_t columns_ = 2;
+  std::size_t rows_ = 2;
+  double inv_step_x_ = 0.0;
+  double inv_step_y_ = 0.0;
+  std::vector<Vec2> vectors_;
+};
+
+// 焼いたベクトル場を重みつきで足し合わせる。crossfade で重みを時間とともに
+// 移し替える。時刻は持たず、呼び出し側が advance(dt) で進める。
+class FlowBlender {
+public:
+  // 追加した順の番号を返す。最初の 1 枚の重みは 1、以降は 0。
+  std::size_t add(std::shared_ptr<const FlowField> field);
+  std::size_t size() const;
+
+  // 重みを直接決める。進行中の crossfade は止める。
+  void set_weight(std::size_t index, double weight);
+  double weight(std::size_t index) const;
+  // いまの重みから、index だけが 1 の重みへ duration 秒かけて線形に移る。
+  // duration <= 0 ならすぐに切り替える。
+  void crossfade(std::size_t index, double duration);
+  bool fading() const;
+  void advance(double dt);
+
+  // 重みが 0 でない場の和。
+  Vec2 sample(double x, double y) const;
+
+private:
+  struct Layer {
+    std::shared_ptr<const FlowField> field;
+    double weight = 0.0;
+    double from = 0.0;
+    double to = 0.0;
+  };
+
+  void check(std::size_t index) const;
+
+  std::vector<Layer> layers_;
+  double fade_elapsed_ = 0.0;
+  double fade_duration_ = 0.0;
+};
+
+// よく使う形。bake に渡す。
+namespace flow {
+
+// どこでも同じ速度。
+FlowField::Function uniform(Vec2 velocity);
+// (cx, cy) のまわりを回る流れ。speed > 0 で画面上の時計回り (y 下向き)。
+// 中心から radius で最大になり、中心と遠方で弱まる。
+FlowField::Function vortex(Vec2 center, double speed, double radius);
+// (cx, cy) へ向かう流れ (speed < 0 で湧き出し)。radius の内側で減速する。
+FlowField::Function attractor(Vec2 center, double speed, double radius);
+// direction (rad) へ進みながら、横に wavelength の周期で揺れる流れ
+// (草原を渡る風)。
+FlowField::Function wave(double direction, double speed, double amplitude,
+                         double wavelength);
+
+} // namespace flow
+
+} // namespace toio::planning
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "toio/control/obstacle_tracker.hpp"
+#include "toio/control/spatial_grid.hpp"
+#include "toio/middleware/cube_state.hpp"
+#include "toio/planning/flow_field.hpp"
+#include "toio/planning/orca.hpp"
+#include "toio/runtime/thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace toio::planning {
+
+struct TargetPoint {
+  double x = 0.0;
+  double y = 0.0;
+};
+
+// 反発のあとで Cube 同士の衝突をどう防ぐか。
+enum class Avoidance {
+  // collision_stop_distance の内側で速度を縮める。
+  Brake,
+  // 反発後の速度を希望速度として ORCA で衝突しない速度に直す。
+  Orca,
+};
+
+struct MotionPlannerParameters {
+  double field_min_x = 34.0;
+  double field_min_y = 35.0;
+  double field_max_x = 949.0;
+  double field_max_y = 898.0;
+  double safety_margin = 50.0;
+
+  double random_theta = 0.8;
+  double random_sigma = 120.0;
+  double random_speed_limit = 150.0;
+  double random_bias_x = 0.0;
+  double random_bias_y = 0.0;
+  // set_flow の流れを random_bias に足すときの倍率。ランダムウォークは
+  // random_theta の速さでその場の流れの速度に寄っていく。
+  double flow_weight = 1.0;
+  double boundary_reflect_margin = 60.0;
+  double boundary_damping = 0.5;
+
+  double safe_distance = 120.0;
+  double repulsion_gain = 2600.0;
+  double boundary_repulsion_gain = 3200.0;
+  double max_speed = 180.0;
+  double collision_stop_distance = 90.0;
+  double collision_stop_min_scale = 0.05;
+  double lookahead_time = 0.35;
+
+  Avoidance avoidance = Avoidance::Brake;
+  // avoidance が Orca のときに使う。max_speed は上の max_speed で上書きする。
+  OrcaParameters orca;
+
+  // step を分けて回すスレッド数 (呼び出したスレッドを含む)。1 なら呼び出した
+  // スレッドだけ、0 なら std::thread::hardware_concurrency()。出力は
+  // threads によらずビット単位で一致する。ORCA の解も同じ ThreadPool で分ける
+  // (orca.threads は使わない)。
+  std::size_t threads = 1;
+
+  // 乱数列の種。同じ種・同じ入力・同じ dt の列なら出力はビット単位で一致する。
+  std::uint32_t seed = 1;
+};
+
+// Ornstein-Uhlenbeck のランダムウォークに Cube 同士と境界の反発、近距離の
+// ブレーキ (または ORCA) を足し、少し先にいてほしい地点を目標として返す。時刻は持たず、
+// 呼び出し側が step(dt) で固定刻みに進める。
+// 乱数だけを添字順に引いておき、残りは Cube ごとに独立した計算 (近傍の力は
+// 自分の側で添字の昇順に足す) として ThreadPool で分ける。
+class MotionPlanner {
+public:
+  explicit MotionPlanner(MotionPlannerParameters params = {});
+
+  const MotionPlannerParameters &parameters() const;
+
+  // 乱数列を seed からやり直し、Cube ごとの速度を 0 に戻す。
+  void reset(std::uint32_t seed);
+  // count 台分の状態と作業領域 (グリッド・worker ごとの近傍の一覧・ORCA) を
+  // 確保しておく。以後 count 台以下・障害物 16 個以下の step はメモリを
+  // 確保しない。
+  void reserve(std::size_t count);
+
+  std::vector<TargetPoint> initial_targets(std::size_t cube_count) const;
+
+  // step のたびに各 Cube の位置で標本を取る流れ。nullptr で外す。重みの
+  // crossfade (advance) は呼び出し側が step の間に進める。
+  void set_flow(std::shared_ptr<const FlowBlender> flow);
+
+  // dt 秒進めて positions[i] ごとの目標を返す。参照は次の step まで有効。
+  // 台数が変わると増えた分の速度は 0 から始まる。dt <= 0 は std::invalid_argument。
+  // obstacles (人など) からは片側だけの反発を受け、ブレーキ / ORCA でも避ける。
+  // 距離は障害物の縁から測る。
+  const std::vector<TargetPoint> &
+  step(std::span<const middleware::Position> positions, double dt,
+       std::span<const control::Obstacle> obstacles = {});
+
+  std::uint64_t steps() const;
+
+private:
+  struct RobotState {
+    double vx = 0.0;
+    double vy = 0.0;
+  };
+
+  void resize(std::size_t count);
+  void update_grid(std::span<const middleware::Position> positions,
+                   std::span<const control::Obstacle> obstacles);
+  void draw_noise(std::size_t count);
+  // threads が 1 のとき。反発とブレーキは組ごとに 1 度だけ計算して両側に足す。
+  void step_serial(std::span<const middleware::Position> positions,
+                   std::span<const control::Obstacle> obstacles, double dt);
+  // ThreadPool で分けるとき。Cube i の 1 step 分を、近傍の力を自分の側で
+  // 集めて求める。neighbors は worker ごとの作業領域。
+  void step_agent(std::size_t i,
+                  std::span<const middleware::Position> positions,
+                  std::span<const control::Obstacle> obstacles, double dt,
+                  std::vector<std::size_t> &neighbors);
+  // 乱数・流れ・境界の反射。ORCA なら前の step の速度も控える。
+  void start_agent(std::size_t i,
+                   std::span<const middleware::Position> positions, double dt);
+  void update_random_velocity(RobotState &state, double dt, Vec2 bias,
+                              Vec2 noise) const;
+  void apply_boundary_reflection(RobotState &state,
+                                 const middleware::Position &position) const;
+  // low (添字の小さい側) が high から受ける反発。high には符号を変えて足す。
+  // 届かなければ false。
+  bool pair_force(const middleware::Position &low,
+                  const middleware::Position &high, Vec2 &force) const;
+  bool obstacle_force(const middleware::Position &position,
+                      const control::Obstacle &obstacle, Vec2 &force) const;
+  // 壁からの力を accel に足す (反発のあとに、左・右・上・下の順)。
+  void add_boundary_force(const middleware::Position &position,
+                          Vec2 &accel) const;
+  void integrate(RobotState &state, Vec2 accel, double dt) const;
+  // 2 台の距離で決まる速度の倍率。ブレーキの距離の外なら 1。
+  double brake_factor(const middleware::Position &a,
+                      const middleware::Position &b) const;
+  void brake_for_obstacles(std::size_t i,
+                           std::span<const middleware::Position> positions,
+                           std::span<const control::Obstacle> obstacles,
+                           std::vector<std::size_t> &neighbors);
+  void apply_orca(std::span<const middleware::Position> positions,
+                  std::span<const control::Obstacle> obstacles, double dt);
+  TargetPoint make_target(const middleware::Position &position,
+                          const RobotState &state) const;
+  double min_x() const;
+  double max_x() const;
+  double min_y() const;
+  double max_y() const;
+  double repulsion_distance() const;
+
+  MotionPlannerParameters params_;
+  std::vector<RobotState> robot_states_;
+  // 反発とブレーキの近傍探索用。id は positions の添字、その後ろに obstacles。
+  control::SpatialGrid grid_;
+  // 今回の obstacles の最大半径。近傍探索の半径に足す。
+  double obstacle_reach_ = 0.0;
+  // threads が 1 でなければ作り、orca_ にも渡す。コピーした MotionPlanner
+  // とは共有する (parallel_for は 1 つずつ走るので、同時に step してもよい)。
+  std::shared_ptr<runtime::ThreadPool> pool_;
+  // step ごとに使い回す作業領域。neighbors_ は worker ごと、noise_ は
+  // Cube ごとに x, y の順で添字順に引いた正規乱数。accel と scales は
+  // step_serial だけが使う。
+  std::vector<std::vector<std::size_t>> neighbors_;
+  std::vector<double> noise_;
+  std::vector<double> accel_x_;
+  std::vector<double> accel_y_;
+  std::vector<double> scales_;
+  std::vector<TargetPoint> targets_;
+  std::shared_ptr<const FlowBlender> flow_;
+  Orca orca_;
+  std::vector<OrcaAgent> orca_agents_;
+  std::mt19937 rng_;
+  std::normal_distribution<double> normal_dist_;
+  std::uint64_t steps_ = 0;
+};
+
+} // namespace toio::planning
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "toio/control/obstacle_tracker.hpp"
+#include "toio/control/spatial_grid.hpp"
+#include "toio/runtime/thread_pool.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace toio::planning {
+
+struct Vec2 {
+  double x = 0.0;
+  double y = 0.0;
+};
+
+struct OrcaAgent {
+  Vec2 position;
+  // いま出している速度。相手もこの速度で動いている前提で避け方を分担する。
+  Vec2 velocity;
+  // 障害がなければ出したい速度。
+  Vec2 preferred;
+};
+
+// 速度空間の半平面。point を通り、direction の左側が許される速度。
+struct OrcaLine {
+  Vec2 point;
+  Vec2 direction;
+};
+
+struct OrcaParameters {
+  // Cube の半径 (マット座標)。一辺 32mm の外接円に少し余裕を足す。
+  double radius = 20.0;
+  // この距離の中の近い順に max_neighbors 台だけを考える。
+  double neighbor_distance = 150.0;
+  std::size_t max_neighbors = 10;
+  // この時間 (s) 先までぶつからない速度を選ぶ。長いほど早めに避ける。
+  double time_horizon = 2.0;
+  double max_speed = 180.0;
+  // 1 より大きければ、Orca がこの数のスレッドの runtime::ThreadPool を作り、
+  // Cube ごとの線形計画を分けて解く。ThreadPool を渡したとき (MotionPlanner
+  // の中) は使わない。
+  std::size_t threads = 1;
+};
+
+// ORCA (Optimal Reciprocal Collision Avoidance)。各 Cube について、近くの
+// Cube との衝突を避ける半平面 (ORCA 線) を作り、その共通部分の中で preferred
+// に最も近い速度を 2 次元の線形計画で求める。解けない (過密) ときは半平面の
+// 侵害が最小になる速度を選ぶ。Cube ごとの計画は前の速度だけに依存するので
+// 互いに独立で、スレッド数に関係なく同じ結果になる。
+class Orca {
+public:
+  // pool を渡せばそれで分けて解く (MotionPlanner は自分の ThreadPool を
+  // 渡す)。なければ params.threads が 1 より大きいときだけ作る。
+  explicit Orca(OrcaParameters params = {}, control::GridBounds bounds = {},
+                std::shared_ptr<runtime::ThreadPool> pool = nullptr);
+
+  const OrcaParameters &parameters() const;
+  // agents と obstacles を合わせて ids 個までの solve がメモリを確保しない
+  // ように、グリッドと作業領域を確保しておく。
+  void reserve(std::size_t ids);
+
+  // agents[i] ごとの新しい速度を返す。参照は次の solve まで有効。dt は制御の
+  // 刻み (s) で、すでに重なっている Cube をこの時間で離す速度を作るのに使う。
+  // obstacles (人など) は半径と速度を持つ円として扱い、相手は避けてくれない
+  // 前提で避ける量をすべて Cube 側が持つ。
+  const std::vector<Vec2> &
+  solve(std::span<const OrcaAgent> agents, double dt,
+        std::span<const control::Obstacle> obstacles = {});
+
+private:
+  // worker ごとの作業領域。
+  struct Scratch {
+    std::vector<std::pair<double, std::size_t>> neighbors;
+    std::vector<std::size_t> obstacles;
+    std::vector<OrcaLine> lines;
+    std::vector<OrcaLine> projected;
+  };
+
+  void solve_range(std::span<const OrcaAgent> agents,
+                   std::span<const control::Obstacle> obstacles, double dt,
+                   std::size_t begin, std::size_t end, Scratch &scratch);
+  Vec2 solve_agent(std::span<const OrcaAgent> agents,
+                   std::span<const control::Obstacle> obstacles, double dt,
+                   std::size_t index, Scratch &scratch) const;
+  // other との ORCA 線。share は避ける量のうち自分が持つ割合。
+  OrcaLine make_line(const OrcaAgent &agent, Vec2 other_position,
+                     Vec2 other_velocity, double combined_radius, double share,
+                     double dt, Vec2 fallback) const;
+
+  OrcaParameters params_;
+  // id は agents の添字、その後ろに obstacles。
+  control::SpatialGrid grid_;
+  // 今回の obstacles の最大半径。近傍探索の半径に足す。
+  double obstacle_reach_ = 0.0;
+  // コピーした Orca とは共有する (parallel_for は 1 つずつ走る)。
+  std::shared_ptr<runtime::ThreadPool> pool_;
+  std::vector<Scratch> scratch_;
+  std::vector<Vec2> velocities_;
+};
+
+} // namespace toio::planning
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "toio/control/spatial_grid.hpp"
+#include "toio/planning/behavior.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace toio::planning {
+
+struct ThemeOptions {
+  // 目標を収めるフィールド。
+  control::GridBounds field{};
+  // enter のたびにこの種から乱数列をやり直す。
+  std::uint32_t seed = 1;
+};
+
+// 組み込みのテーマ名。
+//   medaka: 池を回る流れに乗って、まとまった群れでゆっくり泳ぐ。
+//   locust: 草原を渡る風に押されながら、ばらばらに速く跳ね回る。障害物を避ける。
+//   duck:   列をそろえてフィールドの左右を行き来する。
+//   star:   切り替えたときの位置を星座として、中心のまわりをゆっくり回りながら
+//           Cube ごとの周期で瞬く。障害物の近くは押しのける。
+std::span<const std::string_view> theme_names();
+
+// name のテーマを作る。知らない名前は std::invalid_argument。
+std::unique_ptr<Behavior> make_theme(std::string_view name,
+                                     const ThemeOptions &options = {});
+
+} // namespace toio::planning
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json_fwd.hpp>
+
+namespace toio::record {
+
+// セッションログのファイル形式 (リトルエンディアン)。
+//
+//   FileHeader
+//   RecordHeader + payload ...   (時刻順に追記)
+//   IndexEntry ...               (close 時。kIndexStride 件ごと)
+//   server id テーブル            (u16 長さ + UTF-8 を servers 件)
+//   Trailer
+//
+// Trailer がない (書き込み中に落ちた) ファイルは先頭から走査して読む。
+inline constexpr char kLogMagic[8] = {'T', 'O', 'I', 'O', 'R', 'E', 'C', '\0'};
+inline constexpr char kIndexMagic[8] = {'T', 'O', 'I', 'O', 'I', 'D', 'X', '\0'};
+inline constexpr std::uint32_t kLogVersion = 1;
+inline constexpr std::uint64_t kIndexStride = 256;
+
+enum class RecordKind : std::uint8_t {
+  // payload は server id。以降のレコードの server 番号を定義する。
+  Server = 0,
+  // リレーから受け取ったフレーム。
+  Inbound = 1,
+  // リレーへ書いたフレーム。
+  Outbound = 2,
+  Open = 3,
+  Close = 4,
+};
+
+// payload が JSON テキストではなく MessagePack。
+inline constexpr std::uint8_t kFlagMsgpack = 0x01;
+
+#pragma pack(push, 1)
+struct FileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t header_size;
+  // 記録開始時の壁時計 (epoch us)。RecordHeader::t_us の基準。
+  std::int64_t wall_start_us;
+  std::uint64_t reserved;
+};
+
+struct RecordHeader {
+  // 記録開始からの経過時間 (Clock::now 基準)。
+  std::int64_t t_us;
+  std::uint32_t size;
+  RecordKind kind;
+  std::uint8_t flags;
+  std::uint16_t server;
+};
+
+struct IndexEntry {
+  std::int64_t t_us;
+  std::uint64_t offset;
+};
+
+struct Trailer {
+  char magic[8];
+  std::uint64_t index_offset;
+  std::uint64_t index_count;
+  std::uint64_t servers_offset;
+  std::uint64_t record_count;
+  // キューあふれで記録できなかったイベント数。
+  std::uint64_t dropped;
+  std::int64_t last_t_us;
+};
+#pragma pack(pop)
+
+struct LogRecord {
+  std::chrono::microseconds t{0};
+  RecordKind kind = RecordKind::Inbound;
+  std::uint16_t server = 0;
+  std::uint8_t flags = 0;
+  // mmap した領域を指す。SessionLog より長く持たない。
+  std::span<const std::uint8_t> payload;
+
+  nlohmann::json json() const;
+  // JSON テキスト (MessagePack なら dump し直す)。
+  std::string text() const;
+};
+
+// 記録済みのログを mmap して読む。スレッドセーフ (読み取り専用)。
+class SessionLog {
+public:
+  explicit SessionLog(const std::string &path);
+  ~SessionLog();
+
+  SessionLog(const SessionLog &) = delete;
+  SessionLog &operator=(const SessionLog &) = delete;
+
+  class Cursor {
+  public:
+    // 次のレコード。終端または途中で切れたレコードなら false。
+    bool next(LogRecord &record);
+
+  private:
+    friend class SessionLog;
+    Cursor(const SessionLog &log, std::size_t offset)
+        : log_(&log), offset_(offset) {}
+
+    const SessionLog *log_;
+    std::size_t offset_;
+  };
+
+  // from 以降の最初のレコードから読む (索引で位置を引く)。
+  Cursor cursor(std::chrono::microseconds from = {}) const;
+
+  std::chrono::system_clock::time_point wall_start() const;
+  // server 番号順の server id。
+  const std::vector<std::string> &servers() const;
+  std::uint64_t record_count() const;
+  std::uint64_t dropped() const;
+  std::chrono::microseconds duration() const;
+  // Trailer がなく、走査で索引を作り直した場合 true。
+  bool recovered() const;
+
+private:
+  void scan();
+
+  const std::uint8_t *data_ = nullptr;
+  std::size_t size_ = 0;
+  // レコード領域の終端 (索引の先頭)。
+  std::size_t records_end_ = 0;
+  FileHeader header_{};
+  std::vector<IndexEntry> index_;
+  std::vector<std::string> servers_;
+  std::uint64_t record_count_ = 0;
+  std::uint64_t dropped_ = 0;
+  std::int64_t last_t_us_ = 0;
+  bool recovered_ = false;
+};
+
+} // namespace toio::record
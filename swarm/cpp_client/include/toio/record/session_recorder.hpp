@@ -0,0 +1,119 @@
+#pragma once
+
+#include "toio/middleware/server_session.hpp"
+#include "toio/record/session_log.hpp"
+#include "toio/runtime/clock.hpp"
+#include "toio/transport/connection.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace toio::record {
+
+struct RecorderOptions {
+  // 書き込みスレッドに渡す前のキューの上限 (件)。超えた分は捨てて数える。
+  std::size_t queue_limit = 1 << 16;
+  std::chrono::milliseconds flush_interval{200};
+  // JSON を MessagePack に詰め直して保存する (書き込みスレッドで変換)。
+  bool msgpack = true;
+};
+
+struct RecorderStats {
+  std::uint64_t recorded = 0;
+  std::uint64_t dropped = 0;
+  std::uint64_t bytes = 0;
+};
+
+// 送受信フレームを SessionLog 形式で追記する。record はキューに積むだけで、
+// 変換とファイル書き込みは専用スレッドで行う (制御側はファイル I/O を待たない)。
+// 時刻は clock の now() で付け、書き込みスレッド自体は実時間で動く。
+class SessionRecorder {
+public:
+  SessionRecorder(const std::string &path,
+                  RecorderOptions options = {},
+                  std::shared_ptr<runtime::Clock> clock =
+                      runtime::system_clock());
+  ~SessionRecorder();
+
+  SessionRecorder(const SessionRecorder &) = delete;
+  SessionRecorder &operator=(const SessionRecorder &) = delete;
+
+  // server id に番号を振る (同じ id には同じ番号)。
+  std::uint16_t register_server(const std::string &server_id);
+  void record(RecordKind kind, std::uint16_t server, std::string text);
+  // 残りを書き出し、索引と Trailer を付けて閉じる。以降の record は捨てる。
+  void close();
+
+  RecorderStats stats() const;
+
+private:
+  struct Event {
+    std::int64_t t_us = 0;
+    RecordKind kind = RecordKind::Inbound;
+    std::uint16_t server = 0;
+    std::string text;
+  };
+
+  std::int64_t elapsed_us() const;
+  void write_loop();
+  void append(const Event &event);
+  void write_trailer();
+
+  RecorderOptions options_;
+  std::shared_ptr<runtime::Clock> clock_;
+  runtime::Clock::time_point started_at_;
+  std::ofstream file_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Event> pending_;
+  std::unordered_map<std::string, std::uint16_t> server_index_;
+  std::vector<std::string> servers_;
+  bool stopping_ = false;
+  bool closed_ = false;
+  std::uint64_t dropped_ = 0;
+  std::thread writer_;
+
+  // 以下は書き込みスレッドのみが触る (stats 用に atomic)。
+  std::atomic<std::uint64_t> recorded_{0};
+  std::atomic<std::uint64_t> bytes_{0};
+  std::vector<IndexEntry> index_;
+  std::int64_t last_t_us_ = 0;
+  std::vector<std::uint8_t> buffer_;
+};
+
+// inner の送受信をそのまま流しつつ recorder に記録する Connection。
+class RecordingConnection : public transport::Connection {
+public:
+  RecordingConnection(std::unique_ptr<transport::Connection> inner,
+                      std::shared_ptr<SessionRecorder> recorder,
+                      const std::string &server_id);
+  ~RecordingConnection() override;
+
+  void open(ReceiveHandler on_message, LogHandler on_log) override;
+  void close() override;
+  bool is_open() const override;
+  void write(const std::string &text) override;
+
+private:
+  std::unique_ptr<transport::Connection> inner_;
+  std::shared_ptr<SessionRecorder> recorder_;
+  std::uint16_t server_;
+};
+
+// inner (空なら WebSocket) が作る Connection を RecordingConnection で包む。
+middleware::ConnectionFactory
+recording_connection_factory(std::shared_ptr<SessionRecorder> recorder,
+                             middleware::ConnectionFactory inner = {});
+
+} // namespace toio::record
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "toio/middleware/server_session.hpp"
+#include "toio/record/session_log.hpp"
+#include "toio/runtime/clock.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace toio::record {
+
+struct ReplayOptions {
+  // 1.0 で記録時と同じ間隔。0 以下なら待たずに流す。
+  double speed = 1.0;
+  std::chrono::microseconds from{0};
+  std::optional<std::chrono::microseconds> to;
+};
+
+struct ReplayStats {
+  // ServerSession に渡した受信フレーム。
+  std::uint64_t delivered = 0;
+  // 対応するサーバーの接続が開いていなかった受信フレーム。
+  std::uint64_t skipped = 0;
+  // ログに残っていた送信フレーム (記録時のコントローラの出力)。
+  std::uint64_t recorded_commands = 0;
+  // 再生中に middleware が書いた送信フレーム (いまのコントローラの出力)。
+  std::uint64_t live_commands = 0;
+  std::chrono::microseconds span{0};
+};
+
+// SessionLog の受信フレームを、記録時の server id ごとの Connection として
+// middleware に流し直す。FleetManager / FleetControl に connection_factory()
+// を渡して start してから run を呼ぶ。リレーへの書き込みはどこにも届かず、
+// 数えて command observer に渡すだけ (recording_connection_factory で包めば
+// 別のログに残せる)。
+class SessionReplayer {
+public:
+  using CommandObserver =
+      std::function<void(const std::string &server_id, const std::string &text)>;
+
+  explicit SessionReplayer(const SessionLog &log,
+                           std::shared_ptr<runtime::Clock> clock =
+                               runtime::system_clock());
+  ~SessionReplayer();
+
+  SessionReplayer(const SessionReplayer &) = delete;
+  SessionReplayer &operator=(const SessionReplayer &) = delete;
+
+  middleware::ConnectionFactory connection_factory();
+  // ログに記録された server id それぞれの ServerConfig (cubes は空)。
+  std::vector<middleware::ServerConfig> server_configs() const;
+  void set_command_observer(CommandObserver observer);
+
+  // 呼び出したスレッドで受信フレームを配送する。
+  ReplayStats run(const ReplayOptions &options = {});
+
+private:
+  class ReplayConnection;
+
+  void on_command(const std::string &server_id, const std::string &text);
+
+  const SessionLog &log_;
+  std::shared_ptr<runtime::Clock> clock_;
+
+  // connections_ と配送を守る。
+  std::mutex mutex_;
+  std::unordered_map<std::string, ReplayConnection *> connections_;
+  std::mutex observer_mutex_;
+  CommandObserver observer_;
+  std::uint64_t live_commands_ = 0;
+};
+
+} // namespace toio::record
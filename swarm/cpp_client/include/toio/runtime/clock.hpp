@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace toio::runtime {
+
+// 時刻と待機の差し替え口。既定の SystemClock は steady_clock と
+// std::this_thread を使い、シミュレーションでは仮想時間の実装に置き換える。
+class Clock {
+public:
+  using duration = std::chrono::steady_clock::duration;
+  using time_point = std::chrono::steady_clock::time_point;
+
+  virtual ~Clock() = default;
+
+  virtual time_point now() const = 0;
+  // Position::timestamp_ms (epoch ms) と比べるための壁時計。
+  virtual std::chrono::system_clock::time_point wall_now() const = 0;
+  virtual void sleep_until(time_point deadline) = 0;
+  // std::condition_variable::wait_until (述語付き) と同じ。lock は cv と
+  // 組になる mutex を保持した状態で渡す。
+  virtual bool wait_until(std::unique_lock<std::mutex> &lock,
+                          std::condition_variable &cv,
+                          time_point deadline,
+                          const std::function<bool()> &ready) = 0;
+
+  void sleep_for(duration timeout) { sleep_until(now() + timeout); }
+};
+
+class SystemClock : public Clock {
+public:
+  time_point now() const override;
+  std::chrono::system_clock::time_point wall_now() const override;
+  void sleep_until(time_point deadline) override;
+  bool wait_until(std::unique_lock<std::mutex> &lock,
+                  std::condition_variable &cv,
+                  time_point deadline,
+                  const std::function<bool()> &ready) override;
+};
+
+// プロセス共通の SystemClock。
+std::shared_ptr<Clock> system_clock();
+
+} // namespace toio::runtime
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace toio::runtime {
+
+// 長く走るタスク (ゴール追従やフラッシャー) の起動口。
+class Executor {
+public:
+  virtual ~Executor() = default;
+
+  virtual std::future<void> spawn(std::function<void()> task) = 0;
+  // spawn したタスクの終了を待つ。
+  virtual void wait(std::future<void> &task) = 0;
+};
+
+// タスクごとにスレッドを起こす (std::async と同じ)。
+class ThreadExecutor : public Executor {
+public:
+  std::future<void> spawn(std::function<void()> task) override;
+  void wait(std::future<void> &task) override;
+};
+
+std::shared_ptr<Executor> thread_executor();
+
+} // namespace toio::runtime
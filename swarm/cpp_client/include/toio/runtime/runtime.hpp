@@ -0,0 +1,16 @@
+#pragma once
+
+#include "toio/runtime/clock.hpp"
+#include "toio/runtime/executor.hpp"
+
+#include <memory>
+
+namespace toio::runtime {
+
+// Middleware / Control が使う時計とタスク実行。既定は実時間とスレッド。
+struct Runtime {
+  std::shared_ptr<Clock> clock = system_clock();
+  std::shared_ptr<Executor> executor = thread_executor();
+};
+
+} // namespace toio::runtime
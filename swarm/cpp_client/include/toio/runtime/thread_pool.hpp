@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace toio::runtime {
+
+// 1 step の中の短い計算を分けて並べるスレッドプール (Executor は長く走る
+// タスク用)。parallel_for は範囲をチャンクに分けて各スレッドに前もって
+// 配り、自分の分を先頭から片付けたスレッドは他のスレッドの分を末尾から
+// 盗む (ワークスティーリング)。どのチャンクをどのスレッドが処理するかは
+// 毎回変わるので、結果を決定的にしたい呼び出し側は、添字ごとに独立した
+// 計算にして worker ごとの作業領域だけを共有しないこと。
+class ThreadPool {
+public:
+  // 呼び出したスレッドを含めて threads 本で回す (threads - 1 本を起こす)。
+  // 0 なら std::thread::hardware_concurrency()。
+  explicit ThreadPool(std::size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  std::size_t size() const;
+
+  // [0, count) を grain 個ずつのチャンクに分け、fn(begin, end, worker) を
+  // 呼ぶ。worker は 0..size()-1 で、同じ worker の fn が同時に走ることは
+  // ない。呼び出したスレッドも worker 0 として加わり、全チャンクが終わるまで
+  // 戻らない。fn の例外は 1 つだけ呼び出し側で投げ直す。別のスレッドから
+  // 同時に呼ぶと順に実行する。メモリは確保しない。
+  template <typename Fn>
+  void parallel_for(std::size_t count, std::size_t grain, Fn &&fn) {
+    using Callable = std::remove_reference_t<Fn>;
+    run(count, grain,
+        [](void *context, std::size_t begin, std::size_t end,
+           std::size_t worker) {
+          (*static_cast<Callable *>(context))(begin, end, worker);
+        },
+        const_cast<void *>(static_cast<const void *>(&fn)));
+  }
+
+private:
+  using Task = void (*)(void *context, std::size_t begin, std::size_t end,
+                        std::size_t worker);
+
+  // worker ごとの残りのチャンク [front, back)。上位 32 ビットが front。
+  // 持ち主は front から、盗む側は back から CAS で取る。
+  struct alignas(64) Queue {
+    std::atomic<std::uint64_t> range{0};
+  };
+
+  void run(std::size_t count, std::size_t grain, Task task, void *context);
+  void worker_loop(std::size_t worker);
+  void work(std::size_t worker);
+  bool pop_front(std::size_t worker, std::uint32_t &chunk);
+  bool steal_back(std::size_t victim, std::uint32_t &chunk);
+  void execute(std::size_t worker, std::uint32_t chunk);
+
+  std::size_t size_ = 1;
+  std::unique_ptr<Queue[]> queues_;
+  std::vector<std::thread> threads_;
+  // parallel_for を 1 つずつにする。
+  std::mutex run_mutex_;
+
+  // 以下は mutex_ で守る (remaining_ を除く)。
+  std::mutex mutex_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  std::uint64_t generation_ = 0;
+  // いまの parallel_for に加わっている起こしたスレッドの数。
+  std::size_t active_ = 0;
+  bool stopping_ = false;
+  Task task_ = nullptr;
+  void *context_ = nullptr;
+  std::size_t count_ = 0;
+  std::size_t grain_ = 1;
+  std::exception_ptr error_;
+  std::atomic<std::size_t> remaining_{0};
+};
+
+} // namespace toio::runtime
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "toio/sim/sim_cube.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::sim {
+
+// BLE 1 接続あたりの送信モデル。コマンドは latency (+ jitter) 後に届き、
+// 同じ Cube への書き込みは interval に 1 回しか届かない。
+struct BleParams {
+  std::chrono::microseconds latency{15000};
+  std::chrono::microseconds jitter{5000};
+  std::chrono::microseconds interval{30000};
+  // Cube ごとの未配送コマンドの上限。超えたコマンドは error result。
+  std::size_t queue_limit = 64;
+  // true なら Python リレーと同様、1 接続のメッセージを到着順に 1 つずつ
+  // (BLE 書き込みの完了を待って) 処理する。
+  bool serialize_per_client = false;
+};
+
+struct EmulatorConfig {
+  std::vector<std::string> cube_ids;
+  CubeModelParams cube;
+  BleParams ble;
+  // 位置が変わった Cube の通知周期。
+  std::chrono::microseconds notify_interval{30000};
+  // 物理演算の刻み。
+  std::chrono::microseconds physics_step{5000};
+  int battery_percent = 90;
+  std::uint32_t seed = 1;
+  // true なら connect を待たずに全 Cube を接続済みにする。
+  bool connected_at_start = false;
+  // position の timestamp_ms の基準 (epoch ms)。SimTime 0 に対応する。
+  std::uint64_t epoch_ms = 0;
+};
+
+// relay_server/server.py と同じ JSON プロトコルを話す、ネットワークを
+// 持たないリレーの中身。時刻は呼び出し側が進める (advance) ため、
+// 同じ入力と seed からは同じ出力になる。スレッドセーフではない。
+class EmulatedRelay {
+public:
+  using ClientId = std::uint64_t;
+  using Sink = std::function<void(const nlohmann::json &)>;
+
+  explicit EmulatedRelay(EmulatorConfig config);
+
+  // 接続時の system メッセージを sink に送る。
+  ClientId add_client(Sink sink);
+  void remove_client(ClientId client);
+
+  // 受信したメッセージを now に到着したものとして予約する。
+  void handle_message(ClientId client, const nlohmann::json &message,
+                      SimTime now);
+  // now までの物理演算・BLE 配送・位置通知を進める。
+  void advance(SimTime now);
+
+  SimTime now() const;
+  const std::vector<SimCube> &cubes() const;
+  std::size_t pending_operations() const;
+
+private:
+  struct Operation {
+    SimTime due{0};
+    std::uint64_t sequence = 0;
+    ClientId client = 0;
+    nlohmann::json payload;
+    std::string type;
+    // 同じ Cube の BLE キューを使うコマンドなら Cube の index。
+    std::optional<std::size_t> cube;
+  };
+  struct LaterFirst {
+    bool operator()(const Operation &a, const Operation &b) const {
+      return a.due != b.due ? a.due > b.due : a.sequence > b.sequence;
+    }
+  };
+
+  struct CubeLink {
+    bool connected = false;
+    SimTime next_slot{0};
+    std::size_t queued = 0;
+    SimTime next_notify{0};
+    // 最後に通知した整数座標。
+    std::optional<std::tuple<int, int, int, bool>> last_notified;
+    std::set<ClientId> subscribers;
+  };
+
+  struct Client {
+    Sink sink;
+    SimTime busy_until{0};
+    std::set<std::size_t> subscriptions;
+  };
+
+  void schedule(ClientId client, const nlohmann::json &message, SimTime now);
+  SimTime ble_delivery(std::size_t cube, SimTime now);
+  void execute(const Operation &operation);
+  void execute_command(const Operation &operation);
+  void execute_query(const Operation &operation);
+  void step_physics(SimTime until);
+  void publish_positions();
+  void send(ClientId client, const nlohmann::json &message);
+  void send_result(ClientId client, const std::string &cmd,
+                   const std::string &target, bool success,
+                   const std::string &message, bool require_result);
+  void flush_target_events();
+  nlohmann::json position_json(std::size_t cube) const;
+  void unsubscribe(ClientId client, std::size_t cube);
+  std::optional<std::size_t> find_cube(const std::string &id) const;
+
+  EmulatorConfig config_;
+  std::vector<SimCube> cubes_;
+  std::vector<CubeLink> links_;
+  std::unordered_map<std::string, std::size_t> index_;
+  std::map<ClientId, Client> clients_;
+  ClientId next_client_ = 1;
+
+  std::priority_queue<Operation, std::vector<Operation>, LaterFirst> operations_;
+  std::uint64_t next_sequence_ = 0;
+  SimTime now_{0};
+  std::mt19937 rng_;
+  std::vector<TargetEvent> target_events_;
+};
+
+} // namespace toio::sim
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "toio/sim/emulated_relay.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/websocket.hpp>
+
+namespace toio::sim {
+
+struct RelayEmulatorOptions {
+  std::string host = "127.0.0.1";
+  unsigned short port = 8765;
+  // 物理演算と配送を進める実時間の周期。
+  std::chrono::milliseconds tick{5};
+};
+
+// EmulatedRelay を実時間で進め、WebSocket で公開するサーバー。
+// 接続ごとに受信スレッドと送信スレッドを持つ (ToioClient と同じ同期 I/O)。
+class RelayEmulatorServer {
+public:
+  RelayEmulatorServer(EmulatorConfig config, RelayEmulatorOptions options);
+  ~RelayEmulatorServer();
+
+  RelayEmulatorServer(const RelayEmulatorServer &) = delete;
+  RelayEmulatorServer &operator=(const RelayEmulatorServer &) = delete;
+
+  void start();
+  void stop();
+  unsigned short port() const;
+
+private:
+  using websocket_t =
+      boost::beast::websocket::stream<boost::asio::ip::tcp::socket>;
+
+  struct Connection {
+    explicit Connection(boost::asio::ip::tcp::socket socket)
+        : websocket(std::move(socket)) {}
+    websocket_t websocket;
+    EmulatedRelay::ClientId client = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::string> outgoing;
+    bool closing = false;
+    std::atomic<bool> finished{false};
+    std::thread reader;
+    std::thread writer;
+  };
+
+  SimTime elapsed() const;
+  void accept_loop();
+  void tick_loop();
+  void serve(Connection &connection);
+  void write_loop(Connection &connection);
+  void close_connection(Connection &connection);
+  void reap_finished();
+
+  RelayEmulatorOptions options_;
+  std::chrono::steady_clock::time_point started_at_;
+
+  std::mutex relay_mutex_;
+  EmulatedRelay relay_;
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  std::atomic<bool> running_{false};
+  std::thread accept_thread_;
+  std::thread tick_thread_;
+
+  std::mutex connections_mutex_;
+  std::list<std::unique_ptr<Connection>> connections_;
+};
+
+} // namespace toio::sim
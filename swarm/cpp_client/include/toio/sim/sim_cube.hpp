@@ -0,0 +1,134 @@
+#pragma once
+
+#include "toio/transport/move_target.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace toio::sim {
+
+// シミュレーション時刻。エミュレータ起動時を 0 とする。
+using SimTime = std::chrono::nanoseconds;
+
+struct MatBounds {
+  double min_x = 34.0;
+  double min_y = 35.0;
+  double max_x = 949.0;
+  double max_y = 898.0;
+};
+
+// toio の差動二輪モデル。単位はマット座標 (dot) と toio のモーター指示値。
+struct CubeModelParams {
+  // 指示値 1 あたりのタイヤ速度 [dot/s]。4.3 rpm/指示値、タイヤ径 12.5mm、
+  // 1 dot ≒ 1.36mm から。
+  double dots_per_speed = 2.066;
+  // 左右タイヤ間隔 [dot] (26.6mm)。
+  double tread = 19.5;
+  // この指示値未満ではモーターが回らない。
+  int deadzone = 10;
+  int max_speed = 115;
+  // 指示値に対するタイヤ速度の一次遅れ時定数 [s]。
+  double motor_time_constant = 0.03;
+  MatBounds bounds;
+
+  // 目標指定制御の到達判定と制御ゲイン。
+  double target_tolerance = 5.0;
+  double angle_tolerance_deg = 5.0;
+  double target_slowdown_distance = 40.0;
+  double target_turn_gain = 1.2;
+  int target_min_speed = 15;
+  // timeout 0 の場合のファームウェア既定値。
+  std::chrono::seconds default_target_timeout{10};
+};
+
+struct CubePose {
+  double x = 0.0;
+  double y = 0.0;
+  double angle = 0.0; // 度。+x が 0、y 下向きに増える。
+};
+
+// 目標指定制御のキューブ応答コード (toio.py の ResponseCode 名)。
+enum class TargetResponse {
+  Success,
+  Timeout,
+  ToioIdMissed,
+  InvalidParameter,
+  InvalidState,
+  OtherWrite,
+  NotSupported,
+  FailedToAppend,
+};
+
+std::string to_string(TargetResponse response);
+
+struct TargetRequest {
+  int request_id = 0;
+  std::vector<transport::MoveTarget> points;
+  int max_speed = 80;
+  transport::MoveType move_type = transport::MoveType::Curve;
+  std::chrono::seconds timeout{0};
+  // relay の result に載せる情報。
+  std::string cmd;
+  std::string target;
+  std::uint64_t client = 0;
+  bool require_result = true;
+};
+
+struct TargetEvent {
+  TargetRequest request;
+  TargetResponse response = TargetResponse::Success;
+};
+
+class SimCube {
+public:
+  SimCube(std::string id, CubePose pose, const CubeModelParams &params);
+
+  const std::string &id() const;
+  const CubePose &pose() const;
+  bool on_mat() const;
+  bool moving() const;
+
+  // 通常のモーター制御。duration 0 は無期限。実行中の目標指定制御は
+  // OtherWrite で打ち切られ events に入る。
+  void set_motor(int left,
+                 int right,
+                 SimTime duration,
+                 SimTime now,
+                 std::vector<TargetEvent> &events);
+  // append = false なら実行中の目標を OtherWrite で打ち切って置き換える。
+  void set_target(TargetRequest request,
+                  bool append,
+                  SimTime now,
+                  std::vector<TargetEvent> &events);
+
+  void step(SimTime now, double dt, std::vector<TargetEvent> &events);
+
+private:
+  void abort_targets(std::vector<TargetEvent> &events);
+  // 目標指定制御の左右指示値。到達・タイムアウトした要求は events に入れる。
+  std::pair<double, double> target_command(SimTime now,
+                                           std::vector<TargetEvent> &events);
+  double wheel_speed(double command) const;
+
+  std::string id_;
+  CubePose pose_;
+  CubeModelParams params_;
+  bool on_mat_ = true;
+
+  double command_left_ = 0.0;
+  double command_right_ = 0.0;
+  double wheel_left_ = 0.0;  // [dot/s]
+  double wheel_right_ = 0.0; // [dot/s]
+  std::optional<SimTime> motor_deadline_;
+
+  std::deque<TargetRequest> targets_;
+  std::size_t target_point_ = 0;
+  SimTime point_started_{0};
+  bool rotating_in_place_ = false;
+};
+
+} // namespace toio::sim
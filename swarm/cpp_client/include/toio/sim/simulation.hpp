@@ -0,0 +1,80 @@
+#pragma once
+
+#include "toio/api/fleet_control.hpp"
+#include "toio/fault/fault_injector.hpp"
+#include "toio/middleware/server_session.hpp"
+#include "toio/runtime/runtime.hpp"
+#include "toio/sim/emulated_relay.hpp"
+#include "toio/sim/virtual_clock.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace toio::transport {
+class Connection;
+}
+
+namespace toio::sim {
+
+struct SimulationConfig {
+  // 仮想 Cube と BLE のモデル。epoch_ms は clock.wall_start で上書きする。
+  EmulatorConfig relay;
+  VirtualClock::Options clock;
+  std::string server_id = "sim";
+  // FleetControl に渡す ServerConfig の既定値。
+  bool auto_connect = true;
+  bool auto_subscribe = true;
+  middleware::RateLimitConfig rate_limit;
+  // 指定するとクライアントとリレーの間に遅延・欠落・障害を挟む。
+  std::optional<fault::FaultConfig> faults;
+};
+
+// 実機・ネットワーク・実時間なしで FleetControl を動かす。
+// EmulatedRelay とプロセス内の Connection をつなぎ、GoalController や
+// ServerSession のタスクを VirtualClock 上で走らせる。同じ設定と操作列からは
+// 同じ結果になり、時間は待機中のタスクがなければ一気に進む。
+// コンストラクタを呼んだスレッドがドライバーになり、run_for などで時間を進める。
+class Simulation {
+public:
+  explicit Simulation(SimulationConfig config);
+  ~Simulation();
+
+  Simulation(const Simulation &) = delete;
+  Simulation &operator=(const Simulation &) = delete;
+
+  VirtualClock &clock();
+  runtime::Runtime runtime();
+  middleware::ConnectionFactory connection_factory();
+  std::vector<middleware::ServerConfig> server_configs() const;
+
+  // server_configs() / runtime() / connection_factory() で作った FleetControl。
+  api::FleetControl &control();
+  const EmulatedRelay &relay() const;
+  // SimulationConfig::faults を指定したときだけ非 null。走行中に設定を変えられる。
+  fault::FaultInjector *faults();
+
+  // ドライバーを timeout だけ待たせ、その間の仮想時間を進める。
+  void run_for(runtime::Clock::duration timeout);
+  SimTime sim_time() const;
+  // リレーからクライアントへ配送したメッセージ数。
+  std::uint64_t delivered_messages() const;
+
+private:
+  class Loopback;
+
+  void deliver(runtime::Clock::time_point now);
+
+  SimulationConfig config_;
+  std::shared_ptr<VirtualClock> clock_;
+  EmulatedRelay relay_;
+  std::shared_ptr<fault::FaultInjector> faults_;
+  std::vector<Loopback *> loopbacks_;
+  std::uint64_t delivered_ = 0;
+  std::unique_ptr<api::FleetControl> control_;
+};
+
+} // namespace toio::sim
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "toio/runtime/clock.hpp"
+#include "toio/runtime/executor.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace toio::sim {
+
+// 仮想時間の Clock 兼 Executor。
+// spawn したタスクと、このオブジェクトを作ったスレッド (ドライバー) を
+// 1 本ずつ決定的な順で走らせる。実行中のタスクが sleep / wait に入ると
+// 次に起きるタスクへ切り替え、全員が待機中なら起床時刻まで時間を飛ばす。
+// 待機は必ずこのクラスの sleep_until / wait_until / wait を通すこと
+// (std::this_thread::sleep_for や future::wait で止まると全体が止まる)。
+class VirtualClock : public runtime::Clock, public runtime::Executor {
+public:
+  struct Options {
+    // 時間を飛ばすときの最大刻み。刻みごとに hook を呼び、wait_until の
+    // 条件を見直す。
+    std::chrono::microseconds quantum{5000};
+    time_point start{};
+    // start に対応する壁時計 (固定値にして出力を再現可能にする)。
+    std::chrono::system_clock::time_point wall_start{
+        std::chrono::milliseconds(1700000000000)};
+  };
+  // 現在時刻を受け取る。リレーの advance と受信メッセージの配送に使う。
+  using Hook = std::function<void(time_point)>;
+
+  explicit VirtualClock(Options options);
+  VirtualClock();
+  ~VirtualClock() override;
+
+  VirtualClock(const VirtualClock &) = delete;
+  VirtualClock &operator=(const VirtualClock &) = delete;
+
+  time_point now() const override;
+  std::chrono::system_clock::time_point wall_now() const override;
+  void sleep_until(time_point deadline) override;
+  bool wait_until(std::unique_lock<std::mutex> &lock,
+                  std::condition_variable &cv,
+                  time_point deadline,
+                  const std::function<bool()> &ready) override;
+
+  std::future<void> spawn(std::function<void()> task) override;
+  void wait(std::future<void> &task) override;
+
+  // タスクを切り替えるたび、および時間を進めるたびに実行中のスレッドから
+  // 呼ばれる。hook の中で待機してはいけない。
+  void add_hook(Hook hook);
+
+  const Options &options() const;
+  // start からの経過時間。
+  duration elapsed() const;
+  // タスクの切り替え回数。
+  std::uint64_t switches() const;
+
+private:
+  struct Task {
+    std::uint64_t id = 0;
+    std::thread::id thread_id;
+    bool blocked = false;
+    bool done = false;
+    // 起床予定時刻と、同時刻のタスク間の順序 (待機に入った順)。
+    time_point wake = time_point::max();
+    std::uint64_t order = 0;
+    const std::function<bool()> *ready = nullptr;
+    bool resumed = false;
+    std::condition_variable cv;
+    std::thread thread;
+  };
+
+  Task &current_task(const std::unique_lock<std::mutex> &lock) const;
+  void block(time_point wake, const std::function<bool()> *ready);
+  Task &schedule_next(std::unique_lock<std::mutex> &lock);
+  void resume(Task &task);
+  void finish(Task &task);
+  void run_hooks(std::unique_lock<std::mutex> &lock);
+  void reap_finished();
+
+  Options options_;
+  std::atomic<time_point::rep> now_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Task>> tasks_;
+  Task *current_ = nullptr;
+  std::uint64_t next_id_ = 0;
+  std::uint64_t next_order_ = 0;
+  std::atomic<std::uint64_t> switches_{0};
+  bool shutdown_ = false;
+  std::vector<Hook> hooks_;
+};
+
+} // namespace toio::sim
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace toio::transport {
+
+// ToioClient とリレーの間の 1 本のメッセージ通路 (テキストフレーム単位)。
+// 既定は WebSocketConnection。シミュレーションではプロセス内の実装に差し替える。
+class Connection {
+public:
+  using ReceiveHandler = std::function<void(const std::string &)>;
+  using LogHandler = std::function<void(const std::string &)>;
+
+  virtual ~Connection() = default;
+
+  // 受信したフレームは on_message に渡す (呼び出し元のスレッドは実装依存)。
+  virtual void open(ReceiveHandler on_message, LogHandler log) = 0;
+  virtual void close() = 0;
+  virtual bool is_open() const = 0;
+  // ToioClient が 1 本ずつに直列化して呼ぶ。失敗時は例外を投げる。
+  virtual void write(const std::string &text) = 0;
+};
+
+} // namespace toio::transport
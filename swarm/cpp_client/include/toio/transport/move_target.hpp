@@ -0,0 +1,34 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+namespace toio::transport {
+
+// toio の「目標指定付きモーター制御」の移動タイプ。
+enum class MoveType {
+  Curve = 0,
+  CurveNoReverse = 1,
+  RotateThenMove = 2,
+};
+
+struct MoveTarget {
+  int x = 0;
+  int y = 0;
+  // 省略時は到達後に回転しない。
+  std::optional<int> angle;
+};
+
+inline std::string to_string(MoveType type) {
+  switch (type) {
+  case MoveType::CurveNoReverse:
+    return "curve_no_reverse";
+  case MoveType::RotateThenMove:
+    return "rotate_then_move";
+  case MoveType::Curve:
+  default:
+    return "curve";
+  }
+}
+
+} // namespace toio::transport
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace toio::transport {
+
+// 人などを追跡する外部プロセスから届く 1 件分の通知。座標・半径・速度は
+// マット座標 (速度は 1 秒あたり) で、カメラ座標からの変換は送る側で行う。
+struct ObstacleMessage {
+  enum class Kind {
+    Update,
+    Remove,
+    Clear,
+  };
+
+  Kind kind = Kind::Update;
+  std::uint32_t id = 0;
+  double x = 0.0;
+  double y = 0.0;
+  double radius = 0.0;
+  double vx = 0.0;
+  double vy = 0.0;
+};
+
+// JSON テキスト。1 件なら
+//   {"id": 1, "x": 400, "y": 300, "radius": 80, "vx": 0, "vy": 120}
+// (radius / vx / vy は省略時 0、{"id": 1, "remove": true} で削除、
+// {"clear": true} で全削除)。配列や {"obstacles": [...]} で複数件をまとめられる。
+// 形式が違えば std::invalid_argument。
+std::vector<ObstacleMessage> parse_obstacle_json(const std::string &text);
+
+// OSC 1.0 のメッセージまたはバンドル。
+//   /obstacle        id x y [radius [vx vy]]   (i または f)
+//   /obstacle/remove id
+//   /obstacle/clear
+// 知らないアドレスは無視する。壊れたパケットは std::invalid_argument。
+std::vector<ObstacleMessage> parse_obstacle_osc(const std::uint8_t *data,
+                                                std::size_t size);
+
+// UDP の 1 データグラム。先頭が '/' か '#' なら OSC、それ以外は JSON として読む。
+std::vector<ObstacleMessage> parse_obstacle_datagram(const std::uint8_t *data,
+                                                     std::size_t size);
+
+} // namespace toio::transport
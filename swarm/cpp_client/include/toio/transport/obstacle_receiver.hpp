@@ -0,0 +1,60 @@
+#pragma once
+
+#include "toio/transport/obstacle_message.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+namespace toio::transport {
+
+// 障害物の通知を UDP (JSON または OSC) で受ける。受信は reader スレッドで
+// 行い、データグラムごとに parse_obstacle_datagram した結果を順に渡す。
+// WebSocket で配信するトラッカーには WebSocketConnection の受信ハンドラで
+// parse_obstacle_json を呼べばよい。
+class ObstacleReceiver {
+public:
+  using MessageHandler = std::function<void(const ObstacleMessage &)>;
+  using LogHandler = std::function<void(const std::string &)>;
+
+  // port 0 は空いているポートを割り当てる (port() で分かる)。
+  explicit ObstacleReceiver(std::uint16_t port,
+                            std::string address = "127.0.0.1");
+  ~ObstacleReceiver();
+
+  ObstacleReceiver(const ObstacleReceiver &) = delete;
+  ObstacleReceiver &operator=(const ObstacleReceiver &) = delete;
+
+  void open(MessageHandler on_message, LogHandler on_log = {});
+  void close();
+  bool is_open() const;
+  std::uint16_t port() const;
+
+private:
+  void start_receive();
+  void handle_datagram(std::size_t size);
+  void log(const std::string &message) const;
+
+  std::string address_;
+  std::uint16_t port_;
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::udp::socket socket_;
+  boost::asio::ip::udp::endpoint sender_;
+  // UDP の最大長。
+  std::array<std::uint8_t, 65536> buffer_{};
+
+  std::atomic<bool> running_{false};
+  std::thread reader_thread_;
+
+  MessageHandler on_message_;
+  LogHandler log_;
+};
+
+} // namespace toio::transport
@@ -1,19 +1,41 @@
 #pragma once
 
+#include "toio/transport/connection.hpp"
+#include "toio/transport/move_target.hpp"
+
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
-#include <thread>
+#include <unordered_map>
+#include <vector>
 
-#include <boost/asio/io_context.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/beast/websocket.hpp>
 #include <nlohmann/json.hpp>
 
 namespace toio::transport {
 
+// move の duration_ms の範囲。キューブは 10 ms 単位で数え、10 ms 未満 (0 を
+// 含む) は「時間指定なし」になって自動停止しない。
+inline constexpr std::chrono::milliseconds kMinMoveDuration{10};
+inline constexpr std::chrono::milliseconds kMaxMoveDuration{2550};
+
+// duration が kMinMoveDuration..kMaxMoveDuration の外なら std::invalid_argument。
+void check_move_duration(std::chrono::milliseconds duration);
+
+// 停止系コマンド用の優先レーンの統計。latency は送信要求から write 完了まで。
+struct PriorityStats {
+  std::uint64_t priority_writes = 0;
+  std::uint64_t discarded_commands = 0;
+  std::chrono::microseconds last_latency{0};
+  std::chrono::microseconds max_latency{0};
+};
+
 class ToioClient {
 public:
   using Json = nlohmann::json;
@@ -21,6 +43,8 @@ public:
   using LogHandler = std::function<void(const std::string &)>;
 
   ToioClient(std::string host, std::string port, std::string endpoint = "/ws");
+  // 任意の Connection (プロセス内のシミュレーションなど) を使う。
+  explicit ToioClient(std::unique_ptr<Connection> connection);
   ~ToioClient();
 
   ToioClient(const ToioClient &) = delete;
@@ -49,6 +73,25 @@ public:
                  int left_speed,
                  int right_speed,
                  std::optional<bool> require_result = std::nullopt);
+  // duration 後にキューブ側で止まる move。範囲は check_move_duration。
+  void send_move_for(const std::string &target,
+                     int left_speed,
+                     int right_speed,
+                     std::chrono::milliseconds duration,
+                     std::optional<bool> require_result = std::nullopt);
+  void send_move_to(const std::string &target,
+                    const MoveTarget &goal,
+                    int max_speed,
+                    MoveType move_type,
+                    int request_id,
+                    std::optional<bool> require_result = std::nullopt);
+  void send_move_to_multi(const std::string &target,
+                          const std::vector<MoveTarget> &goals,
+                          int max_speed,
+                          MoveType move_type,
+                          bool append,
+                          int request_id,
+                          std::optional<bool> require_result = std::nullopt);
   void set_led(const std::string &target,
                int r,
                int g,
@@ -58,28 +101,44 @@ public:
   void query_position(const std::string &target,
                       std::optional<bool> notify);
 
+  // 優先レーンで送る停止コマンド。待機中の通常送信より先に書き込まれ、
+  // 対象 Cube 向けに待機中だった move 系コマンドは破棄される。
+  void send_stop(const std::string &target,
+                 std::optional<bool> require_result = std::nullopt);
+  void send_stop_all(const std::vector<std::string> &targets,
+                     std::optional<bool> require_result = std::nullopt);
+  PriorityStats priority_stats() const;
+
 private:
-  using websocket_t =
-      boost::beast::websocket::stream<boost::asio::ip::tcp::socket>;
+  enum class Lane {
+    Normal,
+    Priority,
+  };
 
   void ensure_connected() const;
-  void reader_loop();
   void dispatch_message(const std::string &payload_text);
-  void send_json(const Json &message);
+  Json make_command(const std::string &cmd,
+                    const std::string &target,
+                    const Json &params,
+                    std::optional<bool> require_result) const;
+  void send_json(const Json &message,
+                 Lane lane = Lane::Normal,
+                 const std::string &target = {},
+                 bool preemptible = false);
   void log(const std::string &message) const;
 
-  std::string host_;
-  std::string port_;
-  std::string endpoint_;
-
-  boost::asio::io_context io_context_;
-  boost::asio::ip::tcp::resolver resolver_;
-  websocket_t websocket_;
-
-  std::atomic<bool> connected_{false};
-  std::atomic<bool> running_{false};
-  std::thread reader_thread_;
+  std::unique_ptr<Connection> connection_;
+  // write_mutex_ は送信スロット (writing_) と優先レーンの状態を保護する。
+  // Connection への write 自体はロック外で 1 本ずつ行う。
   mutable std::mutex write_mutex_;
+  std::condition_variable write_cv_;
+  bool writing_ = false;
+  std::size_t priority_waiting_ = 0;
+  std::atomic<std::uint64_t> stop_epoch_{0};
+  std::uint64_t stop_all_epoch_ = 0;
+  // Cube ごとの最後の停止の epoch。disconnect_cube で消す。
+  std::unordered_map<std::string, std::uint64_t> cube_stop_epochs_;
+  PriorityStats priority_stats_;
 
   MessageHandler message_handler_;
   LogHandler log_handler_;
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "toio/transport/connection.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/websocket.hpp>
+
+namespace toio::transport {
+
+// Boost.Beast の同期 WebSocket。受信は reader スレッドで行う。
+class WebSocketConnection : public Connection {
+public:
+  WebSocketConnection(std::string host,
+                      std::string port,
+                      std::string endpoint = "/ws");
+  ~WebSocketConnection() override;
+
+  WebSocketConnection(const WebSocketConnection &) = delete;
+  WebSocketConnection &operator=(const WebSocketConnection &) = delete;
+
+  void open(ReceiveHandler on_message, LogHandler on_log) override;
+  void close() override;
+  bool is_open() const override;
+  void write(const std::string &text) override;
+
+private:
+  using websocket_t =
+      boost::beast::websocket::stream<boost::asio::ip::tcp::socket>;
+
+  void reader_loop();
+  void log(const std::string &message) const;
+
+  std::string host_;
+  std::string port_;
+  std::string endpoint_;
+
+  boost::asio::io_context io_context_;
+  boost::asio::ip::tcp::resolver resolver_;
+  websocket_t websocket_;
+
+  std::atomic<bool> connected_{false};
+  std::atomic<bool> running_{false};
+  std::thread reader_thread_;
+
+  ReceiveHandler on_message_;
+  LogHandler log_;
+};
+
+} // namespace toio::transport
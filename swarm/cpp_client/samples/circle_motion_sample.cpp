@@ -1,8 +1,8 @@
-#include "motion_planner.hpp"
-
 #include "toio/api/fleet_control.hpp"
 #include "toio/cli/config_loader.hpp"
 #include "toio/middleware/cube_state.hpp"
+#include "toio/planning/assignment.hpp"
+#include "toio/planning/motion_planner.hpp"
 
 #include <algorithm>
 #include <atomic>
@@ -12,6 +12,8 @@
 #include <future>
 #include <iostream>
 #include <mutex>
+#include <random>
+#include <span>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -230,7 +232,11 @@ int main(int argc, char **argv) {
     std::cout << "Driving " << active_cubes.size()
               << " cube(s) using the motion planner demo.\n";
 
-    swarm::samples::MotionPlanner planner;
+    // 実機のデモは毎回違う動きにする。
+    toio::planning::MotionPlannerParameters planner_params;
+    planner_params.seed = std::random_device{}();
+    toio::planning::MotionPlanner planner(planner_params);
+    planner.reserve(active_cubes.size());
     auto goal_for_position = [](double x, double y) {
       toio::control::GoalOptions goal;
       goal.goal_x = static_cast<int>(std::lround(x));
@@ -242,24 +248,33 @@ int main(int argc, char **argv) {
       return goal;
     };
 
-    
+    // 並べた順ではなく、移動距離が最小になるように整列位置を割り当てる。
     auto initial_targets = planner.initial_targets(active_cubes.size());
+    const auto start_positions =
+        extract_positions(active_cubes, control.snapshot());
+    toio::planning::TargetAssigner assigner;
+    const auto &assignment = assigner.assign(
+        std::span<const toio::middleware::Position>(start_positions),
+        initial_targets);
     for (std::size_t i = 0; i < active_cubes.size(); ++i) {
-      if (i >= initial_targets.size()) {
-        break;
-      }
-      const auto &target = initial_targets[i];
+      const auto &target = initial_targets[assignment.target_of[i]];
       control.start_goal(active_cubes[i], goal_for_position(target.x, target.y));
     }
 
     const auto start_time = std::chrono::steady_clock::now();
     const auto end_time = start_time + kDemoDuration;
+    auto last_step = start_time;
 
     while (std::chrono::steady_clock::now() < end_time &&
            !g_interrupted.load()) {
       auto snapshots = control.snapshot();
       auto positions = extract_positions(active_cubes, snapshots);
-      auto targets = planner.next_targets(positions);
+      // 実際に経過した時間だけ進める。
+      const auto now = std::chrono::steady_clock::now();
+      const double dt = std::max(
+          std::chrono::duration<double>(now - last_step).count(), 1e-3);
+      last_step = now;
+      const auto &targets = planner.step(positions, dt);
       if (targets.size() != active_cubes.size()) {
         std::cerr << "Planner output size mismatch, skipping update cycle.\n";
         std::this_thread::sleep_for(kUpdateInterval);
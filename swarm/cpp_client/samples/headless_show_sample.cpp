@@ -0,0 +1,307 @@
+// circle_motion_sample と同じ MotionPlanner + GoalController の構成を、
+// 実機なし・仮想時間で最後まで走らせる。
+//   ./headless_show_sample --cubes 100 --duration-s 600 --seed 1
+//   ./headless_show_sample --cubes 100 --duration-s 90 --flock
+//   ./headless_show_sample --cubes 100 --duration-s 90 --person
+//   ./headless_show_sample --cubes 100 --duration-s 90 --flow
+//   ./headless_show_sample --cubes 100 --duration-s 90 --formation --assign index
+//   ./headless_show_sample --cubes 30 --duration-s 60 --choreography demo
+//   ./headless_show_sample --cubes 100 --duration-s 120 --themes all
+// 同じ引数なら最後の digest (全 Cube の最終位置のハッシュ) は毎回一致する。
+
+#include "show_runner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+struct ShowArgs {
+  std::size_t cubes = 100;
+  std::chrono::seconds duration{600};
+  std::chrono::milliseconds planner_interval{120};
+  std::chrono::milliseconds poll_interval{100};
+  std::uint32_t seed = 1;
+  // MotionPlanner を分けて回すスレッド数。0 ならコア数。
+  std::size_t planner_threads = 1;
+  bool flock = false;
+  bool orca = false;
+  bool person = false;
+  bool flow = false;
+  bool formation = false;
+  // 空なら添字順。
+  std::optional<toio::planning::AssignmentMethod> assign =
+      toio::planning::AssignmentMethod::Auto;
+  // JSON のパスか demo。
+  std::string choreography;
+  // カンマ区切りのテーマ名か all。
+  std::string themes;
+  std::chrono::milliseconds theme_period{20000};
+  std::chrono::milliseconds theme_fade{4000};
+  // 送受信の両方向に同じ性質を入れる。
+  toio::fault::FaultConfig faults;
+};
+
+void print_usage(const char *argv0) {
+  std::cout
+      << "Usage: " << argv0 << " [options]\n"
+      << "  --cubes <N>              Number of simulated cubes (default 100)\n"
+      << "  --duration-s <s>         Simulated show length (default 600)\n"
+      << "  --planner-ms <ms>        Planner update period (default 120)\n"
+      << "  --poll-ms <ms>           GoalController poll_interval (default 100)\n"
+      << "  --seed <n>               Planner / relay seed (default 1)\n"
+      << "  --planner-threads <N>    MotionPlanner threads, 0 = all cores\n"
+      << "                           (default 1, same output for any N)\n"
+      << "  --flock                  Use the Flock planner (form, split, reunite)\n"
+      << "  --orca                   Use ORCA instead of the collision brake\n"
+      << "  --person                 Walk a virtual person across the mat\n"
+      << "  --flow                   Drift with a vortex / wind flow field\n"
+      << "  --formation              Cycle formations (rings, grid, two blocks)\n"
+      << "  --assign <method>        auto | hungarian | auction | greedy | index\n"
+      << "                           (default auto)\n"
+      << "  --choreography <path>    Play a keyframe choreography JSON (or demo)\n"
+      << "  --themes <a,b,...>       Cycle behavior themes (medaka, locust, duck,\n"
+      << "                           star, or all)\n"
+      << "  --theme-period-s <s>     Seconds per theme (default 20)\n"
+      << "  --theme-fade-s <s>       Crossfade between themes (default 4)\n"
+      << "Network faults (both directions):\n"
+      << "  --latency-ms <ms>        Fixed one-way latency\n"
+      << "  --jitter-ms <ms>         Extra random latency\n"
+      << "  --jitter <dist>          uniform | normal | exponential (default uniform)\n"
+      << "  --in-order               Do not let jitter reorder messages\n"
+      << "  --drop <p>               Independent drop probability\n"
+      << "  --burst <p>              Probability of entering a burst loss\n"
+      << "  --bandwidth-kbps <k>     Bandwidth cap in kB/s\n"
+      << "  --outage-every-s <s>     Mean time between outages\n"
+      << "  --outage-ms <ms>         Outage length\n"
+      << "  --outage-hold            Hold messages during outages instead of dropping\n";
+}
+
+ShowArgs parse_args(int argc, char **argv) {
+  ShowArgs args;
+  auto value = [&](int &i, const std::string &name) -> std::string {
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + name);
+    }
+    return argv[++i];
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--cubes") {
+      args.cubes = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--duration-s") {
+      args.duration = std::chrono::seconds(std::stol(value(i, arg)));
+    } else if (arg == "--planner-ms") {
+      args.planner_interval = std::chrono::milliseconds(std::stol(value(i, arg)));
+    } else if (arg == "--poll-ms") {
+      args.poll_interval = std::chrono::milliseconds(std::stol(value(i, arg)));
+    } else if (arg == "--seed") {
+      args.seed = static_cast<std::uint32_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--planner-threads") {
+      args.planner_threads = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--flock") {
+      args.flock = true;
+    } else if (arg == "--orca") {
+      args.orca = true;
+    } else if (arg == "--person") {
+      args.person = true;
+    } else if (arg == "--flow") {
+      args.flow = true;
+    } else if (arg == "--formation") {
+      args.formation = true;
+    } else if (arg == "--choreography") {
+      args.choreography = value(i, arg);
+    } else if (arg == "--themes") {
+      args.themes = value(i, arg);
+    } else if (arg == "--theme-period-s") {
+      args.theme_period = std::chrono::milliseconds(
+          std::lround(std::stod(value(i, arg)) * 1000.0));
+    } else if (arg == "--theme-fade-s") {
+      args.theme_fade = std::chrono::milliseconds(
+          std::lround(std::stod(value(i, arg)) * 1000.0));
+    } else if (arg == "--assign") {
+      const auto name = value(i, arg);
+      if (name == "index") {
+        args.assign.reset();
+      } else if (name == "auto") {
+        args.assign = toio::planning::AssignmentMethod::Auto;
+      } else if (name == "hungarian") {
+        args.assign = toio::planning::AssignmentMethod::Hungarian;
+      } else if (name == "auction") {
+        args.assign = toio::planning::AssignmentMethod::Auction;
+      } else if (name == "greedy") {
+        args.assign = toio::planning::AssignmentMethod::Greedy;
+      } else {
+        throw std::runtime_error("Unknown assignment method: " + name);
+      }
+    } else if (arg == "--latency-ms") {
+      const std::chrono::milliseconds latency(std::stol(value(i, arg)));
+      args.faults.uplink.latency = args.faults.downlink.latency = latency;
+    } else if (arg == "--jitter-ms") {
+      const std::chrono::milliseconds jitter(std::stol(value(i, arg)));
+      args.faults.uplink.jitter = args.faults.downlink.jitter = jitter;
+    } else if (arg == "--jitter") {
+      const auto name = value(i, arg);
+      auto distribution = toio::fault::LatencyDistribution::Uniform;
+      if (name == "normal") {
+        distribution = toio::fault::LatencyDistribution::Normal;
+      } else if (name == "exponential") {
+        distribution = toio::fault::LatencyDistribution::Exponential;
+      } else if (name != "uniform") {
+        throw std::runtime_error("Unknown jitter distribution: " + name);
+      }
+      args.faults.uplink.distribution = args.faults.downlink.distribution =
+          distribution;
+    } else if (arg == "--in-order") {
+      args.faults.uplink.keep_order = args.faults.downlink.keep_order = true;
+    } else if (arg == "--drop") {
+      const double rate = std::stod(value(i, arg));
+      args.faults.uplink.drop_rate = args.faults.downlink.drop_rate = rate;
+    } else if (arg == "--burst") {
+      const double rate = std::stod(value(i, arg));
+      args.faults.uplink.burst_enter = args.faults.downlink.burst_enter = rate;
+    } else if (arg == "--bandwidth-kbps") {
+      const double bandwidth = std::stod(value(i, arg)) * 1000.0;
+      args.faults.uplink.bandwidth = args.faults.downlink.bandwidth = bandwidth;
+    } else if (arg == "--outage-every-s") {
+      args.faults.outage_interval = std::chrono::milliseconds(
+          static_cast<std::int64_t>(std::stod(value(i, arg)) * 1000.0));
+    } else if (arg == "--outage-ms") {
+      args.faults.outage_duration =
+          std::chrono::milliseconds(std::stol(value(i, arg)));
+    } else if (arg == "--outage-hold") {
+      args.faults.outage_mode = toio::fault::OutageMode::Hold;
+    } else if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+  return args;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    const auto args = parse_args(argc, argv);
+
+    swarm::samples::ShowConfig config;
+    config.cubes = args.cubes;
+    config.duration = args.duration;
+    config.planner_interval = args.planner_interval;
+    config.poll_interval = args.poll_interval;
+    config.seed = args.seed;
+    config.planner.threads = args.planner_threads;
+    if (args.flock) {
+      config.mode = swarm::samples::ShowPlanner::Flock;
+    }
+    if (args.formation) {
+      config.mode = swarm::samples::ShowPlanner::Formation;
+      if (args.assign) {
+        config.assignment->method = *args.assign;
+      } else {
+        config.assignment.reset();
+      }
+    }
+    if (args.orca) {
+      config.planner.avoidance = toio::planning::Avoidance::Orca;
+    }
+    if (!args.choreography.empty()) {
+      config.mode = swarm::samples::ShowPlanner::Choreography;
+      config.choreography =
+          std::make_shared<const toio::planning::Choreography>(
+              args.choreography == "demo"
+                  ? swarm::samples::make_demo_choreography(config)
+                  : toio::planning::Choreography::load(args.choreography));
+    }
+    if (!args.themes.empty()) {
+      config.mode = swarm::samples::ShowPlanner::Themes;
+      config.theme_period = args.theme_period;
+      config.theme_fade = args.theme_fade;
+      if (args.themes != "all") {
+        std::size_t begin = 0;
+        while (begin <= args.themes.size()) {
+          const auto end = std::min(args.themes.find(',', begin),
+                                    args.themes.size());
+          config.themes.push_back(args.themes.substr(begin, end - begin));
+          begin = end + 1;
+        }
+      }
+    }
+    config.person = args.person;
+    config.flow = args.flow;
+    if (args.faults.active()) {
+      config.faults = args.faults;
+      config.faults->seed = args.seed;
+    }
+    const auto result = swarm::samples::run_headless_show(config);
+    const auto &metrics = result.metrics;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "cubes            " << config.cubes << "\n"
+              << "simulated        " << result.simulated_s << " s\n"
+              << "wall             " << result.wall_s << " s ("
+              << result.simulated_s / std::max(result.wall_s, 1e-9)
+              << "x real time)\n"
+              << "planner steps    " << result.planner_steps << "\n"
+              << "goal ticks       " << result.goal_ticks << "\n"
+              << "messages         " << result.messages << "\n"
+              << "task switches    " << result.task_switches << "\n"
+              << "state age p99    " << result.state_age_p99_ms << " ms\n"
+              << "min distance     " << metrics.min_distance << "\n"
+              << "collisions       " << metrics.collisions << "\n"
+              << "coverage         " << metrics.coverage * 100.0 << " %\n"
+              << "jerk rms         " << metrics.jerk_rms << "\n";
+    if (config.person) {
+      std::cout << "person contacts  " << metrics.person_contacts << "\n";
+    }
+    if (config.mode == swarm::samples::ShowPlanner::Formation) {
+      std::cout << "formations       " << metrics.settled << "/"
+                << metrics.formations << " settled, mean "
+                << metrics.settle_s << " s\n"
+                << "assigned travel  " << metrics.assigned_distance
+                << " per switch, max " << metrics.assigned_max_distance << "\n";
+    }
+    if (config.mode == swarm::samples::ShowPlanner::Choreography) {
+      std::cout << "tracking error   " << metrics.tracking_error << "\n";
+    }
+    if (config.mode == swarm::samples::ShowPlanner::Themes) {
+      std::cout << "theme switches   " << metrics.theme_switches << "\n"
+                << "late ticks       " << result.late_ticks << "\n";
+    }
+    std::cout << "digest           " << std::hex << result.digest << std::dec
+              << "\n";
+    if (config.faults) {
+      for (const auto &[name, link] :
+           {std::pair{"uplink  ", result.faults.uplink},
+            std::pair{"downlink", result.faults.downlink}}) {
+        std::cout << "faults " << name << "  " << link.delivered << "/"
+                  << link.messages << " delivered, dropped " << link.dropped
+                  << " + burst " << link.burst_dropped << " + outage "
+                  << link.outage_dropped << ", mean delay "
+                  << link.delay_ms_total /
+                         static_cast<double>(std::max<std::uint64_t>(
+                             1, link.messages - link.dropped -
+                                    link.burst_dropped - link.outage_dropped))
+                  << " ms, max " << link.delay_ms_max << " ms\n";
+      }
+      std::cout << "outages          " << result.faults.outages << "\n";
+    }
+  } catch (const std::exception &ex) {
+    std::cerr << "Headless show failed: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
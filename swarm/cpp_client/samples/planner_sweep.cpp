@@ -0,0 +1,463 @@
+// MotionPlanner のパラメータを振って headless ショーを並列に走らせ、
+// 評価指標でランク付けしたレポートを書き出す。
+//   ./planner_sweep --grid safe_distance=90,120,150 --grid repulsion_gain=2000,2600,3200
+//   ./planner_sweep --range random_sigma=60:180 --samples 32 --seeds 1,2 --jobs 8
+// 各実行は仮想時間の Simulation を 1 スレッドで持つので、コア数だけ同時に走る。
+
+#include "show_runner.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+using toio::planning::MotionPlannerParameters;
+using swarm::samples::ShowConfig;
+using swarm::samples::ShowMetrics;
+using swarm::samples::ShowResult;
+
+namespace {
+
+struct ParameterField {
+  const char *name;
+  double MotionPlannerParameters::*member;
+};
+
+// 振れるパラメータ。フィールド範囲は評価 (被覆率) の前提なので含めない。
+const ParameterField kFields[] = {
+    {"safety_margin", &MotionPlannerParameters::safety_margin},
+    {"random_theta", &MotionPlannerParameters::random_theta},
+    {"random_sigma", &MotionPlannerParameters::random_sigma},
+    {"random_speed_limit", &MotionPlannerParameters::random_speed_limit},
+    {"random_bias_x", &MotionPlannerParameters::random_bias_x},
+    {"random_bias_y", &MotionPlannerParameters::random_bias_y},
+    {"boundary_reflect_margin", &MotionPlannerParameters::boundary_reflect_margin},
+    {"boundary_damping", &MotionPlannerParameters::boundary_damping},
+    {"safe_distance", &MotionPlannerParameters::safe_distance},
+    {"repulsion_gain", &MotionPlannerParameters::repulsion_gain},
+    {"boundary_repulsion_gain", &MotionPlannerParameters::boundary_repulsion_gain},
+    {"max_speed", &MotionPlannerParameters::max_speed},
+    {"collision_stop_distance", &MotionPlannerParameters::collision_stop_distance},
+    {"collision_stop_min_scale", &MotionPlannerParameters::collision_stop_min_scale},
+    {"lookahead_time", &MotionPlannerParameters::lookahead_time},
+};
+
+const ParameterField &find_field(const std::string &name) {
+  for (const auto &field : kFields) {
+    if (name == field.name) {
+      return field;
+    }
+  }
+  throw std::runtime_error("Unknown planner parameter: " + name);
+}
+
+struct GridAxis {
+  const ParameterField *field = nullptr;
+  std::vector<double> values;
+};
+
+struct RangeAxis {
+  const ParameterField *field = nullptr;
+  double low = 0.0;
+  double high = 0.0;
+};
+
+struct Weights {
+  double coverage = 1.0;
+  double distance = 1.0;
+  double collision = 0.05;
+  double jerk = 1.0;
+};
+
+struct SweepArgs {
+  std::vector<GridAxis> grid;
+  std::vector<RangeAxis> ranges;
+  std::size_t samples = 16;
+  std::uint32_t search_seed = 1;
+  std::vector<std::uint32_t> seeds{1};
+  std::size_t cubes = 100;
+  std::chrono::seconds duration{120};
+  std::size_t jobs = 0;
+  std::size_t top = 10;
+  Weights weights;
+  std::string out = "planner_sweep.json";
+  std::string csv;
+};
+
+// 1 つの候補 = 振ったパラメータの値の組。
+struct Candidate {
+  std::vector<std::pair<const ParameterField *, double>> values;
+};
+
+struct CandidateResult {
+  const Candidate *candidate = nullptr;
+  ShowMetrics metrics;
+  double score = 0.0;
+  std::vector<std::size_t> runs;
+};
+
+void print_usage(const char *argv0) {
+  std::cout
+      << "Usage: " << argv0 << " [options]\n"
+      << "  --grid <name>=<v1,v2,...>  Values to try (repeatable, cartesian product)\n"
+      << "  --range <name>=<lo>:<hi>   Uniform random range (repeatable)\n"
+      << "  --samples <N>              Random draws per grid point (default 16)\n"
+      << "  --search-seed <n>          Seed for the random draws (default 1)\n"
+      << "  --seeds <s1,s2,...>        Simulation seeds per candidate (default 1)\n"
+      << "  --cubes <N>                Simulated cubes (default 100)\n"
+      << "  --duration-s <s>           Simulated show length (default 120)\n"
+      << "  --jobs <N>                 Parallel runs (default: hardware threads)\n"
+      << "  --top <K>                  Rows to print (default 10)\n"
+      << "  --w-coverage <w>           Score weight for coverage (default 1)\n"
+      << "  --w-distance <w>           Score weight for min distance / 100 (default 1)\n"
+      << "  --w-collision <w>          Score penalty per collision (default 0.05)\n"
+      << "  --w-jerk <w>               Score penalty for jerk rms / 1e4 (default 1)\n"
+      << "  --out <path>               JSON report (default planner_sweep.json)\n"
+      << "  --csv <path>               Also write a CSV table\n"
+      << "Parameters:";
+  for (const auto &field : kFields) {
+    std::cout << " " << field.name;
+  }
+  std::cout << std::endl;
+}
+
+std::vector<std::string> split(const std::string &text, char separator) {
+  std::vector<std::string> parts;
+  std::size_t begin = 0;
+  while (true) {
+    const auto end = text.find(separator, begin);
+    parts.push_back(text.substr(begin, end - begin));
+    if (end == std::string::npos) {
+      return parts;
+    }
+    begin = end + 1;
+  }
+}
+
+std::pair<std::string, std::string> split_assignment(const std::string &text) {
+  const auto eq = text.find('=');
+  if (eq == std::string::npos || eq == 0 || eq + 1 == text.size()) {
+    throw std::runtime_error("Expected <name>=<values>: " + text);
+  }
+  return {text.substr(0, eq), text.substr(eq + 1)};
+}
+
+SweepArgs parse_args(int argc, char **argv) {
+  SweepArgs args;
+  auto value = [&](int &i, const std::string &name) -> std::string {
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + name);
+    }
+    return argv[++i];
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--grid") {
+      const auto [name, list] = split_assignment(value(i, arg));
+      GridAxis axis{&find_field(name), {}};
+      for (const auto &item : split(list, ',')) {
+        axis.values.push_back(std::stod(item));
+      }
+      args.grid.push_back(std::move(axis));
+    } else if (arg == "--range") {
+      const auto [name, bounds] = split_assignment(value(i, arg));
+      const auto parts = split(bounds, ':');
+      if (parts.size() != 2) {
+        throw std::runtime_error("Expected <lo>:<hi> for " + name);
+      }
+      RangeAxis axis{&find_field(name), std::stod(parts[0]), std::stod(parts[1])};
+      if (axis.high < axis.low) {
+        std::swap(axis.low, axis.high);
+      }
+      args.ranges.push_back(axis);
+    } else if (arg == "--samples") {
+      args.samples = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--search-seed") {
+      args.search_seed = static_cast<std::uint32_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--seeds") {
+      args.seeds.clear();
+      for (const auto &item : split(value(i, arg), ',')) {
+        args.seeds.push_back(static_cast<std::uint32_t>(std::stoul(item)));
+      }
+    } else if (arg == "--cubes") {
+      args.cubes = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--duration-s") {
+      args.duration = std::chrono::seconds(std::stol(value(i, arg)));
+    } else if (arg == "--jobs") {
+      args.jobs = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--top") {
+      args.top = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--w-coverage") {
+      args.weights.coverage = std::stod(value(i, arg));
+    } else if (arg == "--w-distance") {
+      args.weights.distance = std::stod(value(i, arg));
+    } else if (arg == "--w-collision") {
+      args.weights.collision = std::stod(value(i, arg));
+    } else if (arg == "--w-jerk") {
+      args.weights.jerk = std::stod(value(i, arg));
+    } else if (arg == "--out") {
+      args.out = value(i, arg);
+    } else if (arg == "--csv") {
+      args.csv = value(i, arg);
+    } else if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+  if (args.seeds.empty()) {
+    throw std::runtime_error("--seeds must not be empty");
+  }
+  if (args.jobs == 0) {
+    args.jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  return args;
+}
+
+// グリッドの直積に、ranges があれば各点ごとに samples 個の一様乱数を足す。
+std::vector<Candidate> build_candidates(const SweepArgs &args) {
+  std::vector<Candidate> candidates(1);
+  for (const auto &axis : args.grid) {
+    std::vector<Candidate> expanded;
+    expanded.reserve(candidates.size() * axis.values.size());
+    for (const auto &base : candidates) {
+      for (double value : axis.values) {
+        auto next = base;
+        next.values.emplace_back(axis.field, value);
+        expanded.push_back(std::move(next));
+      }
+    }
+    candidates = std::move(expanded);
+  }
+  if (!args.ranges.empty()) {
+    std::mt19937 rng(args.search_seed);
+    std::vector<Candidate> expanded;
+    expanded.reserve(candidates.size() * args.samples);
+    for (const auto &base : candidates) {
+      for (std::size_t n = 0; n < args.samples; ++n) {
+        auto next = base;
+        for (const auto &axis : args.ranges) {
+          std::uniform_real_distribution<double> dist(axis.low, axis.high);
+          next.values.emplace_back(axis.field, dist(rng));
+        }
+        expanded.push_back(std::move(next));
+      }
+    }
+    candidates = std::move(expanded);
+  }
+  return candidates;
+}
+
+// 被覆率と最小距離は大きいほど良く、接触とジャークは小さいほど良い。
+double score_of(const ShowMetrics &metrics, const Weights &weights) {
+  return weights.coverage * metrics.coverage +
+         weights.distance * metrics.min_distance / 100.0 -
+         weights.collision * static_cast<double>(metrics.collisions) -
+         weights.jerk * metrics.jerk_rms / 1e4;
+}
+
+nlohmann::json metrics_json(const ShowMetrics &metrics) {
+  return {{"min_distance", metrics.min_distance},
+          {"collisions", metrics.collisions},
+          {"coverage", metrics.coverage},
+          {"jerk_rms", metrics.jerk_rms}};
+}
+
+nlohmann::json params_json(const Candidate &candidate) {
+  nlohmann::json params = nlohmann::json::object();
+  for (const auto &[field, value] : candidate.values) {
+    params[field->name] = value;
+  }
+  return params;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    const auto args = parse_args(argc, argv);
+    const auto candidates = build_candidates(args);
+    const auto total = candidates.size() * args.seeds.size();
+    std::cout << "candidates " << candidates.size() << " x seeds "
+              << args.seeds.size() << " = " << total << " runs on "
+              << args.jobs << " threads" << std::endl;
+
+    std::vector<ShowResult> results(total);
+    std::vector<std::string> errors(total);
+    std::atomic<std::size_t> next{0};
+    std::atomic<std::size_t> done{0};
+    std::mutex output_mutex;
+    const auto wall_started = std::chrono::steady_clock::now();
+
+    // run i = 候補 i / seeds 数、seed i % seeds 数。
+    auto worker = [&] {
+      for (std::size_t i = next++; i < total; i = next++) {
+        ShowConfig config;
+        config.cubes = args.cubes;
+        config.duration = args.duration;
+        config.seed = args.seeds[i % args.seeds.size()];
+        for (const auto &[field, value] : candidates[i / args.seeds.size()].values) {
+          config.planner.*(field->member) = value;
+        }
+        try {
+          results[i] = swarm::samples::run_headless_show(config);
+        } catch (const std::exception &ex) {
+          errors[i] = ex.what();
+        }
+        const auto finished = ++done;
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cerr << "\r" << finished << "/" << total << " runs" << std::flush;
+      }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t n = 0; n < std::min(args.jobs, total); ++n) {
+      workers.emplace_back(worker);
+    }
+    for (auto &thread : workers) {
+      thread.join();
+    }
+    std::cerr << std::endl;
+    const auto wall = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - wall_started)
+                          .count();
+
+    for (std::size_t i = 0; i < total; ++i) {
+      if (!errors[i].empty()) {
+        throw std::runtime_error("run " + std::to_string(i) + " failed: " +
+                                 errors[i]);
+      }
+    }
+
+    // seed 間の集計: 最小距離は最悪値、接触は合計、被覆率とジャークは平均。
+    std::vector<CandidateResult> ranked;
+    ranked.reserve(candidates.size());
+    for (std::size_t c = 0; c < candidates.size(); ++c) {
+      CandidateResult entry;
+      entry.candidate = &candidates[c];
+      entry.metrics.min_distance = std::numeric_limits<double>::infinity();
+      for (std::size_t s = 0; s < args.seeds.size(); ++s) {
+        const auto run = c * args.seeds.size() + s;
+        const auto &metrics = results[run].metrics;
+        entry.runs.push_back(run);
+        entry.metrics.min_distance =
+            std::min(entry.metrics.min_distance, metrics.min_distance);
+        entry.metrics.collisions += metrics.collisions;
+        entry.metrics.coverage += metrics.coverage;
+        entry.metrics.jerk_rms += metrics.jerk_rms;
+        entry.metrics.samples += metrics.samples;
+      }
+      const auto seeds = static_cast<double>(args.seeds.size());
+      entry.metrics.coverage /= seeds;
+      entry.metrics.jerk_rms /= seeds;
+      entry.score = score_of(entry.metrics, args.weights);
+      ranked.push_back(std::move(entry));
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const CandidateResult &a, const CandidateResult &b) {
+                       return a.score > b.score;
+                     });
+
+    double simulated = 0.0;
+    for (const auto &result : results) {
+      simulated += result.simulated_s;
+    }
+
+    nlohmann::json report;
+    report["sweep"] = {{"cubes", args.cubes},
+                       {"duration_s", args.duration.count()},
+                       {"seeds", args.seeds},
+                       {"jobs", args.jobs},
+                       {"runs", total},
+                       {"wall_s", wall},
+                       {"simulated_s", simulated},
+                       {"weights",
+                        {{"coverage", args.weights.coverage},
+                         {"distance", args.weights.distance},
+                         {"collision", args.weights.collision},
+                         {"jerk", args.weights.jerk}}}};
+    auto &rows = report["results"] = nlohmann::json::array();
+    for (std::size_t rank = 0; rank < ranked.size(); ++rank) {
+      const auto &entry = ranked[rank];
+      nlohmann::json runs = nlohmann::json::array();
+      for (auto run : entry.runs) {
+        const auto &result = results[run];
+        char digest[17];
+        std::snprintf(digest, sizeof(digest), "%016llx",
+                      static_cast<unsigned long long>(result.digest));
+        auto item = metrics_json(result.metrics);
+        item["seed"] = args.seeds[run % args.seeds.size()];
+        item["digest"] = digest;
+        item["wall_s"] = result.wall_s;
+        runs.push_back(std::move(item));
+      }
+      rows.push_back({{"rank", rank + 1},
+                      {"score", entry.score},
+                      {"params", params_json(*entry.candidate)},
+                      {"metrics", metrics_json(entry.metrics)},
+                      {"runs", std::move(runs)}});
+    }
+    std::ofstream out(args.out);
+    if (!out) {
+      throw std::runtime_error("Failed to open " + args.out);
+    }
+    out << report.dump(2) << "\n";
+
+    if (!args.csv.empty()) {
+      std::ofstream csv(args.csv);
+      if (!csv) {
+        throw std::runtime_error("Failed to open " + args.csv);
+      }
+      csv << "rank,score,min_distance,collisions,coverage,jerk_rms";
+      for (const auto &[field, value] : candidates.front().values) {
+        csv << "," << field->name;
+      }
+      csv << "\n";
+      for (std::size_t rank = 0; rank < ranked.size(); ++rank) {
+        const auto &entry = ranked[rank];
+        csv << rank + 1 << "," << entry.score << ","
+            << entry.metrics.min_distance << "," << entry.metrics.collisions
+            << "," << entry.metrics.coverage << "," << entry.metrics.jerk_rms;
+        for (const auto &[field, value] : entry.candidate->values) {
+          csv << "," << value;
+        }
+        csv << "\n";
+      }
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << "wall " << wall
+              << " s, simulated " << simulated << " s ("
+              << simulated / std::max(wall, 1e-9) << "x real time)\n"
+              << "rank   score  min_dist  coll  cover%      jerk  params\n";
+    for (std::size_t rank = 0; rank < std::min(args.top, ranked.size()); ++rank) {
+      const auto &entry = ranked[rank];
+      std::cout << std::setw(4) << rank + 1 << std::setw(8)
+                << std::setprecision(3) << entry.score << std::setw(10)
+                << std::setprecision(1) << entry.metrics.min_distance
+                << std::setw(6) << entry.metrics.collisions << std::setw(8)
+                << entry.metrics.coverage * 100.0 << std::setw(10)
+                << std::setprecision(0) << entry.metrics.jerk_rms << "  "
+                << params_json(*entry.candidate).dump() << "\n";
+    }
+    std::cout << "report written to " << args.out << std::endl;
+  } catch (const std::exception &ex) {
+    std::cerr << "Planner sweep failed: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,687 @@
+#include "show_runner.hpp"
+
+#include "toio/api/behavior_player.hpp"
+#include "toio/api/choreography_player.hpp"
+#include "toio/control/obstacle_tracker.hpp"
+#include "toio/control/spatial_grid.hpp"
+#include "toio/planning/flow_field.hpp"
+#include "toio/planning/themes.hpp"
+#include "toio/sim/simulation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace swarm::samples {
+
+namespace {
+
+// 最小距離はこの半径の中だけ探す (それより離れていれば半径を返す)。
+constexpr double kDistanceSearchRadius = 200.0;
+
+std::vector<toio::middleware::Position>
+extract_positions(const std::vector<toio::api::CubeHandle> &cubes,
+                  const std::vector<toio::middleware::CubeSnapshot> &snapshots) {
+  std::vector<toio::middleware::Position> positions;
+  positions.reserve(cubes.size());
+  for (const auto &cube : cubes) {
+    toio::middleware::Position position{};
+    for (const auto &snapshot : snapshots) {
+      if (snapshot.state.cube_id == cube.cube_id &&
+          snapshot.state.position.has_value()) {
+        position = *snapshot.state.position;
+        break;
+      }
+    }
+    positions.push_back(position);
+  }
+  return positions;
+}
+
+// 経過の割合 (0..1) に応じてグループとゴールを切り替える。
+void direct_flock(toio::planning::Flock &flock, double progress) {
+  const auto &params = flock.parameters();
+  const double mid_x = (params.field_min_x + params.field_max_x) * 0.5;
+  const double mid_y = (params.field_min_y + params.field_max_y) * 0.5;
+  const double quarter = (params.field_max_x - params.field_min_x) * 0.25;
+  if (progress < 1.0 / 3.0) {
+    if (!flock.goal(0)) {
+      flock.set_goal(0, {mid_x, mid_y});
+    }
+  } else if (progress < 2.0 / 3.0) {
+    if (flock.group_size(1) == 0) {
+      flock.split(0, 1, 0.0);
+      flock.set_goal(0, {mid_x - quarter, mid_y});
+      flock.set_goal(1, {mid_x + quarter, mid_y});
+    }
+  } else if (flock.group_size(1) > 0) {
+    flock.merge(1, 0);
+    flock.set_goal(0, {mid_x, mid_y});
+  }
+}
+
+// 仮想の人の t 秒後の位置。左右の端で折り返す。
+toio::control::Obstacle person_at(const ShowConfig &config, double t) {
+  const auto &p = config.planner;
+  const double left = p.field_min_x + config.person_radius;
+  const double span =
+      std::max(1.0, p.field_max_x - p.field_min_x - 2.0 * config.person_radius);
+  const double travel = std::fmod(config.person_speed * t, 2.0 * span);
+  const bool forward = travel < span;
+  toio::control::Obstacle person;
+  person.x = forward ? left + travel : left + 2.0 * span - travel;
+  person.y = (p.field_min_y + p.field_max_y) * 0.5;
+  person.radius = config.person_radius;
+  person.vx = forward ? config.person_speed : -config.person_speed;
+  return person;
+}
+
+// 渦 (0) と風 (1) の 2 枚。最初は渦だけ。
+std::shared_ptr<toio::planning::FlowBlender> make_show_flow(const ShowConfig &config) {
+  namespace flow = toio::planning::flow;
+  const auto &p = config.planner;
+  const toio::control::GridBounds bounds{p.field_min_x, p.field_min_y,
+                                         p.field_max_x, p.field_max_y};
+  const toio::planning::Vec2 center{(p.field_min_x + p.field_max_x) * 0.5,
+                                    (p.field_min_y + p.field_max_y) * 0.5};
+  auto blender = std::make_shared<toio::planning::FlowBlender>();
+  blender->add(std::make_shared<toio::planning::FlowField>(
+      toio::planning::FlowField::bake(flow::vortex(center, 120.0, 250.0),
+                                      bounds)));
+  blender->add(std::make_shared<toio::planning::FlowField>(
+      toio::planning::FlowField::bake(flow::wave(0.0, 90.0, 60.0, 300.0),
+                                      bounds)));
+  return blender;
+}
+
+constexpr double kPi = 3.14159265358979323846;
+// 隊形の間隔 (マット座標) と、マットの縁から空ける幅。
+constexpr double kFormationSpacing = 45.0;
+constexpr double kFormationMargin = 60.0;
+
+// 矩形に count 点を縦横の間隔がほぼ等しい格子で並べる。
+void grid_formation(double min_x, double min_y, double max_x, double max_y,
+                    std::size_t count,
+                    std::vector<toio::planning::TargetPoint> &out) {
+  const double width = std::max(1.0, max_x - min_x);
+  const double height = std::max(1.0, max_y - min_y);
+  const auto columns = std::max<std::size_t>(
+      1, static_cast<std::size_t>(std::lround(
+             std::sqrt(static_cast<double>(count) * width / height))));
+  const auto rows = (count + columns - 1) / columns;
+  for (std::size_t i = 0; i < count; ++i) {
+    out.push_back({min_x + width * (static_cast<double>(i % columns) + 0.5) /
+                               static_cast<double>(columns),
+                   min_y + height * (static_cast<double>(i / columns) + 0.5) /
+                               static_cast<double>(rows)});
+  }
+}
+
+// 隊形を切り替えて目標点を割り当て、揃うまでの時間を測る。
+class FormationDirector {
+public:
+  FormationDirector(const ShowConfig &config, std::size_t cubes)
+      : config_(config), goals_(cubes) {
+    if (config.assignment) {
+      assigner_.emplace(*config.assignment);
+    }
+  }
+
+  // 次の隊形に切り替え、Cube ごとの目標点を返す。
+  const std::vector<toio::planning::TargetPoint> &
+  next(const std::vector<toio::middleware::Position> &positions,
+       double elapsed_s) {
+    make_formation(kind_++ % 3, positions.size());
+    if (assigner_) {
+      const auto &assignment =
+          assigner_->assign(std::span<const toio::middleware::Position>(positions),
+                            formation_);
+      for (std::size_t i = 0; i < positions.size(); ++i) {
+        goals_[i] = formation_[assignment.target_of[i]];
+      }
+    } else {
+      std::copy(formation_.begin(), formation_.end(), goals_.begin());
+    }
+    double total = 0.0;
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      const double d = std::hypot(goals_[i].x - positions[i].x,
+                                  goals_[i].y - positions[i].y);
+      total += d;
+      metrics_.assigned_max_distance =
+          std::max(metrics_.assigned_max_distance, d);
+    }
+    metrics_.assigned_distance += total;
+    ++metrics_.formations;
+    switched_s_ = elapsed_s;
+    settled_ = false;
+    return goals_;
+  }
+
+  void observe(const std::vector<toio::middleware::Position> &positions,
+               double elapsed_s) {
+    if (settled_ || metrics_.formations == 0) {
+      return;
+    }
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      if (std::hypot(goals_[i].x - positions[i].x,
+                     goals_[i].y - positions[i].y) > config_.settle_distance) {
+        return;
+      }
+    }
+    settled_ = true;
+    ++metrics_.settled;
+    settle_sum_s_ += elapsed_s - switched_s_;
+  }
+
+  void finish(ShowMetrics &metrics) const {
+    metrics.formations = metrics_.formations;
+    metrics.settled = metrics_.settled;
+    metrics.settle_s =
+        metrics_.settled ? settle_sum_s_ / static_cast<double>(metrics_.settled)
+                         : 0.0;
+    metrics.assigned_distance =
+        metrics_.formations ? metrics_.assigned_distance /
+                                  static_cast<double>(metrics_.formations)
+                            : 0.0;
+    metrics.assigned_max_distance = metrics_.assigned_max_distance;
+  }
+
+private:
+  void make_formation(std::size_t kind, std::size_t count) {
+    const auto &p = config_.planner;
+    const double min_x = p.field_min_x + kFormationMargin;
+    const double min_y = p.field_min_y + kFormationMargin;
+    const double max_x = p.field_max_x - kFormationMargin;
+    const double max_y = p.field_max_y - kFormationMargin;
+    formation_.clear();
+    if (kind == 0) {
+      // 外側の円から kFormationSpacing 間隔で詰め、入りきらなければ内側へ。
+      const double cx = (min_x + max_x) * 0.5;
+      const double cy = (min_y + max_y) * 0.5;
+      double radius = std::min(max_x - min_x, max_y - min_y) * 0.5;
+      while (formation_.size() < count) {
+        const auto capacity = std::max<std::size_t>(
+            1, static_cast<std::size_t>(2.0 * kPi * radius / kFormationSpacing));
+        const auto ring = std::min(capacity, count - formation_.size());
+        for (std::size_t k = 0; k < ring; ++k) {
+          const double angle =
+              2.0 * kPi * static_cast<double>(k) / static_cast<double>(ring);
+          formation_.push_back(
+              {cx + radius * std::cos(angle), cy + radius * std::sin(angle)});
+        }
+        radius = std::max(0.0, radius - kFormationSpacing);
+      }
+    } else if (kind == 1) {
+      grid_formation(min_x, min_y, max_x, max_y, count, formation_);
+    } else {
+      const double third = (max_x - min_x) / 3.0;
+      grid_formation(min_x, min_y, min_x + third, max_y, count / 2, formation_);
+      grid_formation(max_x - third, min_y, max_x, max_y, count - count / 2,
+                     formation_);
+    }
+  }
+
+  const ShowConfig &config_;
+  std::optional<toio::planning::TargetAssigner> assigner_;
+  std::vector<toio::planning::TargetPoint> formation_;
+  std::vector<toio::planning::TargetPoint> goals_;
+  std::size_t kind_ = 0;
+  double switched_s_ = 0.0;
+  bool settled_ = false;
+  double settle_sum_s_ = 0.0;
+  ShowMetrics metrics_;
+};
+
+std::uint64_t pose_digest(const std::vector<toio::sim::SimCube> &cubes) {
+  std::uint64_t hash = 1469598103934665603ULL;
+  auto mix = [&hash](std::int64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      hash ^= static_cast<std::uint64_t>(value >> (i * 8)) & 0xFF;
+      hash *= 1099511628211ULL;
+    }
+  };
+  for (const auto &cube : cubes) {
+    const auto pose = cube.pose();
+    mix(std::llround(pose.x * 1000.0));
+    mix(std::llround(pose.y * 1000.0));
+    mix(std::llround(pose.angle * 1000.0));
+  }
+  return hash;
+}
+
+// 一定間隔でシミュレータの実姿勢を見て評価指標を積算する。
+class MetricsProbe {
+public:
+  MetricsProbe(const ShowConfig &config, std::size_t cubes)
+      : config_(config),
+        dt_s_(std::chrono::duration<double>(config.sample_interval).count()),
+        grid_(kDistanceSearchRadius,
+              {config.planner.field_min_x, config.planner.field_min_y,
+               config.planner.field_max_x, config.planner.field_max_y}),
+        history_(cubes),
+        inside_person_(cubes, 0) {
+    const auto &p = config.planner;
+    columns_ = static_cast<std::size_t>(
+        std::ceil((p.field_max_x - p.field_min_x) / config.coverage_cell));
+    rows_ = static_cast<std::size_t>(
+        std::ceil((p.field_max_y - p.field_min_y) / config.coverage_cell));
+    visited_.assign(std::max<std::size_t>(1, columns_ * rows_), 0);
+    metrics_.min_distance = kDistanceSearchRadius;
+  }
+
+  void sample(const std::vector<toio::sim::SimCube> &cubes,
+              const toio::control::Obstacle *person) {
+    ++metrics_.samples;
+    if (person) {
+      const double reach = person->radius + 0.5 * config_.contact_distance;
+      for (std::size_t i = 0; i < cubes.size(); ++i) {
+        const auto &pose = cubes[i].pose();
+        const std::uint8_t inside =
+            std::hypot(pose.x - person->x, pose.y - person->y) < reach;
+        if (inside && !inside_person_[i]) {
+          ++metrics_.person_contacts;
+        }
+        inside_person_[i] = inside;
+      }
+    }
+    std::unordered_set<std::uint64_t> contacts;
+    for (std::size_t i = 0; i < cubes.size(); ++i) {
+      const auto &pose = cubes[i].pose();
+      grid_.update(i, pose.x, pose.y);
+      mark_visited(pose.x, pose.y);
+      accumulate_jerk(i, pose.x, pose.y);
+    }
+    grid_.rebuild();
+    for (std::size_t i = 0; i < cubes.size(); ++i) {
+      const auto &pose = cubes[i].pose();
+      grid_.for_each_within(
+          pose.x, pose.y, kDistanceSearchRadius,
+          [&](const toio::control::SpatialGrid::Item &item) {
+            if (item.id <= i) {
+              return;
+            }
+            const double distance = std::hypot(item.x - pose.x, item.y - pose.y);
+            metrics_.min_distance = std::min(metrics_.min_distance, distance);
+            if (distance < config_.contact_distance) {
+              contacts.insert(static_cast<std::uint64_t>(i) * cubes.size() +
+                              item.id);
+            }
+          });
+    }
+    for (auto key : contacts) {
+      if (!contacts_.count(key)) {
+        ++metrics_.collisions;
+      }
+    }
+    contacts_.swap(contacts);
+  }
+
+  ShowMetrics finish() const {
+    auto metrics = metrics_;
+    const auto visited =
+        std::count(visited_.begin(), visited_.end(), std::uint8_t{1});
+    metrics.coverage =
+        static_cast<double>(visited) / static_cast<double>(visited_.size());
+    metrics.jerk_rms =
+        jerk_count_ ? std::sqrt(jerk_sq_sum_ / static_cast<double>(jerk_count_))
+                    : 0.0;
+    return metrics;
+  }
+
+private:
+  struct History {
+    std::array<double, 3> x{};
+    std::array<double, 3> y{};
+    std::size_t count = 0;
+  };
+
+  void mark_visited(double x, double y) {
+    const auto &p = config_.planner;
+    const auto column = static_cast<std::size_t>(std::clamp(
+        (x - p.field_min_x) / config_.coverage_cell, 0.0,
+        static_cast<double>(columns_ - 1)));
+    const auto row = static_cast<std::size_t>(std::clamp(
+        (y - p.field_min_y) / config_.coverage_cell, 0.0,
+        static_cast<double>(rows_ - 1)));
+    visited_[row * columns_ + column] = 1;
+  }
+
+  // j = (p[t] - 3p[t-1] + 3p[t-2] - p[t-3]) / dt^3
+  void accumulate_jerk(std::size_t index, double x, double y) {
+    auto &h = history_[index];
+    if (h.count >= 3) {
+      const double dt3 = dt_s_ * dt_s_ * dt_s_;
+      const double jx = (x - 3.0 * h.x[2] + 3.0 * h.x[1] - h.x[0]) / dt3;
+      const double jy = (y - 3.0 * h.y[2] + 3.0 * h.y[1] - h.y[0]) / dt3;
+      jerk_sq_sum_ += jx * jx + jy * jy;
+      ++jerk_count_;
+    }
+    h.x = {h.x[1], h.x[2], x};
+    h.y = {h.y[1], h.y[2], y};
+    h.count = std::min<std::size_t>(h.count + 1, 3);
+  }
+
+  const ShowConfig &config_;
+  double dt_s_;
+  toio::control::SpatialGrid grid_;
+  std::vector<History> history_;
+  std::vector<std::uint8_t> inside_person_;
+  std::size_t columns_ = 1;
+  std::size_t rows_ = 1;
+  std::vector<std::uint8_t> visited_;
+  std::unordered_set<std::uint64_t> contacts_;
+  double jerk_sq_sum_ = 0.0;
+  std::uint64_t jerk_count_ = 0;
+  ShowMetrics metrics_;
+};
+
+// シミュレータ上のキューブ ID (S000, S001, ...)。
+std::string sim_cube_id(std::size_t index) {
+  // size_t の最大桁 (20) でも切れない大きさ。
+  char id[24];
+  std::snprintf(id, sizeof(id), "S%03zu", index);
+  return id;
+}
+
+} // namespace
+
+toio::planning::Choreography make_demo_choreography(const ShowConfig &config) {
+  constexpr double kStep = 5.0;
+  const auto &p = config.planner;
+  const double cx = (p.field_min_x + p.field_max_x) * 0.5;
+  const double cy = (p.field_min_y + p.field_max_y) * 0.5;
+  const double outer =
+      std::min(p.field_max_x - p.field_min_x, p.field_max_y - p.field_min_y) *
+          0.5 -
+      kFormationMargin;
+  const double seconds = std::chrono::duration<double>(config.duration).count();
+  const auto keys = static_cast<std::size_t>(std::ceil(seconds / kStep)) + 1;
+  const auto count = std::max<std::size_t>(1, config.cubes);
+  std::vector<toio::planning::ChoreographyTrack> tracks(config.cubes);
+  for (std::size_t i = 0; i < config.cubes; ++i) {
+    auto &track = tracks[i];
+    track.cube = sim_cube_id(i);
+    for (std::size_t k = 0; k < keys; ++k) {
+      // 外周と 0.6 倍の円を行き来しながら、1 コマで 1/8 周回る。
+      const double radius = k % 2 == 0 ? outer : outer * 0.6;
+      const double angle = 2.0 * kPi *
+                           (static_cast<double>(i) / static_cast<double>(count) +
+                            static_cast<double>(k) / 8.0);
+      toio::planning::Keyframe key;
+      key.t = static_cast<double>(k) * kStep;
+      key.x = cx + radius * std::cos(angle);
+      key.y = cy + radius * std::sin(angle);
+      key.angle = std::fmod(angle * 180.0 / kPi + 90.0, 360.0);
+      key.led = k % 3 == 0   ? toio::middleware::LedColor{255, 0, 0}
+                : k % 3 == 1 ? toio::middleware::LedColor{0, 255, 0}
+                             : toio::middleware::LedColor{0, 0, 255};
+      key.ease = toio::planning::Ease::Smooth;
+      track.keyframes.push_back(key);
+    }
+  }
+  return toio::planning::Choreography(std::move(tracks));
+}
+
+ShowResult run_headless_show(const ShowConfig &config) {
+  toio::sim::SimulationConfig sim_config;
+  for (std::size_t i = 0; i < config.cubes; ++i) {
+    sim_config.relay.cube_ids.push_back(sim_cube_id(i));
+  }
+  sim_config.relay.seed = config.seed;
+  sim_config.faults = config.faults;
+  const auto wall_started = std::chrono::steady_clock::now();
+
+  // Simulation より先に作り、後で壊す (終了処理中も hook が呼ばれるため)。
+  MetricsProbe probe(config, config.cubes);
+  bool probing = false;
+  toio::sim::Simulation sim(sim_config);
+  auto next_sample = sim.clock().now();
+  toio::runtime::Clock::time_point show_start{};
+  if (config.sample_interval.count() > 0) {
+    sim.clock().add_hook([&](toio::runtime::Clock::time_point now) {
+      if (!probing || now < next_sample) {
+        return;
+      }
+      std::optional<toio::control::Obstacle> person;
+      if (config.person) {
+        person = person_at(
+            config, std::chrono::duration<double>(now - show_start).count());
+      }
+      probe.sample(sim.relay().cubes(), person ? &*person : nullptr);
+      next_sample += config.sample_interval;
+    });
+  }
+
+  auto &control = sim.control();
+  control.set_goal_logger([](const std::string &, const std::string &) {});
+  control.start();
+
+  const auto cubes = control.cubes();
+  // auto_connect の完了を待つ。
+  sim.run_for(std::chrono::seconds(1));
+
+  toio::control::GoalOptions base;
+  base.stop_dist = 5.0;
+  base.poll_interval = config.poll_interval;
+  base.vmax = 80.0;
+  base.wmax = 80.0;
+  std::shared_ptr<toio::control::ObstacleTracker> tracker;
+  std::vector<toio::control::Obstacle> obstacles;
+  if (config.person) {
+    tracker = std::make_shared<toio::control::ObstacleTracker>(
+        sim.runtime().clock);
+    control.set_obstacles(tracker);
+    base.avoidance.enabled = true;
+  }
+  auto goal_for = [&base](const toio::planning::TargetPoint &target) {
+    auto goal = base;
+    goal.goal_x = static_cast<int>(std::lround(target.x));
+    goal.goal_y = static_cast<int>(std::lround(target.y));
+    return goal;
+  };
+
+  auto params = config.planner;
+  params.seed = config.seed;
+  toio::planning::MotionPlanner planner(params);
+  planner.reserve(cubes.size());
+  std::optional<toio::planning::Flock> flock;
+  if (config.mode == ShowPlanner::Flock) {
+    auto flock_params = config.flock;
+    flock_params.seed = config.seed;
+    flock.emplace(flock_params);
+    flock->resize(cubes.size());
+  }
+  const double planner_dt =
+      std::chrono::duration<double>(config.planner_interval).count();
+  std::shared_ptr<toio::planning::FlowBlender> flow;
+  if (config.flow) {
+    flow = make_show_flow(config);
+    planner.set_flow(flow);
+    if (flock) {
+      flock->set_flow(flow);
+    }
+  }
+  auto next_flow_switch = config.flow_period;
+  std::optional<FormationDirector> formation;
+  auto next_formation = config.formation_period;
+  auto initial = planner.initial_targets(cubes.size());
+  if (config.mode == ShowPlanner::Formation) {
+    formation.emplace(config, cubes.size());
+    initial = formation->next(extract_positions(cubes, control.snapshot()), 0.0);
+  }
+  std::optional<toio::api::ChoreographyPlayer> player;
+  if (config.mode == ShowPlanner::Choreography) {
+    if (!config.choreography) {
+      throw std::invalid_argument("Choreography mode requires a choreography");
+    }
+    toio::api::ChoreographyOptions options;
+    options.goal = base;
+    options.tick = config.planner_interval;
+    player.emplace(control, *config.choreography, options, sim.runtime());
+    player->start(cubes);
+  }
+  std::optional<toio::api::BehaviorPlayer> themes;
+  if (config.mode == ShowPlanner::Themes) {
+    toio::planning::ThemeOptions theme_options;
+    theme_options.field = {config.planner.field_min_x, config.planner.field_min_y,
+                           config.planner.field_max_x, config.planner.field_max_y};
+    theme_options.seed = config.seed;
+    toio::planning::BehaviorRuntime behaviors;
+    if (config.themes.empty()) {
+      for (const auto name : toio::planning::theme_names()) {
+        behaviors.add(toio::planning::make_theme(name, theme_options));
+      }
+    } else {
+      for (const auto &name : config.themes) {
+        behaviors.add(toio::planning::make_theme(name, theme_options));
+      }
+    }
+    toio::api::BehaviorOptions options;
+    options.goal = base;
+    options.tick = config.planner_interval;
+    options.fade = config.theme_fade;
+    options.obstacles = tracker;
+    themes.emplace(control, std::move(behaviors), options, sim.runtime());
+    themes->start(cubes);
+  }
+  auto next_theme = config.theme_period;
+  const std::size_t theme_count =
+      config.themes.empty() ? toio::planning::theme_names().size()
+                            : config.themes.size();
+  std::uint64_t theme_switches = 0;
+  if (!player && !themes) {
+    for (std::size_t i = 0; i < cubes.size(); ++i) {
+      control.start_goal(cubes[i], goal_for(initial[i]));
+    }
+  }
+  double tracking_sum = 0.0;
+  std::uint64_t tracking_count = 0;
+
+  ShowResult result;
+  probing = true;
+  show_start = sim.clock().now();
+  const auto show_end = show_start + config.duration;
+  while (sim.clock().now() < show_end) {
+    if (tracker) {
+      // 外部のトラッカーの代わり。プランナーの周期で位置と速度を送る。
+      const auto person = person_at(
+          config, std::chrono::duration<double>(sim.clock().now() - show_start)
+                      .count());
+      tracker->update(person);
+      tracker->snapshot(obstacles);
+    }
+    if (flow) {
+      const auto elapsed = sim.clock().now() - show_start;
+      if (config.flow_period.count() > 0 && elapsed >= next_flow_switch) {
+        // 渦と風を交互に。
+        flow->crossfade(flow->weight(0) > 0.5 ? 1 : 0,
+                        std::chrono::duration<double>(config.flow_fade).count());
+        next_flow_switch += config.flow_period;
+      }
+      flow->advance(planner_dt);
+    }
+    const auto positions = extract_positions(cubes, control.snapshot());
+    if (player) {
+      const auto &table = player->table();
+      const double t =
+          std::chrono::duration<double>(sim.clock().now() - player->start_time())
+              .count();
+      if (t >= 0.0) {
+        const auto frame = table.frame_at(t);
+        for (std::size_t i = 0; i < table.tracks(); ++i) {
+          const auto &pose = table.pose(frame, i);
+          tracking_sum +=
+              std::hypot(pose.x - positions[i].x, pose.y - positions[i].y);
+          ++tracking_count;
+        }
+      }
+      ++result.planner_steps;
+      sim.run_for(config.planner_interval);
+      continue;
+    }
+    if (themes) {
+      // テーマの切り替えは次の tick で拾われる。目標は BehaviorPlayer の
+      // タスクが送るので、ここは時間を進めるだけ。
+      const auto elapsed = sim.clock().now() - show_start;
+      if (config.theme_period.count() > 0 && elapsed >= next_theme) {
+        themes->switch_to((themes->current() + 1) % theme_count);
+        ++theme_switches;
+        next_theme += config.theme_period;
+      }
+      sim.run_for(config.planner_interval);
+      continue;
+    }
+    if (formation) {
+      const auto elapsed = sim.clock().now() - show_start;
+      const double elapsed_s = std::chrono::duration<double>(elapsed).count();
+      formation->observe(positions, elapsed_s);
+      if (config.formation_period.count() > 0 && elapsed >= next_formation) {
+        const auto &goals = formation->next(positions, elapsed_s);
+        for (std::size_t i = 0; i < cubes.size(); ++i) {
+          control.update_goal(cubes[i], goal_for(goals[i]));
+        }
+        next_formation += config.formation_period;
+      }
+      ++result.planner_steps;
+      sim.run_for(config.planner_interval);
+      continue;
+    }
+    if (flock) {
+      direct_flock(*flock, std::chrono::duration<double>(sim.clock().now() -
+                                                         show_start) /
+                               config.duration);
+    }
+    const auto &targets = flock ? flock->step(positions, planner_dt)
+                                : planner.step(positions, planner_dt, obstacles);
+    for (std::size_t i = 0; i < cubes.size() && i < targets.size(); ++i) {
+      control.update_goal(cubes[i], goal_for(targets[i]));
+    }
+    ++result.planner_steps;
+    sim.run_for(config.planner_interval);
+  }
+  probing = false;
+  if (player) {
+    player->stop();
+  }
+  if (themes) {
+    result.planner_steps = themes->ticks();
+    result.late_ticks = themes->late_ticks();
+    themes->stop();
+  }
+  control.stop_all_goals();
+
+  const auto loop = control.loop_metrics();
+  result.metrics = probe.finish();
+  if (formation) {
+    formation->finish(result.metrics);
+  }
+  result.metrics.theme_switches = theme_switches;
+  if (tracking_count > 0) {
+    result.metrics.tracking_error =
+        tracking_sum / static_cast<double>(tracking_count);
+  }
+  result.simulated_s = std::chrono::duration<double>(sim.clock().elapsed()).count();
+  result.wall_s = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - wall_started)
+                      .count();
+  result.goal_ticks = loop.ticks;
+  result.messages = sim.delivered_messages();
+  result.task_switches = sim.clock().switches();
+  result.state_age_p99_ms = loop.state_age_ms.percentile(0.99);
+  if (auto *faults = sim.faults()) {
+    result.faults = faults->stats();
+  }
+  result.digest = pose_digest(sim.relay().cubes());
+  return result;
+}
+
+} // namespace swarm::samples
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "toio/fault/fault_injector.hpp"
+#include "toio/planning/assignment.hpp"
+#include "toio/planning/choreography.hpp"
+#include "toio/planning/flock.hpp"
+#include "toio/planning/motion_planner.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace swarm::samples {
+
+enum class ShowPlanner {
+  Motion,
+  // Flock で「集まる → 左右に分かれる → 再び集まる」を 3 等分した時間で演じる。
+  Flock,
+  // プランナーを使わず、隊形 (同心円 → 格子 → 左右 2 つの塊) を
+  // formation_period ごとに切り替え、割り当てた目標点へ直接向かわせる。
+  Formation,
+  // choreography を ChoreographyPlayer で再生する (プランナーを使わない)。
+  Choreography,
+  // themes を BehaviorPlayer で theme_period ごとに theme_fade かけて
+  // 順に切り替える。
+  Themes,
+};
+
+// MotionPlanner (または Flock) + GoalController のショーを Simulation (仮想時間) で
+// 1 回走らせる設定。
+struct ShowConfig {
+  std::size_t cubes = 100;
+  std::chrono::milliseconds duration{600000};
+  std::chrono::milliseconds planner_interval{120};
+  std::chrono::milliseconds poll_interval{100};
+  // リレーの遅延ばらつきとプランナーの乱数に使う。
+  std::uint32_t seed = 1;
+  ShowPlanner mode = ShowPlanner::Motion;
+  toio::planning::MotionPlannerParameters planner;
+  toio::planning::FlockParameters flock;
+  // true ならマットの中央の高さを左右に往復する仮想の人を障害物として流す。
+  // プランナーには step の obstacles で、GoalController には ObstacleTracker
+  // で渡し、GoalOptions::avoidance を有効にする。
+  bool person = false;
+  double person_radius = 80.0;
+  double person_speed = 150.0;
+  // true ならマット中央の渦と左から右へ渡る風の 2 つの流れ場を焼き、
+  // flow_period ごとに flow_fade かけて切り替えながらプランナーに流す。
+  bool flow = false;
+  std::chrono::milliseconds flow_period{20000};
+  std::chrono::milliseconds flow_fade{5000};
+  // Formation の切り替え間隔。assignment が空なら i 番目の Cube を隊形の
+  // i 番目の点へ (添字順)、あれば TargetAssigner で移動距離の小さい組を選ぶ。
+  std::chrono::milliseconds formation_period{15000};
+  std::optional<toio::planning::AssignmentOptions> assignment =
+      toio::planning::AssignmentOptions{};
+  // 全 Cube が目標点からこの距離以内に入ったら隊形が揃ったとみなす。
+  double settle_distance = 15.0;
+  // Choreography で再生する振り付け。トラック i を i 番目の Cube が踊る。
+  std::shared_ptr<const toio::planning::Choreography> choreography;
+  // Themes で演じるテーマ名 (toio::planning::theme_names)。空なら全部。
+  std::vector<std::string> themes;
+  std::chrono::milliseconds theme_period{20000};
+  std::chrono::milliseconds theme_fade{4000};
+
+  // 評価指標の計測間隔 (仮想時間)。0 なら計測しない。
+  std::chrono::milliseconds sample_interval{20};
+  // Cube 中心間がこの距離 (マット座標) 未満になったら接触とみなす。
+  // 一辺 32mm ≒ 23.5。
+  double contact_distance = 24.0;
+  // 被覆率を数えるセルの一辺 (マット座標)。
+  double coverage_cell = 50.0;
+  // 指定するとクライアントとリレーの間に遅延・欠落・障害を入れる。
+  std::optional<toio::fault::FaultConfig> faults;
+};
+
+// シミュレータ上の実際の姿勢から計測した評価指標。
+struct ShowMetrics {
+  // 計測中の Cube 中心間距離の最小値。
+  double min_distance = 0.0;
+  // 接触 (contact_distance 未満) に入ったペアの回数。
+  std::uint64_t collisions = 0;
+  // 仮想の人 (person_radius + contact_distance / 2 の円) に Cube が入った回数。
+  std::uint64_t person_contacts = 0;
+  // 1 台でも通過したセルの割合 (0..1)。
+  double coverage = 0.0;
+  // 位置の 3 階差分から求めたジャークの RMS [マット座標/s^3]。
+  double jerk_rms = 0.0;
+  std::uint64_t samples = 0;
+  // Formation: 切り替えた回数、次の切り替えまでに揃った回数と、揃うまでの
+  // 平均時間 [s]、割り当てた移動距離の合計の平均と最大。
+  std::uint64_t formations = 0;
+  std::uint64_t settled = 0;
+  double settle_s = 0.0;
+  double assigned_distance = 0.0;
+  double assigned_max_distance = 0.0;
+  // Choreography: 再生開始後、planner_interval ごとに見た実際の位置と
+  // 表のいまのコマとの距離の平均。
+  double tracking_error = 0.0;
+  // Themes: テーマを切り替えた回数。
+  std::uint64_t theme_switches = 0;
+};
+
+struct ShowResult {
+  ShowMetrics metrics;
+  double simulated_s = 0.0;
+  double wall_s = 0.0;
+  // Themes では BehaviorPlayer の tick 数。
+  std::uint64_t planner_steps = 0;
+  // Themes: 予定より遅れた tick 数。
+  std::uint64_t late_ticks = 0;
+  std::uint64_t goal_ticks = 0;
+  std::uint64_t messages = 0;
+  std::uint64_t task_switches = 0;
+  std::uint64_t state_age_p99_ms = 0;
+  toio::fault::FaultStats faults;
+  // 全 Cube の最終姿勢の FNV-1a。同じ設定なら毎回一致する。
+  std::uint64_t digest = 0;
+};
+
+// 円周に並んだ Cube が 5 秒ごとに回りながら半径を変え、色を変える
+// 振り付け (config.duration の長さ、config.cubes 台)。
+toio::planning::Choreography make_demo_choreography(const ShowConfig &config);
+
+// 呼び出したスレッドで Simulation を作って最後まで走らせる。
+// 別スレッドから同時に呼んでよい (Simulation ごとに独立)。
+ShowResult run_headless_show(const ShowConfig &config);
+
+} // namespace swarm::samples
@@ -0,0 +1,203 @@
+#include "toio/api/behavior_player.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace toio::api {
+namespace {
+
+double to_seconds(std::chrono::milliseconds duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+BehaviorPlayer::BehaviorPlayer(FleetControl &control,
+                               planning::BehaviorRuntime behaviors,
+                               BehaviorOptions options,
+                               runtime::Runtime runtime)
+    : control_(control), behaviors_(std::move(behaviors)),
+      options_(std::move(options)), runtime_(std::move(runtime)) {
+  if (behaviors_.size() == 0) {
+    throw std::invalid_argument("BehaviorPlayer requires a behavior");
+  }
+  if (options_.tick.count() <= 0) {
+    throw std::invalid_argument("BehaviorPlayer tick must be positive");
+  }
+  current_ = behaviors_.current();
+}
+
+BehaviorPlayer::~BehaviorPlayer() {
+  try {
+    stop();
+  } catch (...) {
+  }
+}
+
+void BehaviorPlayer::start(std::vector<CubeHandle> cubes) {
+  stop();
+  cubes_ = std::move(cubes);
+  const auto count = cubes_.size();
+  behaviors_.reserve(count);
+  positions_.assign(count, middleware::Position{});
+  obstacles_.clear();
+  read_positions();
+
+  // いまの位置で止めておき、以後は update_goal で目標だけを動かす。
+  sent_goals_.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const planning::TargetPoint here{static_cast<double>(positions_[i].x),
+                                     static_cast<double>(positions_[i].y)};
+    const auto goal = goal_for(here);
+    control_.start_goal(cubes_[i], goal);
+    // 着いてもタスクを終わらせず、以後の update_goal を受けられるようにする。
+    control_.update_goal(cubes_[i], goal);
+    sent_goals_[i].x = goal.goal_x;
+    sent_goals_[i].y = goal.goal_y;
+  }
+  ticks_ = 0;
+  late_ticks_ = 0;
+  goals_sent_ = 0;
+  cancel_ = std::make_shared<std::atomic<bool>>(false);
+  running_ = true;
+  worker_ = runtime_.executor->spawn(
+      [this, cancel = cancel_]() { run(cancel); });
+}
+
+void BehaviorPlayer::stop() {
+  if (cancel_) {
+    cancel_->store(true);
+  }
+  if (worker_.valid()) {
+    runtime_.executor->wait(worker_);
+  }
+  running_ = false;
+  for (const auto &cube : cubes_) {
+    control_.stop_goal(cube);
+  }
+  cubes_.clear();
+}
+
+bool BehaviorPlayer::running() const {
+  return running_.load();
+}
+
+void BehaviorPlayer::switch_to(std::size_t index,
+                               std::optional<std::chrono::milliseconds> fade) {
+  if (index >= behaviors_.size()) {
+    throw std::out_of_range("BehaviorPlayer has no behavior " +
+                            std::to_string(index));
+  }
+  std::lock_guard<std::mutex> lock(switch_mutex_);
+  pending_switch_ = SwitchRequest{index, to_seconds(fade.value_or(options_.fade))};
+}
+
+void BehaviorPlayer::switch_to(std::string_view name,
+                               std::optional<std::chrono::milliseconds> fade) {
+  // 名前は start 後に変わらないので、タスクと並んで引いてよい。
+  switch_to(behaviors_.find(name), fade);
+}
+
+std::size_t BehaviorPlayer::current() const {
+  return current_.load();
+}
+
+std::uint64_t BehaviorPlayer::ticks() const {
+  return ticks_.load();
+}
+
+std::uint64_t BehaviorPlayer::late_ticks() const {
+  return late_ticks_.load();
+}
+
+std::uint64_t BehaviorPlayer::goals_sent() const {
+  return goals_sent_.load();
+}
+
+void BehaviorPlayer::run(std::shared_ptr<std::atomic<bool>> cancel) {
+  auto next = runtime_.clock->now() + options_.tick;
+  try {
+    while (!cancel->load()) {
+      runtime_.clock->sleep_until(next);
+      if (cancel->load()) {
+        break;
+      }
+      const auto now = runtime_.clock->now();
+      tick();
+      if (now - next >= options_.tick) {
+        ++late_ticks_;
+      }
+      ++ticks_;
+      // 遅れた分の tick は飛ばす。dt は固定なので Behavior の出力は
+      // 呼ばれた回数だけで決まる。
+      next += options_.tick;
+      while (next <= now) {
+        next += options_.tick;
+      }
+    }
+  } catch (...) {
+    // FleetControl が止まったときなど。タスクを終える。
+  }
+  running_ = false;
+}
+
+void BehaviorPlayer::tick() {
+  {
+    std::lock_guard<std::mutex> lock(switch_mutex_);
+    if (pending_switch_) {
+      behaviors_.switch_to(pending_switch_->index, pending_switch_->fade);
+      pending_switch_.reset();
+    }
+  }
+  read_positions();
+  if (options_.obstacles) {
+    options_.obstacles->snapshot(obstacles_);
+  }
+  const auto &targets =
+      behaviors_.step(positions_, to_seconds(options_.tick), obstacles_);
+  current_ = behaviors_.current();
+  for (std::size_t i = 0; i < cubes_.size(); ++i) {
+    const auto goal = goal_for(targets[i]);
+    if (goal.goal_x != sent_goals_[i].x || goal.goal_y != sent_goals_[i].y) {
+      control_.update_goal(cubes_[i], goal);
+      sent_goals_[i].x = goal.goal_x;
+      sent_goals_[i].y = goal.goal_y;
+      ++goals_sent_;
+    }
+  }
+}
+
+void BehaviorPlayer::read_positions() {
+  const auto snapshots = control_.snapshot();
+  for (std::size_t i = 0; i < cubes_.size(); ++i) {
+    const auto &cube = cubes_[i];
+    auto matches = [&cube](const middleware::CubeSnapshot &snapshot) {
+      return snapshot.state.cube_id == cube.cube_id &&
+             snapshot.state.server_id == cube.server_id;
+    };
+    // snapshot はたいてい cubes と同じ順なので、まず同じ添字を見る。
+    const middleware::CubeSnapshot *found =
+        i < snapshots.size() && matches(snapshots[i]) ? &snapshots[i] : nullptr;
+    for (std::size_t j = 0; !found && j < snapshots.size(); ++j) {
+      if (matches(snapshots[j])) {
+        found = &snapshots[j];
+      }
+    }
+    // 位置が読めない Cube は前の位置のまま。
+    if (found && found->state.position) {
+      positions_[i] = *found->state.position;
+    }
+  }
+}
+
+control::GoalOptions
+BehaviorPlayer::goal_for(const planning::TargetPoint &target) const {
+  auto goal = options_.goal;
+  goal.goal_x = static_cast<int>(std::lround(target.x));
+  goal.goal_y = static_cast<int>(std::lround(target.y));
+  return goal;
+}
+
+} // namespace toio::api
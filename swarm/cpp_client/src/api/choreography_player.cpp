@@ -0,0 +1,253 @@
+#include "toio/api/choreography_player.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace toio::api {
+namespace {
+
+int to_degrees(double angle) {
+  const auto degrees = static_cast<int>(std::lround(angle)) % 360;
+  return degrees < 0 ? degrees + 360 : degrees;
+}
+
+transport::MoveTarget to_target(double x, double y, double angle) {
+  transport::MoveTarget target;
+  target.x = static_cast<int>(std::lround(x));
+  target.y = static_cast<int>(std::lround(y));
+  target.angle = to_degrees(angle);
+  return target;
+}
+
+bool same_point(const transport::MoveTarget &a, const transport::MoveTarget &b) {
+  return a.x == b.x && a.y == b.y;
+}
+
+bool same_color(const middleware::LedColor &a, const middleware::LedColor &b) {
+  return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+} // namespace
+
+ChoreographyPlayer::ChoreographyPlayer(FleetControl &control,
+                                       const planning::Choreography &choreography,
+                                       ChoreographyOptions options,
+                                       runtime::Runtime runtime)
+    : control_(control), options_(std::move(options)),
+      runtime_(std::move(runtime)), table_(choreography.compile()) {
+  if (options_.tick.count() <= 0) {
+    throw std::invalid_argument("ChoreographyPlayer tick must be positive");
+  }
+  track_cubes_.reserve(choreography.tracks().size());
+  keyframes_.reserve(choreography.tracks().size());
+  for (const auto &track : choreography.tracks()) {
+    track_cubes_.push_back(track.cube);
+    auto &points = keyframes_.emplace_back();
+    for (const auto &key : track.keyframes) {
+      const auto point = to_target(key.x, key.y, key.angle);
+      if (points.empty() || !same_point(points.back(), point)) {
+        points.push_back(point);
+      } else {
+        points.back().angle = point.angle;
+      }
+    }
+  }
+}
+
+ChoreographyPlayer::~ChoreographyPlayer() {
+  try {
+    stop();
+  } catch (...) {
+  }
+}
+
+void ChoreographyPlayer::start(std::vector<CubeHandle> cubes) {
+  stop();
+  const auto tracks = table_.tracks();
+  if (cubes.empty()) {
+    cubes.reserve(tracks);
+    for (std::size_t i = 0; i < tracks; ++i) {
+      if (track_cubes_[i].empty()) {
+        throw std::invalid_argument("ChoreographyPlayer track " +
+                                    std::to_string(i) +
+                                    " has no cube; pass cubes to start");
+      }
+      cubes.push_back(control_.resolve_cube(track_cubes_[i]));
+    }
+  }
+  if (cubes.size() < tracks) {
+    throw std::invalid_argument(
+        "ChoreographyPlayer needs " + std::to_string(tracks) +
+        " cube(s), got " + std::to_string(cubes.size()));
+  }
+  cubes.resize(tracks);
+  cubes_ = std::move(cubes);
+
+  // 最初のコマへ向かわせておき、lead 後に全員そろって動き出す。
+  sent_goals_.resize(tracks);
+  sent_leds_.resize(tracks);
+  for (std::size_t i = 0; i < tracks; ++i) {
+    const auto &pose = table_.pose(0, i);
+    const auto goal = goal_for(pose);
+    control_.start_goal(cubes_[i], goal);
+    // 着いてもタスクを終わらせず、以後の update_goal を受けられるようにする。
+    control_.update_goal(cubes_[i], goal);
+    sent_goals_[i] = to_target(pose.x, pose.y, pose.angle);
+    sent_leds_[i] = pose.led;
+    if (options_.leds) {
+      control_.set_led(cubes_[i], pose.led, false);
+    }
+  }
+  start_time_ = runtime_.clock->now() + options_.lead;
+  frame_ = 0;
+  ticks_ = 0;
+  late_ticks_ = 0;
+  cancel_ = std::make_shared<std::atomic<bool>>(false);
+  running_ = true;
+  worker_ = runtime_.executor->spawn(
+      [this, cancel = cancel_]() { run(cancel); });
+}
+
+void ChoreographyPlayer::stop() {
+  if (cancel_) {
+    cancel_->store(true);
+  }
+  if (worker_.valid()) {
+    runtime_.executor->wait(worker_);
+  }
+  running_ = false;
+  for (const auto &cube : cubes_) {
+    control_.stop_goal(cube);
+  }
+  cubes_.clear();
+}
+
+bool ChoreographyPlayer::running() const {
+  return running_.load();
+}
+
+const planning::ChoreographyTable &ChoreographyPlayer::table() const {
+  return table_;
+}
+
+runtime::Clock::time_point ChoreographyPlayer::start_time() const {
+  return start_time_;
+}
+
+std::size_t ChoreographyPlayer::frame() const {
+  return frame_.load();
+}
+
+std::uint64_t ChoreographyPlayer::ticks() const {
+  return ticks_.load();
+}
+
+std::uint64_t ChoreographyPlayer::late_ticks() const {
+  return late_ticks_.load();
+}
+
+void ChoreographyPlayer::wait() {
+  if (worker_.valid()) {
+    runtime_.executor->wait(worker_);
+  }
+}
+
+void ChoreographyPlayer::run(std::shared_ptr<std::atomic<bool>> cancel) {
+  const bool trajectory = options_.mode == ChoreographyMode::Trajectory;
+  // 最後のコマも 1 コマ分の長さを持たせて繰り返す。
+  const double period = table_.duration() + 1.0 / table_.frame_rate();
+  auto next = start_time_;
+  bool first = true;
+  // loop で何周目か。Trajectory は周が変わるたびに送り直す。
+  std::uint64_t pass = 0;
+  try {
+    while (!cancel->load()) {
+      runtime_.clock->sleep_until(next);
+      if (cancel->load()) {
+        break;
+      }
+      const auto now = runtime_.clock->now();
+      double t = std::chrono::duration<double>(now - start_time_).count();
+      std::uint64_t current_pass = 0;
+      if (options_.loop) {
+        current_pass = static_cast<std::uint64_t>(std::max(0.0, t) / period);
+        t = std::fmod(t, period);
+      }
+      const auto frame = table_.frame_at(t);
+      if (trajectory && (first || current_pass != pass)) {
+        send_trajectories(!first);
+        pass = current_pass;
+      }
+      send_frame(frame, !trajectory);
+      if (now - next >= options_.tick) {
+        ++late_ticks_;
+      }
+      frame_ = frame;
+      ++ticks_;
+      first = false;
+      if (!options_.loop && frame + 1 >= table_.frames()) {
+        break;
+      }
+      // 遅れた分の tick は飛ばす。コマは時刻から引くのでずれない。
+      next += options_.tick;
+      while (next <= now) {
+        next += options_.tick;
+      }
+    }
+  } catch (...) {
+    // FleetControl が止まったときなど。再生を終える。
+  }
+  running_ = false;
+}
+
+void ChoreographyPlayer::send_frame(std::size_t frame, bool goals) {
+  const auto *poses = table_.frame(frame);
+  for (std::size_t i = 0; i < cubes_.size(); ++i) {
+    const auto &pose = poses[i];
+    if (goals) {
+      const auto target = to_target(pose.x, pose.y, pose.angle);
+      if (!same_point(target, sent_goals_[i])) {
+        control_.update_goal(cubes_[i], goal_for(pose));
+        sent_goals_[i] = target;
+      }
+    }
+    if (options_.leds && !same_color(pose.led, sent_leds_[i])) {
+      control_.set_led(cubes_[i], pose.led, false);
+      sent_leds_[i] = pose.led;
+    }
+  }
+}
+
+void ChoreographyPlayer::send_trajectories(bool restart) {
+  for (std::size_t i = 0; i < cubes_.size(); ++i) {
+    const auto &points = keyframes_[i];
+    if (points.size() < 2) {
+      continue;
+    }
+    // 最初の周の先頭は lead のあいだに向かった位置。2 周目からは最後の点に
+    // いるので、先頭と違えば先頭へも戻る。
+    auto begin = points.begin() + 1;
+    if (restart && !same_point(points.front(), points.back())) {
+      begin = points.begin();
+    }
+    // 前の周の軌道が残っていれば start_trajectory が打ち切る。
+    control_.send_trajectory(
+        cubes_[i], std::vector<transport::MoveTarget>(begin, points.end()),
+        options_.trajectory);
+  }
+}
+
+control::GoalOptions
+ChoreographyPlayer::goal_for(const planning::ChoreographyPose &pose) const {
+  auto goal = options_.goal;
+  goal.goal_x = static_cast<int>(std::lround(pose.x));
+  goal.goal_y = static_cast<int>(std::lround(pose.y));
+  goal.goal_angle = to_degrees(pose.angle);
+  return goal;
+}
+
+} // namespace toio::api
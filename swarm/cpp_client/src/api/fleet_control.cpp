@@ -29,8 +29,10 @@ std::string read_string_field(const nlohmann::json &obj, const char *key) {
 
 } // namespace
 
-FleetControl::FleetControl(std::vector<middleware::ServerConfig> configs)
-    : manager_(),
+FleetControl::FleetControl(std::vector<middleware::ServerConfig> configs,
+                           runtime::Runtime runtime,
+                           middleware::ConnectionFactory connect)
+    : manager_(std::move(runtime), std::move(connect)),
       goal_controller_(manager_) {
   manager_.apply_config(std::move(configs));
   manager_.set_message_callback(
@@ -84,6 +86,11 @@ void FleetControl::set_goal_logger(control::GoalController::Logger logger) {
   goal_controller_.set_logger(std::move(logger));
 }
 
+void FleetControl::set_obstacles(
+    std::shared_ptr<const control::ObstacleTracker> obstacles) {
+  goal_controller_.set_obstacles(std::move(obstacles));
+}
+
 std::vector<CubeHandle> FleetControl::cubes() const {
   std::vector<CubeHandle> result;
   result.reserve(cube_index_.size());
@@ -97,6 +104,11 @@ std::vector<middleware::CubeSnapshot> FleetControl::snapshot() const {
   return manager_.snapshot();
 }
 
+std::unordered_map<std::string, middleware::RateLimitStats>
+FleetControl::rate_limit_stats() const {
+  return manager_.rate_limit_stats();
+}
+
 CubeHandle FleetControl::resolve_cube(const std::string &cube_id) const {
   auto it = cube_index_.find(cube_id);
   if (it == cube_index_.end()) {
@@ -220,6 +232,55 @@ bool FleetControl::move(const CubeHandle &handle,
                        require_result);
 }
 
+bool FleetControl::move_for(const std::string &cube_id,
+                            int left_speed,
+                            int right_speed,
+                            std::chrono::milliseconds duration,
+                            std::optional<bool> require_result) {
+  return move_for(resolve_cube(cube_id),
+                  left_speed,
+                  right_speed,
+                  duration,
+                  require_result);
+}
+
+bool FleetControl::move_for(const CubeHandle &handle,
+                            int left_speed,
+                            int right_speed,
+                            std::chrono::milliseconds duration,
+                            std::optional<bool> require_result) {
+  ensure_started();
+  return manager_.move_for(handle.server_id,
+                           handle.cube_id,
+                           left_speed,
+                           right_speed,
+                           duration,
+                           require_result);
+}
+
+std::optional<int> FleetControl::move_to(const std::string &cube_id,
+                                         const transport::MoveTarget &goal,
+                                         int max_speed,
+                                         transport::MoveType move_type,
+                                         std::optional<bool> require_result) {
+  return move_to(
+      resolve_cube(cube_id), goal, max_speed, move_type, require_result);
+}
+
+std::optional<int> FleetControl::move_to(const CubeHandle &handle,
+                                         const transport::MoveTarget &goal,
+                                         int max_speed,
+                                         transport::MoveType move_type,
+                                         std::optional<bool> require_result) {
+  ensure_started();
+  return manager_.move_to(handle.server_id,
+                          handle.cube_id,
+                          goal,
+                          max_speed,
+                          move_type,
+                          require_result);
+}
+
 bool FleetControl::start_goal(const std::string &cube_id,
                               control::GoalOptions options) {
   return start_goal(resolve_cube(cube_id), std::move(options));
@@ -246,6 +307,60 @@ bool FleetControl::update_goal(const CubeHandle &handle,
                                       std::move(options));
 }
 
+control::PathHandle
+FleetControl::start_path(const std::string &cube_id,
+                         std::vector<control::Waypoint> waypoints,
+                         control::GoalOptions options) {
+  return start_path(resolve_cube(cube_id),
+                    std::move(waypoints),
+                    std::move(options));
+}
+
+control::PathHandle
+FleetControl::start_path(const CubeHandle &handle,
+                         std::vector<control::Waypoint> waypoints,
+                         control::GoalOptions options) {
+  ensure_started();
+  return goal_controller_.start_path(handle.server_id,
+                                     handle.cube_id,
+                                     std::move(waypoints),
+                                     std::move(options));
+}
+
+std::optional<control::PathHandle>
+FleetControl::append_waypoints(const std::string &cube_id,
+                               std::vector<control::Waypoint> waypoints) {
+  return append_waypoints(resolve_cube(cube_id), std::move(waypoints));
+}
+
+std::optional<control::PathHandle>
+FleetControl::append_waypoints(const CubeHandle &handle,
+                               std::vector<control::Waypoint> waypoints) {
+  return goal_controller_.append_waypoints(handle.server_id,
+                                           handle.cube_id,
+                                           std::move(waypoints));
+}
+
+control::TrajectoryHandle
+FleetControl::send_trajectory(const std::string &cube_id,
+                              std::vector<transport::MoveTarget> points,
+                              control::TrajectoryOptions options) {
+  return send_trajectory(resolve_cube(cube_id),
+                         std::move(points),
+                         std::move(options));
+}
+
+control::TrajectoryHandle
+FleetControl::send_trajectory(const CubeHandle &handle,
+                              std::vector<transport::MoveTarget> points,
+                              control::TrajectoryOptions options) {
+  ensure_started();
+  return goal_controller_.start_trajectory(handle.server_id,
+                                           handle.cube_id,
+                                           std::move(points),
+                                           std::move(options));
+}
+
 bool FleetControl::stop_goal(const std::string &cube_id) {
   return stop_goal(resolve_cube(cube_id));
 }
@@ -258,6 +373,26 @@ std::size_t FleetControl::stop_all_goals() {
   return goal_controller_.stop_all();
 }
 
+control::LoopMetricsSnapshot FleetControl::loop_metrics() const {
+  return goal_controller_.loop_metrics();
+}
+
+void FleetControl::reset_loop_metrics() {
+  goal_controller_.reset_loop_metrics();
+}
+
+void FleetControl::set_loop_metrics_dump(const std::string &path) {
+  goal_controller_.set_loop_metrics_dump(path);
+}
+
+middleware::EmergencyStopReport FleetControl::emergency_stop() {
+  ensure_started();
+  goal_controller_.cancel_all();
+  auto report = manager_.emergency_stop();
+  goal_controller_.stop_all();
+  return report;
+}
+
 void FleetControl::handle_message(const std::string &server_id,
                                   const nlohmann::json &json) {
   bool handled = false;
@@ -319,6 +454,7 @@ FleetControl::register_pending_command(const std::string &key) {
     }
     pending_commands_[key] = promise;
   }
+  pending_cv_.notify_all();
   return future;
 }
 
@@ -339,6 +475,10 @@ bool FleetControl::complete_pending_command(
     promise->set_value(result);
   } catch (...) {
   }
+  {
+    std::lock_guard lock(pending_mutex_);
+  }
+  pending_cv_.notify_all();
   return true;
 }
 
@@ -347,7 +487,15 @@ FleetControl::wait_for_command_result(const std::string &key,
                                       std::future<CommandResult> &future,
                                       std::chrono::milliseconds timeout) {
   if (future.valid()) {
-    if (future.wait_for(timeout) == std::future_status::ready) {
+    auto &clock = *manager_.runtime().clock;
+    std::unique_lock lock(pending_mutex_);
+    const bool ready = clock.wait_until(
+        lock, pending_cv_, clock.now() + timeout, [&future]() {
+          return future.wait_for(std::chrono::seconds(0)) ==
+                 std::future_status::ready;
+        });
+    lock.unlock();
+    if (ready) {
       return future.get();
     }
     // Timed out, caller will decide whether to synthesize a failure.
@@ -370,6 +518,10 @@ void FleetControl::cancel_all_pending(const std::string &reason) {
     } catch (...) {
     }
   }
+  {
+    std::lock_guard lock(pending_mutex_);
+  }
+  pending_cv_.notify_all();
 }
 
 void FleetControl::ensure_started() {
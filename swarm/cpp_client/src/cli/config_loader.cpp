@@ -1,5 +1,6 @@
 #include "toio/cli/config_loader.hpp"
 
+#include <chrono>
 #include <cstdlib>
 #include <iostream>
 #include <random>
@@ -55,6 +56,21 @@ std::vector<ServerConfig> load_fleet_config(const std::string &path) {
       config.default_require_result =
           server_node["default_require_result"].as<bool>();
     }
+    if (auto limit_node = server_node["rate_limit"]; limit_node) {
+      if (!limit_node.IsMap()) {
+        throw std::runtime_error("servers[].rate_limit must be a map");
+      }
+      auto &limit = config.rate_limit;
+      limit.enabled = limit_node["enabled"].as<bool>(true);
+      limit.interval = std::chrono::milliseconds(
+          limit_node["interval_ms"].as<int>(
+              static_cast<int>(limit.interval.count())));
+      limit.burst = limit_node["burst"].as<int>(limit.burst);
+      if (limit.interval.count() <= 0 || limit.burst <= 0) {
+        throw std::runtime_error(
+            "rate_limit.interval_ms and rate_limit.burst must be positive");
+      }
+    }
     if (auto cubes_node = server_node["cubes"]; cubes_node && cubes_node.IsSequence()) {
       for (const auto &cube_node : cubes_node) {
         CubeConfig cube;
@@ -84,7 +100,8 @@ std::vector<ServerConfig> load_fleet_config(const std::string &path) {
 } // namespace
 
 void print_usage(const char *argv0) {
-  std::cout << "Usage: " << argv0 << " --fleet-config <fleet.yaml>\n";
+  std::cout << "Usage: " << argv0
+            << " --fleet-config <fleet.yaml> [--record <session.toiolog>]\n";
 }
 
 Options parse_options(int argc, char **argv) {
@@ -95,6 +112,8 @@ Options parse_options(int argc, char **argv) {
     if (arg == "--fleet-config" && i + 1 < argc) {
       opt.fleet_config_path = argv[++i];
       has_config = true;
+    } else if (arg == "--record" && i + 1 < argc) {
+      opt.record_path = argv[++i];
     } else if (arg == "--help" || arg == "-h") {
       print_usage(argv[0]);
       std::exit(0);
@@ -1,9 +1,11 @@
 #include "toio/control/goal_controller.hpp"
 
+#include "toio/transport/toio_client.hpp"
+
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <thread>
+#include <iterator>
 #include <vector>
 
 namespace toio::control {
@@ -14,6 +16,28 @@ using toio::middleware::CubeState;
 using toio::middleware::FleetManager;
 using toio::middleware::Position;
 
+
+template <typename Duration>
+std::chrono::microseconds to_us(Duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+
+// 判断に使う位置の古さ。リレーの timestamp_ms (epoch ms) があればそれを、
+// なければ ServerSession が状態を更新した時刻を基準にする。
+std::chrono::milliseconds state_age(const CubeState &state,
+                                    const runtime::Clock &clock) {
+  if (state.position && state.position->timestamp_ms > 0) {
+    const auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            clock.wall_now().time_since_epoch())
+                            .count();
+    return std::chrono::milliseconds(
+        std::max<std::int64_t>(0, now_ms - static_cast<std::int64_t>(
+                                               state.position->timestamp_ms)));
+  }
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      clock.now() - state.last_update);
+}
+
 double wrap_deg180(double angle) {
   double wrapped = std::fmod(angle + 180.0, 360.0);
   if (wrapped < 0) {
@@ -22,6 +46,65 @@ double wrap_deg180(double angle) {
   return wrapped - 180.0;
 }
 
+// 近くの Cube や障害物に応じて (left, right) を減速・偏向する。
+// for_each_neighbor は (x, y, 半径) を渡し、距離は半径を引いた縁から測る。
+// compute_goal_move と同じく left = v - w/2, right = v + w/2。
+template <typename ForEachNeighbor>
+std::pair<int, int> apply_avoidance(const Position &current,
+                                    std::pair<int, int> speeds,
+                                    const GoalOptions &params,
+                                    ForEachNeighbor &&for_each_neighbor) {
+  const auto &avoid = params.avoidance;
+  double v = 0.5 * (speeds.first + speeds.second);
+  double w = static_cast<double>(speeds.second - speeds.first);
+  if (std::abs(v) < 1e-6) {
+    return speeds;
+  }
+
+  constexpr double deg_to_rad = 3.14159265358979323846 / 180.0;
+  const double heading = current.angle * deg_to_rad;
+  // 後退中は進行方向が機体の向きの逆になる。
+  const double sign = v >= 0.0 ? 1.0 : -1.0;
+  const double dir_x = sign * std::cos(heading);
+  const double dir_y = sign * std::sin(heading);
+
+  const double span =
+      std::max(1e-6, avoid.influence_radius - avoid.stop_distance);
+  double scale = 1.0;
+  double deflect = 0.0;
+  for_each_neighbor([&](double nx, double ny, double clearance) {
+    const double dx = nx - current.x;
+    const double dy = ny - current.y;
+    const double center = std::hypot(dx, dy);
+    const double dist = center - clearance;
+    if (center < 1e-6 || dist > avoid.influence_radius) {
+      return;
+    }
+    const double ahead = (dir_x * dx + dir_y * dy) / center;
+    if (ahead <= avoid.min_ahead_cos) {
+      return;
+    }
+    const double closeness =
+        std::clamp(1.0 - (dist - avoid.stop_distance) / span, 0.0, 1.0);
+    scale = std::min(scale, 1.0 - ahead * closeness);
+    // 進行方向の左右どちら側にいるか (y 下向きの座標系で cross > 0 は
+    // 角度が増える側)。角度を減らす旋回は w > 0。真正面は全台が同じ向きに
+    // 避けるよう cross >= 0 側に寄せる。
+    const double cross = dir_x * dy - dir_y * dx;
+    deflect += (cross >= 0.0 ? 1.0 : -1.0) * ahead * closeness;
+  });
+
+  v *= std::clamp(scale, std::clamp(avoid.min_scale, 0.0, 1.0), 1.0);
+  w += std::clamp(deflect, -1.0, 1.0) * avoid.deflect_gain * params.wmax;
+  w = std::clamp(w, -params.wmax, params.wmax);
+
+  const double left = std::clamp(v - 0.5 * w, -100.0, 100.0);
+  const double right = std::clamp(v + 0.5 * w, -100.0, 100.0);
+  return {static_cast<int>(left), static_cast<int>(right)};
+}
+
+} // namespace
+
 std::optional<std::pair<int, int>>
 compute_goal_move(const Position &current,
                   const GoalOptions &params,
@@ -75,10 +158,22 @@ compute_goal_move(const Position &current,
   return std::pair<int, int>{static_cast<int>(left), static_cast<int>(right)};
 }
 
-} // namespace
+// どの経路でタスクを抜けても未完了の waypoint / path の future を解決する。
+struct GoalController::SettleGuard {
+  SharedGoal &goal;
+  const std::atomic<bool> &cancel;
+  bool reached = false;
+  ~SettleGuard() {
+    settle_path(goal,
+                reached ? GoalStatus::Reached
+                        : (cancel.load() ? GoalStatus::Cancelled
+                                         : GoalStatus::Failed));
+  }
+};
 
 GoalController::GoalController(FleetManager &manager)
     : manager_(manager),
+      runtime_(manager.runtime()),
       logger_([](const std::string &key, const std::string &message) {
         std::cout << "[goal " << key << "] " << message << std::endl;
       }) {}
@@ -87,11 +182,31 @@ GoalController::~GoalController() {
   stop_all();
 }
 
+LoopMetricsSnapshot GoalController::loop_metrics() const {
+  return metrics_.snapshot();
+}
+
+void GoalController::reset_loop_metrics() {
+  metrics_.reset();
+}
+
+void GoalController::set_loop_metrics_dump(const std::string &path) {
+  metrics_.set_dump_path(path);
+}
+
 void GoalController::set_logger(Logger logger) {
   std::lock_guard<std::mutex> lock(log_mutex_);
   logger_ = std::move(logger);
 }
 
+void GoalController::set_obstacles(
+    std::shared_ptr<const ObstacleTracker> obstacles) {
+  std::lock_guard<std::mutex> lock(neighbor_mutex_);
+  obstacles_ = std::move(obstacles);
+  // 次の周期で作り直させる。
+  neighbor_index_.reset();
+}
+
 std::string GoalController::make_key(const std::string &server_id,
                                      const std::string &cube_id) {
   return server_id + ":" + cube_id;
@@ -109,17 +224,78 @@ void GoalController::log(const std::string &key,
   }
 }
 
+std::shared_ptr<const GoalController::NeighborIndex>
+GoalController::neighbor_index(std::chrono::milliseconds refresh_interval,
+                               double radius) {
+  const auto now = runtime_.clock->now();
+  std::lock_guard<std::mutex> lock(neighbor_mutex_);
+  const auto obstacle_version = obstacles_ ? obstacles_->version() : 0;
+  if (neighbor_index_ && now - neighbor_index_->built_at < refresh_interval &&
+      neighbor_index_->grid.cell_size() == std::max(radius, 1.0) &&
+      neighbor_index_->obstacle_version == obstacle_version) {
+    return neighbor_index_;
+  }
+  auto index = std::make_shared<NeighborIndex>(
+      NeighborIndex{now, {}, SpatialGrid(radius), {}, obstacle_version, 0.0});
+  for (const auto &snapshot : manager_.snapshot()) {
+    const auto &state = snapshot.state;
+    if (!state.connected || !state.position || !state.position->on_mat) {
+      continue;
+    }
+    index->grid.update(index->keys.size(), state.position->x,
+                       state.position->y);
+    index->keys.push_back(make_key(state.server_id, state.cube_id));
+  }
+  if (obstacles_) {
+    obstacles_->snapshot(index->obstacles);
+    for (std::size_t k = 0; k < index->obstacles.size(); ++k) {
+      const auto &obstacle = index->obstacles[k];
+      index->grid.update(index->keys.size() + k, obstacle.x, obstacle.y);
+      index->obstacle_reach = std::max(index->obstacle_reach, obstacle.radius);
+    }
+  }
+  index->grid.rebuild();
+  neighbor_index_ = std::move(index);
+  return neighbor_index_;
+}
+
 std::optional<CubeState>
 GoalController::find_cube_state(const std::string &server_id,
                                 const std::string &cube_id) const {
-  auto snapshots = manager_.snapshot();
-  for (const auto &snapshot : snapshots) {
-    if (snapshot.state.server_id == server_id &&
-        snapshot.state.cube_id == cube_id) {
-      return snapshot.state;
+  return manager_.cube_state(server_id, cube_id);
+}
+
+bool GoalController::ensure_connected(const std::string &server_id,
+                                      const std::string &cube_id,
+                                      const std::atomic<bool> &cancel_flag) {
+  const std::string key = make_key(server_id, cube_id);
+  auto initial_state = find_cube_state(server_id, cube_id);
+  if (!initial_state) {
+    log(key, "cube state not found, aborting");
+    return false;
+  }
+  if (initial_state->connected) {
+    return true;
+  }
+  if (!manager_.connect(server_id, cube_id, true)) {
+    log(key, "failed to send connect command");
+    return false;
+  }
+  auto &clock = *runtime_.clock;
+  const auto deadline = clock.now() + std::chrono::seconds(5);
+  while (!cancel_flag.load() && clock.now() < deadline) {
+    auto state = find_cube_state(server_id, cube_id);
+    if (state && state->connected) {
+      return true;
     }
+    clock.sleep_for(std::chrono::milliseconds(100));
+  }
+  auto state = find_cube_state(server_id, cube_id);
+  if (state && state->connected) {
+    return true;
   }
-  return std::nullopt;
+  log(key, "failed to confirm connection");
+  return false;
 }
 
 void GoalController::run_goal_task(
@@ -129,85 +305,255 @@ void GoalController::run_goal_task(
     std::shared_ptr<std::atomic<bool>> cancel_flag) {
   const std::string key = make_key(server_id, cube_id);
 
+  SettleGuard settle_guard{*shared_goal, *cancel_flag};
+
   auto copy_goal = [&shared_goal]() {
     std::lock_guard<std::mutex> lock(shared_goal->mutex);
     return shared_goal->options;
   };
 
+  // path モードでは先頭 waypoint を目標に差し替える。キューが空なら
+  // finished を立てて以降の append を拒否する。
+  auto apply_waypoint = [&shared_goal](GoalOptions &options,
+                                       std::chrono::milliseconds &dwell) {
+    std::lock_guard<std::mutex> lock(shared_goal->mutex);
+    if (shared_goal->waypoints.empty()) {
+      shared_goal->finished = true;
+      return false;
+    }
+    const auto &waypoint = shared_goal->waypoints.front().waypoint;
+    options.goal_x = waypoint.x;
+    options.goal_y = waypoint.y;
+    options.stop_dist = waypoint.stop_dist;
+    dwell = waypoint.dwell;
+    return true;
+  };
+
+  auto complete_waypoint = [&shared_goal]() {
+    std::lock_guard<std::mutex> lock(shared_goal->mutex);
+    if (shared_goal->waypoints.empty()) {
+      return;
+    }
+    shared_goal->waypoints.front().done.set_value(GoalStatus::Reached);
+    shared_goal->waypoints.pop_front();
+  };
+
   auto options = copy_goal();
+  const bool path_mode = shared_goal->path_mode;
+  auto &clock = *runtime_.clock;
 
-  auto wait_for_connection = [&]() {
-    const auto deadline =
-        std::chrono::steady_clock::now() + std::chrono::seconds(5);
-    while (!cancel_flag->load() &&
-           std::chrono::steady_clock::now() < deadline) {
-      auto state = find_cube_state(server_id, cube_id);
-      if (state && state->connected) {
-        return true;
+  auto sleep_cancellable = [&](std::chrono::milliseconds duration) {
+    const auto deadline = clock.now() + duration;
+    while (!cancel_flag->load()) {
+      const auto now = clock.now();
+      if (now >= deadline) {
+        break;
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      clock.sleep_for(std::min<runtime::Clock::duration>(options.poll_interval,
+                                                         deadline - now));
     }
-    auto state = find_cube_state(server_id, cube_id);
-    return state && state->connected;
   };
 
   try {
-    log(key,
-        "started toward (" + std::to_string(options.goal_x) + ", " +
-            std::to_string(options.goal_y) + ")");
+    if (path_mode) {
+      log(key, "started path");
+    } else {
+      log(key,
+          "started toward (" + std::to_string(options.goal_x) + ", " +
+              std::to_string(options.goal_y) + ")");
+    }
 
-    auto initial_state = find_cube_state(server_id, cube_id);
-    if (!initial_state) {
-      log(key, "cube state not found, aborting");
+    if (!ensure_connected(server_id, cube_id, *cancel_flag)) {
       return;
     }
-    if (!initial_state->connected) {
-      if (!manager_.connect(server_id, cube_id, true)) {
-        log(key, "failed to send connect command");
+
+    // 計測用: 周期の開始時刻・開始予定時刻と、この周期で送ったコマンド数。
+    TickSample tick;
+    runtime::Clock::time_point tick_start{};
+    std::optional<runtime::Clock::time_point> expected_start;
+    auto query_position = [&]() {
+      manager_.query_position(server_id, cube_id, false);
+      ++tick.commands;
+    };
+    // 周期の終わり: 計測値を記録してから poll_interval 待つ。
+    auto sleep_tick = [&](std::chrono::milliseconds duration) {
+      const auto now = clock.now();
+      tick.compute = to_us(now - tick_start);
+      metrics_.record(key, tick);
+      expected_start = now + duration;
+      clock.sleep_until(now + duration);
+    };
+
+    if (!options.firmware_target) {
+      manager_.query_position(server_id, cube_id, false);
+    }
+    bool reached_goal = false;
+    double direction_state = 1.0;
+
+    // command_lease 用: 最後に送った速度とリースの期限。
+    std::optional<std::pair<int, int>> last_speeds;
+    runtime::Clock::time_point lease_expiry{};
+    auto send_speeds = [&](int left, int right) {
+      if (options.command_lease.count() <= 0) {
+        manager_.move(server_id, cube_id, left, right, false);
+        ++tick.commands;
         return;
       }
-      if (!wait_for_connection()) {
-        log(key, "failed to confirm connection");
+      const auto lease =
+          std::clamp(options.command_lease, transport::kMinMoveDuration,
+                     transport::kMaxMoveDuration);
+      const auto now = clock.now();
+      const std::pair<int, int> speeds{left, right};
+      const bool changed = !last_speeds || *last_speeds != speeds;
+      const bool stopped = left == 0 && right == 0;
+      const bool expiring =
+          now + options.poll_interval + options.lease_margin >= lease_expiry;
+      if (!changed && (stopped || !expiring)) {
         return;
       }
-    }
-
-    manager_.query_position(server_id, cube_id, false);
-    bool reached_goal = false;
-    double direction_state = 1.0;
+      manager_.move_for(server_id, cube_id, left, right, lease, false);
+      ++tick.commands;
+      last_speeds = speeds;
+      lease_expiry = now + lease;
+    };
+
+    // firmware_target 用: 最後に送った move_to と完了待ちの request_id
+    // (-1 なら待っていない)。
+    std::optional<transport::MoveTarget> sent_target;
+    int pending_request = -1;
+
+    // 到達時の共通処理。タスクを終了する場合は true を返す。
+    auto handle_arrival = [&](std::chrono::milliseconds dwell) {
+      if (path_mode) {
+        if (!options.firmware_target) {
+          send_speeds(0, 0);
+        }
+        log(key,
+            "waypoint reached (" + std::to_string(options.goal_x) + ", " +
+                std::to_string(options.goal_y) + ")");
+        complete_waypoint();
+        direction_state = 1.0;
+        sent_target.reset();
+        sleep_cancellable(dwell);
+        return false;
+      }
+      if (shared_goal->auto_stop_on_goal.load()) {
+        reached_goal = true;
+        return true;
+      }
+      if (!options.firmware_target) {
+        send_speeds(0, 0);
+        query_position();
+        sleep_tick(options.poll_interval);
+      }
+      return false;
+    };
 
     while (!cancel_flag->load()) {
+      tick_start = clock.now();
+      tick = TickSample{};
+      tick.started_at = clock.wall_now();
+      if (expected_start) {
+        tick.has_jitter = true;
+        tick.start_jitter = to_us(tick_start - *expected_start);
+        expected_start.reset();
+      }
       options = copy_goal();
+      std::chrono::milliseconds dwell{0};
+      if (path_mode && !apply_waypoint(options, dwell)) {
+        reached_goal = true;
+        break;
+      }
       auto state = find_cube_state(server_id, cube_id);
+      tick.state_lookup = to_us(clock.now() - tick_start);
       if (!state) {
         log(key, "cube disappeared from manager state");
         break;
       }
+      if (state->position) {
+        tick.state_age = state_age(*state, clock);
+      }
+      if (options.firmware_target) {
+        const transport::MoveTarget goal{
+            options.goal_x, options.goal_y, options.goal_angle};
+        const bool goal_changed =
+            !sent_target || sent_target->x != goal.x ||
+            sent_target->y != goal.y || sent_target->angle != goal.angle;
+        if (goal_changed) {
+          const auto request = manager_.move_to(server_id,
+                                                cube_id,
+                                                goal,
+                                                options.firmware_max_speed,
+                                                options.firmware_move_type,
+                                                true);
+          ++tick.commands;
+          if (!request) {
+            log(key, "failed to send move_to command");
+            break;
+          }
+          pending_request = *request;
+          sent_target = goal;
+        } else if (pending_request >= 0 && state->target_result &&
+                   state->target_result->request_id == pending_request) {
+          const bool success = state->target_result->success;
+          pending_request = -1;
+          if (!success) {
+            log(key, "move_to failed: " + state->target_result->message);
+            if (path_mode || shared_goal->auto_stop_on_goal.load()) {
+              break;
+            }
+            // 保持中は次の tick で同じ目標を送り直す。
+            sent_target.reset();
+          } else if (handle_arrival(dwell)) {
+            break;
+          } else {
+            continue;
+          }
+        }
+        sleep_tick(options.poll_interval);
+        continue;
+      }
       if (!state->position) {
-        manager_.query_position(server_id, cube_id, false);
-        std::this_thread::sleep_for(options.poll_interval);
+        query_position();
+        sleep_tick(options.poll_interval);
         continue;
       }
       auto speeds =
           compute_goal_move(*state->position, options, direction_state);
       if (!speeds) {
-        if (shared_goal->auto_stop_on_goal.load()) {
-          reached_goal = true;
+        if (handle_arrival(dwell)) {
           break;
         }
-        manager_.move(server_id, cube_id, 0, 0, false);
-        manager_.query_position(server_id, cube_id, false);
-        std::this_thread::sleep_for(options.poll_interval);
         continue;
       }
-      manager_.move(server_id, cube_id, speeds->first, speeds->second, false);
-      manager_.query_position(server_id, cube_id, false);
-      std::this_thread::sleep_for(options.poll_interval);
+      if (options.avoidance.enabled) {
+        const auto &avoid = options.avoidance;
+        const auto index =
+            neighbor_index(avoid.refresh_interval, avoid.influence_radius);
+        const auto &self = *state->position;
+        *speeds = apply_avoidance(self, *speeds, options, [&](auto &&visit) {
+          index->grid.for_each_within(
+              self.x, self.y, avoid.influence_radius + index->obstacle_reach,
+              [&](const SpatialGrid::Item &item) {
+                if (item.id >= index->keys.size()) {
+                  const auto &obstacle =
+                      index->obstacles[item.id - index->keys.size()];
+                  visit(item.x, item.y, obstacle.radius);
+                } else if (index->keys[item.id] != key) {
+                  visit(item.x, item.y, 0.0);
+                }
+              });
+        });
+      }
+      send_speeds(speeds->first, speeds->second);
+      query_position();
+      sleep_tick(options.poll_interval);
     }
 
     manager_.move(server_id, cube_id, 0, 0, false);
+    settle_guard.reached = reached_goal;
     if (reached_goal) {
-      log(key, "goal reached");
+      log(key, path_mode ? "path completed" : "goal reached");
     } else if (cancel_flag->load()) {
       log(key, "goal task cancelled");
     }
@@ -218,10 +564,215 @@ void GoalController::run_goal_task(
   }
 }
 
+void GoalController::run_trajectory_task(
+    const std::string &server_id,
+    const std::string &cube_id,
+    std::shared_ptr<SharedGoal> shared_goal,
+    std::shared_ptr<std::atomic<bool>> cancel_flag) {
+  const std::string key = make_key(server_id, cube_id);
+  SettleGuard settle_guard{*shared_goal, *cancel_flag};
+  const auto &points = shared_goal->trajectory;
+  const auto &options = shared_goal->trajectory_options;
+  auto &progress = *shared_goal->progress;
+  const std::size_t chunk_size =
+      std::clamp<std::size_t>(options.chunk_size, 1, 29);
+
+  struct SentChunk {
+    int request_id = -1;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+  };
+  std::deque<SentChunk> outstanding;
+  std::size_t next_point = 0;
+  // 先頭のチャンクの結果を待ち始めた時刻 (送ったか前のチャンクが完了した時刻)。
+  auto head_started = runtime_.clock->now();
+  std::size_t resends = 0;
+
+  try {
+    log(key,
+        "started trajectory with " + std::to_string(points.size()) +
+            " point(s) in " + std::to_string(progress.total_chunks.load()) +
+            " chunk(s)");
+    if (!ensure_connected(server_id, cube_id, *cancel_flag)) {
+      return;
+    }
+
+    bool completed = false;
+    bool failed = false;
+    while (!cancel_flag->load()) {
+      auto state = find_cube_state(server_id, cube_id);
+      if (!state) {
+        log(key, "cube disappeared from manager state");
+        break;
+      }
+
+      // キューブは受け付け順に完了するため、結果の request_id までの
+      // チャンクはすべて完了とみなす。target_result は move_to_multi を送る
+      // たびに ServerSession が消すので、前のコマンドや一巡した request_id の
+      // 古い結果でチャンクを完了にすることはない (消えた結果の分は後の
+      // チャンクの結果でまとめて完了になる)。
+      if (state->target_result) {
+        const auto &result = *state->target_result;
+        auto it = std::find_if(outstanding.begin(),
+                               outstanding.end(),
+                               [&](const SentChunk &chunk) {
+                                 return chunk.request_id == result.request_id;
+                               });
+        if (it != outstanding.end()) {
+          if (!result.success) {
+            log(key, "trajectory chunk failed: " + result.message);
+            failed = true;
+            break;
+          }
+          const auto done = std::next(it);
+          for (auto chunk = outstanding.begin(); chunk != done; ++chunk) {
+            progress.completed_points += chunk->end - chunk->begin;
+            progress.completed_chunks += 1;
+          }
+          outstanding.erase(outstanding.begin(), done);
+          head_started = runtime_.clock->now();
+          resends = 0;
+        }
+      }
+
+      if (next_point >= points.size() && outstanding.empty()) {
+        completed = true;
+        break;
+      }
+
+      // 先頭のチャンクの結果がキューブ側のタイムアウトを過ぎても来なければ
+      // 結果を失ったとみなし、積んだ分を捨ててそのチャンクの先頭から上書きで
+      // 送り直す (最後のチャンクの結果を失うと待ち続けてしまうため)。
+      if (!outstanding.empty()) {
+        const auto &head = outstanding.front();
+        const auto deadline =
+            head_started +
+            options.point_timeout *
+                static_cast<std::int64_t>(head.end - head.begin) +
+            options.poll_interval;
+        if (runtime_.clock->now() >= deadline) {
+          if (resends >= options.max_resends) {
+            log(key, "trajectory chunk timed out");
+            failed = true;
+            break;
+          }
+          ++resends;
+          log(key,
+              "trajectory chunk result missing, resending from point " +
+                  std::to_string(head.begin));
+          progress.sent_chunks -= outstanding.size();
+          next_point = head.begin;
+          outstanding.clear();
+        }
+      }
+
+      while (next_point < points.size() &&
+             outstanding.size() <= options.pipeline_depth) {
+        const std::size_t end = std::min(points.size(), next_point + chunk_size);
+        std::vector<transport::MoveTarget> chunk(
+            points.begin() + static_cast<std::ptrdiff_t>(next_point),
+            points.begin() + static_cast<std::ptrdiff_t>(end));
+        const bool append = !outstanding.empty();
+        auto request_id = manager_.move_to_multi(server_id,
+                                                 cube_id,
+                                                 chunk,
+                                                 options.max_speed,
+                                                 options.move_type,
+                                                 append,
+                                                 true);
+        if (!request_id) {
+          log(key, "failed to send move_to_multi command");
+          failed = true;
+          break;
+        }
+        if (!append) {
+          head_started = runtime_.clock->now();
+        }
+        outstanding.push_back(SentChunk{*request_id, next_point, end});
+        progress.sent_chunks += 1;
+        next_point = end;
+      }
+      if (failed) {
+        break;
+      }
+      runtime_.clock->sleep_for(options.poll_interval);
+    }
+
+    manager_.move(server_id, cube_id, 0, 0, false);
+    settle_guard.reached = completed;
+    if (completed) {
+      log(key, "trajectory completed");
+    } else if (cancel_flag->load()) {
+      log(key, "trajectory cancelled");
+    }
+  } catch (const std::exception &ex) {
+    log(key, std::string("error: ") + ex.what());
+  } catch (...) {
+    log(key, "error: unknown exception");
+  }
+}
+
+void GoalController::launch_task(const std::string &server_id,
+                                 const std::string &cube_id,
+                                 std::shared_ptr<SharedGoal> shared_goal) {
+  const std::string key = make_key(server_id, cube_id);
+  auto cancel_flag = std::make_shared<std::atomic<bool>>(false);
+  auto worker = runtime_.executor->spawn([this,
+                                         server_id,
+                                         cube_id,
+                                         shared_goal,
+                                         cancel_flag]() {
+    if (shared_goal->trajectory_mode) {
+      run_trajectory_task(server_id, cube_id, shared_goal, cancel_flag);
+    } else {
+      run_goal_task(server_id, cube_id, shared_goal, cancel_flag);
+    }
+  });
+
+  std::lock_guard<std::mutex> lock(tasks_mutex_);
+  tasks_.emplace(key,
+                 GoalTask{server_id,
+                          cube_id,
+                          std::move(shared_goal),
+                          std::move(cancel_flag),
+                          std::move(worker)});
+}
+
+std::vector<std::shared_future<GoalStatus>>
+GoalController::enqueue_waypoints(SharedGoal &goal,
+                                  std::vector<Waypoint> waypoints) {
+  std::vector<std::shared_future<GoalStatus>> futures;
+  futures.reserve(waypoints.size());
+  for (auto &waypoint : waypoints) {
+    QueuedWaypoint queued;
+    queued.waypoint = waypoint;
+    futures.push_back(queued.done.get_future().share());
+    goal.waypoints.push_back(std::move(queued));
+  }
+  return futures;
+}
+
+void GoalController::settle_path(SharedGoal &goal, GoalStatus status) {
+  std::lock_guard<std::mutex> lock(goal.mutex);
+  goal.finished = true;
+  const GoalStatus pending_status =
+      status == GoalStatus::Reached ? GoalStatus::Failed : status;
+  for (auto &queued : goal.waypoints) {
+    queued.done.set_value(pending_status);
+  }
+  goal.waypoints.clear();
+  if (goal.path_mode || goal.trajectory_mode) {
+    try {
+      goal.path_done.set_value(status);
+    } catch (const std::future_error &) {
+      // already settled
+    }
+  }
+}
+
 bool GoalController::start_goal(const std::string &server_id,
                                 const std::string &cube_id,
                                 GoalOptions options) {
-  const std::string key = make_key(server_id, cube_id);
   stop_goal(server_id, cube_id);
 
   auto shared_goal = std::make_shared<SharedGoal>();
@@ -230,27 +781,87 @@ bool GoalController::start_goal(const std::string &server_id,
     shared_goal->options = std::move(options);
     shared_goal->auto_stop_on_goal.store(true);
   }
-  auto cancel_flag = std::make_shared<std::atomic<bool>>(false);
-  auto worker = std::async(std::launch::async,
-                           [this,
-                            server_id,
-                            cube_id,
-                            shared_goal,
-                            cancel_flag]() {
-                             run_goal_task(server_id,
-                                           cube_id,
-                                           shared_goal,
-                                           cancel_flag);
-                           });
-
-  std::lock_guard<std::mutex> lock(tasks_mutex_);
-  tasks_.emplace(key,
-                 GoalTask{std::move(shared_goal),
-                          std::move(cancel_flag),
-                          std::move(worker)});
+  launch_task(server_id, cube_id, std::move(shared_goal));
   return true;
 }
 
+PathHandle GoalController::start_path(const std::string &server_id,
+                                      const std::string &cube_id,
+                                      std::vector<Waypoint> waypoints,
+                                      GoalOptions options) {
+  stop_goal(server_id, cube_id);
+
+  auto shared_goal = std::make_shared<SharedGoal>();
+  PathHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(shared_goal->mutex);
+    shared_goal->options = std::move(options);
+    shared_goal->path_mode = true;
+    shared_goal->path_future = shared_goal->path_done.get_future().share();
+    handle.waypoints = enqueue_waypoints(*shared_goal, std::move(waypoints));
+    handle.path = shared_goal->path_future;
+  }
+  launch_task(server_id, cube_id, std::move(shared_goal));
+  return handle;
+}
+
+TrajectoryHandle
+GoalController::start_trajectory(const std::string &server_id,
+                                 const std::string &cube_id,
+                                 std::vector<transport::MoveTarget> points,
+                                 TrajectoryOptions options) {
+  stop_goal(server_id, cube_id);
+
+  auto shared_goal = std::make_shared<SharedGoal>();
+  auto progress = std::make_shared<TrajectoryProgress>();
+  const std::size_t chunk_size =
+      std::clamp<std::size_t>(options.chunk_size, 1, 29);
+  progress->total_points = points.size();
+  progress->total_chunks = (points.size() + chunk_size - 1) / chunk_size;
+
+  TrajectoryHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(shared_goal->mutex);
+    shared_goal->trajectory_mode = true;
+    shared_goal->trajectory = std::move(points);
+    shared_goal->trajectory_options = std::move(options);
+    shared_goal->progress = progress;
+    shared_goal->path_future = shared_goal->path_done.get_future().share();
+    handle.done = shared_goal->path_future;
+  }
+  handle.progress = std::move(progress);
+  launch_task(server_id, cube_id, std::move(shared_goal));
+  return handle;
+}
+
+std::optional<PathHandle>
+GoalController::append_waypoints(const std::string &server_id,
+                                 const std::string &cube_id,
+                                 std::vector<Waypoint> waypoints) {
+  const std::string key = make_key(server_id, cube_id);
+  std::shared_ptr<SharedGoal> shared_goal;
+  {
+    std::lock_guard<std::mutex> lock(tasks_mutex_);
+    auto it = tasks_.find(key);
+    if (it == tasks_.end()) {
+      return std::nullopt;
+    }
+    shared_goal = it->second.shared_goal;
+  }
+  const std::size_t count = waypoints.size();
+  PathHandle handle;
+  {
+    std::lock_guard<std::mutex> goal_lock(shared_goal->mutex);
+    if (!shared_goal->path_mode || shared_goal->finished) {
+      return std::nullopt;
+    }
+    handle.waypoints = enqueue_waypoints(*shared_goal, std::move(waypoints));
+    handle.path = shared_goal->path_future;
+  }
+  log(key, "appended " + std::to_string(count) + " waypoint(s)");
+  return handle;
+}
+
 bool GoalController::update_goal(const std::string &server_id,
                                  const std::string &cube_id,
                                  GoalOptions options) {
@@ -289,31 +900,52 @@ bool GoalController::stop_goal(const std::string &server_id,
     worker = std::move(it->second.worker);
     tasks_.erase(it);
   }
-  if (worker.valid()) {
-    worker.wait();
-  }
+  send_priority_stop(server_id, cube_id);
+  runtime_.executor->wait(worker);
   return true;
 }
 
 std::size_t GoalController::stop_all() {
   std::vector<std::future<void>> workers;
+  std::vector<std::pair<std::string, std::string>> targets;
   {
     std::lock_guard<std::mutex> lock(tasks_mutex_);
     workers.reserve(tasks_.size());
+    targets.reserve(tasks_.size());
     for (auto &[_, task] : tasks_) {
       task.cancel_flag->store(true);
       workers.push_back(std::move(task.worker));
+      targets.emplace_back(task.server_id, task.cube_id);
     }
     tasks_.clear();
   }
+  for (const auto &[server_id, cube_id] : targets) {
+    send_priority_stop(server_id, cube_id);
+  }
   for (auto &worker : workers) {
-    if (worker.valid()) {
-      worker.wait();
-    }
+    runtime_.executor->wait(worker);
   }
   return workers.size();
 }
 
+std::size_t GoalController::cancel_all() {
+  std::lock_guard<std::mutex> lock(tasks_mutex_);
+  for (auto &[_, task] : tasks_) {
+    task.cancel_flag->store(true);
+  }
+  return tasks_.size();
+}
+
+void GoalController::send_priority_stop(const std::string &server_id,
+                                        const std::string &cube_id) {
+  try {
+    manager_.stop_cube(server_id, cube_id);
+  } catch (const std::exception &ex) {
+    log(make_key(server_id, cube_id),
+        std::string("priority stop failed: ") + ex.what());
+  }
+}
+
 bool GoalController::has_goal(const std::string &server_id,
                               const std::string &cube_id) const {
   const std::string key = make_key(server_id, cube_id);
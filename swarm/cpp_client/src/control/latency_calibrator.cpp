@@ -0,0 +1,276 @@
+#include "toio/control/latency_calibrator.hpp"
+
+#include "toio/transport/toio_client.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+#include <optional>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::control {
+
+namespace {
+
+using Clock = runtime::Clock;
+
+struct Probe {
+  std::string server_id;
+  std::string cube_id;
+  std::optional<middleware::Position> baseline;
+  Clock::time_point sent_at{};
+  std::chrono::system_clock::time_point sent_wall{};
+  bool done = false;
+  LatencySample sample;
+};
+
+bool moved(const middleware::Position &from, const middleware::Position &to,
+           const LatencyCalibrationOptions &options) {
+  const double distance = std::hypot(to.x - from.x, to.y - from.y);
+  int angle = std::abs(to.angle - from.angle) % 360;
+  angle = std::min(angle, 360 - angle);
+  return distance >= options.onset_distance || angle >= options.onset_angle;
+}
+
+double ms_between(Clock::time_point from, Clock::time_point to) {
+  return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+LatencyDistribution summarize(std::vector<double> values) {
+  LatencyDistribution distribution;
+  if (values.empty()) {
+    return distribution;
+  }
+  std::sort(values.begin(), values.end());
+  // 最近傍順位法。
+  auto rank = [&values](double q) {
+    const auto index = static_cast<std::size_t>(
+        std::ceil(q * static_cast<double>(values.size())));
+    return values[std::min(values.size() - 1, index == 0 ? 0 : index - 1)];
+  };
+  distribution.count = values.size();
+  distribution.min = values.front();
+  distribution.max = values.back();
+  distribution.mean = std::accumulate(values.begin(), values.end(), 0.0) /
+                      static_cast<double>(values.size());
+  distribution.p50 = rank(0.5);
+  distribution.p90 = rank(0.9);
+  distribution.p99 = rank(0.99);
+  return distribution;
+}
+
+LatencyGroup summarize_group(const std::vector<const LatencySample *> &samples,
+                             std::string server_id, std::string cube_id) {
+  LatencyGroup group;
+  group.server_id = std::move(server_id);
+  group.cube_id = std::move(cube_id);
+  std::vector<double> motion;
+  std::vector<double> observed;
+  std::vector<double> age;
+  for (const auto *sample : samples) {
+    if (!sample->detected) {
+      ++group.misses;
+      continue;
+    }
+    observed.push_back(sample->observed_ms);
+    if (sample->has_timestamp) {
+      motion.push_back(sample->motion_ms);
+      age.push_back(sample->report_age_ms);
+    }
+  }
+  group.motion = summarize(std::move(motion));
+  group.observed = summarize(std::move(observed));
+  group.report_age = summarize(std::move(age));
+  return group;
+}
+
+} // namespace
+
+LatencyCalibrator::LatencyCalibrator(middleware::FleetManager &manager)
+    : manager_(manager) {}
+
+LatencyReport LatencyCalibrator::run(
+    const std::vector<std::pair<std::string, std::string>> &cubes,
+    const LatencyCalibrationOptions &options) {
+  const auto &clock = manager_.runtime().clock;
+  LatencyReport report;
+
+  auto has_position = [this](const std::pair<std::string, std::string> &cube) {
+    const auto state = manager_.cube_state(cube.first, cube.second);
+    return state && state->position.has_value();
+  };
+  bool waiting = false;
+  for (const auto &cube : cubes) {
+    if (!has_position(cube)) {
+      manager_.query_position(cube.first, cube.second, true);
+      waiting = true;
+    }
+  }
+  const auto subscribe_deadline = clock->now() + options.subscribe_wait;
+  while (waiting && clock->now() < subscribe_deadline) {
+    clock->sleep_for(options.poll_interval);
+    waiting = !std::all_of(cubes.begin(), cubes.end(), has_position);
+  }
+
+  for (std::size_t trial = 0; trial < options.trials; ++trial) {
+    const int speed = trial % 2 == 0 ? options.speed : -options.speed;
+    std::vector<Probe> probes;
+    probes.reserve(cubes.size());
+    for (const auto &[server_id, cube_id] : cubes) {
+      Probe probe;
+      probe.server_id = server_id;
+      probe.cube_id = cube_id;
+      probe.sample.server_id = server_id;
+      probe.sample.cube_id = cube_id;
+      probe.sample.trial = trial;
+      if (const auto state = manager_.cube_state(server_id, cube_id)) {
+        probe.baseline = state->position;
+      }
+      probes.push_back(std::move(probe));
+    }
+    // 位置が分からない Cube には送らず、取りこぼしとして数える。
+    for (auto &probe : probes) {
+      if (!probe.baseline) {
+        probe.done = true;
+        continue;
+      }
+      probe.sent_wall = clock->wall_now();
+      probe.sent_at = clock->now();
+      if (!manager_.move_for(probe.server_id, probe.cube_id, speed, speed,
+                             std::clamp(options.step_duration,
+                                        transport::kMinMoveDuration,
+                                        transport::kMaxMoveDuration),
+                             false)) {
+        probe.done = true;
+      }
+    }
+
+    const auto deadline = clock->now() + options.timeout;
+    auto pending = [&probes] {
+      return std::any_of(probes.begin(), probes.end(),
+                         [](const Probe &probe) { return !probe.done; });
+    };
+    while (pending() && clock->now() < deadline) {
+      for (auto &probe : probes) {
+        if (probe.done) {
+          continue;
+        }
+        const auto state = manager_.cube_state(probe.server_id, probe.cube_id);
+        if (!state || !state->position || state->last_update <= probe.sent_at ||
+            !moved(*probe.baseline, *state->position, options)) {
+          continue;
+        }
+        const auto sent_ms = std::chrono::duration<double, std::milli>(
+                                 probe.sent_wall.time_since_epoch())
+                                 .count();
+        probe.done = true;
+        probe.sample.detected = true;
+        probe.sample.observed_ms = ms_between(probe.sent_at, state->last_update);
+        // timestamp_ms が 0 ならリレーの時刻はない (GoalController と同じ扱い)。
+        if (state->position->timestamp_ms > 0) {
+          probe.sample.has_timestamp = true;
+          probe.sample.motion_ms =
+              static_cast<double>(state->position->timestamp_ms) - sent_ms;
+          probe.sample.report_age_ms =
+              probe.sample.observed_ms - probe.sample.motion_ms;
+        }
+      }
+      clock->sleep_for(options.poll_interval);
+    }
+
+    for (auto &probe : probes) {
+      if (probe.baseline) {
+        manager_.stop_cube(probe.server_id, probe.cube_id);
+      }
+      report.samples.push_back(std::move(probe.sample));
+    }
+    clock->sleep_for(options.settle);
+  }
+
+  // Cube の集計は指定した順に並べる。
+  std::map<std::pair<std::string, std::string>, std::vector<const LatencySample *>>
+      by_cube;
+  std::map<std::string, std::vector<const LatencySample *>> by_server;
+  std::vector<const LatencySample *> all;
+  for (const auto &sample : report.samples) {
+    by_cube[{sample.server_id, sample.cube_id}].push_back(&sample);
+    by_server[sample.server_id].push_back(&sample);
+    all.push_back(&sample);
+  }
+  for (const auto &[server_id, cube_id] : cubes) {
+    auto it = by_cube.find({server_id, cube_id});
+    if (it != by_cube.end()) {
+      report.cubes.push_back(summarize_group(it->second, server_id, cube_id));
+      by_cube.erase(it);
+    }
+  }
+  for (const auto &[server_id, samples] : by_server) {
+    report.servers.push_back(summarize_group(samples, server_id, {}));
+  }
+  report.overall = summarize_group(all, {}, {});
+
+  report.suggested_lookahead_s = report.overall.observed.p50 / 1000.0;
+  const auto &margin = report.overall.motion.count > 0
+                           ? report.overall.motion
+                           : report.overall.observed;
+  report.suggested_lease_margin = std::chrono::milliseconds(
+      static_cast<std::int64_t>(std::ceil(std::max(0.0, margin.p99))));
+  return report;
+}
+
+void to_json(nlohmann::json &json, const LatencyDistribution &distribution) {
+  json = nlohmann::json{
+      {"count", distribution.count}, {"min", distribution.min},
+      {"mean", distribution.mean},   {"p50", distribution.p50},
+      {"p90", distribution.p90},     {"p99", distribution.p99},
+      {"max", distribution.max},
+  };
+}
+
+void to_json(nlohmann::json &json, const LatencyGroup &group) {
+  json = nlohmann::json{
+      {"server", group.server_id},
+      {"misses", group.misses},
+      {"motion_ms", group.motion},
+      {"observed_ms", group.observed},
+      {"report_age_ms", group.report_age},
+  };
+  if (!group.cube_id.empty()) {
+    json["cube"] = group.cube_id;
+  }
+}
+
+void to_json(nlohmann::json &json, const LatencyReport &report) {
+  nlohmann::json samples = nlohmann::json::array();
+  for (const auto &sample : report.samples) {
+    nlohmann::json item{
+        {"server", sample.server_id},
+        {"cube", sample.cube_id},
+        {"trial", sample.trial},
+        {"detected", sample.detected},
+    };
+    if (sample.detected) {
+      item["observed_ms"] = sample.observed_ms;
+      if (sample.has_timestamp) {
+        item["motion_ms"] = sample.motion_ms;
+        item["report_age_ms"] = sample.report_age_ms;
+      }
+    }
+    samples.push_back(std::move(item));
+  }
+  json = nlohmann::json{
+      {"overall", report.overall},
+      {"servers", report.servers},
+      {"cubes", report.cubes},
+      {"samples", std::move(samples)},
+      {"suggested",
+       {{"lookahead_time_s", report.suggested_lookahead_s},
+        {"lease_margin_ms", report.suggested_lease_margin.count()}}},
+  };
+}
+
+} // namespace toio::control
@@ -0,0 +1,186 @@
+#include "toio/control/loop_metrics.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::control {
+
+namespace {
+
+std::uint64_t to_unsigned(std::int64_t value) {
+  return value > 0 ? static_cast<std::uint64_t>(value) : 0;
+}
+
+} // namespace
+
+double Histogram::Snapshot::mean() const {
+  return count == 0 ? 0.0
+                    : static_cast<double>(sum) / static_cast<double>(count);
+}
+
+std::uint64_t Histogram::Snapshot::percentile(double q) const {
+  if (count == 0) {
+    return 0;
+  }
+  const auto rank = static_cast<std::uint64_t>(
+      std::clamp(q, 0.0, 1.0) * static_cast<double>(count - 1));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets[i];
+    if (seen > rank) {
+      return std::min(bucket_upper_bound(i), max);
+    }
+  }
+  return max;
+}
+
+void Histogram::record(std::uint64_t value) {
+  buckets_[bucket_for(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  auto current = max_.load(std::memory_order_relaxed);
+  while (value > current &&
+         !max_.compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot result;
+  for (std::size_t i = 0; i < kBucketCount; ++i) {
+    result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  result.count = count_.load(std::memory_order_relaxed);
+  result.sum = sum_.load(std::memory_order_relaxed);
+  result.max = max_.load(std::memory_order_relaxed);
+  return result;
+}
+
+void Histogram::reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+std::size_t Histogram::bucket_for(std::uint64_t value) {
+  return std::min<std::size_t>(std::bit_width(value), kBucketCount - 1);
+}
+
+std::uint64_t Histogram::bucket_upper_bound(std::size_t bucket) {
+  if (bucket == 0) {
+    return 0;
+  }
+  return (std::uint64_t{1} << bucket) - 1;
+}
+
+void LoopMetrics::record(const std::string &key, const TickSample &sample) {
+  ticks_.fetch_add(1, std::memory_order_relaxed);
+  if (sample.has_jitter) {
+    start_jitter_us_.record(to_unsigned(sample.start_jitter.count()));
+  }
+  state_lookup_us_.record(to_unsigned(sample.state_lookup.count()));
+  compute_us_.record(to_unsigned(sample.compute.count()));
+  if (sample.state_age.count() >= 0) {
+    state_age_ms_.record(to_unsigned(sample.state_age.count()));
+  }
+  commands_per_tick_.record(to_unsigned(sample.commands));
+  if (dump_enabled_.load(std::memory_order_relaxed)) {
+    dump(key, sample);
+  }
+}
+
+LoopMetricsSnapshot LoopMetrics::snapshot() const {
+  LoopMetricsSnapshot result;
+  result.ticks = ticks_.load(std::memory_order_relaxed);
+  result.start_jitter_us = start_jitter_us_.snapshot();
+  result.state_lookup_us = state_lookup_us_.snapshot();
+  result.compute_us = compute_us_.snapshot();
+  result.state_age_ms = state_age_ms_.snapshot();
+  result.commands_per_tick = commands_per_tick_.snapshot();
+  return result;
+}
+
+void LoopMetrics::reset() {
+  ticks_.store(0, std::memory_order_relaxed);
+  start_jitter_us_.reset();
+  state_lookup_us_.reset();
+  compute_us_.reset();
+  state_age_ms_.reset();
+  commands_per_tick_.reset();
+}
+
+void LoopMetrics::set_dump_path(const std::string &path) {
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  dump_enabled_.store(false);
+  if (dump_stream_.is_open()) {
+    dump_stream_.close();
+  }
+  if (path.empty()) {
+    return;
+  }
+  dump_stream_.open(path, std::ios::out | std::ios::app);
+  if (!dump_stream_) {
+    throw std::runtime_error("Failed to open loop metrics dump: " + path);
+  }
+  dump_enabled_.store(true);
+}
+
+void LoopMetrics::dump(const std::string &key, const TickSample &sample) {
+  nlohmann::json line{
+      {"key", key},
+      {"t_us", std::chrono::duration_cast<std::chrono::microseconds>(
+                   sample.started_at.time_since_epoch())
+                   .count()},
+      {"state_lookup_us", sample.state_lookup.count()},
+      {"compute_us", sample.compute.count()},
+      {"commands", sample.commands},
+  };
+  if (sample.has_jitter) {
+    line["start_jitter_us"] = sample.start_jitter.count();
+  }
+  if (sample.state_age.count() >= 0) {
+    line["state_age_ms"] = sample.state_age.count();
+  }
+  std::lock_guard<std::mutex> lock(dump_mutex_);
+  if (dump_stream_.is_open()) {
+    dump_stream_ << line.dump() << '\n';
+  }
+}
+
+void to_json(nlohmann::json &json, const Histogram::Snapshot &snapshot) {
+  // 末尾の空 bucket は省く。
+  std::size_t used = Histogram::kBucketCount;
+  while (used > 0 && snapshot.buckets[used - 1] == 0) {
+    --used;
+  }
+  json = nlohmann::json{
+      {"count", snapshot.count},
+      {"mean", snapshot.mean()},
+      {"p50", snapshot.percentile(0.50)},
+      {"p90", snapshot.percentile(0.90)},
+      {"p99", snapshot.percentile(0.99)},
+      {"max", snapshot.max},
+      {"buckets", std::vector<std::uint64_t>(snapshot.buckets.begin(),
+                                             snapshot.buckets.begin() + used)},
+  };
+}
+
+void to_json(nlohmann::json &json, const LoopMetricsSnapshot &snapshot) {
+  json = nlohmann::json{
+      {"ticks", snapshot.ticks},
+      {"start_jitter_us", snapshot.start_jitter_us},
+      {"state_lookup_us", snapshot.state_lookup_us},
+      {"compute_us", snapshot.compute_us},
+      {"state_age_ms", snapshot.state_age_ms},
+      {"commands_per_tick", snapshot.commands_per_tick},
+  };
+}
+
+} // namespace toio::control
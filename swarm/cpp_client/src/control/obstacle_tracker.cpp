@@ -0,0 +1,111 @@
+#include "toio/control/obstacle_tracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace toio::control {
+
+ObstacleTracker::ObstacleTracker(std::shared_ptr<runtime::Clock> clock,
+                                 std::chrono::milliseconds ttl)
+    : clock_(std::move(clock)), ttl_(ttl) {
+  if (!clock_) {
+    throw std::invalid_argument("ObstacleTracker requires a clock");
+  }
+  if (ttl_.count() <= 0) {
+    throw std::invalid_argument("ObstacleTracker ttl must be positive");
+  }
+}
+
+void ObstacleTracker::update(const Obstacle &obstacle) {
+  // NaN はどの比較も偽になるので、範囲の内側にあることを確かめる形で弾く。
+  const bool in_range =
+      std::fabs(obstacle.x) <= kMaxObstacleCoordinate &&
+      std::fabs(obstacle.y) <= kMaxObstacleCoordinate &&
+      obstacle.radius >= 0.0 && obstacle.radius <= kMaxObstacleRadius &&
+      std::isfinite(obstacle.vx) && std::isfinite(obstacle.vy) &&
+      std::hypot(obstacle.vx, obstacle.vy) <= kMaxObstacleSpeed;
+  if (!in_range) {
+    throw std::invalid_argument("invalid obstacle " +
+                                std::to_string(obstacle.id));
+  }
+  const auto now = clock_->now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[obstacle.id] = Entry{obstacle, now};
+  ++version_;
+}
+
+bool ObstacleTracker::remove(std::uint32_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (entries_.erase(id) == 0) {
+    return false;
+  }
+  ++version_;
+  return true;
+}
+
+void ObstacleTracker::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  ++version_;
+}
+
+void ObstacleTracker::apply(const transport::ObstacleMessage &message) {
+  using Kind = transport::ObstacleMessage::Kind;
+  switch (message.kind) {
+  case Kind::Remove:
+    remove(message.id);
+    return;
+  case Kind::Clear:
+    clear();
+    return;
+  case Kind::Update:
+  default:
+    update(Obstacle{message.id, message.x, message.y, message.radius,
+                    message.vx, message.vy});
+    return;
+  }
+}
+
+std::size_t ObstacleTracker::size() const {
+  const auto now = clock_->now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<std::size_t>(
+      std::count_if(entries_.begin(), entries_.end(), [&](const auto &entry) {
+        return now - entry.second.updated <= ttl_;
+      }));
+}
+
+std::uint64_t ObstacleTracker::version() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return version_;
+}
+
+void ObstacleTracker::snapshot(std::vector<Obstacle> &out) const {
+  out.clear();
+  const auto now = clock_->now();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &[id, entry] : entries_) {
+    const auto age = now - entry.updated;
+    if (age > ttl_) {
+      continue;
+    }
+    // 受信の間隔ぶん遅れた位置を速度で今に合わせる。
+    const double seconds =
+        std::max(0.0, std::chrono::duration<double>(age).count());
+    auto obstacle = entry.obstacle;
+    obstacle.x += obstacle.vx * seconds;
+    obstacle.y += obstacle.vy * seconds;
+    out.push_back(obstacle);
+  }
+}
+
+std::vector<Obstacle> ObstacleTracker::snapshot() const {
+  std::vector<Obstacle> out;
+  snapshot(out);
+  return out;
+}
+
+} // namespace toio::control
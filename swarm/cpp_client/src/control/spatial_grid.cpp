@@ -0,0 +1,121 @@
+#include "toio/control/spatial_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace toio::control {
+
+namespace {
+
+// 範囲外は端のセルに寄せる。int に直す前に寄せるので、大きな値や NaN でも
+// あふれない。
+int clamp_cell(double cell, int count) {
+  if (!(cell > 0.0)) {
+    return 0;
+  }
+  return cell < static_cast<double>(count - 1) ? static_cast<int>(cell)
+                                                : count - 1;
+}
+
+} // namespace
+
+SpatialGrid::SpatialGrid(double cell_size, Bounds bounds)
+    : cell_size_(std::max(cell_size, 1.0)), bounds_(bounds) {
+  const double width = std::max(bounds_.max_x - bounds_.min_x, cell_size_);
+  const double height = std::max(bounds_.max_y - bounds_.min_y, cell_size_);
+  columns_ = std::max(1, static_cast<int>(std::ceil(width / cell_size_)));
+  rows_ = std::max(1, static_cast<int>(std::ceil(height / cell_size_)));
+  cell_end_.resize(static_cast<std::size_t>(columns_) *
+                   static_cast<std::size_t>(rows_));
+}
+
+void SpatialGrid::reserve(std::size_t ids) {
+  slots_.reserve(ids);
+  items_.reserve(ids);
+}
+
+void SpatialGrid::clear() {
+  std::fill(slots_.begin(), slots_.end(), Slot{});
+  items_.clear();
+  std::fill(cell_end_.begin(), cell_end_.end(), 0);
+  size_ = 0;
+  dirty_ = false;
+}
+
+void SpatialGrid::update(std::size_t id, double x, double y) {
+  if (id >= slots_.size()) {
+    slots_.resize(id + 1);
+  }
+  auto &slot = slots_[id];
+  if (slot.cell == kNoCell) {
+    ++size_;
+  }
+  slot.cell = cell_of(x, y);
+  slot.x = x;
+  slot.y = y;
+  dirty_ = true;
+}
+
+void SpatialGrid::remove(std::size_t id) {
+  if (!contains(id)) {
+    return;
+  }
+  slots_[id] = Slot{};
+  --size_;
+  dirty_ = true;
+}
+
+void SpatialGrid::rebuild() {
+  // セルごとに数え、先頭の位置を求めてから id の昇順に詰める。詰め終わると
+  // cell_end_[c] はセル c の末尾になる。
+  std::fill(cell_end_.begin(), cell_end_.end(), 0);
+  for (const auto &slot : slots_) {
+    if (slot.cell != kNoCell) {
+      ++cell_end_[slot.cell];
+    }
+  }
+  std::uint32_t offset = 0;
+  for (auto &end : cell_end_) {
+    const auto count = end;
+    end = offset;
+    offset += count;
+  }
+  items_.resize(size_);
+  for (std::size_t id = 0; id < slots_.size(); ++id) {
+    const auto &slot = slots_[id];
+    if (slot.cell != kNoCell) {
+      items_[cell_end_[slot.cell]++] = Item{id, slot.x, slot.y};
+    }
+  }
+  dirty_ = false;
+}
+
+bool SpatialGrid::contains(std::size_t id) const {
+  return id < slots_.size() && slots_[id].cell != kNoCell;
+}
+
+std::size_t SpatialGrid::size() const {
+  return size_;
+}
+
+double SpatialGrid::cell_size() const {
+  return cell_size_;
+}
+
+const SpatialGrid::Bounds &SpatialGrid::bounds() const {
+  return bounds_;
+}
+
+int SpatialGrid::column(double x) const {
+  return clamp_cell(std::floor((x - bounds_.min_x) / cell_size_), columns_);
+}
+
+int SpatialGrid::row(double y) const {
+  return clamp_cell(std::floor((y - bounds_.min_y) / cell_size_), rows_);
+}
+
+std::uint32_t SpatialGrid::cell_of(double x, double y) const {
+  return static_cast<std::uint32_t>(row(y) * columns_ + column(x));
+}
+
+} // namespace toio::control
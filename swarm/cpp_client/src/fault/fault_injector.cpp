@@ -0,0 +1,347 @@
+#include "toio/fault/fault_injector.hpp"
+
+#include "toio/transport/websocket_connection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+
+namespace toio::fault {
+
+namespace {
+
+using Clock = runtime::Clock;
+
+double to_ms(Clock::duration value) {
+  return std::chrono::duration<double, std::milli>(value).count();
+}
+
+Clock::duration from_us(double us) {
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double, std::micro>(us));
+}
+
+} // namespace
+
+bool LinkProfile::active() const {
+  return latency.count() > 0 || jitter.count() > 0 || drop_rate > 0.0 ||
+         burst_enter > 0.0 || bandwidth > 0.0;
+}
+
+bool FaultConfig::active() const {
+  return uplink.active() || downlink.active() ||
+         (outage_interval.count() > 0 && outage_duration.count() > 0);
+}
+
+FaultInjector::FaultInjector(FaultConfig config, runtime::Runtime runtime)
+    : runtime_(std::move(runtime)), config_(std::move(config)),
+      rng_(config_.seed) {}
+
+void FaultInjector::set_config(const FaultConfig &config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (config.outage_interval != config_.outage_interval ||
+      config.outage_duration != config_.outage_duration) {
+    outage_scheduled_ = false;
+  }
+  config_ = config;
+}
+
+FaultConfig FaultInjector::config() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_;
+}
+
+bool FaultInjector::active(Direction direction) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto &profile =
+      direction == Direction::Uplink ? config_.uplink : config_.downlink;
+  return profile.active() || config_.active() ||
+         runtime_.clock->now() < outage_end_;
+}
+
+void FaultInjector::start_outage(std::chrono::milliseconds duration) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  outage_end_ = std::max(outage_end_, runtime_.clock->now() + duration);
+  ++stats_.outages;
+}
+
+bool FaultInjector::in_outage() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return runtime_.clock->now() < outage_end_;
+}
+
+FaultStats FaultInjector::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+const runtime::Runtime &FaultInjector::runtime() const {
+  return runtime_;
+}
+
+std::optional<Clock::time_point>
+FaultInjector::schedule(Direction direction, std::size_t bytes,
+                        LinkState &state) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto now = runtime_.clock->now();
+  advance_outages(now);
+  const auto &profile =
+      direction == Direction::Uplink ? config_.uplink : config_.downlink;
+  auto &stats = stats_for(direction);
+  ++stats.messages;
+  stats.bytes += bytes;
+
+  const bool outage = now < outage_end_;
+  if (outage && config_.outage_mode == OutageMode::Drop) {
+    ++stats.outage_dropped;
+    return std::nullopt;
+  }
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  if (state.in_burst) {
+    state.in_burst = unit(rng_) >= profile.burst_exit;
+  } else if (profile.burst_enter > 0.0) {
+    state.in_burst = unit(rng_) < profile.burst_enter;
+  }
+  if (state.in_burst) {
+    ++stats.burst_dropped;
+    return std::nullopt;
+  }
+  if (profile.drop_rate > 0.0 && unit(rng_) < profile.drop_rate) {
+    ++stats.dropped;
+    return std::nullopt;
+  }
+
+  // Hold の障害中は明けた時点から送り始める。
+  auto start = outage ? outage_end_ : now;
+  if (profile.bandwidth > 0.0) {
+    start = std::max(start, state.free_at) +
+            from_us(static_cast<double>(bytes) * 1e6 / profile.bandwidth);
+    state.free_at = start;
+  }
+  auto due = start + sample_delay(profile);
+  if (profile.keep_order) {
+    due = std::max(due, state.last_due);
+  }
+  state.last_due = std::max(state.last_due, due);
+
+  const auto delay = to_ms(due - now);
+  stats.delay_ms_total += delay;
+  stats.delay_ms_max = std::max(stats.delay_ms_max, delay);
+  return due;
+}
+
+void FaultInjector::mark_delivered(Direction direction) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_for(direction).delivered;
+}
+
+LinkStats &FaultInjector::stats_for(Direction direction) {
+  return direction == Direction::Uplink ? stats_.uplink : stats_.downlink;
+}
+
+// 障害の予定はメッセージが来たときにまとめて進める (誰も送らない間の障害も数える)。
+void FaultInjector::advance_outages(Clock::time_point now) {
+  if (config_.outage_interval.count() <= 0 ||
+      config_.outage_duration.count() <= 0) {
+    return;
+  }
+  if (!outage_scheduled_) {
+    next_outage_ = now + sample_outage_gap();
+    outage_scheduled_ = true;
+  }
+  while (next_outage_ <= now) {
+    const auto end = next_outage_ + config_.outage_duration;
+    outage_end_ = std::max(outage_end_, end);
+    ++stats_.outages;
+    next_outage_ = end + sample_outage_gap();
+  }
+}
+
+Clock::duration FaultInjector::sample_delay(const LinkProfile &profile) {
+  const auto base = std::chrono::duration_cast<Clock::duration>(profile.latency);
+  const auto jitter = static_cast<double>(profile.jitter.count());
+  if (jitter <= 0.0) {
+    return base;
+  }
+  double extra_us = 0.0;
+  switch (profile.distribution) {
+  case LatencyDistribution::Uniform:
+    extra_us = std::uniform_real_distribution<double>(0.0, jitter)(rng_);
+    break;
+  case LatencyDistribution::Normal:
+    extra_us = std::abs(std::normal_distribution<double>(0.0, jitter)(rng_));
+    break;
+  case LatencyDistribution::Exponential:
+    extra_us = std::exponential_distribution<double>(1.0 / jitter)(rng_);
+    break;
+  }
+  return base + from_us(extra_us);
+}
+
+Clock::duration FaultInjector::sample_outage_gap() {
+  const auto mean_us = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          config_.outage_interval)
+          .count());
+  return from_us(std::exponential_distribution<double>(1.0 / mean_us)(rng_));
+}
+
+FaultyConnection::FaultyConnection(std::unique_ptr<transport::Connection> inner,
+                                   std::shared_ptr<FaultInjector> injector)
+    : inner_(std::move(inner)), injector_(std::move(injector)) {
+  if (!inner_ || !injector_) {
+    throw std::invalid_argument("FaultyConnection requires a connection and an injector");
+  }
+}
+
+FaultyConnection::~FaultyConnection() {
+  close();
+}
+
+void FaultyConnection::open(ReceiveHandler on_message, LogHandler on_log) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pump_.valid() && !stopping_) {
+      return;
+    }
+  }
+  stop_pump();
+  on_message_ = std::move(on_message);
+  on_log_ = on_log;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    pump_thread_ = {};
+  }
+  pump_ = injector_->runtime().executor->spawn([this]() { pump(); });
+  try {
+    inner_->open(
+        [this](const std::string &text) { enqueue(Direction::Downlink, text); },
+        std::move(on_log));
+  } catch (...) {
+    stop_pump();
+    throw;
+  }
+}
+
+void FaultyConnection::close() {
+  inner_->close();
+  stop_pump();
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_ = {};
+  uplink_ = {};
+  downlink_ = {};
+}
+
+bool FaultyConnection::is_open() const {
+  return inner_->is_open();
+}
+
+void FaultyConnection::write(const std::string &text) {
+  if (!inner_->is_open()) {
+    throw std::runtime_error("Connection is closed");
+  }
+  enqueue(Direction::Uplink, text);
+}
+
+void FaultyConnection::enqueue(Direction direction, std::string text) {
+  if (!injector_->active(direction)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 直前まで遅延していた分があれば追い越さないよう列に並べる。
+    if (queue_.empty()) {
+      lock.unlock();
+      if (direction == Direction::Uplink) {
+        inner_->write(text);
+      } else if (on_message_) {
+        on_message_(text);
+      }
+      return;
+    }
+  }
+  auto &state = direction == Direction::Uplink ? uplink_ : downlink_;
+  const auto due = injector_->schedule(direction, text.size(), state);
+  if (!due) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push(Pending{*due, next_order_++, direction, std::move(text)});
+    ++generation_;
+  }
+  cv_.notify_all();
+}
+
+void FaultyConnection::deliver(Pending &item) {
+  if (item.direction == Direction::Uplink) {
+    try {
+      inner_->write(item.text);
+    } catch (const std::exception &ex) {
+      if (on_log_) {
+        on_log_(std::string("Fault injection: delayed write failed: ") +
+                ex.what());
+      }
+      return;
+    }
+  } else if (on_message_) {
+    on_message_(item.text);
+  }
+  injector_->mark_delivered(item.direction);
+}
+
+void FaultyConnection::pump() {
+  const auto &clock = injector_->runtime().clock;
+  std::unique_lock<std::mutex> lock(mutex_);
+  pump_thread_ = std::this_thread::get_id();
+  while (!stopping_) {
+    if (!queue_.empty() && queue_.top().due <= clock->now()) {
+      auto item = std::move(const_cast<Pending &>(queue_.top()));
+      queue_.pop();
+      lock.unlock();
+      deliver(item);
+      lock.lock();
+      continue;
+    }
+    const auto deadline =
+        queue_.empty() ? Clock::time_point::max() : queue_.top().due;
+    const auto seen = generation_;
+    clock->wait_until(lock, cv_, deadline, [this, seen]() {
+      return stopping_ || generation_ != seen;
+    });
+  }
+}
+
+void FaultyConnection::stop_pump() {
+  bool from_pump = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    from_pump = pump_thread_ == std::this_thread::get_id();
+  }
+  cv_.notify_all();
+  // 配送中のハンドラから close された場合は自分を待てないので、終了だけ伝える。
+  if (pump_.valid() && !from_pump) {
+    injector_->runtime().executor->wait(pump_);
+    pump_ = {};
+  }
+}
+
+middleware::ConnectionFactory
+fault_injection_factory(std::shared_ptr<FaultInjector> injector,
+                        middleware::ConnectionFactory inner) {
+  return [injector = std::move(injector), inner = std::move(inner)](
+             const middleware::ServerConfig &config)
+             -> std::unique_ptr<transport::Connection> {
+    std::unique_ptr<transport::Connection> connection;
+    if (inner) {
+      connection = inner(config);
+    } else {
+      connection = std::make_unique<transport::WebSocketConnection>(
+          config.host, config.port, config.endpoint);
+    }
+    return std::make_unique<FaultyConnection>(std::move(connection), injector);
+  };
+}
+
+} // namespace toio::fault
@@ -1,12 +1,16 @@
 #include "toio/cli/config_loader.hpp"
 #include "toio/control/goal_controller.hpp"
+#include "toio/control/latency_calibrator.hpp"
 #include "toio/middleware/fleet_manager.hpp"
+#include "toio/record/session_recorder.hpp"
 
 #include <algorithm>
 #include <cstdint>
 #include <cstdlib>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -107,18 +111,92 @@ void print_status(const std::vector<CubeSnapshot> &snapshots) {
   }
 }
 
+void print_rate_limits(
+    const std::unordered_map<std::string, toio::middleware::RateLimitStats>
+        &stats) {
+  std::cout << std::left << std::setw(15) << "Server" << std::setw(10)
+            << "Sent" << std::setw(10) << "Deferred" << std::setw(10)
+            << "Merged"
+            << "Dropped\n";
+  for (const auto &[server_id, entry] : stats) {
+    std::cout << std::left << std::setw(15) << server_id << std::setw(10)
+              << entry.sent << std::setw(10) << entry.deferred
+              << std::setw(10) << entry.merged << entry.dropped << "\n";
+  }
+}
+
+void print_loop_metrics(const toio::control::LoopMetricsSnapshot &metrics) {
+  std::cout << "Goal loop ticks: " << metrics.ticks << "\n"
+            << std::left << std::setw(20) << "Metric" << std::setw(10)
+            << "Count" << std::setw(10) << "Mean" << std::setw(10) << "p50"
+            << std::setw(10) << "p99"
+            << "Max\n";
+  auto row = [](const char *name,
+                const toio::control::Histogram::Snapshot &histogram) {
+    std::cout << std::left << std::setw(20) << name << std::setw(10)
+              << histogram.count << std::setw(10)
+              << static_cast<long long>(histogram.mean()) << std::setw(10)
+              << histogram.percentile(0.5) << std::setw(10)
+              << histogram.percentile(0.99) << histogram.max << "\n";
+  };
+  row("start_jitter_us", metrics.start_jitter_us);
+  row("state_lookup_us", metrics.state_lookup_us);
+  row("compute_us", metrics.compute_us);
+  row("state_age_ms", metrics.state_age_ms);
+  row("commands_per_tick", metrics.commands_per_tick);
+}
+
+void print_latency_report(const toio::control::LatencyReport &report) {
+  std::cout << std::left << std::setw(15) << "Server" << std::setw(12)
+            << "Cube" << std::setw(8) << "Misses" << std::setw(12)
+            << "motion p50" << std::setw(12) << "motion p99" << std::setw(14)
+            << "observed p50" << std::setw(14) << "observed p99"
+            << "report age p50\n";
+  auto row = [](const toio::control::LatencyGroup &group, const char *label) {
+    std::cout << std::left << std::fixed << std::setprecision(1)
+              << std::setw(15) << (group.server_id.empty() ? label : group.server_id.c_str())
+              << std::setw(12) << (group.cube_id.empty() ? "*" : group.cube_id)
+              << std::setw(8) << group.misses << std::setw(12)
+              << group.motion.p50 << std::setw(12) << group.motion.p99
+              << std::setw(14) << group.observed.p50 << std::setw(14)
+              << group.observed.p99 << group.report_age.p50 << "\n";
+  };
+  for (const auto &group : report.cubes) {
+    row(group, "");
+  }
+  for (const auto &group : report.servers) {
+    row(group, "");
+  }
+  row(report.overall, "(all)");
+  std::cout << "Suggested lookahead_time " << std::setprecision(3)
+            << report.suggested_lookahead_s << " s, lease_margin "
+            << report.suggested_lease_margin.count() << " ms\n"
+            << std::defaultfloat;
+  if (report.overall.motion.count > 0) {
+    std::cout << "  (lease_margin uses relay timestamps and includes the "
+                 "host/relay clock offset; sync both clocks first)\n";
+  }
+}
+
 void print_help() {
   std::cout << "Commands:\n"
             << "  help                      Show this message\n"
             << "  status                    Show latest state snapshot\n"
+            << "  limits                    Show rate limiter counters\n"
+            << "  metrics [reset|dump <path>|dump off]\n"
+            << "                            Goal loop timing histograms\n"
+            << "  calibrate [all] [N] [path] Measure command-to-motion latency\n"
+            << "                            with N step commands (default 10)\n"
             << "  use <cube-id>|<srv:cube>  Switch active cube\n"
             << "  connect                   Connect active cube\n"
             << "  disconnect                Disconnect active cube\n"
             << "  move <L> <R> [require]    Send move (-100..100). "
                "require=0 to skip result\n"
             << "  moveall <L> <R> [require] Broadcast move to all cubes\n"
-            << "  stop                      Shortcut for move 0 0\n"
+            << "  stop                      Shortcut for move 0 0 (priority lane)\n"
+            << "  estop                     Emergency stop all cubes and goals\n"
             << "  goal <X> <Y> [stop]       Drive active cube toward goal (mm)\n"
+            << "  moveto <X> <Y> [A] [spd]  Firmware target move (move_to)\n"
             << "  goalstop [cube]           Stop goal task for active/target cube\n"
             << "  goalstopall               Stop all goal tasks\n"
             << "  led <R> <G> <B>           Set LED color (0-255)\n"
@@ -189,7 +267,17 @@ int main(int argc, char **argv) {
     const Options options = parse_options(argc, argv);
     FleetPlan plan = build_fleet_plan(options);
 
-    FleetManager manager(plan.configs);
+    // manager より先に作り、後に閉じる (索引を書くのはデストラクタ)。
+    std::shared_ptr<toio::record::SessionRecorder> recorder;
+    toio::middleware::ConnectionFactory connect;
+    if (!options.record_path.empty()) {
+      recorder =
+          std::make_shared<toio::record::SessionRecorder>(options.record_path);
+      connect = toio::record::recording_connection_factory(recorder);
+      std::cout << "Recording session to " << options.record_path << std::endl;
+    }
+
+    FleetManager manager(plan.configs, {}, connect);
     manager.set_message_callback(
         [](const std::string &server_id, const Json &json) {
           print_received(server_id, json);
@@ -236,6 +324,49 @@ int main(int argc, char **argv) {
           print_help();
         } else if (cmd == "status") {
           print_status(manager.snapshot());
+        } else if (cmd == "metrics") {
+          if (tokens.size() >= 2 && tokens[1] == "reset") {
+            goal_controller.reset_loop_metrics();
+          } else if (tokens.size() >= 3 && tokens[1] == "dump") {
+            goal_controller.set_loop_metrics_dump(
+                tokens[2] == "off" ? std::string() : tokens[2]);
+          } else {
+            print_loop_metrics(goal_controller.loop_metrics());
+          }
+        } else if (cmd == "calibrate") {
+          std::vector<std::pair<std::string, std::string>> targets;
+          std::size_t next = 1;
+          if (tokens.size() > next && tokens[next] == "all") {
+            targets = plan.cube_sequence;
+            ++next;
+          } else {
+            targets.push_back(active.get());
+          }
+          toio::control::LatencyCalibrationOptions calibration;
+          if (tokens.size() > next) {
+            const int trials = to_int(tokens[next++]);
+            if (trials < 1) {
+              std::cout << "Usage: calibrate [all] [N] [path] (N >= 1)\n";
+              continue;
+            }
+            calibration.trials = static_cast<std::size_t>(trials);
+          }
+          goal_controller.stop_all();
+          std::cout << "Calibrating " << targets.size() << " cube(s) with "
+                    << calibration.trials << " step(s)...\n";
+          const auto report =
+              toio::control::LatencyCalibrator(manager).run(targets, calibration);
+          print_latency_report(report);
+          if (tokens.size() > next) {
+            std::ofstream out(tokens[next]);
+            if (!out) {
+              throw std::runtime_error("Failed to open " + tokens[next]);
+            }
+            out << Json(report).dump(2) << "\n";
+            std::cout << "Report written to " << tokens[next] << "\n";
+          }
+        } else if (cmd == "limits") {
+          print_rate_limits(manager.rate_limit_stats());
         } else if (cmd == "use") {
           if (tokens.size() < 2) {
             std::cout << "Usage: use <cube-id> or use <server>:<cube>\n";
@@ -274,7 +405,18 @@ int main(int argc, char **argv) {
           std::cout << "Broadcast move command to " << success << " cubes.\n";
         } else if (cmd == "stop") {
           auto target = active.get();
-          manager.move(target.first, target.second, 0, 0, false);
+          manager.stop_cube(target.first, target.second);
+        } else if (cmd == "estop" || cmd == "stopall") {
+          goal_controller.cancel_all();
+          const auto report = manager.emergency_stop();
+          goal_controller.stop_all();
+          for (const auto &server : report.servers) {
+            std::cout << "  " << server.server_id << ": "
+                      << (server.sent ? "sent" : "failed (" + server.error + ")")
+                      << " in " << server.latency.count() << " us\n";
+          }
+          std::cout << "Emergency stop for " << report.cubes << " cube(s) in "
+                    << report.total.count() << " us.\n";
         } else if (cmd == "goal" && tokens.size() >= 3) {
           auto target = active.get();
           GoalOptions options;
@@ -288,6 +430,27 @@ int main(int argc, char **argv) {
               target.first, target.second, options);
           std::cout << "Goal task started for " << target.second << " -> ("
                     << options.goal_x << "," << options.goal_y << ")\n";
+        } else if (cmd == "moveto" && tokens.size() >= 3) {
+          auto target = active.get();
+          toio::transport::MoveTarget goal;
+          goal.x = to_int(tokens[1]);
+          goal.y = to_int(tokens[2]);
+          if (tokens.size() >= 4) {
+            goal.angle = to_int(tokens[3]);
+          }
+          int max_speed = 80;
+          if (tokens.size() >= 5) {
+            max_speed = to_int(tokens[4]);
+          }
+          auto request_id = manager.move_to(target.first,
+                                            target.second,
+                                            goal,
+                                            max_speed,
+                                            toio::transport::MoveType::Curve,
+                                            true);
+          if (request_id) {
+            std::cout << "move_to sent (request_id " << *request_id << ")\n";
+          }
         } else if (cmd == "goalstop") {
           std::pair<std::string, std::string> resolved;
           if (tokens.size() >= 2) {
@@ -6,9 +6,13 @@
 
 namespace toio::middleware {
 
-FleetManager::FleetManager() = default;
+FleetManager::FleetManager(runtime::Runtime runtime, ConnectionFactory connect)
+    : runtime_(std::move(runtime)), connect_(std::move(connect)) {}
 
-FleetManager::FleetManager(std::vector<ServerConfig> configs) {
+FleetManager::FleetManager(std::vector<ServerConfig> configs,
+                           runtime::Runtime runtime,
+                           ConnectionFactory connect)
+    : FleetManager(std::move(runtime), std::move(connect)) {
   apply_config(std::move(configs));
 }
 
@@ -23,7 +27,8 @@ void FleetManager::apply_config(std::vector<ServerConfig> configs) {
   stop();
   sessions_.clear();
   for (auto &config : configs) {
-    auto session = std::make_unique<ServerSession>(std::move(config));
+    auto session =
+        std::make_unique<ServerSession>(std::move(config), runtime_, connect_);
     if (state_callback_) {
       session->set_state_callback(state_callback_);
     }
@@ -46,6 +51,10 @@ void FleetManager::stop() {
   }
 }
 
+const runtime::Runtime &FleetManager::runtime() const {
+  return runtime_;
+}
+
 std::vector<std::string> FleetManager::server_ids() const {
   std::vector<std::string> ids;
   ids.reserve(sessions_.size());
@@ -125,6 +134,51 @@ bool FleetManager::move(const std::string &server_id,
   return true;
 }
 
+bool FleetManager::move_for(const std::string &server_id,
+                            const std::string &cube_id,
+                            int left_speed,
+                            int right_speed,
+                            std::chrono::milliseconds duration,
+                            std::optional<bool> require_result) {
+  auto *session = find_session(server_id);
+  if (!session) {
+    return false;
+  }
+  session->send_move_for(
+      cube_id, left_speed, right_speed, duration, require_result);
+  return true;
+}
+
+std::optional<int> FleetManager::move_to(const std::string &server_id,
+                                         const std::string &cube_id,
+                                         const transport::MoveTarget &goal,
+                                         int max_speed,
+                                         transport::MoveType move_type,
+                                         std::optional<bool> require_result) {
+  auto *session = find_session(server_id);
+  if (!session) {
+    return std::nullopt;
+  }
+  return session->send_move_to(
+      cube_id, goal, max_speed, move_type, require_result);
+}
+
+std::optional<int> FleetManager::move_to_multi(
+    const std::string &server_id,
+    const std::string &cube_id,
+    const std::vector<transport::MoveTarget> &goals,
+    int max_speed,
+    transport::MoveType move_type,
+    bool append,
+    std::optional<bool> require_result) {
+  auto *session = find_session(server_id);
+  if (!session) {
+    return std::nullopt;
+  }
+  return session->send_move_to_multi(
+      cube_id, goals, max_speed, move_type, append, require_result);
+}
+
 std::size_t FleetManager::move_all(int left_speed,
                                    int right_speed,
                                    std::optional<bool> require_result) {
@@ -135,6 +189,40 @@ std::size_t FleetManager::move_all(int left_speed,
   });
 }
 
+bool FleetManager::stop_cube(const std::string &server_id,
+                             const std::string &cube_id) {
+  auto *session = find_session(server_id);
+  if (!session) {
+    return false;
+  }
+  session->stop_cube(cube_id);
+  return true;
+}
+
+EmergencyStopReport FleetManager::emergency_stop() {
+  EmergencyStopReport report;
+  const auto started_at = std::chrono::steady_clock::now();
+  auto elapsed = [&started_at]() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started_at);
+  };
+  for (auto &[server_id, session] : sessions_) {
+    StopLatency entry;
+    entry.server_id = server_id;
+    try {
+      session->emergency_stop();
+      entry.sent = true;
+      report.cubes += session->cube_ids().size();
+    } catch (const std::exception &ex) {
+      entry.error = ex.what();
+    }
+    entry.latency = elapsed();
+    report.servers.push_back(std::move(entry));
+  }
+  report.total = elapsed();
+  return report;
+}
+
 bool FleetManager::set_led(const std::string &server_id,
                            const std::string &cube_id,
                            const LedColor &color,
@@ -214,6 +302,25 @@ std::vector<CubeSnapshot> FleetManager::snapshot() const {
   return result;
 }
 
+std::optional<CubeState>
+FleetManager::cube_state(const std::string &server_id,
+                         const std::string &cube_id) const {
+  const auto *session = find_session(server_id);
+  if (!session) {
+    return std::nullopt;
+  }
+  return session->find_state(cube_id);
+}
+
+std::unordered_map<std::string, RateLimitStats>
+FleetManager::rate_limit_stats() const {
+  std::unordered_map<std::string, RateLimitStats> result;
+  for (const auto &[server_id, session] : sessions_) {
+    result.emplace(server_id, session->rate_limit_stats());
+  }
+  return result;
+}
+
 void FleetManager::set_state_callback(ServerSession::StateCallback callback) {
   state_callback_ = std::move(callback);
   for (auto &[_, session] : sessions_) {
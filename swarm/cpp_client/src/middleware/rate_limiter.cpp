@@ -0,0 +1,46 @@
+#include "toio/middleware/rate_limiter.hpp"
+
+#include <algorithm>
+
+namespace toio::middleware {
+
+TokenBucket::TokenBucket(std::chrono::milliseconds interval,
+                         int burst,
+                         Clock::time_point now)
+    : interval_(std::max(interval, std::chrono::milliseconds(1))),
+      capacity_(static_cast<double>(std::max(burst, 1))),
+      tokens_(capacity_),
+      last_refill_(now) {}
+
+bool TokenBucket::try_consume(Clock::time_point now) {
+  refill(now);
+  if (tokens_ < 1.0) {
+    return false;
+  }
+  tokens_ -= 1.0;
+  return true;
+}
+
+TokenBucket::Clock::time_point
+TokenBucket::next_available(Clock::time_point now) {
+  refill(now);
+  if (tokens_ >= 1.0) {
+    return now;
+  }
+  const auto wait = std::chrono::duration_cast<Clock::duration>(
+      interval_ * (1.0 - tokens_));
+  return now + wait + Clock::duration(1);
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now <= last_refill_) {
+    return;
+  }
+  const double earned =
+      std::chrono::duration<double>(now - last_refill_) /
+      std::chrono::duration<double>(interval_);
+  tokens_ = std::min(capacity_, tokens_ + earned);
+  last_refill_ = now;
+}
+
+} // namespace toio::middleware
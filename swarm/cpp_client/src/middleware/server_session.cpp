@@ -1,7 +1,9 @@
 #include "toio/middleware/server_session.hpp"
 
+#include "toio/transport/connection.hpp"
 #include "toio/transport/toio_client.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <stdexcept>
@@ -93,10 +95,15 @@ Position parse_position(const nlohmann::json &position_json) {
 
 } // namespace
 
-ServerSession::ServerSession(ServerConfig config)
+ServerSession::ServerSession(ServerConfig config,
+                             runtime::Runtime runtime,
+                             const ConnectionFactory &connect)
     : config_(std::move(config)),
-      client_(std::make_unique<transport::ToioClient>(
-          config_.host, config_.port, config_.endpoint)) {
+      runtime_(std::move(runtime)),
+      client_(connect ? std::make_unique<transport::ToioClient>(
+                            connect(config_))
+                      : std::make_unique<transport::ToioClient>(
+                            config_.host, config_.port, config_.endpoint)) {
   client_->set_message_handler(
       [this](const nlohmann::json &json) { handle_message(json); });
 
@@ -121,6 +128,13 @@ const std::string &ServerSession::id() const {
 
 void ServerSession::start() {
   client_->connect();
+  if (config_.rate_limit.enabled && !flusher_.valid()) {
+    {
+      std::lock_guard<std::mutex> lock(limiter_mutex_);
+      flusher_stopping_ = false;
+    }
+    flusher_ = runtime_.executor->spawn([this]() { flush_loop(); });
+  }
 
   for (const auto &cube : config_.cubes) {
     if (cube.auto_connect) {
@@ -146,6 +160,7 @@ void ServerSession::start() {
 }
 
 void ServerSession::stop() {
+  stop_flusher();
   if (client_) {
     client_->close();
   }
@@ -169,22 +184,91 @@ void ServerSession::send_move(const std::string &cube_id,
                               int left_speed,
                               int right_speed,
                               std::optional<bool> require_result) {
-  client_->send_move(cube_id,
-                     left_speed,
-                     right_speed,
-                     effective_require(require_result,
-                                       config_.default_require_result));
+  const auto require = effective_require(require_result,
+                                         config_.default_require_result);
+  if (left_speed == 0 && right_speed == 0) {
+    // 停止は優先レーンへ。保留中の move が後から上書きしないよう先に捨てる。
+    discard_pending_motion(cube_id);
+    client_->send_move(cube_id, 0, 0, require);
+    return;
+  }
+  submit_limited(cube_id, Channel::Motion, [this, cube_id, left_speed,
+                                            right_speed, require]() {
+    client_->send_move(cube_id, left_speed, right_speed, require);
+  });
+}
+
+void ServerSession::send_move_for(const std::string &cube_id,
+                                  int left_speed,
+                                  int right_speed,
+                                  std::chrono::milliseconds duration,
+                                  std::optional<bool> require_result) {
+  // 保留してから送るので、範囲外はここで弾く (フラッシャーで投げない)。
+  transport::check_move_duration(duration);
+  const auto require = effective_require(require_result,
+                                         config_.default_require_result);
+  if (left_speed == 0 && right_speed == 0) {
+    // send_move(0, 0) と同じく停止は優先レーンへ。トークンを待たせない。
+    discard_pending_motion(cube_id);
+    client_->send_move_for(cube_id, 0, 0, duration, require);
+    return;
+  }
+  submit_limited(cube_id, Channel::Motion, [this, cube_id, left_speed,
+                                            right_speed, duration,
+                                            require]() {
+    client_->send_move_for(cube_id, left_speed, right_speed, duration,
+                           require);
+  });
+}
+
+int ServerSession::send_move_to(const std::string &cube_id,
+                                const transport::MoveTarget &goal,
+                                int max_speed,
+                                transport::MoveType move_type,
+                                std::optional<bool> require_result) {
+  bypass_limited_motion(cube_id);
+  clear_target_result(cube_id);
+  const int request_id = next_request_id();
+  client_->send_move_to(cube_id,
+                        goal,
+                        max_speed,
+                        move_type,
+                        request_id,
+                        effective_require(require_result,
+                                          config_.default_require_result));
+  return request_id;
+}
+
+int ServerSession::send_move_to_multi(
+    const std::string &cube_id,
+    const std::vector<transport::MoveTarget> &goals,
+    int max_speed,
+    transport::MoveType move_type,
+    bool append,
+    std::optional<bool> require_result) {
+  bypass_limited_motion(cube_id);
+  clear_target_result(cube_id);
+  const int request_id = next_request_id();
+  client_->send_move_to_multi(cube_id,
+                              goals,
+                              max_speed,
+                              move_type,
+                              append,
+                              request_id,
+                              effective_require(
+                                  require_result,
+                                  config_.default_require_result));
+  return request_id;
 }
 
 void ServerSession::set_led(const std::string &cube_id,
                             const LedColor &color,
                             std::optional<bool> require_result) {
-  client_->set_led(cube_id,
-                   color.r,
-                   color.g,
-                   color.b,
-                   effective_require(require_result,
-                                     config_.default_require_result));
+  const auto require = effective_require(require_result,
+                                         config_.default_require_result);
+  submit_limited(cube_id, Channel::Led, [this, cube_id, color, require]() {
+    client_->set_led(cube_id, color.r, color.g, color.b, require);
+  });
   update_state(cube_id, [&](CubeState &state) {
     state.led = color;
   });
@@ -199,6 +283,28 @@ void ServerSession::query_position(const std::string &cube_id,
   client_->query_position(cube_id, notify);
 }
 
+void ServerSession::stop_cube(const std::string &cube_id) {
+  discard_pending_motion(cube_id);
+  client_->send_stop(cube_id, false);
+}
+
+void ServerSession::emergency_stop() {
+  const auto ids = cube_ids();
+  for (const auto &cube_id : ids) {
+    discard_pending_motion(cube_id);
+  }
+  client_->send_stop_all(ids, false);
+}
+
+transport::PriorityStats ServerSession::priority_stats() const {
+  return client_->priority_stats();
+}
+
+RateLimitStats ServerSession::rate_limit_stats() const {
+  std::lock_guard<std::mutex> lock(limiter_mutex_);
+  return limit_stats_;
+}
+
 bool ServerSession::has_cube(const std::string &cube_id) const {
   std::shared_lock lock(state_mutex_);
   return states_.count(cube_id) > 0;
@@ -223,6 +329,16 @@ CubeState ServerSession::get_state(const std::string &cube_id) const {
   return it->second;
 }
 
+std::optional<CubeState>
+ServerSession::find_state(const std::string &cube_id) const {
+  std::shared_lock lock(state_mutex_);
+  auto it = states_.find(cube_id);
+  if (it == states_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
 std::vector<CubeSnapshot> ServerSession::snapshot() const {
   std::vector<CubeSnapshot> result;
   std::shared_lock lock(state_mutex_);
@@ -267,6 +383,19 @@ void ServerSession::handle_message(const nlohmann::json &json) {
   if (type == "result") {
     const std::string cmd = payload.value("cmd", "");
     const std::string status = payload.value("status", "");
+    if (!target.empty() && (cmd == "move_to" || cmd == "move_to_multi")) {
+      TargetResult result;
+      result.request_id = read_int_field(payload, "request_id", -1);
+      result.success = status == "success";
+      if (auto it = payload.find("message");
+          it != payload.end() && it->is_string()) {
+        result.message = it->get<std::string>();
+      }
+      update_state(target, [&result](CubeState &state) {
+        state.target_result = result;
+      });
+      return;
+    }
     if (target.empty() || status != "success") {
       return;
     }
@@ -306,7 +435,7 @@ void ServerSession::update_state(
       state.server_id = config_.id;
     }
     mutator(state);
-    state.last_update = std::chrono::steady_clock::now();
+    state.last_update = runtime_.clock->now();
     snapshot = state;
   }
   if (state_callback_) {
@@ -314,4 +443,167 @@ void ServerSession::update_state(
   }
 }
 
+void ServerSession::submit_limited(const std::string &cube_id,
+                                   Channel channel,
+                                   std::function<void()> send) {
+  if (!config_.rate_limit.enabled) {
+    send();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(limiter_mutex_);
+    auto &limiter = limiter_for(cube_id);
+    auto &pending = channel == Channel::Motion ? limiter.pending_motion
+                                               : limiter.pending_led;
+    if (pending) {
+      // 最新値だけを残す。
+      pending = std::move(send);
+      ++limit_stats_.merged;
+      return;
+    }
+    if (!limiter.bucket.try_consume(runtime_.clock->now())) {
+      pending = std::move(send);
+      flush_requested_ = true;
+      limiter_cv_.notify_one();
+      return;
+    }
+    ++limit_stats_.sent;
+  }
+  send();
+}
+
+void ServerSession::bypass_limited_motion(const std::string &cube_id) {
+  if (!config_.rate_limit.enabled) {
+    return;
+  }
+  discard_pending_motion(cube_id);
+  std::lock_guard<std::mutex> lock(limiter_mutex_);
+  limiter_for(cube_id).bucket.try_consume(runtime_.clock->now());
+}
+
+void ServerSession::discard_pending_motion(const std::string &cube_id) {
+  if (!config_.rate_limit.enabled) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(limiter_mutex_);
+    auto &limiter = limiter_for(cube_id);
+    ++limiter.motion_generation;
+    if (limiter.pending_motion) {
+      limiter.pending_motion = nullptr;
+      ++limit_stats_.dropped;
+    }
+  }
+  // フラッシャーが送信中の move があれば、それが書き込まれるのを待つ。
+  std::lock_guard<std::mutex> flush(flush_mutex_);
+}
+
+ServerSession::CubeLimiter &
+ServerSession::limiter_for(const std::string &cube_id) {
+  auto it = limiters_.find(cube_id);
+  if (it == limiters_.end()) {
+    it = limiters_
+             .emplace(cube_id,
+                      CubeLimiter(config_.rate_limit, runtime_.clock->now()))
+             .first;
+  }
+  return it->second;
+}
+
+void ServerSession::flush_loop() {
+  struct Ready {
+    std::string cube_id;
+    Channel channel;
+    std::uint64_t generation;
+    std::function<void()> send;
+  };
+  std::unique_lock<std::mutex> lock(limiter_mutex_);
+  while (!flusher_stopping_) {
+    const auto now = runtime_.clock->now();
+    std::vector<Ready> ready;
+    std::optional<TokenBucket::Clock::time_point> wake_at;
+    for (auto &[cube_id, limiter] : limiters_) {
+      for (auto channel : {Channel::Motion, Channel::Led}) {
+        auto &pending = channel == Channel::Motion ? limiter.pending_motion
+                                                   : limiter.pending_led;
+        if (!pending) {
+          continue;
+        }
+        if (!limiter.bucket.try_consume(now)) {
+          const auto next = limiter.bucket.next_available(now);
+          wake_at = wake_at ? std::min(*wake_at, next) : next;
+          break;
+        }
+        ready.push_back(
+            Ready{cube_id, channel, limiter.motion_generation,
+                  std::move(pending)});
+        pending = nullptr;
+      }
+    }
+
+    if (ready.empty()) {
+      runtime_.clock->wait_until(
+          lock, limiter_cv_, wake_at.value_or(TokenBucket::Clock::time_point::max()),
+          [this]() { return flusher_stopping_ || flush_requested_; });
+      flush_requested_ = false;
+      continue;
+    }
+
+    lock.unlock();
+    for (auto &item : ready) {
+      std::lock_guard<std::mutex> flush(flush_mutex_);
+      {
+        std::lock_guard<std::mutex> stats_lock(limiter_mutex_);
+        if (item.channel == Channel::Motion &&
+            limiters_.at(item.cube_id).motion_generation != item.generation) {
+          ++limit_stats_.dropped;
+          continue;
+        }
+        ++limit_stats_.deferred;
+      }
+      try {
+        item.send();
+      } catch (const std::exception &ex) {
+        std::cerr << "[ServerSession] rate-limited send error ("
+                  << item.cube_id << "): " << ex.what() << std::endl;
+      }
+    }
+    lock.lock();
+  }
+
+  for (auto &[_, limiter] : limiters_) {
+    for (auto *pending : {&limiter.pending_motion, &limiter.pending_led}) {
+      if (*pending) {
+        *pending = nullptr;
+        ++limit_stats_.dropped;
+      }
+    }
+  }
+}
+
+void ServerSession::stop_flusher() {
+  {
+    std::lock_guard<std::mutex> lock(limiter_mutex_);
+    flusher_stopping_ = true;
+  }
+  limiter_cv_.notify_all();
+  if (flusher_.valid()) {
+    runtime_.executor->wait(flusher_);
+    flusher_ = {};
+  }
+}
+
+void ServerSession::clear_target_result(const std::string &cube_id) {
+  // 状態の更新ではないので last_update も通知も変えない。
+  std::unique_lock lock(state_mutex_);
+  if (auto it = states_.find(cube_id); it != states_.end()) {
+    it->second.target_result.reset();
+  }
+}
+
+int ServerSession::next_request_id() {
+  // toio の request ID は 1 byte。
+  return request_counter_.fetch_add(1) & 0xFF;
+}
+
 } // namespace toio::middleware
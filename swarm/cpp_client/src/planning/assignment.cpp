@@ -0,0 +1,505 @@
+#include "toio/planning/assignment.hpp"
+
+#include "toio/control/spatial_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+
+namespace toio::planning {
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+// MaxDistance で使えない組のコスト。使える組のコストの合計よりずっと大きい。
+constexpr double kForbidden = 1e15;
+// Auction の ε を 1 段ごとにこの比で縮める。
+constexpr double kEpsilonScale = 5.0;
+// 前回の価格から始めるときは、最後の ε のこの倍から縮める。
+constexpr double kWarmStartEpsilon = 25.0;
+// Greedy で 1 台あたりに候補にする近い目標点の数。
+constexpr std::size_t kGreedyCandidates = 8;
+
+double distance_sq(const TargetPoint &a, const TargetPoint &b) {
+  const double dx = a.x - b.x;
+  const double dy = a.y - b.y;
+  return dx * dx + dy * dy;
+}
+
+control::GridBounds bounds_of(std::span<const TargetPoint> a,
+                              std::span<const TargetPoint> b) {
+  control::GridBounds bounds{kInfinity, kInfinity, -kInfinity, -kInfinity};
+  for (const auto points : {a, b}) {
+    for (const auto &point : points) {
+      bounds.min_x = std::min(bounds.min_x, point.x);
+      bounds.min_y = std::min(bounds.min_y, point.y);
+      bounds.max_x = std::max(bounds.max_x, point.x);
+      bounds.max_y = std::max(bounds.max_y, point.y);
+    }
+  }
+  return bounds;
+}
+
+} // namespace
+
+TargetAssigner::TargetAssigner(AssignmentOptions options)
+    : options_(std::move(options)) {}
+
+const AssignmentOptions &TargetAssigner::options() const {
+  return options_;
+}
+
+void TargetAssigner::set_options(const AssignmentOptions &options) {
+  options_ = options;
+}
+
+const Assignment &
+TargetAssigner::assign(std::span<const middleware::Position> agents,
+                       std::span<const TargetPoint> targets) {
+  positions_.resize(agents.size());
+  for (std::size_t i = 0; i < agents.size(); ++i) {
+    positions_[i] = TargetPoint{static_cast<double>(agents[i].x),
+                                static_cast<double>(agents[i].y)};
+  }
+  return assign(std::span<const TargetPoint>(positions_), targets);
+}
+
+const Assignment &TargetAssigner::assign(std::span<const TargetPoint> agents,
+                                         std::span<const TargetPoint> targets) {
+  if (agents.size() > targets.size()) {
+    throw std::invalid_argument(
+        "TargetAssigner needs at least as many targets (" +
+        std::to_string(targets.size()) + ") as agents (" +
+        std::to_string(agents.size()) + ")");
+  }
+  agents_.assign(agents.begin(), agents.end());
+  targets_.assign(targets.begin(), targets.end());
+  result_.target_of.assign(agents.size(), kNone);
+  result_.method = choose(agents.size());
+  result_.iterations = 0;
+  if (agents.empty()) {
+    finish();
+    return result_;
+  }
+
+  double limit_sq = kInfinity;
+  if (options_.objective == AssignmentObjective::MaxDistance &&
+      result_.method != AssignmentMethod::Greedy) {
+    limit_sq = bottleneck_sq();
+  }
+  switch (result_.method) {
+  case AssignmentMethod::Hungarian:
+    solve_hungarian(limit_sq);
+    break;
+  case AssignmentMethod::Auction:
+    solve_auction(limit_sq);
+    break;
+  case AssignmentMethod::Greedy:
+  case AssignmentMethod::Auto:
+  default:
+    solve_greedy();
+    break;
+  }
+  finish();
+  return result_;
+}
+
+void TargetAssigner::reset() {
+  prices_.clear();
+}
+
+AssignmentMethod TargetAssigner::choose(std::size_t agents) const {
+  if (options_.method != AssignmentMethod::Auto) {
+    return options_.method;
+  }
+  if (agents <= options_.hungarian_limit) {
+    return AssignmentMethod::Hungarian;
+  }
+  if (agents <= options_.auction_limit) {
+    return AssignmentMethod::Auction;
+  }
+  return AssignmentMethod::Greedy;
+}
+
+double TargetAssigner::cost(std::size_t agent, std::size_t target) const {
+  const double d2 = distance_sq(agents_[agent], targets_[target]);
+  return options_.objective == AssignmentObjective::TotalDistance
+             ? std::sqrt(d2)
+             : d2;
+}
+
+// 最短増加路の Hungarian (Jonker-Volgenant の形)。行 = Cube、列 = 目標点で、
+// 添字 0 は番兵。
+void TargetAssigner::solve_hungarian(double limit_sq) {
+  const auto n = agents_.size();
+  const auto m = targets_.size();
+  auto edge = [&](std::size_t i, std::size_t j) {
+    if (limit_sq < kInfinity &&
+        distance_sq(agents_[i], targets_[j]) > limit_sq) {
+      return kForbidden;
+    }
+    return cost(i, j);
+  };
+
+  std::vector<double> u(n + 1, 0.0);
+  std::vector<double> v(m + 1, 0.0);
+  std::vector<std::size_t> row_of(m + 1, 0);
+  std::vector<std::size_t> way(m + 1, 0);
+  std::vector<double> min_slack(m + 1);
+  std::vector<char> used(m + 1);
+  for (std::size_t i = 1; i <= n; ++i) {
+    row_of[0] = i;
+    std::size_t column = 0;
+    std::fill(min_slack.begin(), min_slack.end(), kInfinity);
+    std::fill(used.begin(), used.end(), 0);
+    do {
+      used[column] = 1;
+      const auto row = row_of[column];
+      double delta = kInfinity;
+      std::size_t next = 0;
+      for (std::size_t j = 1; j <= m; ++j) {
+        if (used[j]) {
+          continue;
+        }
+        const double slack = edge(row - 1, j - 1) - u[row] - v[j];
+        if (slack < min_slack[j]) {
+          min_slack[j] = slack;
+          way[j] = column;
+        }
+        if (min_slack[j] < delta) {
+          delta = min_slack[j];
+          next = j;
+        }
+      }
+      for (std::size_t j = 0; j <= m; ++j) {
+        if (used[j]) {
+          u[row_of[j]] += delta;
+          v[j] -= delta;
+        } else {
+          min_slack[j] -= delta;
+        }
+      }
+      column = next;
+    } while (row_of[column] != 0);
+    // 見つけた増加路に沿って付け替える。
+    do {
+      const auto previous = way[column];
+      row_of[column] = row_of[previous];
+      column = previous;
+    } while (column != 0);
+    ++result_.iterations;
+  }
+  for (std::size_t j = 1; j <= m; ++j) {
+    if (row_of[j] != 0) {
+      result_.target_of[row_of[j] - 1] = j - 1;
+    }
+  }
+}
+
+// 前向きのオークション (Gauss-Seidel、ε スケーリング)。目標点のほうが多い
+// ときはどこに入ってもコスト 0 のダミーの Cube で正方にする。ε-CS を
+// 満たして全員が決まれば、合計は最適から (台数) * ε 以内。
+void TargetAssigner::solve_auction(double limit_sq) {
+  const auto n = agents_.size();
+  const auto m = targets_.size();
+  auto allowed = [&](std::size_t i, std::size_t j) {
+    return limit_sq == kInfinity ||
+           distance_sq(agents_[i], targets_[j]) <= limit_sq;
+  };
+
+  double max_cost = 0.0;
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = 0; j < m; ++j) {
+      if (allowed(i, j)) {
+        max_cost = std::max(max_cost, cost(i, j));
+      }
+    }
+  }
+  const double final_epsilon =
+      std::max(options_.auction_tolerance * max_cost / static_cast<double>(m),
+               std::numeric_limits<double>::min());
+  double epsilon;
+  if (prices_.size() == m) {
+    epsilon = final_epsilon * kWarmStartEpsilon;
+  } else {
+    prices_.assign(m, 0.0);
+    epsilon = std::max(max_cost / kEpsilonScale, final_epsilon);
+  }
+
+  owner_.resize(m);
+  std::vector<std::size_t> object_of(m);
+  while (true) {
+    std::fill(owner_.begin(), owner_.end(), kNone);
+    std::fill(object_of.begin(), object_of.end(), kNone);
+    queue_.resize(m);
+    for (std::size_t i = 0; i < m; ++i) {
+      queue_[i] = i;
+    }
+    std::size_t head = 0;
+    while (head < queue_.size()) {
+      const auto person = queue_[head++];
+      double best = -kInfinity;
+      double second = -kInfinity;
+      std::size_t best_object = kNone;
+      for (std::size_t j = 0; j < m; ++j) {
+        double value;
+        if (person < n) {
+          if (!allowed(person, j)) {
+            continue;
+          }
+          value = -cost(person, j) - prices_[j];
+        } else {
+          value = -prices_[j];
+        }
+        if (value > best) {
+          second = best;
+          best = value;
+          best_object = j;
+        } else if (value > second) {
+          second = value;
+        }
+      }
+      const double increment =
+          (second == -kInfinity ? max_cost : best - second) + epsilon;
+      prices_[best_object] += increment;
+      const auto previous = owner_[best_object];
+      owner_[best_object] = person;
+      object_of[person] = best_object;
+      if (previous != kNone) {
+        object_of[previous] = kNone;
+        queue_.push_back(previous);
+      }
+      ++result_.iterations;
+      // 先頭側の使い終わった分を詰めて、キューが伸び続けないようにする。
+      if (head > m && head * 2 > queue_.size()) {
+        queue_.erase(queue_.begin(),
+                     queue_.begin() + static_cast<std::ptrdiff_t>(head));
+        head = 0;
+      }
+    }
+    if (epsilon <= final_epsilon) {
+      break;
+    }
+    epsilon = std::max(epsilon / kEpsilonScale, final_epsilon);
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    result_.target_of[i] = object_of[i];
+  }
+}
+
+// 近い組から順に決め、近所どうしで入れ替えると合計が減るなら入れ替える。
+void TargetAssigner::solve_greedy() {
+  const auto n = agents_.size();
+  const auto m = targets_.size();
+  const auto bounds = bounds_of(agents_, targets_);
+  const double area = std::max(1.0, (bounds.max_x - bounds.min_x) *
+                                        (bounds.max_y - bounds.min_y));
+  // 1 セルに目標点が数点入る程度。
+  const double cell = std::max(1.0, 2.0 * std::sqrt(area / static_cast<double>(m)));
+  const double span = std::max(bounds.max_x - bounds.min_x,
+                               bounds.max_y - bounds.min_y) + cell;
+
+  control::SpatialGrid target_grid(cell, bounds);
+  for (std::size_t j = 0; j < m; ++j) {
+    target_grid.update(j, targets_[j].x, targets_[j].y);
+  }
+  target_grid.rebuild();
+  std::vector<std::tuple<double, std::size_t, std::size_t>> candidates;
+  candidates.reserve(n * kGreedyCandidates);
+  std::vector<std::pair<double, std::size_t>> nearby;
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto want = std::min(kGreedyCandidates, m);
+    double radius = cell;
+    do {
+      nearby.clear();
+      target_grid.for_each_within(
+          agents_[i].x, agents_[i].y, radius,
+          [&](const control::SpatialGrid::Item &item) {
+            nearby.emplace_back(cost(i, item.id), item.id);
+          });
+      radius *= 2.0;
+    } while (nearby.size() < want && radius < 2.0 * span);
+    const auto keep = std::min(want, nearby.size());
+    std::partial_sort(nearby.begin(),
+                      nearby.begin() + static_cast<std::ptrdiff_t>(keep),
+                      nearby.end());
+    for (std::size_t k = 0; k < keep; ++k) {
+      candidates.emplace_back(nearby[k].first, i, nearby[k].second);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  auto &target_of = result_.target_of;
+  owner_.assign(m, kNone);
+  for (const auto &[c, i, j] : candidates) {
+    if (target_of[i] == kNone && owner_[j] == kNone) {
+      target_of[i] = j;
+      owner_[j] = i;
+    }
+  }
+  // 候補が全部埋まっていた Cube は、残りの目標点から最も近いものを取る。
+  for (std::size_t i = 0; i < n; ++i) {
+    if (target_of[i] != kNone) {
+      continue;
+    }
+    double best = kInfinity;
+    std::size_t best_target = kNone;
+    for (std::size_t j = 0; j < m; ++j) {
+      if (owner_[j] == kNone && cost(i, j) < best) {
+        best = cost(i, j);
+        best_target = j;
+      }
+    }
+    target_of[i] = best_target;
+    owner_[best_target] = i;
+  }
+
+  control::SpatialGrid agent_grid(cell, bounds);
+  for (std::size_t i = 0; i < n; ++i) {
+    agent_grid.update(i, agents_[i].x, agents_[i].y);
+  }
+  agent_grid.rebuild();
+  for (std::size_t pass = 0; pass < options_.greedy_passes; ++pass) {
+    bool swapped = false;
+    for (std::size_t i = 0; i < n; ++i) {
+      agent_grid.for_each_within(
+          agents_[i].x, agents_[i].y, 2.0 * cell,
+          [&](const control::SpatialGrid::Item &item) {
+            const auto k = item.id;
+            if (k <= i) {
+              return;
+            }
+            const auto ti = target_of[i];
+            const auto tk = target_of[k];
+            const double now = cost(i, ti) + cost(k, tk);
+            const double swap = cost(i, tk) + cost(k, ti);
+            if (swap < now - 1e-9 * (now + 1.0)) {
+              std::swap(target_of[i], target_of[k]);
+              swapped = true;
+              ++result_.iterations;
+            }
+          });
+    }
+    if (!swapped) {
+      break;
+    }
+  }
+}
+
+// 割り当てが存在する最小の距離 (の 2 乗) を、距離の候補の二分探索で求める。
+double TargetAssigner::bottleneck_sq() {
+  const auto n = agents_.size();
+  const auto m = targets_.size();
+  scratch_.clear();
+  scratch_.reserve(n * m);
+  for (std::size_t i = 0; i < n; ++i) {
+    for (std::size_t j = 0; j < m; ++j) {
+      scratch_.push_back(distance_sq(agents_[i], targets_[j]));
+    }
+  }
+  std::sort(scratch_.begin(), scratch_.end());
+  scratch_.erase(std::unique(scratch_.begin(), scratch_.end()), scratch_.end());
+  // 最大の候補なら必ず割り当てられる。
+  std::size_t low = 0;
+  std::size_t high = scratch_.size() - 1;
+  while (low < high) {
+    const auto mid = low + (high - low) / 2;
+    if (has_matching(scratch_[mid])) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return scratch_[low];
+}
+
+// limit_sq 以内の組だけで全 Cube に目標点を割り当てられるか (Hopcroft-Karp)。
+bool TargetAssigner::has_matching(double limit_sq) {
+  const auto n = agents_.size();
+  const auto m = targets_.size();
+  std::vector<std::size_t> match_agent(n, kNone);
+  std::vector<std::size_t> match_target(m, kNone);
+  std::vector<std::size_t> level(n);
+  std::vector<std::size_t> next_target(n);
+  std::vector<std::size_t> bfs;
+  bfs.reserve(n);
+  auto allowed = [&](std::size_t i, std::size_t j) {
+    return distance_sq(agents_[i], targets_[j]) <= limit_sq;
+  };
+
+  auto augment = [&](auto &&self, std::size_t i) -> bool {
+    for (auto &j = next_target[i]; j < m; ++j) {
+      if (!allowed(i, j)) {
+        continue;
+      }
+      const auto other = match_target[j];
+      if (other == kNone ||
+          (level[other] == level[i] + 1 && self(self, other))) {
+        match_agent[i] = j;
+        match_target[j] = i;
+        ++j;
+        return true;
+      }
+    }
+    level[i] = kNone;
+    return false;
+  };
+
+  std::size_t matched = 0;
+  while (true) {
+    bfs.clear();
+    for (std::size_t i = 0; i < n; ++i) {
+      if (match_agent[i] == kNone) {
+        level[i] = 0;
+        bfs.push_back(i);
+      } else {
+        level[i] = kNone;
+      }
+    }
+    bool found = false;
+    for (std::size_t head = 0; head < bfs.size(); ++head) {
+      const auto i = bfs[head];
+      for (std::size_t j = 0; j < m; ++j) {
+        if (!allowed(i, j)) {
+          continue;
+        }
+        const auto other = match_target[j];
+        if (other == kNone) {
+          found = true;
+        } else if (level[other] == kNone) {
+          level[other] = level[i] + 1;
+          bfs.push_back(other);
+        }
+      }
+    }
+    if (!found) {
+      return matched == n;
+    }
+    std::fill(next_target.begin(), next_target.end(), 0);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (match_agent[i] == kNone && augment(augment, i)) {
+        ++matched;
+      }
+    }
+    if (matched == n) {
+      return true;
+    }
+  }
+}
+
+void TargetAssigner::finish() {
+  result_.total_distance = 0.0;
+  result_.max_distance = 0.0;
+  for (std::size_t i = 0; i < result_.target_of.size(); ++i) {
+    const double d =
+        std::sqrt(distance_sq(agents_[i], targets_[result_.target_of[i]]));
+    result_.total_distance += d;
+    result_.max_distance = std::max(result_.max_distance, d);
+  }
+}
+
+} // namespace toio::planning
@@ -0,0 +1,169 @@
+#include "toio/planning/behavior.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace toio::planning {
+
+std::size_t BehaviorRuntime::add(std::unique_ptr<Behavior> behavior) {
+  if (!behavior) {
+    throw std::invalid_argument("BehaviorRuntime::add requires a behavior");
+  }
+  for (const auto &existing : behaviors_) {
+    if (existing->name() == behavior->name()) {
+      throw std::invalid_argument("BehaviorRuntime already has " +
+                                  std::string(behavior->name()));
+    }
+  }
+  behavior->reserve(capacity_);
+  behaviors_.push_back(std::move(behavior));
+  return behaviors_.size() - 1;
+}
+
+std::size_t BehaviorRuntime::size() const {
+  return behaviors_.size();
+}
+
+Behavior &BehaviorRuntime::behavior(std::size_t index) {
+  if (index >= behaviors_.size()) {
+    throw std::out_of_range("BehaviorRuntime has no behavior " +
+                            std::to_string(index));
+  }
+  return *behaviors_[index];
+}
+
+std::size_t BehaviorRuntime::find(std::string_view name) const {
+  for (std::size_t i = 0; i < behaviors_.size(); ++i) {
+    if (behaviors_[i]->name() == name) {
+      return i;
+    }
+  }
+  throw std::out_of_range("BehaviorRuntime has no behavior named " +
+                          std::string(name));
+}
+
+void BehaviorRuntime::reserve(std::size_t count) {
+  capacity_ = std::max(capacity_, count);
+  for (auto &behavior : behaviors_) {
+    behavior->reserve(capacity_);
+  }
+  for (auto *values : {&x_, &y_, &vx_, &vy_, &current_x_, &current_y_,
+                       &previous_x_, &previous_y_}) {
+    values->reserve(capacity_);
+  }
+  targets_.reserve(capacity_);
+}
+
+void BehaviorRuntime::switch_to(std::size_t index, double fade) {
+  if (index >= behaviors_.size()) {
+    throw std::out_of_range("BehaviorRuntime has no behavior " +
+                            std::to_string(index));
+  }
+  if (index == current_) {
+    return;
+  }
+  const std::size_t source =
+      fading() && fade_weight() < 0.5 ? previous_ : current_;
+  current_ = index;
+  needs_enter_ = true;
+  if (fade > 0.0 && source != index) {
+    previous_ = source;
+    fade_elapsed_ = 0.0;
+    fade_duration_ = fade;
+  } else {
+    previous_ = index;
+    fade_duration_ = 0.0;
+  }
+}
+
+std::size_t BehaviorRuntime::current() const {
+  return current_;
+}
+
+bool BehaviorRuntime::fading() const {
+  return previous_ != current_;
+}
+
+double BehaviorRuntime::fade_weight() const {
+  if (!fading() || !(fade_duration_ > 0.0)) {
+    return 1.0;
+  }
+  const double u = std::clamp(fade_elapsed_ / fade_duration_, 0.0, 1.0);
+  return u * u * (3.0 - 2.0 * u);
+}
+
+const std::vector<TargetPoint> &
+BehaviorRuntime::step(std::span<const middleware::Position> positions,
+                      double dt, std::span<const control::Obstacle> obstacles) {
+  if (!(dt > 0.0) || !std::isfinite(dt)) {
+    throw std::invalid_argument("BehaviorRuntime::step requires dt > 0");
+  }
+  if (positions.size() > capacity_) {
+    throw std::invalid_argument(
+        "BehaviorRuntime::step got " + std::to_string(positions.size()) +
+        " cube(s) but reserved " + std::to_string(capacity_));
+  }
+  if (behaviors_.empty()) {
+    throw std::invalid_argument("BehaviorRuntime has no behavior");
+  }
+  const auto count = positions.size();
+  // 台数が変わったら速度は 0 から測り直す。
+  const bool fresh = count != count_ || steps_ == 0;
+  for (auto *values : {&x_, &y_, &vx_, &vy_, &current_x_, &current_y_,
+                       &previous_x_, &previous_y_}) {
+    values->resize(count);
+  }
+  targets_.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const double x = static_cast<double>(positions[i].x);
+    const double y = static_cast<double>(positions[i].y);
+    vx_[i] = fresh ? 0.0 : (x - x_[i]) / dt;
+    vy_[i] = fresh ? 0.0 : (y - y_[i]) / dt;
+    x_[i] = x;
+    y_[i] = y;
+  }
+  count_ = count;
+  ++steps_;
+  time_ += dt;
+
+  BehaviorFrame frame;
+  frame.positions = positions;
+  frame.x = x_;
+  frame.y = y_;
+  frame.vx = vx_;
+  frame.vy = vy_;
+  frame.obstacles = obstacles;
+  frame.time = time_;
+  frame.dt = dt;
+  if (needs_enter_) {
+    behaviors_[current_]->enter(frame);
+    needs_enter_ = false;
+  }
+  behaviors_[current_]->step(frame, current_x_, current_y_);
+  if (fading()) {
+    fade_elapsed_ += dt;
+    behaviors_[previous_]->step(frame, previous_x_, previous_y_);
+    const double w = fade_weight();
+    for (std::size_t i = 0; i < count; ++i) {
+      targets_[i] = {previous_x_[i] + (current_x_[i] - previous_x_[i]) * w,
+                     previous_y_[i] + (current_y_[i] - previous_y_[i]) * w};
+    }
+    if (fade_elapsed_ >= fade_duration_) {
+      previous_ = current_;
+    }
+  } else {
+    for (std::size_t i = 0; i < count; ++i) {
+      targets_[i] = {current_x_[i], current_y_[i]};
+    }
+  }
+  return targets_;
+}
+
+std::uint64_t BehaviorRuntime::steps() const {
+  return steps_;
+}
+
+} // namespace toio::planning
@@ -0,0 +1,278 @@
+#include "toio/planning/choreography.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::planning {
+namespace {
+
+// 表がメモリを食いつぶさないようにする (16 バイト x 64M = 1 GiB)。
+constexpr std::size_t kMaxPoses = 64u << 20;
+
+std::runtime_error load_error(const std::string &path,
+                              const std::string &reason) {
+  return std::runtime_error("Choreography " + path + ": " + reason);
+}
+
+Ease parse_ease(const std::string &name) {
+  if (name == "linear") {
+    return Ease::Linear;
+  }
+  if (name == "step") {
+    return Ease::Step;
+  }
+  if (name == "smooth") {
+    return Ease::Smooth;
+  }
+  throw std::invalid_argument("Choreography unknown ease: " + name);
+}
+
+double eased(Ease ease, double u) {
+  switch (ease) {
+  case Ease::Step:
+    return 0.0;
+  case Ease::Smooth:
+    return u * u * (3.0 - 2.0 * u);
+  case Ease::Linear:
+  default:
+    return u;
+  }
+}
+
+std::uint8_t lerp_channel(std::uint8_t a, std::uint8_t b, double u) {
+  return static_cast<std::uint8_t>(
+      std::lround(static_cast<double>(a) + (static_cast<double>(b) - a) * u));
+}
+
+// a から b へ近い向きに回る。
+double lerp_angle(double a, double b, double u) {
+  double delta = std::fmod(b - a, 360.0);
+  if (delta > 180.0) {
+    delta -= 360.0;
+  } else if (delta < -180.0) {
+    delta += 360.0;
+  }
+  double angle = std::fmod(a + delta * u, 360.0);
+  return angle < 0.0 ? angle + 360.0 : angle;
+}
+
+ChoreographyPose to_pose(const Keyframe &key) {
+  return ChoreographyPose{static_cast<float>(key.x), static_cast<float>(key.y),
+                          static_cast<float>(key.angle), key.led};
+}
+
+ChoreographyPose interpolate(const Keyframe &from, const Keyframe &to,
+                             double t) {
+  const double span = to.t - from.t;
+  if (!(span > 0.0)) {
+    return to_pose(to);
+  }
+  const double u = eased(from.ease, std::clamp((t - from.t) / span, 0.0, 1.0));
+  ChoreographyPose pose;
+  pose.x = static_cast<float>(from.x + (to.x - from.x) * u);
+  pose.y = static_cast<float>(from.y + (to.y - from.y) * u);
+  pose.angle = static_cast<float>(lerp_angle(from.angle, to.angle, u));
+  pose.led = {lerp_channel(from.led.r, to.led.r, u),
+              lerp_channel(from.led.g, to.led.g, u),
+              lerp_channel(from.led.b, to.led.b, u)};
+  return pose;
+}
+
+} // namespace
+
+ChoreographyTable::ChoreographyTable(double frame_rate, std::size_t frames,
+                                     std::size_t tracks,
+                                     std::vector<ChoreographyPose> poses)
+    : frame_rate_(frame_rate), frames_(frames), tracks_(tracks),
+      poses_(std::move(poses)) {
+  if (!(frame_rate > 0.0) || !std::isfinite(frame_rate)) {
+    throw std::invalid_argument("ChoreographyTable frame_rate must be positive");
+  }
+  if (poses_.size() != frames * tracks) {
+    throw std::invalid_argument(
+        "ChoreographyTable expects " + std::to_string(frames * tracks) +
+        " poses, got " + std::to_string(poses_.size()));
+  }
+}
+
+double ChoreographyTable::frame_rate() const {
+  return frame_rate_;
+}
+
+std::size_t ChoreographyTable::frames() const {
+  return frames_;
+}
+
+std::size_t ChoreographyTable::tracks() const {
+  return tracks_;
+}
+
+double ChoreographyTable::duration() const {
+  return frames_ > 1 ? static_cast<double>(frames_ - 1) / frame_rate_ : 0.0;
+}
+
+std::size_t ChoreographyTable::frame_at(double t) const {
+  if (frames_ == 0 || !(t > 0.0)) {
+    return 0;
+  }
+  const double index = std::round(t * frame_rate_);
+  const auto last = static_cast<double>(frames_ - 1);
+  return index >= last ? frames_ - 1 : static_cast<std::size_t>(index);
+}
+
+const ChoreographyPose &ChoreographyTable::pose(std::size_t frame,
+                                                std::size_t track) const {
+  return poses_[frame * tracks_ + track];
+}
+
+const ChoreographyPose *ChoreographyTable::frame(std::size_t frame) const {
+  return poses_.data() + frame * tracks_;
+}
+
+Choreography::Choreography(std::vector<ChoreographyTrack> tracks,
+                           double frame_rate)
+    : tracks_(std::move(tracks)), frame_rate_(frame_rate) {
+  if (!(frame_rate > 0.0) || !std::isfinite(frame_rate)) {
+    throw std::invalid_argument("Choreography frame_rate must be positive");
+  }
+  for (std::size_t i = 0; i < tracks_.size(); ++i) {
+    auto &keyframes = tracks_[i].keyframes;
+    if (keyframes.empty()) {
+      throw std::invalid_argument("Choreography track " + std::to_string(i) +
+                                  " has no keyframes");
+    }
+    for (const auto &key : keyframes) {
+      if (!(key.t >= 0.0) || !std::isfinite(key.t) || !std::isfinite(key.x) ||
+          !std::isfinite(key.y) || !std::isfinite(key.angle)) {
+        throw std::invalid_argument("Choreography track " + std::to_string(i) +
+                                    " has an invalid keyframe");
+      }
+    }
+    std::stable_sort(keyframes.begin(), keyframes.end(),
+                     [](const Keyframe &a, const Keyframe &b) {
+                       return a.t < b.t;
+                     });
+  }
+}
+
+Choreography Choreography::from_json(const nlohmann::json &json) {
+  try {
+    const auto &tracks_json = json.at("tracks");
+    if (!tracks_json.is_array()) {
+      throw std::invalid_argument("Choreography \"tracks\" must be an array");
+    }
+    std::vector<ChoreographyTrack> tracks;
+    tracks.reserve(tracks_json.size());
+    for (const auto &track_json : tracks_json) {
+      ChoreographyTrack track;
+      track.cube = track_json.value("cube", std::string{});
+      const auto &keys = track_json.at("keyframes");
+      if (!keys.is_array()) {
+        throw std::invalid_argument(
+            "Choreography \"keyframes\" must be an array");
+      }
+      track.keyframes.reserve(keys.size());
+      for (const auto &key_json : keys) {
+        Keyframe key;
+        key.t = key_json.at("t").get<double>();
+        key.x = key_json.at("x").get<double>();
+        key.y = key_json.at("y").get<double>();
+        // angle と led は省略したら前のキーフレームのまま。
+        const auto *previous =
+            track.keyframes.empty() ? nullptr : &track.keyframes.back();
+        key.angle = key_json.value("angle", previous ? previous->angle : 0.0);
+        if (key_json.contains("led")) {
+          const auto &led = key_json.at("led");
+          if (!led.is_array() || led.size() != 3) {
+            throw std::invalid_argument("Choreography led must be [r, g, b]");
+          }
+          key.led = {led[0].get<std::uint8_t>(), led[1].get<std::uint8_t>(),
+                     led[2].get<std::uint8_t>()};
+        } else if (previous) {
+          key.led = previous->led;
+        }
+        key.ease = parse_ease(key_json.value("ease", std::string("linear")));
+        track.keyframes.push_back(key);
+      }
+      tracks.push_back(std::move(track));
+    }
+    return Choreography(std::move(tracks), json.value("frame_rate", 50.0));
+  } catch (const nlohmann::json::exception &ex) {
+    throw std::invalid_argument(std::string("Choreography JSON: ") + ex.what());
+  }
+}
+
+Choreography Choreography::load(const std::string &path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw load_error(path, "cannot open");
+  }
+  nlohmann::json json;
+  try {
+    in >> json;
+  } catch (const nlohmann::json::exception &ex) {
+    throw load_error(path, ex.what());
+  }
+  try {
+    return from_json(json);
+  } catch (const std::invalid_argument &ex) {
+    throw load_error(path, ex.what());
+  }
+}
+
+const std::vector<ChoreographyTrack> &Choreography::tracks() const {
+  return tracks_;
+}
+
+double Choreography::frame_rate() const {
+  return frame_rate_;
+}
+
+double Choreography::duration() const {
+  double duration = 0.0;
+  for (const auto &track : tracks_) {
+    duration = std::max(duration, track.keyframes.back().t);
+  }
+  return duration;
+}
+
+ChoreographyTable Choreography::compile() const {
+  const auto frames =
+      static_cast<std::size_t>(std::ceil(duration() * frame_rate_)) + 1;
+  const auto count = tracks_.size();
+  if (count != 0 && frames > kMaxPoses / count) {
+    throw std::invalid_argument("Choreography is too long to compile (" +
+                                std::to_string(frames) + " frames x " +
+                                std::to_string(count) + " tracks)");
+  }
+  std::vector<ChoreographyPose> poses(frames * count);
+  for (std::size_t track = 0; track < count; ++track) {
+    const auto &keys = tracks_[track].keyframes;
+    // 時刻は単調に進むので、いまの区間の先頭だけを覚えておけばよい。
+    std::size_t segment = 0;
+    for (std::size_t frame = 0; frame < frames; ++frame) {
+      const double t = static_cast<double>(frame) / frame_rate_;
+      while (segment + 1 < keys.size() && keys[segment + 1].t <= t) {
+        ++segment;
+      }
+      auto &pose = poses[frame * count + track];
+      if (t <= keys.front().t) {
+        pose = to_pose(keys.front());
+      } else if (segment + 1 >= keys.size()) {
+        pose = to_pose(keys.back());
+      } else {
+        pose = interpolate(keys[segment], keys[segment + 1], t);
+      }
+    }
+  }
+  return ChoreographyTable(frame_rate_, frames, count, std::move(poses));
+}
+
+} // namespace toio::planning
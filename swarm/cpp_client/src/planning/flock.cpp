@@ -0,0 +1,454 @@
+#include "toio/planning/flock.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace toio::planning {
+namespace {
+
+constexpr double kEpsilon = 1e-6;
+constexpr double kMinGridCell = 20.0;
+// グループ番号は groups_ の添字なので、大きな番号で表が膨らまないようにする。
+constexpr Flock::GroupId kMaxGroups = 1024;
+
+double clamp(double value, double min_value, double max_value) {
+  return std::max(min_value, std::min(max_value, value));
+}
+
+double interaction_radius(const FlockParameters &params) {
+  return std::max({params.neighbor_radius, params.separation_radius,
+                   params.group_separation_radius, 0.0});
+}
+
+control::SpatialGrid make_grid(const FlockParameters &params) {
+  control::SpatialGrid::Bounds bounds;
+  bounds.min_x = std::min(params.field_min_x, params.field_max_x);
+  bounds.max_x = std::max(params.field_min_x, params.field_max_x);
+  bounds.min_y = std::min(params.field_min_y, params.field_max_y);
+  bounds.max_y = std::max(params.field_min_y, params.field_max_y);
+  return control::SpatialGrid(
+      std::max(interaction_radius(params), kMinGridCell), bounds);
+}
+
+// 長さが limit を超えていれば limit に縮める。
+void limit_length(double &x, double &y, double limit) {
+  if (limit <= 0.0) {
+    return;
+  }
+  const double length = std::hypot(x, y);
+  if (length > limit) {
+    const double scale = limit / length;
+    x *= scale;
+    y *= scale;
+  }
+}
+
+} // namespace
+
+Flock::Flock(FlockParameters params)
+    : params_(std::move(params)),
+      grid_(make_grid(params_)),
+      rng_(params_.seed),
+      normal_dist_(0.0, 1.0) {
+  ensure_group(0);
+}
+
+const FlockParameters &Flock::parameters() const {
+  return params_;
+}
+
+void Flock::set_parameters(const FlockParameters &params) {
+  const bool rebuild =
+      params.field_min_x != params_.field_min_x ||
+      params.field_min_y != params_.field_min_y ||
+      params.field_max_x != params_.field_max_x ||
+      params.field_max_y != params_.field_max_y ||
+      interaction_radius(params) != interaction_radius(params_);
+  params_ = params;
+  if (rebuild) {
+    rebuild_grid();
+  }
+}
+
+void Flock::resize(std::size_t count) {
+  const auto old_count = group_.size();
+  for (std::size_t i = count; i < old_count; ++i) {
+    --groups_[group_[i]].count;
+  }
+  x_.resize(count);
+  y_.resize(count);
+  vx_.resize(count);
+  vy_.resize(count);
+  group_.resize(count, 0);
+  ax_.resize(count);
+  ay_.resize(count);
+  targets_.resize(count);
+  grid_.reserve(count);
+  if (count > old_count) {
+    groups_[0].count += count - old_count;
+  }
+}
+
+std::size_t Flock::size() const {
+  return group_.size();
+}
+
+void Flock::set_group(std::size_t agent, GroupId group) {
+  if (agent >= group_.size()) {
+    throw std::out_of_range("Flock agent out of range: " +
+                            std::to_string(agent));
+  }
+  ensure_group(group);
+  --groups_[group_[agent]].count;
+  group_[agent] = group;
+  ++groups_[group].count;
+}
+
+Flock::GroupId Flock::group(std::size_t agent) const {
+  if (agent >= group_.size()) {
+    throw std::out_of_range("Flock agent out of range: " +
+                            std::to_string(agent));
+  }
+  return group_[agent];
+}
+
+std::size_t Flock::group_size(GroupId group) const {
+  return group < groups_.size() ? groups_[group].count : 0;
+}
+
+void Flock::set_goal(GroupId group, TargetPoint goal) {
+  ensure_group(group);
+  groups_[group].goal = goal;
+}
+
+void Flock::clear_goal(GroupId group) {
+  if (group < groups_.size()) {
+    groups_[group].goal.reset();
+  }
+}
+
+std::optional<TargetPoint> Flock::goal(GroupId group) const {
+  if (group >= groups_.size()) {
+    return std::nullopt;
+  }
+  return groups_[group].goal;
+}
+
+std::size_t Flock::split(GroupId group, GroupId new_group, double direction) {
+  if (steps_ == 0 || group == new_group || group >= groups_.size()) {
+    return 0;
+  }
+  ensure_group(new_group);
+  std::vector<std::pair<double, std::size_t>> members;
+  members.reserve(groups_[group].count);
+  double cx = 0.0;
+  double cy = 0.0;
+  for (std::size_t i = 0; i < group_.size(); ++i) {
+    if (group_[i] == group) {
+      members.emplace_back(0.0, i);
+      cx += x_[i];
+      cy += y_[i];
+    }
+  }
+  if (members.size() < 2) {
+    return 0;
+  }
+  cx /= static_cast<double>(members.size());
+  cy /= static_cast<double>(members.size());
+  const double ux = std::cos(direction);
+  const double uy = std::sin(direction);
+  for (auto &[projection, i] : members) {
+    projection = (x_[i] - cx) * ux + (y_[i] - cy) * uy;
+  }
+  // 同じ射影なら添字で並べ、分け方を一意にする。
+  std::sort(members.begin(), members.end());
+  const auto moved = members.size() / 2;
+  for (std::size_t k = members.size() - moved; k < members.size(); ++k) {
+    group_[members[k].second] = new_group;
+  }
+  groups_[group].count -= moved;
+  groups_[new_group].count += moved;
+  return moved;
+}
+
+void Flock::merge(GroupId from, GroupId into) {
+  if (from == into || from >= groups_.size()) {
+    return;
+  }
+  ensure_group(into);
+  for (auto &group : group_) {
+    if (group == from) {
+      group = into;
+    }
+  }
+  groups_[into].count += groups_[from].count;
+  groups_[from].count = 0;
+  groups_[from].goal.reset();
+}
+
+void Flock::set_flow(std::shared_ptr<const FlowBlender> flow) {
+  flow_ = std::move(flow);
+}
+
+void Flock::reset(std::uint32_t seed) {
+  params_.seed = seed;
+  rng_.seed(seed);
+  normal_dist_.reset();
+  std::fill(vx_.begin(), vx_.end(), 0.0);
+  std::fill(vy_.begin(), vy_.end(), 0.0);
+  steps_ = 0;
+}
+
+const std::vector<TargetPoint> &
+Flock::step(std::span<const middleware::Position> positions, double dt) {
+  if (!(dt > 0.0) || !std::isfinite(dt)) {
+    throw std::invalid_argument("Flock::step requires dt > 0");
+  }
+  ++steps_;
+  if (positions.size() != size()) {
+    resize(positions.size());
+  }
+  if (positions.empty()) {
+    return targets_;
+  }
+
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    x_[i] = positions[i].x;
+    y_[i] = positions[i].y;
+    grid_.update(i, x_[i], y_[i]);
+  }
+  for (std::size_t id = grid_.size(); id-- > positions.size();) {
+    grid_.remove(id);
+  }
+  grid_.rebuild();
+  update_centroids();
+  if (params_.auto_merge_distance > 0.0) {
+    auto_merge();
+  }
+
+  // 先に全台の加速度を求めてから速度を更新する (添字の順に依らない)。
+  for (std::size_t i = 0; i < size(); ++i) {
+    accumulate(i);
+    if (params_.wander_sigma > 0.0 && !groups_[group_[i]].goal) {
+      ax_[i] += params_.wander_sigma * normal_dist_(rng_);
+      ay_[i] += params_.wander_sigma * normal_dist_(rng_);
+    }
+    limit_length(ax_[i], ay_[i], params_.max_accel);
+  }
+
+  const double lookahead = std::max(0.0, params_.lookahead_time);
+  for (std::size_t i = 0; i < size(); ++i) {
+    vx_[i] += ax_[i] * dt;
+    vy_[i] += ay_[i] * dt;
+    limit_length(vx_[i], vy_[i], params_.max_speed);
+    targets_[i].x = clamp(x_[i] + vx_[i] * lookahead, min_x(), max_x());
+    targets_[i].y = clamp(y_[i] + vy_[i] * lookahead, min_y(), max_y());
+  }
+  return targets_;
+}
+
+std::uint64_t Flock::steps() const {
+  return steps_;
+}
+
+void Flock::ensure_group(GroupId group) {
+  if (group >= kMaxGroups) {
+    throw std::out_of_range("Flock group id too large: " +
+                            std::to_string(group));
+  }
+  if (group >= groups_.size()) {
+    groups_.resize(static_cast<std::size_t>(group) + 1);
+  }
+}
+
+void Flock::rebuild_grid() {
+  grid_ = make_grid(params_);
+  grid_.reserve(size());
+  for (std::size_t i = 0; i < size(); ++i) {
+    grid_.update(i, x_[i], y_[i]);
+  }
+  grid_.rebuild();
+}
+
+void Flock::update_centroids() {
+  for (auto &group : groups_) {
+    group.sum_x = 0.0;
+    group.sum_y = 0.0;
+  }
+  for (std::size_t i = 0; i < size(); ++i) {
+    auto &group = groups_[group_[i]];
+    group.sum_x += x_[i];
+    group.sum_y += y_[i];
+  }
+}
+
+// ゴールのないグループ同士が近づいたらまとめる。グループ数は少ないので総当たり。
+void Flock::auto_merge() {
+  const double limit = params_.auto_merge_distance;
+  bool merged = false;
+  for (GroupId g = 0; g < groups_.size(); ++g) {
+    for (GroupId h = g + 1; h < groups_.size(); ++h) {
+      const auto &a = groups_[g];
+      const auto &b = groups_[h];
+      if (a.count == 0 || b.count == 0 || a.goal || b.goal) {
+        continue;
+      }
+      const double na = static_cast<double>(a.count);
+      const double nb = static_cast<double>(b.count);
+      const double dx = a.sum_x / na - b.sum_x / nb;
+      const double dy = a.sum_y / na - b.sum_y / nb;
+      if (std::hypot(dx, dy) < limit) {
+        merge(h, g);
+        merged = true;
+      }
+    }
+  }
+  if (merged) {
+    update_centroids();
+  }
+}
+
+void Flock::accumulate(std::size_t i) {
+  const double xi = x_[i];
+  const double yi = y_[i];
+  const auto gi = group_[i];
+  const double separation_radius = params_.separation_radius;
+  const double neighbor_radius = params_.neighbor_radius;
+  const double group_radius = params_.group_separation_radius;
+
+  double sep_x = 0.0;
+  double sep_y = 0.0;
+  double group_x = 0.0;
+  double group_y = 0.0;
+  double sum_vx = 0.0;
+  double sum_vy = 0.0;
+  double sum_x = 0.0;
+  double sum_y = 0.0;
+  std::size_t mates = 0;
+
+  grid_.for_each_within(
+      xi, yi, interaction_radius(params_),
+      [&](const control::SpatialGrid::Item &item) {
+        const auto j = item.id;
+        if (j == i) {
+          return;
+        }
+        const double dx = xi - x_[j];
+        const double dy = yi - y_[j];
+        const double dist = std::hypot(dx, dy);
+        if (dist < separation_radius && dist > kEpsilon) {
+          const double weight = 1.0 - dist / separation_radius;
+          sep_x += dx / dist * weight;
+          sep_y += dy / dist * weight;
+        }
+        if (group_[j] == gi) {
+          if (dist < neighbor_radius) {
+            sum_vx += vx_[j];
+            sum_vy += vy_[j];
+            sum_x += x_[j];
+            sum_y += y_[j];
+            ++mates;
+          }
+        } else if (dist < group_radius && dist > kEpsilon) {
+          const double weight = 1.0 - dist / group_radius;
+          group_x += dx / dist * weight;
+          group_y += dy / dist * weight;
+        }
+      });
+
+  double ax = params_.separation_gain * sep_x +
+              params_.group_separation_gain * group_x;
+  double ay = params_.separation_gain * sep_y +
+              params_.group_separation_gain * group_y;
+  if (mates > 0) {
+    const double n = static_cast<double>(mates);
+    ax += params_.alignment_gain * (sum_vx / n - vx_[i]) +
+          params_.cohesion_gain * (sum_x / n - xi);
+    ay += params_.alignment_gain * (sum_vy / n - vy_[i]) +
+          params_.cohesion_gain * (sum_y / n - yi);
+  }
+
+  // ゴールへはグループの重心から向かう。全員が同じ速度を目指すので、
+  // 1 点に押し込まれずに形を保ったまま移動する。
+  const auto &group = groups_[gi];
+  if (group.goal && group.count > 0) {
+    const double n = static_cast<double>(group.count);
+    const double gx = group.goal->x - group.sum_x / n;
+    const double gy = group.goal->y - group.sum_y / n;
+    const double dist = std::hypot(gx, gy);
+    double desired_x = 0.0;
+    double desired_y = 0.0;
+    if (dist > kEpsilon) {
+      double speed = params_.cruise_speed;
+      if (params_.arrival_radius > 0.0) {
+        speed *= std::min(1.0, dist / params_.arrival_radius);
+      }
+      desired_x = gx / dist * speed;
+      desired_y = gy / dist * speed;
+    }
+    ax += params_.goal_gain * (desired_x - vx_[i]);
+    ay += params_.goal_gain * (desired_y - vy_[i]);
+  }
+  if (flow_) {
+    const auto flow = flow_->sample(xi, yi);
+    ax += params_.flow_gain * (flow.x - vx_[i]);
+    ay += params_.flow_gain * (flow.y - vy_[i]);
+  }
+
+  ax_[i] = ax;
+  ay_[i] = ay;
+  add_boundary(i);
+}
+
+void Flock::add_boundary(std::size_t i) {
+  const double margin = params_.boundary_margin;
+  const double gain = params_.boundary_gain;
+  if (margin <= 0.0 || gain <= 0.0) {
+    return;
+  }
+  const double left = x_[i] - min_x();
+  const double right = max_x() - x_[i];
+  const double top = y_[i] - min_y();
+  const double bottom = max_y() - y_[i];
+  if (left < margin) {
+    ax_[i] += gain * (1.0 - std::max(left, 0.0) / margin);
+  }
+  if (right < margin) {
+    ax_[i] -= gain * (1.0 - std::max(right, 0.0) / margin);
+  }
+  if (top < margin) {
+    ay_[i] += gain * (1.0 - std::max(top, 0.0) / margin);
+  }
+  if (bottom < margin) {
+    ay_[i] -= gain * (1.0 - std::max(bottom, 0.0) / margin);
+  }
+}
+
+double Flock::min_x() const {
+  const double left = params_.field_min_x + params_.safety_margin;
+  const double right = params_.field_max_x - params_.safety_margin;
+  return std::min(left, right);
+}
+
+double Flock::max_x() const {
+  const double left = params_.field_min_x + params_.safety_margin;
+  const double right = params_.field_max_x - params_.safety_margin;
+  return std::max(left, right);
+}
+
+double Flock::min_y() const {
+  const double top = params_.field_min_y + params_.safety_margin;
+  const double bottom = params_.field_max_y - params_.safety_margin;
+  return std::min(top, bottom);
+}
+
+double Flock::max_y() const {
+  const double top = params_.field_min_y + params_.safety_margin;
+  const double bottom = params_.field_max_y - params_.safety_margin;
+  return std::max(top, bottom);
+}
+
+} // namespace toio::planning
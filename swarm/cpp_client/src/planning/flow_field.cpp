@@ -0,0 +1,376 @@
+#include "toio/planning/flow_field.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::planning {
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kEpsilon = 1e-9;
+// 格子が細かすぎてメモリを食いつぶさないようにする。
+constexpr std::size_t kMaxPoints = 4u << 20;
+
+void check_bounds(const control::GridBounds &bounds) {
+  if (!(bounds.max_x > bounds.min_x) || !(bounds.max_y > bounds.min_y)) {
+    throw std::invalid_argument("FlowField bounds must not be empty");
+  }
+}
+
+std::size_t points_along(double length, double cell_size) {
+  if (!(length > 0.0)) {
+    // 空の範囲はコンストラクタの check_bounds で弾く。
+    return 2;
+  }
+  if (!(cell_size > 0.0) || !std::isfinite(cell_size)) {
+    throw std::invalid_argument("FlowField cell_size must be positive");
+  }
+  return std::max<std::size_t>(
+      2, static_cast<std::size_t>(std::ceil(length / cell_size)) + 1);
+}
+
+std::runtime_error load_error(const std::string &path,
+                              const std::string &reason) {
+  return std::runtime_error("FlowField " + path + ": " + reason);
+}
+
+// "P6 <w> <h> <maxval>" のヘッダ。# からの行はコメント。
+std::size_t read_ppm_number(std::istream &in, const std::string &path) {
+  in >> std::ws;
+  while (in.peek() == '#') {
+    std::string comment;
+    std::getline(in, comment);
+    in >> std::ws;
+  }
+  std::size_t value = 0;
+  if (!(in >> value)) {
+    throw load_error(path, "broken PPM header");
+  }
+  return value;
+}
+
+FlowField load_ppm(const std::string &path, double scale,
+                   control::GridBounds bounds) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw load_error(path, "cannot open");
+  }
+  std::string magic;
+  in >> magic;
+  if (magic != "P6") {
+    throw load_error(path, "only binary PPM (P6) is supported");
+  }
+  const auto width = read_ppm_number(in, path);
+  const auto height = read_ppm_number(in, path);
+  const auto max_value = read_ppm_number(in, path);
+  if (width < 2 || height < 2 || max_value != 255 ||
+      width * height > kMaxPoints) {
+    throw load_error(path, "PPM must be at least 2x2 with maxval 255");
+  }
+  in.get();
+  std::vector<unsigned char> pixels(width * height * 3);
+  if (!in.read(reinterpret_cast<char *>(pixels.data()),
+               static_cast<std::streamsize>(pixels.size()))) {
+    throw load_error(path, "truncated PPM");
+  }
+  // 128 を 0 とし、0 / 255 を -scale / scale に合わせる。
+  auto channel = [scale](unsigned char value) {
+    return std::clamp((static_cast<double>(value) - 128.0) / 127.0, -1.0,
+                      1.0) *
+           scale;
+  };
+  std::vector<Vec2> vectors(width * height);
+  for (std::size_t i = 0; i < vectors.size(); ++i) {
+    vectors[i] = Vec2{channel(pixels[i * 3]), channel(pixels[i * 3 + 1])};
+  }
+  return FlowField(bounds, width, height, std::move(vectors));
+}
+
+} // namespace
+
+FlowField::FlowField(control::GridBounds bounds, double cell_size)
+    : FlowField(bounds,
+                points_along(bounds.max_x - bounds.min_x, cell_size),
+                points_along(bounds.max_y - bounds.min_y, cell_size), {}) {}
+
+FlowField::FlowField(control::GridBounds bounds, std::size_t columns,
+                     std::size_t rows, std::vector<Vec2> vectors)
+    : bounds_(bounds), columns_(columns), rows_(rows),
+      vectors_(std::move(vectors)) {
+  check_bounds(bounds_);
+  if (columns_ < 2 || rows_ < 2 || columns_ * rows_ > kMaxPoints) {
+    throw std::invalid_argument("FlowField needs 2x2 to 4M grid points");
+  }
+  if (vectors_.empty()) {
+    vectors_.resize(columns_ * rows_);
+  } else if (vectors_.size() != columns_ * rows_) {
+    throw std::invalid_argument("FlowField vectors must be columns * rows");
+  }
+  inv_step_x_ =
+      static_cast<double>(columns_ - 1) / (bounds_.max_x - bounds_.min_x);
+  inv_step_y_ =
+      static_cast<double>(rows_ - 1) / (bounds_.max_y - bounds_.min_y);
+}
+
+FlowField FlowField::bake(const Function &fn, control::GridBounds bounds,
+                          double cell_size) {
+  if (!fn) {
+    throw std::invalid_argument("FlowField::bake requires a function");
+  }
+  FlowField field(bounds, cell_size);
+  const double step_x = 1.0 / field.inv_step_x_;
+  const double step_y = 1.0 / field.inv_step_y_;
+  for (std::size_t r = 0; r < field.rows_; ++r) {
+    const double y = bounds.min_y + step_y * static_cast<double>(r);
+    for (std::size_t c = 0; c < field.columns_; ++c) {
+      const double x = bounds.min_x + step_x * static_cast<double>(c);
+      field.at(c, r) = fn(x, y);
+    }
+  }
+  return field;
+}
+
+FlowField FlowField::from_json(const nlohmann::json &json) {
+  try {
+    control::GridBounds bounds;
+    if (json.contains("bounds")) {
+      const auto &b = json.at("bounds");
+      bounds.min_x = b.at("min_x").get<double>();
+      bounds.min_y = b.at("min_y").get<double>();
+      bounds.max_x = b.at("max_x").get<double>();
+      bounds.max_y = b.at("max_y").get<double>();
+    }
+    const auto columns = json.at("columns").get<std::size_t>();
+    const auto rows = json.at("rows").get<std::size_t>();
+    const double scale = json.value("scale", 1.0);
+    const auto &values = json.at("vectors");
+    if (!values.is_array()) {
+      throw std::invalid_argument("FlowField \"vectors\" must be an array");
+    }
+    std::vector<Vec2> vectors;
+    vectors.reserve(values.size());
+    for (const auto &value : values) {
+      if (!value.is_array() || value.size() != 2) {
+        throw std::invalid_argument("FlowField vector must be [vx, vy]");
+      }
+      vectors.push_back(
+          Vec2{value[0].get<double>() * scale, value[1].get<double>() * scale});
+    }
+    if (vectors.empty()) {
+      throw std::invalid_argument("FlowField \"vectors\" is empty");
+    }
+    return FlowField(bounds, columns, rows, std::move(vectors));
+  } catch (const nlohmann::json::exception &ex) {
+    throw std::invalid_argument(std::string("FlowField JSON: ") + ex.what());
+  }
+}
+
+FlowField FlowField::load(const std::string &path, double scale,
+                          control::GridBounds bounds) {
+  const auto dot = path.rfind('.');
+  const auto extension = dot == std::string::npos ? "" : path.substr(dot);
+  if (extension == ".ppm") {
+    return load_ppm(path, scale, bounds);
+  }
+  if (extension != ".json") {
+    throw load_error(path, "unknown extension (use .json or .ppm)");
+  }
+  std::ifstream in(path);
+  if (!in) {
+    throw load_error(path, "cannot open");
+  }
+  nlohmann::json json;
+  try {
+    in >> json;
+  } catch (const nlohmann::json::exception &ex) {
+    throw load_error(path, ex.what());
+  }
+  try {
+    return from_json(json);
+  } catch (const std::invalid_argument &ex) {
+    throw load_error(path, ex.what());
+  }
+}
+
+const control::GridBounds &FlowField::bounds() const {
+  return bounds_;
+}
+
+std::size_t FlowField::columns() const {
+  return columns_;
+}
+
+std::size_t FlowField::rows() const {
+  return rows_;
+}
+
+const Vec2 &FlowField::at(std::size_t column, std::size_t row) const {
+  return vectors_[row * columns_ + column];
+}
+
+Vec2 &FlowField::at(std::size_t column, std::size_t row) {
+  return vectors_[row * columns_ + column];
+}
+
+Vec2 FlowField::sample(double x, double y) const {
+  const double max_column = static_cast<double>(columns_ - 1);
+  const double max_row = static_cast<double>(rows_ - 1);
+  const double fx =
+      std::clamp((x - bounds_.min_x) * inv_step_x_, 0.0, max_column);
+  const double fy = std::clamp((y - bounds_.min_y) * inv_step_y_, 0.0, max_row);
+  // 右端・下端の点は 1 つ手前のセルの端として補間する。
+  const auto c = std::min(static_cast<std::size_t>(fx), columns_ - 2);
+  const auto r = std::min(static_cast<std::size_t>(fy), rows_ - 2);
+  const double tx = fx - static_cast<double>(c);
+  const double ty = fy - static_cast<double>(r);
+  const auto *top = &vectors_[r * columns_ + c];
+  const auto *bottom = top + columns_;
+  const double top_x = top[0].x + (top[1].x - top[0].x) * tx;
+  const double top_y = top[0].y + (top[1].y - top[0].y) * tx;
+  const double bottom_x = bottom[0].x + (bottom[1].x - bottom[0].x) * tx;
+  const double bottom_y = bottom[0].y + (bottom[1].y - bottom[0].y) * tx;
+  return Vec2{top_x + (bottom_x - top_x) * ty, top_y + (bottom_y - top_y) * ty};
+}
+
+std::size_t FlowBlender::add(std::shared_ptr<const FlowField> field) {
+  if (!field) {
+    throw std::invalid_argument("FlowBlender::add requires a field");
+  }
+  Layer layer;
+  layer.field = std::move(field);
+  layer.weight = layers_.empty() ? 1.0 : 0.0;
+  layers_.push_back(std::move(layer));
+  return layers_.size() - 1;
+}
+
+std::size_t FlowBlender::size() const {
+  return layers_.size();
+}
+
+void FlowBlender::set_weight(std::size_t index, double weight) {
+  check(index);
+  if (!std::isfinite(weight)) {
+    throw std::invalid_argument("FlowBlender weight must be finite");
+  }
+  fade_duration_ = 0.0;
+  layers_[index].weight = weight;
+}
+
+double FlowBlender::weight(std::size_t index) const {
+  check(index);
+  return layers_[index].weight;
+}
+
+void FlowBlender::crossfade(std::size_t index, double duration) {
+  check(index);
+  for (std::size_t i = 0; i < layers_.size(); ++i) {
+    auto &layer = layers_[i];
+    layer.from = layer.weight;
+    layer.to = i == index ? 1.0 : 0.0;
+  }
+  fade_elapsed_ = 0.0;
+  fade_duration_ = duration > 0.0 ? duration : 0.0;
+  if (fade_duration_ == 0.0) {
+    for (auto &layer : layers_) {
+      layer.weight = layer.to;
+    }
+  }
+}
+
+bool FlowBlender::fading() const {
+  return fade_duration_ > 0.0;
+}
+
+void FlowBlender::advance(double dt) {
+  if (!fading() || !(dt > 0.0)) {
+    return;
+  }
+  fade_elapsed_ = std::min(fade_elapsed_ + dt, fade_duration_);
+  const double t = fade_elapsed_ / fade_duration_;
+  for (auto &layer : layers_) {
+    layer.weight = layer.from + (layer.to - layer.from) * t;
+  }
+  if (fade_elapsed_ >= fade_duration_) {
+    fade_duration_ = 0.0;
+  }
+}
+
+Vec2 FlowBlender::sample(double x, double y) const {
+  Vec2 sum;
+  for (const auto &layer : layers_) {
+    if (layer.weight == 0.0) {
+      continue;
+    }
+    const auto value = layer.field->sample(x, y);
+    sum.x += layer.weight * value.x;
+    sum.y += layer.weight * value.y;
+  }
+  return sum;
+}
+
+void FlowBlender::check(std::size_t index) const {
+  if (index >= layers_.size()) {
+    throw std::out_of_range("FlowBlender layer " + std::to_string(index) +
+                            " does not exist");
+  }
+}
+
+namespace flow {
+
+FlowField::Function uniform(Vec2 velocity) {
+  return [velocity](double, double) { return velocity; };
+}
+
+FlowField::Function vortex(Vec2 center, double speed, double radius) {
+  const double r0 = std::max(radius, kEpsilon);
+  return [center, speed, r0](double x, double y) {
+    const double dx = x - center.x;
+    const double dy = y - center.y;
+    const double dist = std::hypot(dx, dy);
+    if (dist < kEpsilon) {
+      return Vec2{};
+    }
+    // r0 で 1 になり、中心と遠方で 0 に近づく。
+    const double ratio = dist / r0;
+    const double magnitude = speed * 2.0 * ratio / (1.0 + ratio * ratio);
+    // 接線方向 (-dy, dx)。y 下向きなので画面上は時計回り。
+    return Vec2{-dy / dist * magnitude, dx / dist * magnitude};
+  };
+}
+
+FlowField::Function attractor(Vec2 center, double speed, double radius) {
+  const double r0 = std::max(radius, kEpsilon);
+  return [center, speed, r0](double x, double y) {
+    const double dx = center.x - x;
+    const double dy = center.y - y;
+    const double dist = std::hypot(dx, dy);
+    if (dist < kEpsilon) {
+      return Vec2{};
+    }
+    const double magnitude = speed * std::min(1.0, dist / r0);
+    return Vec2{dx / dist * magnitude, dy / dist * magnitude};
+  };
+}
+
+FlowField::Function wave(double direction, double speed, double amplitude,
+                         double wavelength) {
+  const double ux = std::cos(direction);
+  const double uy = std::sin(direction);
+  const double k = 2.0 * kPi / std::max(wavelength, kEpsilon);
+  return [ux, uy, speed, amplitude, k](double x, double y) {
+    // 進む向きに沿った位置で横揺れの位相が変わる。
+    const double along = x * ux + y * uy;
+    const double sway = amplitude * std::sin(k * along);
+    return Vec2{ux * speed - uy * sway, uy * speed + ux * sway};
+  };
+}
+
+} // namespace flow
+
+} // namespace toio::planning
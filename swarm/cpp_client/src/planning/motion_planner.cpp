@@ -0,0 +1,582 @@
+#include "toio/planning/motion_planner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace toio::planning {
+namespace {
+
+constexpr double kEpsilon = 1e-6;
+// 半径が 0 に近いときにセルが細かくなりすぎないようにする。
+constexpr double kMinGridCell = 20.0;
+// 障害物の縁に食い込んだときの反発の上限を決める距離。
+constexpr double kMinObstacleGap = 5.0;
+// ThreadPool に渡す 1 チャンクの台数。
+constexpr std::size_t kAgentsPerChunk = 64;
+// reserve で Cube の後ろに空けておく障害物 (人など) の数。
+constexpr std::size_t kReservedObstacles = 16;
+
+double clamp(double value, double min_value, double max_value) {
+  return std::max(min_value, std::min(max_value, value));
+}
+
+OrcaParameters orca_parameters(const MotionPlannerParameters &params) {
+  auto orca = params.orca;
+  orca.max_speed = params.max_speed;
+  return orca;
+}
+
+control::SpatialGrid::Bounds
+field_bounds(const MotionPlannerParameters &params) {
+  control::SpatialGrid::Bounds bounds;
+  bounds.min_x = std::min(params.field_min_x, params.field_max_x);
+  bounds.max_x = std::max(params.field_min_x, params.field_max_x);
+  bounds.min_y = std::min(params.field_min_y, params.field_max_y);
+  bounds.max_y = std::max(params.field_min_y, params.field_max_y);
+  return bounds;
+}
+
+} // namespace
+
+MotionPlanner::MotionPlanner(MotionPlannerParameters params)
+    : params_(std::move(params)),
+      grid_(std::max({repulsion_distance(), params_.collision_stop_distance,
+                      kMinGridCell}),
+            field_bounds(params_)),
+      pool_(params_.threads != 1
+                ? std::make_shared<runtime::ThreadPool>(params_.threads)
+                : nullptr),
+      orca_(orca_parameters(params_), field_bounds(params_), pool_),
+      rng_(params_.seed),
+      normal_dist_(0.0, 1.0) {
+  neighbors_.resize(pool_ ? pool_->size() : 1);
+}
+
+const MotionPlannerParameters &MotionPlanner::parameters() const {
+  return params_;
+}
+
+void MotionPlanner::reset(std::uint32_t seed) {
+  params_.seed = seed;
+  rng_.seed(seed);
+  // normal_distribution は 2 つ目の値を持ち越すので、それも捨てる。
+  normal_dist_.reset();
+  std::fill(robot_states_.begin(), robot_states_.end(), RobotState{});
+  steps_ = 0;
+}
+
+void MotionPlanner::reserve(std::size_t count) {
+  robot_states_.reserve(count);
+  noise_.reserve(count * 2);
+  accel_x_.reserve(count);
+  accel_y_.reserve(count);
+  scales_.reserve(count);
+  targets_.reserve(count);
+  orca_agents_.reserve(count);
+  // グリッドの id と近傍の一覧には障害物の分も空けておく。
+  const auto ids = count + kReservedObstacles;
+  grid_.reserve(ids);
+  for (auto &neighbors : neighbors_) {
+    neighbors.reserve(ids);
+  }
+  orca_.reserve(ids);
+}
+
+std::vector<TargetPoint>
+MotionPlanner::initial_targets(std::size_t cube_count) const {
+  std::vector<TargetPoint> targets;
+  if (cube_count == 0) {
+    return targets;
+  }
+  targets.reserve(cube_count);
+  const double span_x = std::max(1.0, max_x() - min_x());
+  const double mid_y = (min_y() + max_y()) * 0.5;
+  for (std::size_t i = 0; i < cube_count; ++i) {
+    const double ratio = (static_cast<double>(i) + 0.5) /
+                         static_cast<double>(cube_count);
+    TargetPoint point;
+    point.x = min_x() + span_x * ratio;
+    point.y = mid_y;
+    targets.push_back(point);
+  }
+  return targets;
+}
+
+void MotionPlanner::set_flow(std::shared_ptr<const FlowBlender> flow) {
+  flow_ = std::move(flow);
+}
+
+const std::vector<TargetPoint> &
+MotionPlanner::step(std::span<const middleware::Position> positions,
+                    double dt, std::span<const control::Obstacle> obstacles) {
+  if (!(dt > 0.0) || !std::isfinite(dt)) {
+    throw std::invalid_argument("MotionPlanner::step requires dt > 0");
+  }
+  ++steps_;
+  resize(positions.size());
+  if (positions.empty()) {
+    return targets_;
+  }
+  update_grid(positions, obstacles);
+  // 乱数は添字順に引いておく。残りは Cube ごとに決まった順で足すので、
+  // 1 スレッドでも分けても同じ値になる。
+  draw_noise(positions.size());
+  if (pool_) {
+    pool_->parallel_for(
+        positions.size(), kAgentsPerChunk,
+        [&](std::size_t begin, std::size_t end, std::size_t worker) {
+          for (std::size_t i = begin; i < end; ++i) {
+            step_agent(i, positions, obstacles, dt, neighbors_[worker]);
+          }
+        });
+  } else {
+    step_serial(positions, obstacles, dt);
+  }
+
+  if (params_.avoidance == Avoidance::Orca) {
+    apply_orca(positions, obstacles, dt);
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+      targets_[i] = make_target(positions[i], robot_states_[i]);
+    }
+  }
+  return targets_;
+}
+
+std::uint64_t MotionPlanner::steps() const {
+  return steps_;
+}
+
+void MotionPlanner::resize(std::size_t count) {
+  robot_states_.resize(count);
+  noise_.resize(count * 2);
+  accel_x_.resize(count);
+  accel_y_.resize(count);
+  scales_.resize(count);
+  targets_.resize(count);
+  if (params_.avoidance == Avoidance::Orca) {
+    orca_agents_.resize(count);
+  }
+}
+
+// 毎 step 全台の位置を入れ直す。セルをまたがなければ座標の書き換えだけで済む。
+void MotionPlanner::update_grid(
+    std::span<const middleware::Position> positions,
+    std::span<const control::Obstacle> obstacles) {
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    grid_.update(i, positions[i].x, positions[i].y);
+  }
+  obstacle_reach_ = 0.0;
+  for (std::size_t k = 0; k < obstacles.size(); ++k) {
+    grid_.update(positions.size() + k, obstacles[k].x, obstacles[k].y);
+    obstacle_reach_ = std::max(obstacle_reach_, obstacles[k].radius);
+  }
+  const auto used = positions.size() + obstacles.size();
+  for (std::size_t id = grid_.size(); id-- > used;) {
+    grid_.remove(id);
+  }
+  grid_.rebuild();
+}
+
+void MotionPlanner::draw_noise(std::size_t count) {
+  for (std::size_t i = 0; i < count * 2; ++i) {
+    noise_[i] = normal_dist_(rng_);
+  }
+}
+
+// 反発とブレーキは組ごとに 1 度だけ計算して両側に足す。Cube ごとに見ると、
+// 添字の小さい相手から順に足されることになる (step_agent と同じ順)。
+void MotionPlanner::step_serial(std::span<const middleware::Position> positions,
+                                std::span<const control::Obstacle> obstacles,
+                                double dt) {
+  const auto count = positions.size();
+  auto &neighbors = neighbors_.front();
+  for (std::size_t i = 0; i < count; ++i) {
+    start_agent(i, positions, dt);
+  }
+
+  std::fill(accel_x_.begin(), accel_x_.end(), 0.0);
+  std::fill(accel_y_.begin(), accel_y_.end(), 0.0);
+  const double safe_distance = repulsion_distance();
+  if (params_.repulsion_gain > 0.0 && safe_distance > 0.0) {
+    for (std::size_t i = 0; i < count; ++i) {
+      // 障害物の id は Cube より後ろなので、Cube の後にまとめて足される。
+      neighbors.clear();
+      grid_.for_each_within(
+          positions[i].x, positions[i].y, safe_distance + obstacle_reach_,
+          [&neighbors, i](const control::SpatialGrid::Item &item) {
+            if (item.id > i) {
+              neighbors.push_back(item.id);
+            }
+          });
+      std::sort(neighbors.begin(), neighbors.end());
+      Vec2 force;
+      for (const auto j : neighbors) {
+        if (j >= count) {
+          if (obstacle_force(positions[i], obstacles[j - count], force)) {
+            accel_x_[i] += force.x;
+            accel_y_[i] += force.y;
+          }
+        } else if (pair_force(positions[i], positions[j], force)) {
+          accel_x_[i] += force.x;
+          accel_y_[i] += force.y;
+          accel_x_[j] -= force.x;
+          accel_y_[j] -= force.y;
+        }
+      }
+    }
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    Vec2 accel{accel_x_[i], accel_y_[i]};
+    add_boundary_force(positions[i], accel);
+    integrate(robot_states_[i], accel, dt);
+  }
+
+  if (params_.avoidance == Avoidance::Orca) {
+    return;
+  }
+  const double stop_distance = params_.collision_stop_distance;
+  if (stop_distance > kEpsilon) {
+    std::fill(scales_.begin(), scales_.end(), 1.0);
+    for (std::size_t i = 0; i < count; ++i) {
+      grid_.for_each_within(
+          positions[i].x, positions[i].y, stop_distance,
+          [&](const control::SpatialGrid::Item &item) {
+            const auto j = item.id;
+            if (j <= i || j >= count) {
+              return;
+            }
+            const double factor = brake_factor(positions[i], positions[j]);
+            scales_[i] = std::min(scales_[i], factor);
+            scales_[j] = std::min(scales_[j], factor);
+          });
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      robot_states_[i].vx *= scales_[i];
+      robot_states_[i].vy *= scales_[i];
+      brake_for_obstacles(i, positions, obstacles, neighbors);
+    }
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    targets_[i] = make_target(positions[i], robot_states_[i]);
+  }
+}
+
+// 近傍の力は自分の側で集め、相手ごとの力は添字の小さい側から見た向きで
+// 求めて符号を変える。足す順を添字の昇順に固定するので、どの worker が
+// 計算しても step_serial と同じ値になる。
+void MotionPlanner::step_agent(std::size_t i,
+                               std::span<const middleware::Position> positions,
+                               std::span<const control::Obstacle> obstacles,
+                               double dt, std::vector<std::size_t> &neighbors) {
+  const auto count = positions.size();
+  auto &state = robot_states_[i];
+  start_agent(i, positions, dt);
+
+  Vec2 accel;
+  const double safe_distance = repulsion_distance();
+  if (params_.repulsion_gain > 0.0 && safe_distance > 0.0) {
+    neighbors.clear();
+    grid_.for_each_within(
+        positions[i].x, positions[i].y, safe_distance + obstacle_reach_,
+        [&neighbors, i](const control::SpatialGrid::Item &item) {
+          if (item.id != i) {
+            neighbors.push_back(item.id);
+          }
+        });
+    std::sort(neighbors.begin(), neighbors.end());
+    Vec2 force;
+    for (const auto j : neighbors) {
+      if (j >= count) {
+        if (obstacle_force(positions[i], obstacles[j - count], force)) {
+          accel.x += force.x;
+          accel.y += force.y;
+        }
+      } else if (j < i) {
+        if (pair_force(positions[j], positions[i], force)) {
+          accel.x -= force.x;
+          accel.y -= force.y;
+        }
+      } else if (pair_force(positions[i], positions[j], force)) {
+        accel.x += force.x;
+        accel.y += force.y;
+      }
+    }
+  }
+  add_boundary_force(positions[i], accel);
+  integrate(state, accel, dt);
+
+  if (params_.avoidance == Avoidance::Orca) {
+    return;
+  }
+  const double stop_distance = params_.collision_stop_distance;
+  if (stop_distance > kEpsilon) {
+    // 最小値なので相手を見る順によらない。
+    double scale = 1.0;
+    grid_.for_each_within(
+        positions[i].x, positions[i].y, stop_distance,
+        [&](const control::SpatialGrid::Item &item) {
+          const auto j = item.id;
+          if (j == i || j >= count) {
+            return;
+          }
+          scale = std::min(scale, j < i ? brake_factor(positions[j], positions[i])
+                                        : brake_factor(positions[i], positions[j]));
+        });
+    state.vx *= scale;
+    state.vy *= scale;
+    brake_for_obstacles(i, positions, obstacles, neighbors);
+  }
+  targets_[i] = make_target(positions[i], state);
+}
+
+void MotionPlanner::start_agent(std::size_t i,
+                                std::span<const middleware::Position> positions,
+                                double dt) {
+  auto &state = robot_states_[i];
+  const auto &position = positions[i];
+  if (params_.avoidance == Avoidance::Orca) {
+    // ORCA には前の step で出した速度をいまの速度として渡す。
+    auto &agent = orca_agents_[i];
+    agent.position = Vec2{static_cast<double>(position.x),
+                          static_cast<double>(position.y)};
+    agent.velocity = Vec2{state.vx, state.vy};
+  }
+  Vec2 bias{params_.random_bias_x, params_.random_bias_y};
+  if (flow_) {
+    // 格子の双線形補間なので 1 台あたり O(1)。
+    const auto flow = flow_->sample(position.x, position.y);
+    bias.x += params_.flow_weight * flow.x;
+    bias.y += params_.flow_weight * flow.y;
+  }
+  update_random_velocity(state, dt, bias, {noise_[i * 2], noise_[i * 2 + 1]});
+  apply_boundary_reflection(state, position);
+}
+
+void MotionPlanner::update_random_velocity(RobotState &state, double dt,
+                                           Vec2 bias, Vec2 noise) const {
+  const double theta = params_.random_theta;
+  const double sigma = params_.random_sigma;
+  const double sqrt_dt = std::sqrt(dt);
+  state.vx += theta * (bias.x - state.vx) * dt + sigma * sqrt_dt * noise.x;
+  state.vy += theta * (bias.y - state.vy) * dt + sigma * sqrt_dt * noise.y;
+
+  const double speed = std::hypot(state.vx, state.vy);
+  if (speed > params_.random_speed_limit && params_.random_speed_limit > 0.0) {
+    const double scale = params_.random_speed_limit / speed;
+    state.vx *= scale;
+    state.vy *= scale;
+  }
+}
+
+void MotionPlanner::apply_boundary_reflection(
+    RobotState &state, const middleware::Position &position) const {
+  const double margin = params_.boundary_reflect_margin;
+  const double damping = params_.boundary_damping;
+  if (margin <= 0.0) {
+    return;
+  }
+
+  const double left = min_x();
+  const double right = max_x();
+  const double top = min_y();
+  const double bottom = max_y();
+
+  if ((position.x <= left + margin && state.vx < 0.0) ||
+      (position.x >= right - margin && state.vx > 0.0)) {
+    state.vx = -state.vx * std::clamp(damping, 0.0, 1.0);
+  }
+
+  if ((position.y <= top + margin && state.vy < 0.0) ||
+      (position.y >= bottom - margin && state.vy > 0.0)) {
+    state.vy = -state.vy * std::clamp(damping, 0.0, 1.0);
+  }
+}
+
+bool MotionPlanner::pair_force(const middleware::Position &low,
+                               const middleware::Position &high,
+                               Vec2 &force) const {
+  const double safe_distance = repulsion_distance();
+  const double dx = low.x - high.x;
+  const double dy = low.y - high.y;
+  const double dist = std::hypot(dx, dy);
+  if (!(dist < safe_distance && dist > kEpsilon)) {
+    return false;
+  }
+  const double strength =
+      params_.repulsion_gain * (1.0 / dist - 1.0 / safe_distance);
+  force = {strength * (dx / dist), strength * (dy / dist)};
+  return true;
+}
+
+bool MotionPlanner::obstacle_force(const middleware::Position &position,
+                                   const control::Obstacle &obstacle,
+                                   Vec2 &force) const {
+  const double safe_distance = repulsion_distance();
+  const double dx = position.x - obstacle.x;
+  const double dy = position.y - obstacle.y;
+  const double dist = std::hypot(dx, dy);
+  // 縁からの距離。食い込んでいても力が発散しないよう下限を置く。
+  const double gap = std::max(dist - obstacle.radius, kMinObstacleGap);
+  if (!(gap < safe_distance && dist > kEpsilon)) {
+    return false;
+  }
+  // 障害物は押し返さないので片側だけに足す。
+  const double strength =
+      params_.repulsion_gain * (1.0 / gap - 1.0 / safe_distance);
+  force = {strength * (dx / dist), strength * (dy / dist)};
+  return true;
+}
+
+void MotionPlanner::add_boundary_force(const middleware::Position &position,
+                                       Vec2 &accel) const {
+  const double safe_distance = repulsion_distance();
+  const double boundary_gain = params_.boundary_repulsion_gain;
+  if (!(boundary_gain > 0.0 && safe_distance > 0.0)) {
+    return;
+  }
+  const double dist_left = position.x - min_x();
+  const double dist_right = max_x() - position.x;
+  const double dist_top = position.y - min_y();
+  const double dist_bottom = max_y() - position.y;
+
+  if (dist_left < safe_distance && dist_left > kEpsilon) {
+    accel.x += boundary_gain * (1.0 / dist_left - 1.0 / safe_distance);
+  }
+  if (dist_right < safe_distance && dist_right > kEpsilon) {
+    accel.x -= boundary_gain * (1.0 / dist_right - 1.0 / safe_distance);
+  }
+  if (dist_top < safe_distance && dist_top > kEpsilon) {
+    accel.y += boundary_gain * (1.0 / dist_top - 1.0 / safe_distance);
+  }
+  if (dist_bottom < safe_distance && dist_bottom > kEpsilon) {
+    accel.y -= boundary_gain * (1.0 / dist_bottom - 1.0 / safe_distance);
+  }
+}
+
+void MotionPlanner::integrate(RobotState &state, Vec2 accel, double dt) const {
+  state.vx += accel.x * dt;
+  state.vy += accel.y * dt;
+  const double speed = std::hypot(state.vx, state.vy);
+  if (speed > params_.max_speed && params_.max_speed > 0.0) {
+    const double scale = params_.max_speed / speed;
+    state.vx *= scale;
+    state.vy *= scale;
+  }
+}
+
+double MotionPlanner::brake_factor(const middleware::Position &a,
+                                   const middleware::Position &b) const {
+  const double stop_distance = params_.collision_stop_distance;
+  const double dx = a.x - b.x;
+  const double dy = a.y - b.y;
+  const double dist = std::hypot(dx, dy);
+  if (!(dist < stop_distance)) {
+    return 1.0;
+  }
+  const double min_scale = clamp(params_.collision_stop_min_scale, 0.0, 1.0);
+  return clamp(dist / stop_distance, min_scale, 1.0);
+}
+
+void MotionPlanner::brake_for_obstacles(
+    std::size_t i, std::span<const middleware::Position> positions,
+    std::span<const control::Obstacle> obstacles,
+    std::vector<std::size_t> &neighbors) {
+  if (obstacles.empty()) {
+    return;
+  }
+  const double stop_distance = params_.collision_stop_distance;
+  const double min_scale =
+      clamp(params_.collision_stop_min_scale, 0.0, 1.0);
+  auto &state = robot_states_[i];
+  // 障害物に対しては、近づく向きの成分だけを縁までの距離に応じて削る。
+  // 離れる向きには動けるので、人が近づいてきても止まったままにならない。
+  neighbors.clear();
+  grid_.for_each_within(
+      positions[i].x, positions[i].y, stop_distance + obstacle_reach_,
+      [&](const control::SpatialGrid::Item &item) {
+        if (item.id >= positions.size()) {
+          neighbors.push_back(item.id - positions.size());
+        }
+      });
+  std::sort(neighbors.begin(), neighbors.end());
+  for (const auto k : neighbors) {
+    const auto &obstacle = obstacles[k];
+    const double dx = obstacle.x - positions[i].x;
+    const double dy = obstacle.y - positions[i].y;
+    const double dist = std::hypot(dx, dy);
+    const double gap = dist - obstacle.radius;
+    if (gap >= stop_distance || dist <= kEpsilon) {
+      continue;
+    }
+    const double ux = dx / dist;
+    const double uy = dy / dist;
+    const double approach = state.vx * ux + state.vy * uy;
+    if (approach <= 0.0) {
+      continue;
+    }
+    const double factor =
+        gap <= 0.0 ? 0.0 : clamp(gap / stop_distance, min_scale, 1.0);
+    const double removed = approach * (1.0 - factor);
+    state.vx -= removed * ux;
+    state.vy -= removed * uy;
+  }
+}
+
+void MotionPlanner::apply_orca(std::span<const middleware::Position> positions,
+                               std::span<const control::Obstacle> obstacles,
+                               double dt) {
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    orca_agents_[i].preferred = Vec2{robot_states_[i].vx, robot_states_[i].vy};
+  }
+  const auto &velocities =
+      orca_.solve(std::span<const OrcaAgent>(orca_agents_.data(),
+                                             positions.size()),
+                  dt, obstacles);
+  for (std::size_t i = 0; i < positions.size(); ++i) {
+    robot_states_[i].vx = velocities[i].x;
+    robot_states_[i].vy = velocities[i].y;
+  }
+}
+
+TargetPoint MotionPlanner::make_target(const middleware::Position &position,
+                                       const RobotState &state) const {
+  TargetPoint target;
+  const double lookahead = std::max(0.0, params_.lookahead_time);
+  target.x = position.x + state.vx * lookahead;
+  target.y = position.y + state.vy * lookahead;
+  target.x = clamp(target.x, min_x(), max_x());
+  target.y = clamp(target.y, min_y(), max_y());
+  return target;
+}
+
+double MotionPlanner::repulsion_distance() const {
+  return std::max(params_.safe_distance, params_.safety_margin);
+}
+
+double MotionPlanner::min_x() const {
+  const double left = params_.field_min_x + params_.safety_margin;
+  const double right = params_.field_max_x - params_.safety_margin;
+  return std::min(left, right);
+}
+
+double MotionPlanner::max_x() const {
+  const double left = params_.field_min_x + params_.safety_margin;
+  const double right = params_.field_max_x - params_.safety_margin;
+  return std::max(left, right);
+}
+
+double MotionPlanner::min_y() const {
+  const double top = params_.field_min_y + params_.safety_margin;
+  const double bottom = params_.field_max_y - params_.safety_margin;
+  return std::min(top, bottom);
+}
+
+double MotionPlanner::max_y() const {
+  const double top = params_.field_min_y + params_.safety_margin;
+  const double bottom = params_.field_max_y - params_.safety_margin;
+  return std::max(top, bottom);
+}
+
+} // namespace toio::planning
@@ -0,0 +1,357 @@
+#include "toio/planning/orca.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace toio::planning {
+namespace {
+
+constexpr double kEpsilon = 1e-5;
+constexpr double kMinGridCell = 20.0;
+// ThreadPool に渡す 1 チャンクの台数。これ以下なら分けない。
+constexpr std::size_t kAgentsPerChunk = 64;
+constexpr double kMinTimeHorizon = 1e-3;
+
+Vec2 operator+(Vec2 a, Vec2 b) { return {a.x + b.x, a.y + b.y}; }
+Vec2 operator-(Vec2 a, Vec2 b) { return {a.x - b.x, a.y - b.y}; }
+Vec2 operator*(double s, Vec2 a) { return {s * a.x, s * a.y}; }
+double dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+double det(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+double abs_sq(Vec2 a) { return dot(a, a); }
+Vec2 normalize(Vec2 a) {
+  const double length = std::sqrt(abs_sq(a));
+  return length > 0.0 ? (1.0 / length) * a : Vec2{};
+}
+
+// line_no 本目の線上で、それまでの線をすべて満たし速度円に収まる点を探す。
+bool linear_program1(const std::vector<OrcaLine> &lines, std::size_t line_no,
+                     double radius, Vec2 opt_velocity, bool direction_opt,
+                     Vec2 &result) {
+  const auto &line = lines[line_no];
+  const double dot_product = dot(line.point, line.direction);
+  const double discriminant =
+      dot_product * dot_product + radius * radius - abs_sq(line.point);
+  if (discriminant < 0.0) {
+    // 速度円が線の許容側と交わらない。
+    return false;
+  }
+  const double sqrt_discriminant = std::sqrt(discriminant);
+  double t_left = -dot_product - sqrt_discriminant;
+  double t_right = -dot_product + sqrt_discriminant;
+
+  for (std::size_t i = 0; i < line_no; ++i) {
+    const double denominator = det(line.direction, lines[i].direction);
+    const double numerator =
+        det(lines[i].direction, line.point - lines[i].point);
+    if (std::fabs(denominator) <= kEpsilon) {
+      // 平行。許容側が重ならなければ解なし。
+      if (numerator < 0.0) {
+        return false;
+      }
+      continue;
+    }
+    const double t = numerator / denominator;
+    if (denominator >= 0.0) {
+      t_right = std::min(t_right, t);
+    } else {
+      t_left = std::max(t_left, t);
+    }
+    if (t_left > t_right) {
+      return false;
+    }
+  }
+
+  if (direction_opt) {
+    result = dot(opt_velocity, line.direction) > 0.0
+                 ? line.point + t_right * line.direction
+                 : line.point + t_left * line.direction;
+  } else {
+    const double t = dot(line.direction, opt_velocity - line.point);
+    if (t < t_left) {
+      result = line.point + t_left * line.direction;
+    } else if (t > t_right) {
+      result = line.point + t_right * line.direction;
+    } else {
+      result = line.point + t * line.direction;
+    }
+  }
+  return true;
+}
+
+// 半平面の共通部分と速度円の中で opt_velocity に最も近い点。解けなければ
+// 失敗した線の番号を、解ければ lines.size() を返す。
+std::size_t linear_program2(const std::vector<OrcaLine> &lines, double radius,
+                            Vec2 opt_velocity, bool direction_opt,
+                            Vec2 &result) {
+  if (direction_opt) {
+    result = radius * opt_velocity;
+  } else if (abs_sq(opt_velocity) > radius * radius) {
+    result = radius * normalize(opt_velocity);
+  } else {
+    result = opt_velocity;
+  }
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    if (det(lines[i].direction, lines[i].point - result) > 0.0) {
+      const auto previous = result;
+      if (!linear_program1(lines, i, radius, opt_velocity, direction_opt,
+                           result)) {
+        result = previous;
+        return i;
+      }
+    }
+  }
+  return lines.size();
+}
+
+// 共通部分が空のとき、線からのはみ出しの最大値が最小になる速度を選ぶ。
+void linear_program3(const std::vector<OrcaLine> &lines, std::size_t begin_line,
+                     double radius, std::vector<OrcaLine> &projected,
+                     Vec2 &result) {
+  double distance = 0.0;
+  for (std::size_t i = begin_line; i < lines.size(); ++i) {
+    if (det(lines[i].direction, lines[i].point - result) <= distance) {
+      continue;
+    }
+    projected.clear();
+    for (std::size_t j = 0; j < i; ++j) {
+      OrcaLine line;
+      const double determinant = det(lines[i].direction, lines[j].direction);
+      if (std::fabs(determinant) <= kEpsilon) {
+        if (dot(lines[i].direction, lines[j].direction) > 0.0) {
+          // 同じ向きの平行線は i の側で足りる。
+          continue;
+        }
+        line.point = 0.5 * (lines[i].point + lines[j].point);
+      } else {
+        line.point = lines[i].point +
+                     (det(lines[j].direction,
+                          lines[i].point - lines[j].point) /
+                      determinant) *
+                         lines[i].direction;
+      }
+      line.direction = normalize(lines[j].direction - lines[i].direction);
+      projected.push_back(line);
+    }
+    const auto previous = result;
+    if (linear_program2(projected, radius,
+                        Vec2{-lines[i].direction.y, lines[i].direction.x},
+                        true, result) < projected.size()) {
+      // 数値誤差でしか起きない。直前の解を残す。
+      result = previous;
+    }
+    distance = det(lines[i].direction, lines[i].point - result);
+  }
+}
+
+} // namespace
+
+Orca::Orca(OrcaParameters params, control::GridBounds bounds,
+           std::shared_ptr<runtime::ThreadPool> pool)
+    : params_(std::move(params)),
+      grid_(std::max(params_.neighbor_distance, kMinGridCell), bounds),
+      pool_(std::move(pool)) {
+  if (!pool_ && params_.threads > 1) {
+    pool_ = std::make_shared<runtime::ThreadPool>(params_.threads);
+  }
+  scratch_.resize(pool_ ? pool_->size() : 1);
+}
+
+const OrcaParameters &Orca::parameters() const {
+  return params_;
+}
+
+void Orca::reserve(std::size_t ids) {
+  grid_.reserve(ids);
+  velocities_.reserve(ids);
+  for (auto &scratch : scratch_) {
+    scratch.neighbors.reserve(ids);
+    scratch.obstacles.reserve(ids);
+    scratch.lines.reserve(ids);
+    scratch.projected.reserve(ids);
+  }
+}
+
+const std::vector<Vec2> &
+Orca::solve(std::span<const OrcaAgent> agents, double dt,
+            std::span<const control::Obstacle> obstacles) {
+  if (!(dt > 0.0) || !std::isfinite(dt)) {
+    throw std::invalid_argument("Orca::solve requires dt > 0");
+  }
+  velocities_.resize(agents.size());
+  for (std::size_t i = 0; i < agents.size(); ++i) {
+    grid_.update(i, agents[i].position.x, agents[i].position.y);
+  }
+  // 障害物は Cube の後ろの id に載せる。
+  obstacle_reach_ = 0.0;
+  for (std::size_t k = 0; k < obstacles.size(); ++k) {
+    grid_.update(agents.size() + k, obstacles[k].x, obstacles[k].y);
+    obstacle_reach_ = std::max(obstacle_reach_, obstacles[k].radius);
+  }
+  const auto used = agents.size() + obstacles.size();
+  for (std::size_t id = grid_.size(); id-- > used;) {
+    grid_.remove(id);
+  }
+  grid_.rebuild();
+
+  if (!pool_ || agents.size() <= kAgentsPerChunk) {
+    solve_range(agents, obstacles, dt, 0, agents.size(), scratch_[0]);
+    return velocities_;
+  }
+  // 各 worker は自分の範囲の velocities_ だけに書く。グリッドは読むだけ。
+  pool_->parallel_for(
+      agents.size(), kAgentsPerChunk,
+      [&](std::size_t begin, std::size_t end, std::size_t worker) {
+        solve_range(agents, obstacles, dt, begin, end, scratch_[worker]);
+      });
+  return velocities_;
+}
+
+void Orca::solve_range(std::span<const OrcaAgent> agents,
+                       std::span<const control::Obstacle> obstacles, double dt,
+                       std::size_t begin, std::size_t end, Scratch &scratch) {
+  for (std::size_t i = begin; i < end; ++i) {
+    velocities_[i] = solve_agent(agents, obstacles, dt, i, scratch);
+  }
+}
+
+Vec2 Orca::solve_agent(std::span<const OrcaAgent> agents,
+                       std::span<const control::Obstacle> obstacles,
+                       double dt, std::size_t index, Scratch &scratch) const {
+  const auto &agent = agents[index];
+  const double radius = params_.radius;
+  const double max_speed = params_.max_speed;
+  const double neighbor_distance_sq =
+      params_.neighbor_distance * params_.neighbor_distance;
+
+  // 近い順 (同じ距離なら添字順) に max_neighbors 台。並びで線の順番が決まり、
+  // 線形計画の結果もそれで決まる。障害物は台数に数えず、縁までが
+  // neighbor_distance 以内のものを id の順にすべて使う。
+  auto &neighbors = scratch.neighbors;
+  auto &nearby_obstacles = scratch.obstacles;
+  neighbors.clear();
+  nearby_obstacles.clear();
+  grid_.for_each_within(
+      agent.position.x, agent.position.y,
+      params_.neighbor_distance + obstacle_reach_,
+      [&](const control::SpatialGrid::Item &item) {
+        if (item.id == index) {
+          return;
+        }
+        const double dx = item.x - agent.position.x;
+        const double dy = item.y - agent.position.y;
+        const double dist_sq = dx * dx + dy * dy;
+        if (item.id >= agents.size()) {
+          const auto k = item.id - agents.size();
+          if (std::sqrt(dist_sq) - obstacles[k].radius <=
+              params_.neighbor_distance) {
+            nearby_obstacles.push_back(k);
+          }
+          return;
+        }
+        if (dist_sq <= neighbor_distance_sq) {
+          neighbors.emplace_back(dist_sq, item.id);
+        }
+      });
+  const auto limit = std::min(neighbors.size(), params_.max_neighbors);
+  std::partial_sort(neighbors.begin(),
+                    neighbors.begin() + static_cast<std::ptrdiff_t>(limit),
+                    neighbors.end());
+  std::sort(nearby_obstacles.begin(), nearby_obstacles.end());
+
+  auto &lines = scratch.lines;
+  lines.clear();
+  // 障害物は避けてくれないので、避ける量を全部こちらで持つ。
+  for (const auto k : nearby_obstacles) {
+    const auto &obstacle = obstacles[k];
+    const Vec2 position{obstacle.x, obstacle.y};
+    const Vec2 velocity{obstacle.vx, obstacle.vy};
+    lines.push_back(make_line(agent, position, velocity,
+                              radius + obstacle.radius, 1.0, dt,
+                              Vec2{-1.0, 0.0}));
+  }
+  // Cube 同士は相手と半分ずつ避ける。
+  for (std::size_t k = 0; k < limit; ++k) {
+    const auto &other = agents[neighbors[k].second];
+    // 位置も速度も同じなら添字の大小で逆向きに分かれる。
+    const Vec2 fallback =
+        index < neighbors[k].second ? Vec2{-1.0, 0.0} : Vec2{1.0, 0.0};
+    lines.push_back(make_line(agent, other.position, other.velocity,
+                              radius + radius, 0.5, dt, fallback));
+  }
+
+  Vec2 result;
+  const auto failed =
+      linear_program2(lines, max_speed, agent.preferred, false, result);
+  if (failed < lines.size()) {
+    linear_program3(lines, failed, max_speed, scratch.projected, result);
+  }
+  return result;
+}
+
+OrcaLine Orca::make_line(const OrcaAgent &agent, Vec2 other_position,
+                         Vec2 other_velocity, double combined_radius,
+                         double share, double dt, Vec2 fallback) const {
+  const double inv_time_horizon =
+      1.0 / std::max(params_.time_horizon, kMinTimeHorizon);
+  const double inv_time_step = 1.0 / dt;
+  const Vec2 relative_position = other_position - agent.position;
+  const Vec2 relative_velocity = agent.velocity - other_velocity;
+  const double dist_sq = abs_sq(relative_position);
+  const double combined_radius_sq = combined_radius * combined_radius;
+
+  OrcaLine line;
+  Vec2 u;
+  if (dist_sq > combined_radius_sq) {
+    // まだ重なっていない。time_horizon で切った速度障害物の境界へ出る。
+    const Vec2 w = relative_velocity - inv_time_horizon * relative_position;
+    const double w_length_sq = abs_sq(w);
+    const double dot_product = dot(w, relative_position);
+    if (dot_product < 0.0 &&
+        dot_product * dot_product > combined_radius_sq * w_length_sq) {
+      // 切り口の円に射影する。
+      const double w_length = std::sqrt(w_length_sq);
+      const Vec2 unit_w = (1.0 / w_length) * w;
+      line.direction = Vec2{unit_w.y, -unit_w.x};
+      u = (combined_radius * inv_time_horizon - w_length) * unit_w;
+    } else {
+      // 円錐の脚に射影する。
+      const double leg = std::sqrt(dist_sq - combined_radius_sq);
+      if (det(relative_position, w) > 0.0) {
+        line.direction =
+            (1.0 / dist_sq) *
+            Vec2{relative_position.x * leg -
+                     relative_position.y * combined_radius,
+                 relative_position.x * combined_radius +
+                     relative_position.y * leg};
+      } else {
+        line.direction =
+            (-1.0 / dist_sq) *
+            Vec2{relative_position.x * leg +
+                     relative_position.y * combined_radius,
+                 -relative_position.x * combined_radius +
+                     relative_position.y * leg};
+      }
+      const double dot_product2 = dot(relative_velocity, line.direction);
+      u = dot_product2 * line.direction - relative_velocity;
+    }
+  } else {
+    // すでに重なっている。この刻みのうちに離れる速度にする。
+    const Vec2 w = relative_velocity - inv_time_step * relative_position;
+    double w_length = std::sqrt(abs_sq(w));
+    Vec2 unit_w;
+    if (w_length > kEpsilon) {
+      unit_w = (1.0 / w_length) * w;
+    } else {
+      unit_w = fallback;
+      w_length = 0.0;
+    }
+    line.direction = Vec2{unit_w.y, -unit_w.x};
+    u = (combined_radius * inv_time_step - w_length) * unit_w;
+  }
+  line.point = agent.velocity + share * u;
+  return line;
+}
+
+} // namespace toio::planning
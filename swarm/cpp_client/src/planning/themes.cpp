@@ -0,0 +1,311 @@
+#include "toio/planning/themes.hpp"
+
+#include "toio/planning/flock.hpp"
+#include "toio/planning/flow_field.hpp"
+#include "toio/planning/motion_planner.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace toio::planning {
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr std::array<std::string_view, 4> kThemeNames = {"medaka", "locust",
+                                                         "duck", "star"};
+
+Vec2 center_of(const control::GridBounds &field) {
+  return {(field.min_x + field.max_x) * 0.5, (field.min_y + field.max_y) * 0.5};
+}
+
+double short_side(const control::GridBounds &field) {
+  return std::min(field.max_x - field.min_x, field.max_y - field.min_y);
+}
+
+FlockParameters flock_parameters(const ThemeOptions &options) {
+  FlockParameters params;
+  params.field_min_x = options.field.min_x;
+  params.field_min_y = options.field.min_y;
+  params.field_max_x = options.field.max_x;
+  params.field_max_y = options.field.max_y;
+  params.seed = options.seed;
+  return params;
+}
+
+std::shared_ptr<const FlowBlender> make_flow(const FlowField::Function &fn,
+                                             const control::GridBounds &field) {
+  auto blender = std::make_shared<FlowBlender>();
+  blender->add(std::make_shared<FlowField>(FlowField::bake(fn, field)));
+  return blender;
+}
+
+void copy_targets(const std::vector<TargetPoint> &targets,
+                  std::span<double> target_x, std::span<double> target_y) {
+  for (std::size_t i = 0; i < targets.size(); ++i) {
+    target_x[i] = targets[i].x;
+    target_y[i] = targets[i].y;
+  }
+}
+
+// 池を回る流れに乗るメダカの群れ。結合を強く、さまよいを弱くしてまとめる。
+class MedakaBehavior final : public Behavior {
+public:
+  explicit MedakaBehavior(const ThemeOptions &options)
+      : seed_(options.seed), flock_([&] {
+          auto params = flock_parameters(options);
+          params.neighbor_radius = 200.0;
+          params.separation_radius = 80.0;
+          params.separation_gain = 650.0;
+          params.alignment_gain = 1.2;
+          params.cohesion_gain = 0.7;
+          params.wander_sigma = 45.0;
+          params.flow_gain = 0.5;
+          params.max_speed = 120.0;
+          return params;
+        }()) {
+    flock_.set_flow(make_flow(flow::vortex(center_of(options.field), 60.0,
+                                           short_side(options.field) * 0.3),
+                              options.field));
+  }
+
+  std::string_view name() const override { return "medaka"; }
+
+  void reserve(std::size_t count) override { flock_.resize(count); }
+
+  void enter(const BehaviorFrame &) override { flock_.reset(seed_); }
+
+  void step(const BehaviorFrame &frame, std::span<double> target_x,
+            std::span<double> target_y) override {
+    copy_targets(flock_.step(frame.positions, frame.dt), target_x, target_y);
+  }
+
+private:
+  std::uint32_t seed_;
+  Flock flock_;
+};
+
+// 風に押されて跳ね回るバッタ。ランダムウォークを強く速くし、障害物も避ける。
+class LocustBehavior final : public Behavior {
+public:
+  explicit LocustBehavior(const ThemeOptions &options)
+      : seed_(options.seed), planner_([&] {
+          MotionPlannerParameters params;
+          params.field_min_x = options.field.min_x;
+          params.field_min_y = options.field.min_y;
+          params.field_max_x = options.field.max_x;
+          params.field_max_y = options.field.max_y;
+          params.random_theta = 1.6;
+          params.random_sigma = 220.0;
+          params.random_speed_limit = 220.0;
+          params.max_speed = 220.0;
+          params.seed = options.seed;
+          return params;
+        }()) {
+    planner_.set_flow(make_flow(flow::wave(0.0, 80.0, 70.0, 280.0),
+                                options.field));
+  }
+
+  std::string_view name() const override { return "locust"; }
+
+  void reserve(std::size_t count) override { planner_.reserve(count); }
+
+  void enter(const BehaviorFrame &) override { planner_.reset(seed_); }
+
+  void step(const BehaviorFrame &frame, std::span<double> target_x,
+            std::span<double> target_y) override {
+    copy_targets(planner_.step(frame.positions, frame.dt, frame.obstacles),
+                 target_x, target_y);
+  }
+
+private:
+  std::uint32_t seed_;
+  MotionPlanner planner_;
+};
+
+// 列になって左右の岸を行き来するカモ。整列を強くし、群れの重心が岸に
+// 着いたら反対の岸をゴールにする。
+class DuckBehavior final : public Behavior {
+public:
+  explicit DuckBehavior(const ThemeOptions &options)
+      : seed_(options.seed), flock_([&] {
+          auto params = flock_parameters(options);
+          params.separation_radius = 60.0;
+          params.alignment_gain = 2.0;
+          params.cohesion_gain = 0.8;
+          params.wander_sigma = 20.0;
+          params.goal_gain = 1.4;
+          params.cruise_speed = 80.0;
+          return params;
+        }()) {
+    const auto center = center_of(options.field);
+    const double reach = (options.field.max_x - options.field.min_x) * 0.3;
+    shores_[0] = {center.x - reach, center.y};
+    shores_[1] = {center.x + reach, center.y};
+    arrival_ = reach * 0.4;
+  }
+
+  std::string_view name() const override { return "duck"; }
+
+  void reserve(std::size_t count) override { flock_.resize(count); }
+
+  void enter(const BehaviorFrame &frame) override {
+    flock_.reset(seed_);
+    // 遠いほうの岸から向かう。
+    const auto centroid = centroid_of(frame);
+    shore_ = distance_to(centroid, shores_[0]) >
+                     distance_to(centroid, shores_[1])
+                 ? 0
+                 : 1;
+    flock_.set_goal(0, shores_[shore_]);
+  }
+
+  void step(const BehaviorFrame &frame, std::span<double> target_x,
+            std::span<double> target_y) override {
+    if (distance_to(centroid_of(frame), shores_[shore_]) < arrival_) {
+      shore_ = 1 - shore_;
+      flock_.set_goal(0, shores_[shore_]);
+    }
+    copy_targets(flock_.step(frame.positions, frame.dt), target_x, target_y);
+  }
+
+private:
+  static TargetPoint centroid_of(const BehaviorFrame &frame) {
+    TargetPoint centroid;
+    if (frame.x.empty()) {
+      return centroid;
+    }
+    for (std::size_t i = 0; i < frame.x.size(); ++i) {
+      centroid.x += frame.x[i];
+      centroid.y += frame.y[i];
+    }
+    const auto count = static_cast<double>(frame.x.size());
+    return {centroid.x / count, centroid.y / count};
+  }
+
+  static double distance_to(const TargetPoint &a, const TargetPoint &b) {
+    return std::hypot(a.x - b.x, a.y - b.y);
+  }
+
+  std::uint32_t seed_;
+  Flock flock_;
+  std::array<TargetPoint, 2> shores_{};
+  std::size_t shore_ = 0;
+  double arrival_ = 0.0;
+};
+
+// enter したときの位置を星座として、中心のまわりを回りながら半径を
+// Cube ごとの周期で揺らして瞬かせる。状態はすべて Cube ごとの配列 (SoA)。
+class StarBehavior final : public Behavior {
+public:
+  explicit StarBehavior(const ThemeOptions &options)
+      : field_(options.field), center_(center_of(options.field)) {}
+
+  std::string_view name() const override { return "star"; }
+
+  void reserve(std::size_t count) override {
+    radius_.reserve(count);
+    angle_.reserve(count);
+    twinkle_rate_.reserve(count);
+    twinkle_phase_.reserve(count);
+  }
+
+  void enter(const BehaviorFrame &frame) override {
+    const auto count = frame.x.size();
+    radius_.resize(count);
+    angle_.resize(count);
+    twinkle_rate_.resize(count);
+    twinkle_phase_.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      const double dx = frame.x[i] - center_.x;
+      const double dy = frame.y[i] - center_.y;
+      radius_[i] = std::hypot(dx, dy);
+      angle_[i] = std::atan2(dy, dx);
+      // 黄金比で散らし、隣の Cube と同じ周期で瞬かないようにする。
+      const double u = std::fmod(static_cast<double>(i) * kGolden, 1.0);
+      twinkle_rate_[i] = kTwinkleMinRate + u * kTwinkleRateSpread;
+      twinkle_phase_[i] = 2.0 * kPi * std::fmod(u * 7.0, 1.0);
+    }
+    entered_ = frame.time;
+  }
+
+  void step(const BehaviorFrame &frame, std::span<double> target_x,
+            std::span<double> target_y) override {
+    const auto count = frame.x.size();
+    if (count != radius_.size()) {
+      // 台数が変わったら、いまの位置で星座を作り直す。
+      enter(frame);
+    }
+    const double t = frame.time - entered_;
+    const double turn = kAngularSpeed * t;
+    for (std::size_t i = 0; i < count; ++i) {
+      const double twinkle =
+          std::sin(2.0 * kPi * twinkle_rate_[i] * t + twinkle_phase_[i]);
+      // 瞬きは 0 から始める。
+      const double radius =
+          radius_[i] + kTwinkleAmplitude *
+                           (twinkle - std::sin(twinkle_phase_[i]));
+      double x = center_.x + radius * std::cos(angle_[i] + turn);
+      double y = center_.y + radius * std::sin(angle_[i] + turn);
+      for (const auto &obstacle : frame.obstacles) {
+        const double dx = x - obstacle.x;
+        const double dy = y - obstacle.y;
+        const double reach = obstacle.radius + kObstacleClearance;
+        const double distance = std::hypot(dx, dy);
+        if (distance < reach) {
+          const double scale = distance > 1e-9 ? reach / distance : 0.0;
+          x = distance > 1e-9 ? obstacle.x + dx * scale : obstacle.x + reach;
+          y = distance > 1e-9 ? obstacle.y + dy * scale : obstacle.y;
+        }
+      }
+      target_x[i] = std::clamp(x, field_.min_x + kMargin, field_.max_x - kMargin);
+      target_y[i] = std::clamp(y, field_.min_y + kMargin, field_.max_y - kMargin);
+    }
+  }
+
+private:
+  static constexpr double kGolden = 0.6180339887498949;
+  // 1 周およそ 80 秒。
+  static constexpr double kAngularSpeed = 2.0 * kPi / 80.0;
+  static constexpr double kTwinkleAmplitude = 25.0;
+  static constexpr double kTwinkleMinRate = 0.15;
+  static constexpr double kTwinkleRateSpread = 0.35;
+  static constexpr double kObstacleClearance = 90.0;
+  static constexpr double kMargin = 40.0;
+
+  control::GridBounds field_;
+  Vec2 center_;
+  double entered_ = 0.0;
+  std::vector<double> radius_;
+  std::vector<double> angle_;
+  std::vector<double> twinkle_rate_;
+  std::vector<double> twinkle_phase_;
+};
+
+} // namespace
+
+std::span<const std::string_view> theme_names() {
+  return kThemeNames;
+}
+
+std::unique_ptr<Behavior> make_theme(std::string_view name,
+                                     const ThemeOptions &options) {
+  if (name == "medaka") {
+    return std::make_unique<MedakaBehavior>(options);
+  }
+  if (name == "locust") {
+    return std::make_unique<LocustBehavior>(options);
+  }
+  if (name == "duck") {
+    return std::make_unique<DuckBehavior>(options);
+  }
+  if (name == "star") {
+    return std::make_unique<StarBehavior>(options);
+  }
+  throw std::invalid_argument("unknown theme: " + std::string(name));
+}
+
+} // namespace toio::planning
@@ -0,0 +1,212 @@
+// toio_replay: toio_cli --record などで残したセッションログを読む・流し直す。
+//   ./toio_replay show.toiolog --info
+//   ./toio_replay show.toiolog --dump --from-s 30 --to-s 31
+//   ./toio_replay show.toiolog --speed 0
+
+#include "toio/middleware/fleet_manager.hpp"
+#include "toio/record/session_log.hpp"
+#include "toio/record/session_replayer.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+using toio::record::LogRecord;
+using toio::record::RecordKind;
+using toio::record::SessionLog;
+
+namespace {
+
+struct ReplayArgs {
+  std::string path;
+  bool info = false;
+  bool dump = false;
+  toio::record::ReplayOptions replay;
+};
+
+void print_usage(const char *argv0) {
+  std::cout
+      << "Usage: " << argv0 << " <session.toiolog> [options]\n"
+      << "  --info                 Print header, servers and record counts\n"
+      << "  --dump                 Print records as JSON lines\n"
+      << "  --speed <x>            Replay speed (default 1.0, 0 = no waiting)\n"
+      << "  --from-s <s>           Start offset in seconds\n"
+      << "  --to-s <s>             End offset in seconds\n";
+}
+
+std::chrono::microseconds seconds_arg(const std::string &value) {
+  return std::chrono::microseconds(
+      static_cast<std::int64_t>(std::stod(value) * 1e6));
+}
+
+ReplayArgs parse_args(int argc, char **argv) {
+  ReplayArgs args;
+  auto value = [&](int &i, const std::string &name) -> std::string {
+    if (i + 1 >= argc) {
+      throw std::runtime_error(name + " requires a value");
+    }
+    return argv[++i];
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--info") {
+      args.info = true;
+    } else if (arg == "--dump") {
+      args.dump = true;
+    } else if (arg == "--speed") {
+      args.replay.speed = std::stod(value(i, arg));
+    } else if (arg == "--from-s") {
+      args.replay.from = seconds_arg(value(i, arg));
+    } else if (arg == "--to-s") {
+      args.replay.to = seconds_arg(value(i, arg));
+    } else if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else if (!arg.empty() && arg[0] != '-' && args.path.empty()) {
+      args.path = arg;
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+  if (args.path.empty()) {
+    throw std::runtime_error("session log path is required");
+  }
+  return args;
+}
+
+const char *kind_name(RecordKind kind) {
+  switch (kind) {
+  case RecordKind::Server:
+    return "server";
+  case RecordKind::Inbound:
+    return "in";
+  case RecordKind::Outbound:
+    return "out";
+  case RecordKind::Open:
+    return "open";
+  case RecordKind::Close:
+    return "close";
+  }
+  return "unknown";
+}
+
+void print_info(const SessionLog &log) {
+  std::array<std::uint64_t, 5> counts{};
+  std::uint64_t payload_bytes = 0;
+  auto cursor = log.cursor();
+  LogRecord record;
+  while (cursor.next(record)) {
+    const auto kind = static_cast<std::size_t>(record.kind);
+    if (kind < counts.size()) {
+      ++counts[kind];
+    }
+    payload_bytes += record.payload.size();
+  }
+  const auto wall_start =
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          log.wall_start().time_since_epoch())
+          .count();
+  std::cout << "wall start (epoch ms) " << wall_start << "\n"
+            << "duration              " << std::fixed << std::setprecision(3)
+            << log.duration().count() / 1e6 << " s\n"
+            << "records               " << log.record_count() << "\n"
+            << "  inbound             " << counts[1] << "\n"
+            << "  outbound            " << counts[2] << "\n"
+            << "payload bytes         " << payload_bytes << "\n"
+            << "dropped               " << log.dropped() << "\n"
+            << "index                 "
+            << (log.recovered() ? "rebuilt (no trailer)" : "trailer") << "\n"
+            << "servers              ";
+  for (const auto &server : log.servers()) {
+    std::cout << " " << server;
+  }
+  std::cout << std::endl;
+}
+
+void print_dump(const SessionLog &log, const toio::record::ReplayOptions &range) {
+  const auto &servers = log.servers();
+  auto cursor = log.cursor(range.from);
+  LogRecord record;
+  while (cursor.next(record)) {
+    if (range.to && record.t > *range.to) {
+      break;
+    }
+    nlohmann::json line = {
+        {"t_ms", record.t.count() / 1000.0},
+        {"server", record.server < servers.size() ? servers[record.server]
+                                                  : std::string()},
+        {"kind", kind_name(record.kind)},
+    };
+    if (record.kind == RecordKind::Inbound ||
+        record.kind == RecordKind::Outbound) {
+      try {
+        line["message"] = record.json();
+      } catch (const std::exception &) {
+        line["text"] = record.text();
+      }
+    }
+    std::cout << line.dump() << "\n";
+  }
+  std::cout.flush();
+}
+
+void replay(const SessionLog &log, const toio::record::ReplayOptions &options) {
+  toio::record::SessionReplayer replayer(log);
+  toio::middleware::FleetManager manager(replayer.server_configs(), {},
+                                         replayer.connection_factory());
+  manager.start();
+  const auto wall_started = std::chrono::steady_clock::now();
+  const auto stats = replayer.run(options);
+  const auto wall = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wall_started);
+
+  std::cout << std::fixed << std::setprecision(3)
+            << "replayed      " << stats.span.count() / 1e6 << " s in "
+            << wall.count() << " s\n"
+            << "delivered     " << stats.delivered << "\n"
+            << "skipped       " << stats.skipped << "\n"
+            << "commands      " << stats.recorded_commands
+            << " (recorded)\n";
+  for (const auto &snapshot : manager.snapshot()) {
+    const auto &state = snapshot.state;
+    std::cout << "[" << state.server_id << "] " << state.cube_id
+              << (state.connected ? " connected" : " disconnected");
+    if (state.position) {
+      std::cout << " pos=(" << state.position->x << ", " << state.position->y
+                << ", " << state.position->angle << ")";
+    }
+    if (state.battery_percent) {
+      std::cout << " battery=" << *state.battery_percent << "%";
+    }
+    std::cout << "\n";
+  }
+  manager.stop();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    const auto args = parse_args(argc, argv);
+    SessionLog log(args.path);
+    if (args.info) {
+      print_info(log);
+    }
+    if (args.dump) {
+      print_dump(log, args.replay);
+    }
+    if (!args.info && !args.dump) {
+      replay(log, args.replay);
+    }
+  } catch (const std::exception &ex) {
+    std::cerr << "toio_replay failed: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,212 @@
+#include "toio/record/session_log.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::record {
+
+static_assert(std::endian::native == std::endian::little,
+              "session logs are stored little-endian");
+
+namespace {
+
+template <typename T>
+T read_at(const std::uint8_t *data, std::size_t offset) {
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+std::runtime_error log_error(const std::string &path, const std::string &what) {
+  return std::runtime_error("Session log " + path + ": " + what);
+}
+
+} // namespace
+
+nlohmann::json LogRecord::json() const {
+  if (flags & kFlagMsgpack) {
+    return nlohmann::json::from_msgpack(payload.begin(), payload.end());
+  }
+  return nlohmann::json::parse(payload.begin(), payload.end());
+}
+
+std::string LogRecord::text() const {
+  if (flags & kFlagMsgpack) {
+    return json().dump();
+  }
+  return std::string(reinterpret_cast<const char *>(payload.data()),
+                     payload.size());
+}
+
+SessionLog::SessionLog(const std::string &path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw log_error(path, std::strerror(errno));
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0) {
+    const int error = errno;
+    ::close(fd);
+    throw log_error(path, std::strerror(error));
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ < sizeof(FileHeader)) {
+    ::close(fd);
+    throw log_error(path, "too small");
+  }
+  void *mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int error = errno;
+  ::close(fd);
+  if (mapped == MAP_FAILED) {
+    throw log_error(path, std::strerror(error));
+  }
+  data_ = static_cast<const std::uint8_t *>(mapped);
+  ::madvise(mapped, size_, MADV_SEQUENTIAL);
+
+  header_ = read_at<FileHeader>(data_, 0);
+  if (std::memcmp(header_.magic, kLogMagic, sizeof(kLogMagic)) != 0 ||
+      header_.version != kLogVersion || header_.header_size > size_) {
+    ::munmap(mapped, size_);
+    throw log_error(path, "not a session log");
+  }
+
+  const auto trailer_at = size_ - sizeof(Trailer);
+  if (size_ >= header_.header_size + sizeof(Trailer)) {
+    const auto trailer = read_at<Trailer>(data_, trailer_at);
+    const bool valid =
+        std::memcmp(trailer.magic, kIndexMagic, sizeof(kIndexMagic)) == 0 &&
+        trailer.index_offset >= header_.header_size &&
+        trailer.index_offset + trailer.index_count * sizeof(IndexEntry) ==
+            trailer.servers_offset &&
+        trailer.servers_offset <= trailer_at;
+    if (valid) {
+      records_end_ = trailer.index_offset;
+      record_count_ = trailer.record_count;
+      dropped_ = trailer.dropped;
+      last_t_us_ = trailer.last_t_us;
+      index_.resize(trailer.index_count);
+      std::memcpy(index_.data(), data_ + trailer.index_offset,
+                  index_.size() * sizeof(IndexEntry));
+      std::size_t offset = trailer.servers_offset;
+      while (offset + sizeof(std::uint16_t) <= trailer_at) {
+        const auto length = read_at<std::uint16_t>(data_, offset);
+        offset += sizeof(std::uint16_t);
+        if (offset + length > trailer_at) {
+          break;
+        }
+        servers_.emplace_back(reinterpret_cast<const char *>(data_ + offset),
+                              length);
+        offset += length;
+      }
+      return;
+    }
+  }
+  scan();
+}
+
+SessionLog::~SessionLog() {
+  if (data_) {
+    ::munmap(const_cast<std::uint8_t *>(data_), size_);
+  }
+}
+
+void SessionLog::scan() {
+  // 書き込み途中で止まったログ。完全なレコードだけを拾って索引を作る。
+  recovered_ = true;
+  records_end_ = size_;
+  std::size_t offset = header_.header_size;
+  while (offset + sizeof(RecordHeader) <= size_) {
+    const auto header = read_at<RecordHeader>(data_, offset);
+    const auto next = offset + sizeof(RecordHeader) + header.size;
+    if (next > size_) {
+      break;
+    }
+    if (record_count_ % kIndexStride == 0) {
+      index_.push_back({header.t_us, offset});
+    }
+    if (header.kind == RecordKind::Server) {
+      servers_.emplace_back(
+          reinterpret_cast<const char *>(data_ + offset + sizeof(RecordHeader)),
+          header.size);
+    }
+    last_t_us_ = header.t_us;
+    ++record_count_;
+    offset = next;
+  }
+  records_end_ = offset;
+}
+
+bool SessionLog::Cursor::next(LogRecord &record) {
+  const auto &log = *log_;
+  if (offset_ + sizeof(RecordHeader) > log.records_end_) {
+    return false;
+  }
+  const auto header = read_at<RecordHeader>(log.data_, offset_);
+  const auto payload_at = offset_ + sizeof(RecordHeader);
+  if (payload_at + header.size > log.records_end_) {
+    return false;
+  }
+  record.t = std::chrono::microseconds(header.t_us);
+  record.kind = header.kind;
+  record.server = header.server;
+  record.flags = header.flags;
+  record.payload = {log.data_ + payload_at, header.size};
+  offset_ = payload_at + header.size;
+  return true;
+}
+
+SessionLog::Cursor SessionLog::cursor(std::chrono::microseconds from) const {
+  // from より前にある最後の索引点から線形に進める。
+  auto it = std::upper_bound(
+      index_.begin(), index_.end(), from.count(),
+      [](std::int64_t t, const IndexEntry &entry) { return t <= entry.t_us; });
+  std::size_t offset = header_.header_size;
+  if (it != index_.begin()) {
+    offset = std::prev(it)->offset;
+  }
+  Cursor cursor(*this, offset);
+  Cursor probe = cursor;
+  LogRecord record;
+  while (probe.next(record) && record.t < from) {
+    cursor = probe;
+  }
+  return cursor;
+}
+
+std::chrono::system_clock::time_point SessionLog::wall_start() const {
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::microseconds(header_.wall_start_us)));
+}
+
+const std::vector<std::string> &SessionLog::servers() const {
+  return servers_;
+}
+
+std::uint64_t SessionLog::record_count() const {
+  return record_count_;
+}
+
+std::uint64_t SessionLog::dropped() const {
+  return dropped_;
+}
+
+std::chrono::microseconds SessionLog::duration() const {
+  return std::chrono::microseconds(last_t_us_);
+}
+
+bool SessionLog::recovered() const {
+  return recovered_;
+}
+
+} // namespace toio::record
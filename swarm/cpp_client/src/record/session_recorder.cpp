@@ -0,0 +1,272 @@
+#include "toio/record/session_recorder.hpp"
+
+#include "toio/transport/websocket_connection.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::record {
+
+namespace {
+
+// この件数が溜まったら flush_interval を待たずに書き込みスレッドを起こす。
+constexpr std::size_t kWakeBatch = 1024;
+
+template <typename T>
+void write_pod(std::ofstream &file, const T &value) {
+  file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+} // namespace
+
+SessionRecorder::SessionRecorder(const std::string &path,
+                                 RecorderOptions options,
+                                 std::shared_ptr<runtime::Clock> clock)
+    : options_(options),
+      clock_(std::move(clock)),
+      started_at_(clock_->now()),
+      file_(path, std::ios::binary | std::ios::trunc) {
+  if (!file_) {
+    throw std::runtime_error("Failed to open session log: " + path);
+  }
+  FileHeader header{};
+  std::memcpy(header.magic, kLogMagic, sizeof(kLogMagic));
+  header.version = kLogVersion;
+  header.header_size = sizeof(FileHeader);
+  header.wall_start_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          clock_->wall_now().time_since_epoch())
+          .count();
+  write_pod(file_, header);
+  bytes_ = sizeof(FileHeader);
+  pending_.reserve(kWakeBatch);
+  writer_ = std::thread([this] { write_loop(); });
+}
+
+SessionRecorder::~SessionRecorder() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+std::int64_t SessionRecorder::elapsed_us() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(clock_->now() -
+                                                               started_at_)
+      .count();
+}
+
+std::uint16_t SessionRecorder::register_server(const std::string &server_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto it = server_index_.find(server_id); it != server_index_.end()) {
+    return it->second;
+  }
+  const auto index = static_cast<std::uint16_t>(servers_.size());
+  servers_.push_back(server_id);
+  server_index_.emplace(server_id, index);
+  // 番号の定義はキューの上限に関係なく残す。
+  if (!closed_) {
+    pending_.push_back({elapsed_us(), RecordKind::Server, index, server_id});
+  }
+  return index;
+}
+
+void SessionRecorder::record(RecordKind kind,
+                             std::uint16_t server,
+                             std::string text) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || pending_.size() >= options_.queue_limit) {
+      ++dropped_;
+      return;
+    }
+    // ロック内で時刻を取り、ファイル上の順序と時刻の順序を揃える。
+    pending_.push_back({elapsed_us(), kind, server, std::move(text)});
+    wake = pending_.size() == kWakeBatch;
+  }
+  if (wake) {
+    cv_.notify_one();
+  }
+}
+
+void SessionRecorder::close() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    stopping_ = true;
+  }
+  cv_.notify_one();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  write_trailer();
+  file_.close();
+}
+
+RecorderStats SessionRecorder::stats() const {
+  RecorderStats stats;
+  stats.recorded = recorded_.load();
+  stats.bytes = bytes_.load();
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.dropped = dropped_;
+  return stats;
+}
+
+void SessionRecorder::write_loop() {
+  std::vector<Event> batch;
+  batch.reserve(kWakeBatch);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait_for(lock, options_.flush_interval, [this] {
+      return stopping_ || pending_.size() >= kWakeBatch;
+    });
+    batch.swap(pending_);
+    const bool stopping = stopping_;
+    lock.unlock();
+    for (const auto &event : batch) {
+      append(event);
+    }
+    batch.clear();
+    file_.flush();
+    lock.lock();
+    if (stopping && pending_.empty()) {
+      break;
+    }
+  }
+}
+
+void SessionRecorder::append(const Event &event) {
+  const auto offset = bytes_.load();
+  const auto count = recorded_.load();
+  if (count % kIndexStride == 0) {
+    index_.push_back({event.t_us, offset});
+  }
+
+  RecordHeader header{};
+  header.t_us = event.t_us;
+  header.kind = event.kind;
+  header.server = event.server;
+  const char *payload = event.text.data();
+  std::size_t size = event.text.size();
+  const bool frame = event.kind == RecordKind::Inbound ||
+                     event.kind == RecordKind::Outbound;
+  if (options_.msgpack && frame) {
+    try {
+      buffer_.clear();
+      nlohmann::json::to_msgpack(nlohmann::json::parse(event.text), buffer_);
+      payload = reinterpret_cast<const char *>(buffer_.data());
+      size = buffer_.size();
+      header.flags |= kFlagMsgpack;
+    } catch (const std::exception &) {
+      // JSON でないフレームはテキストのまま残す。
+    }
+  }
+  header.size = static_cast<std::uint32_t>(size);
+  write_pod(file_, header);
+  file_.write(payload, static_cast<std::streamsize>(size));
+
+  last_t_us_ = event.t_us;
+  recorded_ = count + 1;
+  bytes_ = offset + sizeof(RecordHeader) + size;
+}
+
+void SessionRecorder::write_trailer() {
+  Trailer trailer{};
+  std::memcpy(trailer.magic, kIndexMagic, sizeof(kIndexMagic));
+  trailer.index_offset = bytes_.load();
+  trailer.index_count = index_.size();
+  for (const auto &entry : index_) {
+    write_pod(file_, entry);
+  }
+  trailer.servers_offset =
+      trailer.index_offset + index_.size() * sizeof(IndexEntry);
+  std::vector<std::string> servers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    servers = servers_;
+    trailer.dropped = dropped_;
+  }
+  for (const auto &server : servers) {
+    write_pod(file_, static_cast<std::uint16_t>(server.size()));
+    file_.write(server.data(), static_cast<std::streamsize>(server.size()));
+  }
+  trailer.record_count = recorded_.load();
+  trailer.last_t_us = last_t_us_;
+  write_pod(file_, trailer);
+  file_.flush();
+}
+
+RecordingConnection::RecordingConnection(
+    std::unique_ptr<transport::Connection> inner,
+    std::shared_ptr<SessionRecorder> recorder,
+    const std::string &server_id)
+    : inner_(std::move(inner)),
+      recorder_(std::move(recorder)),
+      server_(recorder_->register_server(server_id)) {}
+
+RecordingConnection::~RecordingConnection() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void RecordingConnection::open(ReceiveHandler on_message, LogHandler on_log) {
+  if (inner_->is_open()) {
+    return;
+  }
+  // 接続直後に届くフレームより前に置く。
+  recorder_->record(RecordKind::Open, server_, {});
+  inner_->open(
+      [this, on_message = std::move(on_message)](const std::string &text) {
+        recorder_->record(RecordKind::Inbound, server_, text);
+        if (on_message) {
+          on_message(text);
+        }
+      },
+      std::move(on_log));
+}
+
+void RecordingConnection::close() {
+  if (!inner_->is_open()) {
+    inner_->close();
+    return;
+  }
+  inner_->close();
+  recorder_->record(RecordKind::Close, server_, {});
+}
+
+bool RecordingConnection::is_open() const {
+  return inner_->is_open();
+}
+
+void RecordingConnection::write(const std::string &text) {
+  inner_->write(text);
+  recorder_->record(RecordKind::Outbound, server_, text);
+}
+
+middleware::ConnectionFactory
+recording_connection_factory(std::shared_ptr<SessionRecorder> recorder,
+                             middleware::ConnectionFactory inner) {
+  return [recorder = std::move(recorder), inner = std::move(inner)](
+             const middleware::ServerConfig &config)
+             -> std::unique_ptr<transport::Connection> {
+    std::unique_ptr<transport::Connection> connection;
+    if (inner) {
+      connection = inner(config);
+    } else {
+      connection = std::make_unique<transport::WebSocketConnection>(
+          config.host, config.port, config.endpoint);
+    }
+    return std::make_unique<RecordingConnection>(std::move(connection),
+                                                 recorder, config.id);
+  };
+}
+
+} // namespace toio::record
@@ -0,0 +1,156 @@
+#include "toio/record/session_replayer.hpp"
+
+#include "toio/transport/connection.hpp"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace toio::record {
+
+class SessionReplayer::ReplayConnection : public transport::Connection {
+public:
+  ReplayConnection(SessionReplayer &replayer, std::string server_id)
+      : replayer_(replayer), server_id_(std::move(server_id)) {}
+
+  ~ReplayConnection() override { close(); }
+
+  void open(ReceiveHandler on_message, LogHandler on_log) override {
+    std::lock_guard<std::mutex> lock(replayer_.mutex_);
+    if (open_) {
+      return;
+    }
+    on_message_ = std::move(on_message);
+    replayer_.connections_[server_id_] = this;
+    open_ = true;
+    if (on_log) {
+      on_log("Replaying session log as " + server_id_);
+    }
+  }
+
+  void close() override {
+    std::lock_guard<std::mutex> lock(replayer_.mutex_);
+    if (!open_) {
+      return;
+    }
+    open_ = false;
+    auto it = replayer_.connections_.find(server_id_);
+    if (it != replayer_.connections_.end() && it->second == this) {
+      replayer_.connections_.erase(it);
+    }
+  }
+
+  // 配送中 (mutex_ 保持中) のハンドラから送信しても詰まらないよう、ロックを取らない。
+  bool is_open() const override { return open_; }
+
+  void write(const std::string &text) override {
+    replayer_.on_command(server_id_, text);
+  }
+
+  // replayer_.mutex_ を保持した状態で呼ぶ。
+  void deliver(const std::string &text) {
+    if (on_message_) {
+      on_message_(text);
+    }
+  }
+
+private:
+  SessionReplayer &replayer_;
+  std::string server_id_;
+  std::atomic<bool> open_{false};
+  ReceiveHandler on_message_;
+};
+
+SessionReplayer::SessionReplayer(const SessionLog &log,
+                                 std::shared_ptr<runtime::Clock> clock)
+    : log_(log), clock_(std::move(clock)) {}
+
+SessionReplayer::~SessionReplayer() = default;
+
+middleware::ConnectionFactory SessionReplayer::connection_factory() {
+  return [this](const middleware::ServerConfig &config)
+             -> std::unique_ptr<transport::Connection> {
+    return std::make_unique<ReplayConnection>(*this, config.id);
+  };
+}
+
+std::vector<middleware::ServerConfig> SessionReplayer::server_configs() const {
+  std::vector<middleware::ServerConfig> configs;
+  for (const auto &server_id : log_.servers()) {
+    middleware::ServerConfig config;
+    config.id = server_id;
+    config.host = std::string("replay");
+    config.port = std::string("0");
+    configs.push_back(std::move(config));
+  }
+  return configs;
+}
+
+void SessionReplayer::set_command_observer(CommandObserver observer) {
+  std::lock_guard<std::mutex> lock(observer_mutex_);
+  observer_ = std::move(observer);
+}
+
+void SessionReplayer::on_command(const std::string &server_id,
+                                 const std::string &text) {
+  std::lock_guard<std::mutex> lock(observer_mutex_);
+  ++live_commands_;
+  if (observer_) {
+    observer_(server_id, text);
+  }
+}
+
+ReplayStats SessionReplayer::run(const ReplayOptions &options) {
+  ReplayStats stats;
+  const auto live_before = [this] {
+    std::lock_guard<std::mutex> lock(observer_mutex_);
+    return live_commands_;
+  }();
+
+  const auto &servers = log_.servers();
+  auto cursor = log_.cursor(options.from);
+  const auto started_at = clock_->now();
+  std::optional<std::chrono::microseconds> first;
+  LogRecord record;
+  while (cursor.next(record)) {
+    if (options.to && record.t > *options.to) {
+      break;
+    }
+    if (!first) {
+      first = record.t;
+    }
+    stats.span = record.t - *first;
+    if (record.kind == RecordKind::Outbound) {
+      ++stats.recorded_commands;
+      continue;
+    }
+    if (record.kind != RecordKind::Inbound) {
+      continue;
+    }
+    if (record.server >= servers.size()) {
+      throw std::runtime_error("Session log record refers to unknown server " +
+                               std::to_string(record.server));
+    }
+    if (options.speed > 0.0) {
+      const auto offset = std::chrono::duration<double, std::micro>(
+          static_cast<double>(stats.span.count()) / options.speed);
+      clock_->sleep_until(
+          started_at +
+          std::chrono::duration_cast<runtime::Clock::duration>(offset));
+    }
+    const auto text = record.text();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = connections_.find(servers[record.server]);
+    if (it == connections_.end()) {
+      ++stats.skipped;
+      continue;
+    }
+    it->second->deliver(text);
+    ++stats.delivered;
+  }
+
+  std::lock_guard<std::mutex> lock(observer_mutex_);
+  stats.live_commands = live_commands_ - live_before;
+  return stats;
+}
+
+} // namespace toio::record
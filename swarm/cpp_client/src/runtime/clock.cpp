@@ -0,0 +1,35 @@
+#include "toio/runtime/clock.hpp"
+
+#include <thread>
+
+namespace toio::runtime {
+
+Clock::time_point SystemClock::now() const {
+  return std::chrono::steady_clock::now();
+}
+
+std::chrono::system_clock::time_point SystemClock::wall_now() const {
+  return std::chrono::system_clock::now();
+}
+
+void SystemClock::sleep_until(time_point deadline) {
+  std::this_thread::sleep_until(deadline);
+}
+
+bool SystemClock::wait_until(std::unique_lock<std::mutex> &lock,
+                             std::condition_variable &cv,
+                             time_point deadline,
+                             const std::function<bool()> &ready) {
+  if (deadline == time_point::max()) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_until(lock, deadline, ready);
+}
+
+std::shared_ptr<Clock> system_clock() {
+  static const auto clock = std::make_shared<SystemClock>();
+  return clock;
+}
+
+} // namespace toio::runtime
@@ -0,0 +1,22 @@
+#include "toio/runtime/executor.hpp"
+
+#include <utility>
+
+namespace toio::runtime {
+
+std::future<void> ThreadExecutor::spawn(std::function<void()> task) {
+  return std::async(std::launch::async, std::move(task));
+}
+
+void ThreadExecutor::wait(std::future<void> &task) {
+  if (task.valid()) {
+    task.wait();
+  }
+}
+
+std::shared_ptr<Executor> thread_executor() {
+  static const auto executor = std::make_shared<ThreadExecutor>();
+  return executor;
+}
+
+} // namespace toio::runtime
@@ -0,0 +1,190 @@
+#include "toio/runtime/thread_pool.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace toio::runtime {
+namespace {
+
+std::uint64_t pack(std::uint32_t front, std::uint32_t back) {
+  return (static_cast<std::uint64_t>(front) << 32) | back;
+}
+
+std::uint32_t front_of(std::uint64_t range) {
+  return static_cast<std::uint32_t>(range >> 32);
+}
+
+std::uint32_t back_of(std::uint64_t range) {
+  return static_cast<std::uint32_t>(range & 0xFFFFFFFFu);
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads)
+    : size_(threads != 0
+                ? threads
+                : std::max<std::size_t>(1, std::thread::hardware_concurrency())),
+      queues_(std::make_unique<Queue[]>(size_)) {
+  threads_.reserve(size_ - 1);
+  for (std::size_t worker = 1; worker < size_; ++worker) {
+    threads_.emplace_back([this, worker]() { worker_loop(worker); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+std::size_t ThreadPool::size() const {
+  return size_;
+}
+
+void ThreadPool::run(std::size_t count, std::size_t grain, Task task,
+                     void *context) {
+  if (count == 0) {
+    return;
+  }
+  grain = std::max<std::size_t>(grain, 1);
+  // チャンクの番号は 32 ビットに収める。
+  constexpr std::size_t kMaxChunks = std::numeric_limits<std::uint32_t>::max();
+  if ((count - 1) / grain + 1 > kMaxChunks) {
+    grain = (count - 1) / kMaxChunks + 1;
+  }
+  const std::size_t chunks = (count - 1) / grain + 1;
+  if (size_ == 1 || chunks == 1) {
+    task(context, 0, count, 0);
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // 前の parallel_for に遅れて加わったスレッドが抜けるまで、列を作り直さない。
+    done_cv_.wait(lock, [this]() { return active_ == 0; });
+    task_ = task;
+    context_ = context;
+    count_ = count;
+    grain_ = grain;
+    error_ = nullptr;
+    remaining_.store(chunks);
+    // 連続したチャンクをまとめて配る。近くの添字は近くの Cube であることが
+    // 多く、キャッシュに載ったまま処理できる。
+    for (std::size_t worker = 0; worker < size_; ++worker) {
+      queues_[worker].range.store(
+          pack(static_cast<std::uint32_t>(chunks * worker / size_),
+               static_cast<std::uint32_t>(chunks * (worker + 1) / size_)));
+    }
+    ++generation_;
+  }
+  start_cv_.notify_all();
+  work(0);
+
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return remaining_.load() == 0; });
+    error = std::exchange(error_, nullptr);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::worker_loop(std::size_t worker) {
+  std::uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_cv_.wait(lock, [this, seen]() {
+        return stopping_ || generation_ != seen;
+      });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+      ++active_;
+    }
+    work(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--active_ == 0) {
+        done_cv_.notify_all();
+      }
+    }
+  }
+}
+
+void ThreadPool::work(std::size_t worker) {
+  std::uint32_t chunk = 0;
+  while (pop_front(worker, chunk)) {
+    execute(worker, chunk);
+  }
+  // 自分の分が尽きたら、隣から順に末尾を盗む。チャンクは増えないので、
+  // 1 周して何も取れなければ終わり。
+  bool stolen = true;
+  while (stolen && remaining_.load(std::memory_order_acquire) != 0) {
+    stolen = false;
+    for (std::size_t k = 1; k < size_; ++k) {
+      const auto victim = (worker + k) % size_;
+      while (steal_back(victim, chunk)) {
+        execute(worker, chunk);
+        stolen = true;
+      }
+    }
+  }
+}
+
+bool ThreadPool::pop_front(std::size_t worker, std::uint32_t &chunk) {
+  auto &range = queues_[worker].range;
+  auto current = range.load(std::memory_order_acquire);
+  while (front_of(current) < back_of(current)) {
+    if (range.compare_exchange_weak(
+            current, pack(front_of(current) + 1, back_of(current)),
+            std::memory_order_acq_rel, std::memory_order_acquire)) {
+      chunk = front_of(current);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ThreadPool::steal_back(std::size_t victim, std::uint32_t &chunk) {
+  auto &range = queues_[victim].range;
+  auto current = range.load(std::memory_order_acquire);
+  while (front_of(current) < back_of(current)) {
+    if (range.compare_exchange_weak(
+            current, pack(front_of(current), back_of(current) - 1),
+            std::memory_order_acq_rel, std::memory_order_acquire)) {
+      chunk = back_of(current) - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::execute(std::size_t worker, std::uint32_t chunk) {
+  const auto begin = static_cast<std::size_t>(chunk) * grain_;
+  const auto end = std::min(count_, begin + grain_);
+  try {
+    task_(context_, begin, end, worker);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+  }
+  if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_cv_.notify_all();
+  }
+}
+
+} // namespace toio::runtime
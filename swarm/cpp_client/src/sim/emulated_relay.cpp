@@ -0,0 +1,554 @@
+#include "toio/sim/emulated_relay.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace toio::sim {
+
+namespace {
+
+using Json = nlohmann::json;
+
+constexpr std::size_t kMaxMultiTargets = 29;
+constexpr int kMaxDurationMs = 2550;
+constexpr const char *kStopAllTarget = "*";
+
+int read_int(const Json &obj, const char *key, int fallback) {
+  auto it = obj.find(key);
+  if (it == obj.end() || !it->is_number()) {
+    return fallback;
+  }
+  return it->is_number_integer() ? it->get<int>()
+                                 : static_cast<int>(it->get<double>());
+}
+
+std::optional<transport::MoveType> parse_move_type(const std::string &name) {
+  if (name == "curve") {
+    return transport::MoveType::Curve;
+  }
+  if (name == "curve_no_reverse") {
+    return transport::MoveType::CurveNoReverse;
+  }
+  if (name == "rotate_then_move") {
+    return transport::MoveType::RotateThenMove;
+  }
+  return std::nullopt;
+}
+
+transport::MoveTarget parse_target(const Json &obj) {
+  transport::MoveTarget target;
+  target.x = read_int(obj, "x", 0);
+  target.y = read_int(obj, "y", 0);
+  if (auto it = obj.find("angle"); it != obj.end() && it->is_number()) {
+    target.angle = read_int(obj, "angle", 0);
+  }
+  return target;
+}
+
+std::vector<CubePose> initial_layout(std::size_t count,
+                                     const MatBounds &bounds) {
+  std::vector<CubePose> poses;
+  if (count == 0) {
+    return poses;
+  }
+  const double width = std::max(1.0, bounds.max_x - bounds.min_x);
+  const double height = std::max(1.0, bounds.max_y - bounds.min_y);
+  const auto columns = static_cast<std::size_t>(std::max(
+      1.0, std::ceil(std::sqrt(static_cast<double>(count) * width / height))));
+  const std::size_t rows = (count + columns - 1) / columns;
+  poses.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const double cx = (static_cast<double>(i % columns) + 0.5) /
+                      static_cast<double>(columns);
+    const double cy = (static_cast<double>(i / columns) + 0.5) /
+                      static_cast<double>(rows);
+    poses.push_back(
+        CubePose{bounds.min_x + width * cx, bounds.min_y + height * cy, 270.0});
+  }
+  return poses;
+}
+
+} // namespace
+
+EmulatedRelay::EmulatedRelay(EmulatorConfig config)
+    : config_(std::move(config)), rng_(config_.seed) {
+  const auto poses = initial_layout(config_.cube_ids.size(), config_.cube.bounds);
+  cubes_.reserve(config_.cube_ids.size());
+  links_.resize(config_.cube_ids.size());
+  for (std::size_t i = 0; i < config_.cube_ids.size(); ++i) {
+    cubes_.emplace_back(config_.cube_ids[i], poses[i], config_.cube);
+    index_.emplace(config_.cube_ids[i], i);
+    links_[i].connected = config_.connected_at_start;
+    // 通知のタイミングを Cube ごとにずらす。
+    links_[i].next_notify =
+        config_.notify_interval * static_cast<std::int64_t>(i) /
+        static_cast<std::int64_t>(std::max<std::size_t>(1, cubes_.size()));
+  }
+}
+
+EmulatedRelay::ClientId EmulatedRelay::add_client(Sink sink) {
+  const ClientId id = next_client_++;
+  clients_.emplace(id, Client{std::move(sink), now_, {}});
+  send(id, Json{{"type", "system"},
+                {"payload",
+                 {{"status", "connected"},
+                  {"message", "WebSocket connection established."}}}});
+  return id;
+}
+
+void EmulatedRelay::remove_client(ClientId client) {
+  auto it = clients_.find(client);
+  if (it == clients_.end()) {
+    return;
+  }
+  for (auto cube : it->second.subscriptions) {
+    links_[cube].subscribers.erase(client);
+  }
+  clients_.erase(it);
+}
+
+void EmulatedRelay::handle_message(ClientId client,
+                                   const Json &message,
+                                   SimTime now) {
+  advance(now);
+  schedule(client, message, now);
+  advance(now);
+}
+
+SimTime EmulatedRelay::now() const {
+  return now_;
+}
+
+const std::vector<SimCube> &EmulatedRelay::cubes() const {
+  return cubes_;
+}
+
+std::size_t EmulatedRelay::pending_operations() const {
+  return operations_.size();
+}
+
+void EmulatedRelay::schedule(ClientId client, const Json &message,
+                             SimTime now) {
+  auto client_it = clients_.find(client);
+  if (client_it == clients_.end()) {
+    return;
+  }
+  auto &state = client_it->second;
+  const SimTime start = config_.ble.serialize_per_client
+                            ? std::max(now, state.busy_until)
+                            : now;
+
+  Operation op;
+  op.client = client;
+  op.due = start;
+  op.type = message.value("type", "");
+  if (auto it = message.find("payload"); it != message.end() && it->is_object()) {
+    op.payload = *it;
+  } else {
+    op.payload = Json::object();
+  }
+
+  const std::string target = op.payload.value("target", "");
+  const auto cube = find_cube(target);
+  if (op.type == "command") {
+    const std::string cmd = op.payload.value("cmd", "");
+    if (cmd == "stop_all") {
+      // Cube ごとの停止を並列に配送し、最後の配送で result を返す。
+      std::vector<std::size_t> stopping;
+      if (auto it = op.payload.find("params");
+          it != op.payload.end() && it->contains("targets")) {
+        for (const auto &id : (*it)["targets"]) {
+          if (id.is_string()) {
+            if (auto found = find_cube(id.get<std::string>());
+                found && links_[*found].connected) {
+              stopping.push_back(*found);
+            }
+          }
+        }
+      } else {
+        for (std::size_t i = 0; i < links_.size(); ++i) {
+          if (links_[i].connected) {
+            stopping.push_back(i);
+          }
+        }
+      }
+      for (auto index : stopping) {
+        Operation stop;
+        stop.client = client;
+        stop.type = "stop";
+        stop.cube = index;
+        stop.due = ble_delivery(index, start);
+        stop.sequence = next_sequence_++;
+        op.due = std::max(op.due, stop.due);
+        operations_.push(std::move(stop));
+      }
+    } else if (cube && cmd != "connect") {
+      if (links_[*cube].queued >= config_.ble.queue_limit) {
+        op.type = "overflow";
+      } else {
+        op.cube = cube;
+        op.due = ble_delivery(*cube, start);
+      }
+    } else if (cube) {
+      op.due = start + config_.ble.latency;
+    }
+  } else if (op.type == "query" && cube &&
+             op.payload.value("info", "") == "battery") {
+    op.cube = cube;
+    op.due = ble_delivery(*cube, start);
+  }
+
+  if (config_.ble.serialize_per_client) {
+    state.busy_until = op.due;
+  }
+  op.sequence = next_sequence_++;
+  operations_.push(std::move(op));
+}
+
+SimTime EmulatedRelay::ble_delivery(std::size_t cube, SimTime now) {
+  auto &link = links_[cube];
+  SimTime due = now + config_.ble.latency;
+  if (config_.ble.jitter.count() > 0) {
+    const auto jitter_us = static_cast<std::int64_t>(
+        rng_() % static_cast<std::uint64_t>(config_.ble.jitter.count() + 1));
+    due += std::chrono::microseconds(jitter_us);
+  }
+  due = std::max(due, link.next_slot);
+  link.next_slot = due + config_.ble.interval;
+  ++link.queued;
+  return due;
+}
+
+void EmulatedRelay::advance(SimTime now) {
+  while (!operations_.empty() && operations_.top().due <= now) {
+    Operation op = operations_.top();
+    operations_.pop();
+    step_physics(op.due);
+    if (op.cube && op.type != "overflow") {
+      auto &link = links_[*op.cube];
+      link.queued = link.queued > 0 ? link.queued - 1 : 0;
+    }
+    execute(op);
+    flush_target_events();
+  }
+  step_physics(now);
+}
+
+void EmulatedRelay::step_physics(SimTime until) {
+  const auto step = std::max<SimTime>(config_.physics_step, SimTime(1000));
+  while (now_ < until) {
+    const auto dt = std::min<SimTime>(step, until - now_);
+    now_ += dt;
+    const double seconds = std::chrono::duration<double>(dt).count();
+    for (auto &cube : cubes_) {
+      cube.step(now_, seconds, target_events_);
+    }
+    flush_target_events();
+    publish_positions();
+  }
+}
+
+void EmulatedRelay::execute(const Operation &op) {
+  if (op.type == "command" || op.type == "stop" || op.type == "overflow") {
+    execute_command(op);
+  } else if (op.type == "query") {
+    execute_query(op);
+  } else if (op.type == "system") {
+    send(op.client, Json{{"type", "system"},
+                         {"payload",
+                          {{"status", op.payload.value("status", Json())},
+                           {"message", op.payload.value("message", Json())}}}});
+  } else {
+    send(op.client, Json{{"type", "error"},
+                         {"payload", {{"message", "Unknown message type"}}}});
+  }
+}
+
+void EmulatedRelay::execute_command(const Operation &op) {
+  const auto &payload = op.payload;
+  const std::string cmd = payload.value("cmd", "");
+  const std::string target = payload.value("target", "");
+  const bool require_result = payload.value("require_result", true);
+  const Json params = payload.contains("params") && payload["params"].is_object()
+                          ? payload["params"]
+                          : Json::object();
+  auto result = [&](bool success, const std::string &message = {}) {
+    send_result(op.client, cmd, target, success, message, require_result);
+  };
+
+  if (op.type == "stop") {
+    cubes_[*op.cube].set_motor(0, 0, SimTime(0), now_, target_events_);
+    return;
+  }
+  if (op.type == "overflow") {
+    result(false, "BLE queue full");
+    return;
+  }
+  if (cmd == "stop_all") {
+    std::vector<std::string> missing;
+    if (auto it = params.find("targets"); it != params.end() && it->is_array()) {
+      for (const auto &id : *it) {
+        if (!id.is_string()) {
+          continue;
+        }
+        auto cube = find_cube(id.get<std::string>());
+        if (!cube || !links_[*cube].connected) {
+          missing.push_back(id.get<std::string>());
+        }
+      }
+    }
+    if (missing.empty()) {
+      send_result(op.client, cmd, kStopAllTarget, true, {}, require_result);
+    } else {
+      std::string joined;
+      for (const auto &id : missing) {
+        joined += (joined.empty() ? "" : ",") + id;
+      }
+      send_result(op.client, cmd, kStopAllTarget, false,
+                  "Device not connected: " + joined, require_result);
+    }
+    return;
+  }
+
+  const auto cube = find_cube(target);
+  if (cmd == "connect") {
+    if (!cube) {
+      result(false, "Device not found");
+    } else if (links_[*cube].connected) {
+      result(true, "Device already connected");
+    } else {
+      links_[*cube].connected = true;
+      result(true);
+    }
+    return;
+  }
+  if (cmd != "disconnect" && cmd != "move" && cmd != "move_to" &&
+      cmd != "move_to_multi" && cmd != "led") {
+    result(false, "Unknown command");
+    return;
+  }
+  if (!cube || !links_[*cube].connected) {
+    result(false, "Device not connected");
+    return;
+  }
+  auto &sim_cube = cubes_[*cube];
+
+  if (cmd == "disconnect") {
+    sim_cube.set_motor(0, 0, SimTime(0), now_, target_events_);
+    links_[*cube].connected = false;
+    const auto subscribers = links_[*cube].subscribers;
+    for (auto client : subscribers) {
+      send(client, Json{{"type", "response"},
+                        {"payload",
+                         {{"info", "position"},
+                          {"target", target},
+                          {"notify", false},
+                          {"message", "Device disconnected"}}}});
+      unsubscribe(client, *cube);
+    }
+    result(true);
+  } else if (cmd == "move") {
+    const int duration_ms =
+        std::clamp(read_int(params, "duration_ms", 0), 0, kMaxDurationMs);
+    sim_cube.set_motor(read_int(params, "left_speed", 0),
+                       read_int(params, "right_speed", 0),
+                       std::chrono::milliseconds(duration_ms), now_,
+                       target_events_);
+    result(true);
+  } else if (cmd == "led") {
+    result(true);
+  } else {
+    const auto move_type = parse_move_type(params.value("move_type", "curve"));
+    if (!move_type) {
+      result(false, "Unknown move_type: " + params.value("move_type", ""));
+      return;
+    }
+    TargetRequest request;
+    request.request_id = read_int(params, "request_id", 0);
+    request.max_speed = read_int(params, "max_speed", 80);
+    request.move_type = *move_type;
+    request.timeout = std::chrono::seconds(read_int(params, "timeout", 0));
+    request.cmd = cmd;
+    request.target = target;
+    request.client = op.client;
+    request.require_result = require_result;
+    bool append = false;
+    if (cmd == "move_to") {
+      request.points.push_back(parse_target(params));
+    } else {
+      if (auto it = params.find("targets"); it != params.end() && it->is_array()) {
+        for (const auto &point : *it) {
+          request.points.push_back(parse_target(point));
+        }
+      }
+      if (request.points.empty() || request.points.size() > kMaxMultiTargets) {
+        result(false, "targets must contain 1.." +
+                          std::to_string(kMaxMultiTargets) + " points");
+        return;
+      }
+      append = params.value("write_mode", "overwrite") == "append";
+    }
+    sim_cube.set_target(std::move(request), append, now_, target_events_);
+  }
+}
+
+void EmulatedRelay::execute_query(const Operation &op) {
+  const auto &payload = op.payload;
+  const std::string info = payload.value("info", "");
+  const std::string target = payload.value("target", "");
+  const auto cube = find_cube(target);
+  if (!cube || !links_[*cube].connected) {
+    if (cube) {
+      unsubscribe(op.client, *cube);
+    }
+    send(op.client, Json{{"type", "response"},
+                         {"payload",
+                          {{"info", info},
+                           {"target", target},
+                           {"message", "Device not connected"}}}});
+    return;
+  }
+  if (info == "battery") {
+    send(op.client, Json{{"type", "response"},
+                         {"payload",
+                          {{"info", info},
+                           {"target", target},
+                           {"battery_level", config_.battery_percent}}}});
+  } else if (info == "position") {
+    auto client_it = clients_.find(op.client);
+    if (client_it == clients_.end()) {
+      return;
+    }
+    const auto notify = payload.find("notify");
+    if (notify != payload.end() && notify->is_boolean() && notify->get<bool>()) {
+      links_[*cube].subscribers.insert(op.client);
+      client_it->second.subscriptions.insert(*cube);
+    } else {
+      unsubscribe(op.client, *cube);
+    }
+    send(op.client,
+         Json{{"type", "response"},
+              {"payload",
+               {{"info", info},
+                {"target", target},
+                {"notify", links_[*cube].subscribers.count(op.client) > 0},
+                {"position", position_json(*cube)}}}});
+  } else {
+    send(op.client, Json{{"type", "response"},
+                         {"payload",
+                          {{"info", info},
+                           {"target", target},
+                           {"message", "Unknown query"}}}});
+  }
+}
+
+void EmulatedRelay::publish_positions() {
+  for (std::size_t i = 0; i < cubes_.size(); ++i) {
+    auto &link = links_[i];
+    if (now_ < link.next_notify) {
+      continue;
+    }
+    link.next_notify += config_.notify_interval;
+    if (link.next_notify <= now_) {
+      link.next_notify = now_ + config_.notify_interval;
+    }
+    if (link.subscribers.empty()) {
+      continue;
+    }
+    const auto &pose = cubes_[i].pose();
+    const auto snapshot = std::make_tuple(
+        static_cast<int>(std::lround(pose.x)),
+        static_cast<int>(std::lround(pose.y)),
+        static_cast<int>(std::lround(pose.angle)) % 360, cubes_[i].on_mat());
+    if (link.last_notified == snapshot) {
+      continue;
+    }
+    link.last_notified = snapshot;
+    const Json message{{"type", "response"},
+                       {"payload",
+                        {{"info", "position"},
+                         {"target", cubes_[i].id()},
+                         {"notify", true},
+                         {"position", position_json(i)}}}};
+    for (auto client : link.subscribers) {
+      send(client, message);
+    }
+  }
+}
+
+void EmulatedRelay::flush_target_events() {
+  for (auto &event : target_events_) {
+    const bool success = event.response == TargetResponse::Success;
+    if (success && !event.request.require_result) {
+      continue;
+    }
+    send(event.request.client,
+         Json{{"type", "result"},
+              {"payload",
+               {{"cmd", event.request.cmd},
+                {"target", event.request.target},
+                {"status", success ? "success" : "error"},
+                {"request_id", event.request.request_id},
+                {"message", to_string(event.response)}}}});
+  }
+  target_events_.clear();
+}
+
+Json EmulatedRelay::position_json(std::size_t cube) const {
+  const auto &pose = cubes_[cube].pose();
+  return Json{
+      {"x", static_cast<int>(std::lround(pose.x))},
+      {"y", static_cast<int>(std::lround(pose.y))},
+      {"angle", static_cast<int>(std::lround(pose.angle)) % 360},
+      {"on_mat", cubes_[cube].on_mat()},
+      {"timestamp_ms",
+       config_.epoch_ms +
+           static_cast<std::uint64_t>(
+               std::chrono::duration_cast<std::chrono::milliseconds>(now_)
+                   .count())},
+  };
+}
+
+void EmulatedRelay::send(ClientId client, const Json &message) {
+  auto it = clients_.find(client);
+  if (it != clients_.end() && it->second.sink) {
+    it->second.sink(message);
+  }
+}
+
+void EmulatedRelay::send_result(ClientId client,
+                                const std::string &cmd,
+                                const std::string &target,
+                                bool success,
+                                const std::string &message,
+                                bool require_result) {
+  if (success && !require_result) {
+    return;
+  }
+  Json payload{{"cmd", cmd},
+               {"target", target},
+               {"status", success ? "success" : "error"}};
+  if (!message.empty()) {
+    payload["message"] = message;
+  }
+  send(client, Json{{"type", "result"}, {"payload", std::move(payload)}});
+}
+
+void EmulatedRelay::unsubscribe(ClientId client, std::size_t cube) {
+  links_[cube].subscribers.erase(client);
+  if (auto it = clients_.find(client); it != clients_.end()) {
+    it->second.subscriptions.erase(cube);
+  }
+}
+
+std::optional<std::size_t>
+EmulatedRelay::find_cube(const std::string &id) const {
+  auto it = index_.find(id);
+  if (it == index_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+} // namespace toio::sim
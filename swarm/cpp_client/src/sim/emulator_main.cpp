@@ -0,0 +1,179 @@
+// toio_relay_emulator: relay_server/server.py の代わりに仮想 Cube を動かす。
+//   ./toio_relay_emulator --cubes 100 --port 8765 --write-config emu.yaml
+//   ./toio_cli --fleet-config emu.yaml
+
+#include "toio/sim/relay_emulator_server.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using toio::sim::EmulatorConfig;
+using toio::sim::RelayEmulatorOptions;
+using toio::sim::RelayEmulatorServer;
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void handle_signal(int) {
+  g_stop = true;
+}
+
+struct EmulatorArgs {
+  EmulatorConfig config;
+  RelayEmulatorOptions server;
+  std::size_t cube_count = 30;
+  std::string prefix = "S";
+  std::string server_id = "emu";
+  std::string write_config;
+};
+
+void print_usage(const char *argv0) {
+  std::cout
+      << "Usage: " << argv0 << " [options]\n"
+      << "  --host <addr>          Listen address (default 127.0.0.1)\n"
+      << "  --port <port>          Listen port (default 8765)\n"
+      << "  --cubes <N>            Number of virtual cubes (default 30)\n"
+      << "  --prefix <str>         Cube id prefix (default S -> S000, S001...)\n"
+      << "  --ids <a,b,c>          Explicit cube ids (overrides --cubes)\n"
+      << "  --latency-ms <ms>      BLE write latency (default 15)\n"
+      << "  --jitter-ms <ms>       BLE latency jitter (default 5)\n"
+      << "  --interval-ms <ms>     BLE connection interval per cube (default 30)\n"
+      << "  --queue-limit <n>      Pending commands per cube (default 64)\n"
+      << "  --notify-ms <ms>       Position notification period (default 30)\n"
+      << "  --serial               Process each client's messages one by one\n"
+      << "                         like the Python relay\n"
+      << "  --connected            Start with all cubes connected\n"
+      << "  --seed <n>             RNG seed for latency jitter (default 1)\n"
+      << "  --server-id <id>       servers[].id used by --write-config\n"
+      << "  --write-config <path>  Write a fleet YAML for toio_cli on startup\n";
+}
+
+EmulatorArgs parse_args(int argc, char **argv) {
+  EmulatorArgs args;
+  std::vector<std::string> ids;
+  auto value = [&](int &i, const std::string &name) -> std::string {
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + name);
+    }
+    return argv[++i];
+  };
+  auto millis = [](const std::string &text) {
+    return std::chrono::microseconds(
+        static_cast<std::int64_t>(std::stod(text) * 1000.0));
+  };
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--host") {
+      args.server.host = value(i, arg);
+    } else if (arg == "--port") {
+      args.server.port = static_cast<unsigned short>(std::stoi(value(i, arg)));
+    } else if (arg == "--cubes") {
+      args.cube_count = static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--prefix") {
+      args.prefix = value(i, arg);
+    } else if (arg == "--ids") {
+      std::istringstream stream(value(i, arg));
+      std::string id;
+      while (std::getline(stream, id, ',')) {
+        if (!id.empty()) {
+          ids.push_back(id);
+        }
+      }
+    } else if (arg == "--latency-ms") {
+      args.config.ble.latency = millis(value(i, arg));
+    } else if (arg == "--jitter-ms") {
+      args.config.ble.jitter = millis(value(i, arg));
+    } else if (arg == "--interval-ms") {
+      args.config.ble.interval = millis(value(i, arg));
+    } else if (arg == "--queue-limit") {
+      args.config.ble.queue_limit =
+          static_cast<std::size_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--notify-ms") {
+      args.config.notify_interval = millis(value(i, arg));
+    } else if (arg == "--serial") {
+      args.config.ble.serialize_per_client = true;
+    } else if (arg == "--connected") {
+      args.config.connected_at_start = true;
+    } else if (arg == "--seed") {
+      args.config.seed = static_cast<std::uint32_t>(std::stoul(value(i, arg)));
+    } else if (arg == "--server-id") {
+      args.server_id = value(i, arg);
+    } else if (arg == "--write-config") {
+      args.write_config = value(i, arg);
+    } else if (arg == "--help" || arg == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else {
+      throw std::runtime_error("Unknown argument: " + arg);
+    }
+  }
+
+  if (ids.empty()) {
+    for (std::size_t i = 0; i < args.cube_count; ++i) {
+      std::ostringstream id;
+      id << args.prefix << std::setw(3) << std::setfill('0') << i;
+      ids.push_back(id.str());
+    }
+  }
+  args.config.cube_ids = std::move(ids);
+  return args;
+}
+
+void write_fleet_config(const EmulatorArgs &args, unsigned short port) {
+  std::ofstream out(args.write_config);
+  if (!out) {
+    throw std::runtime_error("Failed to write " + args.write_config);
+  }
+  out << "# toio_relay_emulator が生成した設定\n"
+      << "servers:\n"
+      << "  - id: " << args.server_id << "\n"
+      << "    host: " << (args.server.host == "0.0.0.0" ? "127.0.0.1"
+                                                        : args.server.host)
+      << "\n"
+      << "    port: " << port << "\n"
+      << "    endpoint: /ws\n"
+      << "    cubes:\n";
+  for (const auto &id : args.config.cube_ids) {
+    out << "      - id: " << id << "\n"
+        << "        auto_connect: true\n";
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  try {
+    const EmulatorArgs args = parse_args(argc, argv);
+    RelayEmulatorServer server(args.config, args.server);
+    server.start();
+    std::cout << "toio relay emulator listening on ws://" << args.server.host
+              << ":" << server.port() << "/ws with "
+              << args.config.cube_ids.size() << " cube(s)" << std::endl;
+    if (!args.write_config.empty()) {
+      write_fleet_config(args, server.port());
+      std::cout << "Fleet config written to " << args.write_config
+                << std::endl;
+    }
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    while (!g_stop) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    server.stop();
+  } catch (const std::exception &ex) {
+    std::cerr << "Error: " << ex.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
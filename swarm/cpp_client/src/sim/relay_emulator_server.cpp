@@ -0,0 +1,266 @@
+#include "toio/sim/relay_emulator_server.hpp"
+
+#include <iostream>
+
+#include <boost/asio/connect.hpp>
+#include <boost/beast/core.hpp>
+
+namespace toio::sim {
+
+namespace {
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+std::uint64_t epoch_ms_now() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+EmulatorConfig with_epoch(EmulatorConfig config) {
+  if (config.epoch_ms == 0) {
+    config.epoch_ms = epoch_ms_now();
+  }
+  return config;
+}
+} // namespace
+
+RelayEmulatorServer::RelayEmulatorServer(EmulatorConfig config,
+                                         RelayEmulatorOptions options)
+    : options_(std::move(options)),
+      started_at_(std::chrono::steady_clock::now()),
+      relay_(with_epoch(std::move(config))),
+      acceptor_(io_context_) {}
+
+RelayEmulatorServer::~RelayEmulatorServer() {
+  try {
+    stop();
+  } catch (...) {
+  }
+}
+
+void RelayEmulatorServer::start() {
+  if (running_) {
+    return;
+  }
+  const tcp::endpoint endpoint(asio::ip::make_address(options_.host),
+                               options_.port);
+  acceptor_.open(endpoint.protocol());
+  acceptor_.set_option(asio::socket_base::reuse_address(true));
+  acceptor_.bind(endpoint);
+  acceptor_.listen();
+
+  running_ = true;
+  accept_thread_ = std::thread([this] { accept_loop(); });
+  tick_thread_ = std::thread([this] { tick_loop(); });
+}
+
+void RelayEmulatorServer::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  // 同期 accept はソケットを閉じても戻らないことがあるため、自分に接続して
+  // 起こしてから閉じる。
+  {
+    beast::error_code ec;
+    tcp::socket wake(io_context_);
+    wake.connect(tcp::endpoint(asio::ip::make_address(options_.host), port()),
+                 ec);
+  }
+  if (accept_thread_.joinable()) {
+    accept_thread_.join();
+  }
+  if (tick_thread_.joinable()) {
+    tick_thread_.join();
+  }
+  beast::error_code ec;
+  acceptor_.close(ec);
+
+  std::list<std::unique_ptr<Connection>> connections;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    connections.swap(connections_);
+  }
+  for (auto &connection : connections) {
+    close_connection(*connection);
+  }
+}
+
+unsigned short RelayEmulatorServer::port() const {
+  beast::error_code ec;
+  const auto endpoint = acceptor_.local_endpoint(ec);
+  return ec ? options_.port : endpoint.port();
+}
+
+SimTime RelayEmulatorServer::elapsed() const {
+  return std::chrono::duration_cast<SimTime>(std::chrono::steady_clock::now() -
+                                             started_at_);
+}
+
+void RelayEmulatorServer::accept_loop() {
+  while (running_) {
+    beast::error_code ec;
+    tcp::socket socket(io_context_);
+    acceptor_.accept(socket, ec);
+    if (!running_) {
+      break;
+    }
+    if (ec) {
+      if (running_) {
+        std::cerr << "[RelayEmulator] accept error: " << ec.message()
+                  << std::endl;
+      }
+      break;
+    }
+    reap_finished();
+    socket.set_option(tcp::no_delay(true), ec);
+
+    auto connection = std::make_unique<Connection>(std::move(socket));
+    auto &ref = *connection;
+    {
+      std::lock_guard<std::mutex> lock(connections_mutex_);
+      connections_.push_back(std::move(connection));
+    }
+    ref.reader = std::thread([this, &ref] { serve(ref); });
+  }
+}
+
+void RelayEmulatorServer::tick_loop() {
+  auto next = std::chrono::steady_clock::now();
+  while (running_) {
+    next += options_.tick;
+    {
+      std::lock_guard<std::mutex> lock(relay_mutex_);
+      relay_.advance(elapsed());
+    }
+    std::this_thread::sleep_until(next);
+    const auto now = std::chrono::steady_clock::now();
+    if (now > next + options_.tick * 10) {
+      // 大きく遅れた場合は追いつこうとせず基準を取り直す。
+      next = now;
+    }
+  }
+}
+
+void RelayEmulatorServer::serve(Connection &connection) {
+  beast::error_code ec;
+  connection.websocket.accept(ec);
+  if (ec) {
+    std::cerr << "[RelayEmulator] handshake error: " << ec.message()
+              << std::endl;
+    connection.finished = true;
+    return;
+  }
+  connection.writer = std::thread([this, &connection] {
+    write_loop(connection);
+  });
+  {
+    std::lock_guard<std::mutex> lock(relay_mutex_);
+    connection.client = relay_.add_client([&connection](
+                                              const nlohmann::json &message) {
+      {
+        std::lock_guard<std::mutex> queue_lock(connection.mutex);
+        connection.outgoing.push_back(message.dump());
+      }
+      connection.cv.notify_one();
+    });
+  }
+
+  beast::flat_buffer buffer;
+  while (running_) {
+    connection.websocket.read(buffer, ec);
+    if (ec) {
+      break;
+    }
+    const auto text = beast::buffers_to_string(buffer.data());
+    buffer.consume(buffer.size());
+    nlohmann::json message;
+    try {
+      message = nlohmann::json::parse(text);
+    } catch (const std::exception &) {
+      std::lock_guard<std::mutex> queue_lock(connection.mutex);
+      connection.outgoing.push_back(
+          nlohmann::json{{"type", "error"},
+                         {"payload", {{"message", "Invalid JSON"}}}}
+              .dump());
+      connection.cv.notify_one();
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(relay_mutex_);
+    relay_.handle_message(connection.client, message, elapsed());
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(relay_mutex_);
+    relay_.remove_client(connection.client);
+  }
+  {
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    connection.closing = true;
+  }
+  connection.cv.notify_one();
+  connection.finished = true;
+}
+
+void RelayEmulatorServer::write_loop(Connection &connection) {
+  std::unique_lock<std::mutex> lock(connection.mutex);
+  while (true) {
+    connection.cv.wait(lock, [&] {
+      return connection.closing || !connection.outgoing.empty();
+    });
+    if (connection.outgoing.empty()) {
+      break;
+    }
+    auto batch = std::move(connection.outgoing);
+    connection.outgoing.clear();
+    lock.unlock();
+    for (const auto &text : batch) {
+      beast::error_code ec;
+      connection.websocket.write(asio::buffer(text), ec);
+      if (ec) {
+        break;
+      }
+    }
+    lock.lock();
+  }
+}
+
+void RelayEmulatorServer::close_connection(Connection &connection) {
+  beast::error_code ec;
+  connection.websocket.next_layer().shutdown(tcp::socket::shutdown_both, ec);
+  if (connection.reader.joinable()) {
+    connection.reader.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    connection.closing = true;
+  }
+  connection.cv.notify_one();
+  if (connection.writer.joinable()) {
+    connection.writer.join();
+  }
+  connection.websocket.next_layer().close(ec);
+}
+
+void RelayEmulatorServer::reap_finished() {
+  std::list<std::unique_ptr<Connection>> finished;
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex_);
+    for (auto it = connections_.begin(); it != connections_.end();) {
+      if ((*it)->finished) {
+        finished.push_back(std::move(*it));
+        it = connections_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto &connection : finished) {
+    close_connection(*connection);
+  }
+}
+
+} // namespace toio::sim
@@ -0,0 +1,256 @@
+#include "toio/sim/sim_cube.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace toio::sim {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kDegToRad = kPi / 180.0;
+
+double wrap_deg180(double angle) {
+  double wrapped = std::fmod(angle + 180.0, 360.0);
+  if (wrapped < 0) {
+    wrapped += 360.0;
+  }
+  return wrapped - 180.0;
+}
+
+double wrap_deg360(double angle) {
+  double wrapped = std::fmod(angle, 360.0);
+  if (wrapped < 0) {
+    wrapped += 360.0;
+  }
+  return wrapped;
+}
+
+} // namespace
+
+std::string to_string(TargetResponse response) {
+  switch (response) {
+  case TargetResponse::Success:
+    return "SUCCESS";
+  case TargetResponse::Timeout:
+    return "ERROR_TIMEOUT";
+  case TargetResponse::ToioIdMissed:
+    return "ERROR_ID_MISSED";
+  case TargetResponse::InvalidParameter:
+    return "ERROR_INVALID_PARAMETER";
+  case TargetResponse::InvalidState:
+    return "ERROR_INVALID_CUBE_STATE";
+  case TargetResponse::OtherWrite:
+    return "SUCCESS_WITH_OVERWRITE";
+  case TargetResponse::NotSupported:
+    return "ERROR_NOT_SUPPORTED";
+  case TargetResponse::FailedToAppend:
+  default:
+    return "ERROR_FAILED_TO_APPEND";
+  }
+}
+
+SimCube::SimCube(std::string id, CubePose pose, const CubeModelParams &params)
+    : id_(std::move(id)), pose_(pose), params_(params) {}
+
+const std::string &SimCube::id() const {
+  return id_;
+}
+
+const CubePose &SimCube::pose() const {
+  return pose_;
+}
+
+bool SimCube::on_mat() const {
+  return on_mat_;
+}
+
+bool SimCube::moving() const {
+  return wheel_left_ != 0.0 || wheel_right_ != 0.0 || command_left_ != 0.0 ||
+         command_right_ != 0.0 || !targets_.empty();
+}
+
+void SimCube::set_motor(int left,
+                        int right,
+                        SimTime duration,
+                        SimTime now,
+                        std::vector<TargetEvent> &events) {
+  abort_targets(events);
+  command_left_ = left;
+  command_right_ = right;
+  if (duration.count() > 0 && (left != 0 || right != 0)) {
+    motor_deadline_ = now + duration;
+  } else {
+    motor_deadline_.reset();
+  }
+}
+
+void SimCube::set_target(TargetRequest request,
+                         bool append,
+                         SimTime now,
+                         std::vector<TargetEvent> &events) {
+  if (request.points.empty()) {
+    events.push_back(
+        TargetEvent{std::move(request), TargetResponse::InvalidParameter});
+    return;
+  }
+  if (!append) {
+    abort_targets(events);
+  }
+  if (targets_.empty()) {
+    target_point_ = 0;
+    point_started_ = now;
+    rotating_in_place_ = false;
+  }
+  motor_deadline_.reset();
+  targets_.push_back(std::move(request));
+}
+
+void SimCube::abort_targets(std::vector<TargetEvent> &events) {
+  while (!targets_.empty()) {
+    events.push_back(
+        TargetEvent{std::move(targets_.front()), TargetResponse::OtherWrite});
+    targets_.pop_front();
+  }
+  target_point_ = 0;
+  rotating_in_place_ = false;
+}
+
+std::pair<double, double>
+SimCube::target_command(SimTime now, std::vector<TargetEvent> &events) {
+  while (!targets_.empty()) {
+    auto &request = targets_.front();
+    const auto timeout = request.timeout.count() > 0
+                             ? request.timeout
+                             : params_.default_target_timeout;
+    if (now - point_started_ > timeout) {
+      events.push_back(
+          TargetEvent{std::move(request), TargetResponse::Timeout});
+      targets_.pop_front();
+      target_point_ = 0;
+      point_started_ = now;
+      continue;
+    }
+
+    const auto &point = request.points[target_point_];
+    const double max_speed =
+        std::clamp(request.max_speed, params_.deadzone, params_.max_speed);
+    const double min_speed =
+        std::min<double>(max_speed, std::max(params_.target_min_speed,
+                                             params_.deadzone));
+    const double dx = point.x - pose_.x;
+    const double dy = point.y - pose_.y;
+    const double dist = std::hypot(dx, dy);
+
+    if (dist > params_.target_tolerance) {
+      double error = wrap_deg180(std::atan2(dy, dx) / kDegToRad - pose_.angle);
+      double direction = 1.0;
+      if (request.move_type == transport::MoveType::Curve &&
+          std::abs(error) > 90.0) {
+        direction = -1.0;
+        error = wrap_deg180(error + 180.0);
+      }
+      const double turn =
+          std::clamp(params_.target_turn_gain * error, -max_speed, max_speed);
+      if (request.move_type == transport::MoveType::RotateThenMove) {
+        // 向きが揃うまでは旋回のみ。揃ったあとは多少ずれても前進する。
+        if (rotating_in_place_ ? std::abs(error) > params_.angle_tolerance_deg
+                               : std::abs(error) > 15.0) {
+          rotating_in_place_ = true;
+          // その場の旋回は両輪に spin をそのまま与える。半分にすると
+          // min_speed でも不感帯を下回って止まる。
+          const double spin = std::copysign(
+              std::max(std::abs(turn), min_speed), error);
+          return {spin, -spin};
+        }
+        rotating_in_place_ = false;
+      }
+      double speed = std::clamp(
+          max_speed * dist / std::max(params_.target_slowdown_distance, 1.0),
+          min_speed, max_speed);
+      speed *= std::max(0.0, std::cos(error * kDegToRad));
+      const double v = direction * speed;
+      return {v + 0.5 * turn, v - 0.5 * turn};
+    }
+
+    if (point.angle) {
+      const double error =
+          wrap_deg180(static_cast<double>(*point.angle) - pose_.angle);
+      if (std::abs(error) > params_.angle_tolerance_deg) {
+        const double spin = std::copysign(
+            std::clamp(std::abs(params_.target_turn_gain * error), min_speed,
+                       max_speed),
+            error);
+        return {spin, -spin};
+      }
+    }
+
+    // この点に到達。
+    ++target_point_;
+    point_started_ = now;
+    rotating_in_place_ = false;
+    if (target_point_ >= request.points.size()) {
+      events.push_back(
+          TargetEvent{std::move(request), TargetResponse::Success});
+      targets_.pop_front();
+      target_point_ = 0;
+    }
+  }
+  return {0.0, 0.0};
+}
+
+double SimCube::wheel_speed(double command) const {
+  if (std::abs(command) < params_.deadzone) {
+    return 0.0;
+  }
+  const double clamped =
+      std::clamp(command, -static_cast<double>(params_.max_speed),
+                 static_cast<double>(params_.max_speed));
+  return clamped * params_.dots_per_speed;
+}
+
+void SimCube::step(SimTime now, double dt, std::vector<TargetEvent> &events) {
+  if (dt <= 0.0) {
+    return;
+  }
+  if (motor_deadline_ && now >= *motor_deadline_) {
+    command_left_ = 0.0;
+    command_right_ = 0.0;
+    motor_deadline_.reset();
+  }
+  if (!targets_.empty()) {
+    const auto [left, right] = target_command(now, events);
+    command_left_ = left;
+    command_right_ = right;
+  }
+
+  const double target_left = wheel_speed(command_left_);
+  const double target_right = wheel_speed(command_right_);
+  const double alpha =
+      params_.motor_time_constant > 0.0
+          ? 1.0 - std::exp(-dt / params_.motor_time_constant)
+          : 1.0;
+  wheel_left_ += (target_left - wheel_left_) * alpha;
+  wheel_right_ += (target_right - wheel_right_) * alpha;
+  if (target_left == 0.0 && std::abs(wheel_left_) < 1e-3) {
+    wheel_left_ = 0.0;
+  }
+  if (target_right == 0.0 && std::abs(wheel_right_) < 1e-3) {
+    wheel_right_ = 0.0;
+  }
+
+  // 左が速いと角度が増える (y 下向き)。
+  const double v = 0.5 * (wheel_left_ + wheel_right_);
+  const double omega = (wheel_left_ - wheel_right_) / params_.tread;
+  const double mid_heading = pose_.angle * kDegToRad + 0.5 * omega * dt;
+  pose_.x += v * std::cos(mid_heading) * dt;
+  pose_.y += v * std::sin(mid_heading) * dt;
+  pose_.angle = wrap_deg360(pose_.angle + omega * dt / kDegToRad);
+
+  const auto &bounds = params_.bounds;
+  pose_.x = std::clamp(pose_.x, bounds.min_x, bounds.max_x);
+  pose_.y = std::clamp(pose_.y, bounds.min_y, bounds.max_y);
+}
+
+} // namespace toio::sim
@@ -0,0 +1,183 @@
+#include "toio/sim/simulation.hpp"
+
+#include "toio/transport/connection.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+namespace toio::sim {
+
+// EmulatedRelay の 1 クライアントとして振る舞う Connection。送信は即座に
+// リレーへ渡し、リレーからのメッセージは VirtualClock の hook で配送する。
+class Simulation::Loopback : public transport::Connection {
+public:
+  explicit Loopback(Simulation &simulation) : simulation_(simulation) {}
+
+  ~Loopback() override { close(); }
+
+  void open(ReceiveHandler on_message, LogHandler log) override {
+    if (open_) {
+      return;
+    }
+    on_message_ = std::move(on_message);
+    client_ = simulation_.relay_.add_client(
+        [this](const nlohmann::json &message) {
+          inbox_.push_back(message.dump());
+        });
+    simulation_.loopbacks_.push_back(this);
+    open_ = true;
+    if (log) {
+      log("Loopback connected to emulated relay");
+    }
+  }
+
+  void close() override {
+    if (!open_) {
+      return;
+    }
+    open_ = false;
+    simulation_.relay_.remove_client(client_);
+    auto &loopbacks = simulation_.loopbacks_;
+    loopbacks.erase(std::remove(loopbacks.begin(), loopbacks.end(), this),
+                    loopbacks.end());
+    inbox_.clear();
+  }
+
+  bool is_open() const override { return open_; }
+
+  void write(const std::string &text) override {
+    if (!open_) {
+      throw std::runtime_error("Loopback connection is closed");
+    }
+    simulation_.relay_.handle_message(client_, nlohmann::json::parse(text),
+                                      simulation_.sim_time());
+  }
+
+  // 受信済みのメッセージを渡す。渡した数を返す。
+  std::size_t deliver() {
+    std::deque<std::string> pending;
+    pending.swap(inbox_);
+    for (const auto &text : pending) {
+      if (on_message_) {
+        on_message_(text);
+      }
+    }
+    return pending.size();
+  }
+
+private:
+  Simulation &simulation_;
+  bool open_ = false;
+  EmulatedRelay::ClientId client_ = 0;
+  ReceiveHandler on_message_;
+  std::deque<std::string> inbox_;
+};
+
+namespace {
+
+EmulatorConfig with_epoch(EmulatorConfig relay,
+                          const VirtualClock::Options &clock) {
+  relay.epoch_ms = static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          clock.wall_start.time_since_epoch())
+          .count());
+  return relay;
+}
+
+} // namespace
+
+Simulation::Simulation(SimulationConfig config)
+    : config_(std::move(config)),
+      clock_(std::make_shared<VirtualClock>(config_.clock)),
+      relay_(with_epoch(config_.relay, config_.clock)) {
+  clock_->add_hook([this](runtime::Clock::time_point now) { deliver(now); });
+  if (config_.faults) {
+    faults_ = std::make_shared<fault::FaultInjector>(*config_.faults, runtime());
+  }
+}
+
+Simulation::~Simulation() {
+  // タスクを止めてから Connection を閉じる。
+  control_.reset();
+}
+
+VirtualClock &Simulation::clock() {
+  return *clock_;
+}
+
+runtime::Runtime Simulation::runtime() {
+  return runtime::Runtime{clock_, clock_};
+}
+
+middleware::ConnectionFactory Simulation::connection_factory() {
+  middleware::ConnectionFactory loopback =
+      [this](const middleware::ServerConfig &)
+      -> std::unique_ptr<transport::Connection> {
+    return std::make_unique<Loopback>(*this);
+  };
+  if (faults_) {
+    return fault::fault_injection_factory(faults_, std::move(loopback));
+  }
+  return loopback;
+}
+
+std::vector<middleware::ServerConfig> Simulation::server_configs() const {
+  middleware::ServerConfig server;
+  server.id = config_.server_id;
+  // リテラルを直接代入すると GCC 12 が -Wrestrict を誤検出する。
+  server.host = std::string("loopback");
+  server.port = std::string("0");
+  server.rate_limit = config_.rate_limit;
+  for (const auto &cube_id : config_.relay.cube_ids) {
+    middleware::CubeConfig cube;
+    cube.id = cube_id;
+    cube.auto_connect = config_.auto_connect;
+    cube.auto_subscribe = config_.auto_subscribe;
+    server.cubes.push_back(std::move(cube));
+  }
+  return {std::move(server)};
+}
+
+api::FleetControl &Simulation::control() {
+  if (!control_) {
+    control_ = std::make_unique<api::FleetControl>(
+        server_configs(), runtime(), connection_factory());
+  }
+  return *control_;
+}
+
+fault::FaultInjector *Simulation::faults() {
+  return faults_.get();
+}
+
+const EmulatedRelay &Simulation::relay() const {
+  return relay_;
+}
+
+void Simulation::run_for(runtime::Clock::duration timeout) {
+  clock_->sleep_for(timeout);
+}
+
+SimTime Simulation::sim_time() const {
+  return std::chrono::duration_cast<SimTime>(clock_->elapsed());
+}
+
+std::uint64_t Simulation::delivered_messages() const {
+  return delivered_;
+}
+
+void Simulation::deliver(runtime::Clock::time_point now) {
+  relay_.advance(
+      std::chrono::duration_cast<SimTime>(now - config_.clock.start));
+  // 配送中に Connection が閉じられても安全なようにコピーして回す。
+  const auto loopbacks = loopbacks_;
+  for (auto *loopback : loopbacks) {
+    if (std::find(loopbacks_.begin(), loopbacks_.end(), loopback) !=
+        loopbacks_.end()) {
+      delivered_ += loopback->deliver();
+    }
+  }
+}
+
+} // namespace toio::sim
@@ -0,0 +1,261 @@
+#include "toio/sim/virtual_clock.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace toio::sim {
+
+VirtualClock::VirtualClock(Options options)
+    : options_(options),
+      now_(options.start.time_since_epoch().count()) {
+  auto driver = std::make_unique<Task>();
+  driver->id = next_id_++;
+  driver->thread_id = std::this_thread::get_id();
+  current_ = driver.get();
+  tasks_.push_back(std::move(driver));
+}
+
+VirtualClock::VirtualClock() : VirtualClock(Options{}) {}
+
+VirtualClock::~VirtualClock() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+    for (auto &task : tasks_) {
+      task->resumed = true;
+      task->cv.notify_all();
+      if (task->thread.joinable()) {
+        threads.push_back(std::move(task->thread));
+      }
+    }
+  }
+  // 残っていたタスクは待機点で例外を受けて終了する。
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+VirtualClock::time_point VirtualClock::now() const {
+  return time_point(duration(now_.load(std::memory_order_acquire)));
+}
+
+std::chrono::system_clock::time_point VirtualClock::wall_now() const {
+  return options_.wall_start +
+         std::chrono::duration_cast<std::chrono::system_clock::duration>(
+             elapsed());
+}
+
+void VirtualClock::sleep_until(time_point deadline) {
+  if (deadline <= now()) {
+    return;
+  }
+  block(deadline, nullptr);
+}
+
+bool VirtualClock::wait_until(std::unique_lock<std::mutex> &lock,
+                              std::condition_variable & /*cv*/,
+                              time_point deadline,
+                              const std::function<bool()> &ready) {
+  // 通知は使わず、タスクを切り替えるたびに条件を見直す。
+  const std::function<bool()> probe = [&lock, &ready]() {
+    std::lock_guard<std::mutex> relock(*lock.mutex());
+    return ready();
+  };
+  while (!ready()) {
+    if (now() >= deadline) {
+      return false;
+    }
+    lock.unlock();
+    try {
+      block(deadline, &probe);
+    } catch (...) {
+      lock.lock();
+      throw;
+    }
+    lock.lock();
+  }
+  return true;
+}
+
+std::future<void> VirtualClock::spawn(std::function<void()> task) {
+  reap_finished();
+  std::packaged_task<void()> packaged(std::move(task));
+  auto future = packaged.get_future();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (shutdown_) {
+    throw std::runtime_error("VirtualClock is shutting down");
+  }
+  current_task(lock);
+  auto entry = std::make_unique<Task>();
+  entry->id = next_id_++;
+  entry->blocked = true;
+  entry->wake = now();
+  entry->order = next_order_++;
+  Task &spawned = *entry;
+  spawned.thread = std::thread([this, &spawned,
+                                packaged = std::move(packaged)]() mutable {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      spawned.thread_id = std::this_thread::get_id();
+      spawned.cv.wait(lock, [&spawned]() { return spawned.resumed; });
+      spawned.resumed = false;
+      if (shutdown_) {
+        spawned.done = true;
+        return;
+      }
+    }
+    packaged();
+    finish(spawned);
+  });
+  tasks_.push_back(std::move(entry));
+  return future;
+}
+
+void VirtualClock::wait(std::future<void> &task) {
+  if (!task.valid()) {
+    return;
+  }
+  const std::function<bool()> ready = [&task]() {
+    return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  };
+  while (!ready()) {
+    block(time_point::max(), &ready);
+  }
+}
+
+void VirtualClock::add_hook(Hook hook) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  hooks_.push_back(std::move(hook));
+}
+
+const VirtualClock::Options &VirtualClock::options() const {
+  return options_;
+}
+
+VirtualClock::duration VirtualClock::elapsed() const {
+  return now() - options_.start;
+}
+
+std::uint64_t VirtualClock::switches() const {
+  return switches_.load(std::memory_order_relaxed);
+}
+
+VirtualClock::Task &
+VirtualClock::current_task(const std::unique_lock<std::mutex> & /*lock*/) const {
+  if (!current_ || current_->thread_id != std::this_thread::get_id()) {
+    throw std::logic_error(
+        "VirtualClock: called from a thread it does not schedule");
+  }
+  return *current_;
+}
+
+void VirtualClock::block(time_point wake, const std::function<bool()> *ready) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (shutdown_) {
+    throw std::runtime_error("VirtualClock is shutting down");
+  }
+  Task &self = current_task(lock);
+  self.blocked = true;
+  self.wake = wake;
+  self.ready = ready;
+  self.order = next_order_++;
+
+  Task &next = schedule_next(lock);
+  if (&next != &self) {
+    resume(next);
+    self.cv.wait(lock, [&self]() { return self.resumed; });
+    self.resumed = false;
+  }
+  self.ready = nullptr;
+  if (shutdown_) {
+    throw std::runtime_error("VirtualClock is shutting down");
+  }
+}
+
+VirtualClock::Task &
+VirtualClock::schedule_next(std::unique_lock<std::mutex> &lock) {
+  for (;;) {
+    run_hooks(lock);
+    const auto now = this->now();
+    Task *best = nullptr;
+    time_point best_wake = time_point::max();
+    for (auto &task : tasks_) {
+      if (!task->blocked) {
+        continue;
+      }
+      auto wake = std::max(task->wake, now);
+      if (wake > now && task->ready && (*task->ready)()) {
+        wake = now;
+      }
+      if (!best || wake < best_wake ||
+          (wake == best_wake && task->order < best->order)) {
+        best = task.get();
+        best_wake = wake;
+      }
+    }
+    if (!best) {
+      throw std::logic_error("VirtualClock: no task to schedule");
+    }
+    if (best_wake <= now) {
+      best->blocked = false;
+      return *best;
+    }
+    const auto step = std::min<duration>(best_wake - now, options_.quantum);
+    now_.store((now + step).time_since_epoch().count(),
+               std::memory_order_release);
+  }
+}
+
+void VirtualClock::resume(Task &task) {
+  current_ = &task;
+  task.resumed = true;
+  switches_.fetch_add(1, std::memory_order_relaxed);
+  task.cv.notify_one();
+}
+
+void VirtualClock::finish(Task &task) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  task.done = true;
+  task.blocked = false;
+  if (shutdown_) {
+    return;
+  }
+  resume(schedule_next(lock));
+}
+
+void VirtualClock::run_hooks(std::unique_lock<std::mutex> &lock) {
+  if (hooks_.empty()) {
+    return;
+  }
+  const auto now = this->now();
+  lock.unlock();
+  for (auto &hook : hooks_) {
+    hook(now);
+  }
+  lock.lock();
+}
+
+void VirtualClock::reap_finished() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = tasks_.begin(); it != tasks_.end();) {
+      if ((*it)->done) {
+        threads.push_back(std::move((*it)->thread));
+        it = tasks_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  for (auto &thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+} // namespace toio::sim
@@ -0,0 +1,241 @@
+#include "toio/transport/obstacle_message.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <nlohmann/json.hpp>
+
+namespace toio::transport {
+
+namespace {
+
+using json = nlohmann::json;
+
+constexpr std::string_view kOscBundle{"#bundle", 8};
+
+double number_field(const json &object, const char *key, bool required) {
+  const auto it = object.find(key);
+  if (it == object.end()) {
+    if (required) {
+      throw std::invalid_argument(std::string("obstacle needs \"") + key +
+                                  "\"");
+    }
+    return 0.0;
+  }
+  if (!it->is_number()) {
+    throw std::invalid_argument(std::string("obstacle \"") + key +
+                                "\" must be a number");
+  }
+  return it->get<double>();
+}
+
+std::uint32_t id_field(const json &object) {
+  const auto it = object.find("id");
+  if (it == object.end() || !it->is_number_integer() ||
+      it->get<std::int64_t>() < 0 ||
+      it->get<std::int64_t>() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::invalid_argument("obstacle needs a non-negative integer \"id\"");
+  }
+  return static_cast<std::uint32_t>(it->get<std::int64_t>());
+}
+
+void parse_json_item(const json &item, std::vector<ObstacleMessage> &out) {
+  if (!item.is_object()) {
+    throw std::invalid_argument("obstacle must be a JSON object");
+  }
+  ObstacleMessage message;
+  if (item.value("clear", false)) {
+    message.kind = ObstacleMessage::Kind::Clear;
+    out.push_back(message);
+    return;
+  }
+  message.id = id_field(item);
+  if (item.value("remove", false)) {
+    message.kind = ObstacleMessage::Kind::Remove;
+    out.push_back(message);
+    return;
+  }
+  message.x = number_field(item, "x", true);
+  message.y = number_field(item, "y", true);
+  message.radius = number_field(item, "radius", false);
+  message.vx = number_field(item, "vx", false);
+  message.vy = number_field(item, "vy", false);
+  out.push_back(message);
+}
+
+// OSC の読み出し。値はすべてビッグエンディアンで 4 バイト境界に揃う。
+class OscReader {
+public:
+  OscReader(const std::uint8_t *data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  bool done() const { return offset_ >= size_; }
+
+  std::string_view read_string() {
+    const auto *begin = reinterpret_cast<const char *>(data_ + offset_);
+    const auto *end = static_cast<const char *>(
+        std::memchr(begin, '\0', size_ - offset_));
+    if (end == nullptr) {
+      throw std::invalid_argument("OSC string is not terminated");
+    }
+    const auto length = static_cast<std::size_t>(end - begin);
+    skip((length + 4) & ~std::size_t{3});
+    return {begin, length};
+  }
+
+  std::uint32_t read_u32() {
+    require(4);
+    const auto *p = data_ + offset_;
+    offset_ += 4;
+    return (static_cast<std::uint32_t>(p[0]) << 24) |
+           (static_cast<std::uint32_t>(p[1]) << 16) |
+           (static_cast<std::uint32_t>(p[2]) << 8) |
+           static_cast<std::uint32_t>(p[3]);
+  }
+
+  double read_number(char tag) {
+    const auto bits = read_u32();
+    if (tag == 'i') {
+      return static_cast<double>(static_cast<std::int32_t>(bits));
+    }
+    if (tag == 'f') {
+      float value = 0.0f;
+      std::memcpy(&value, &bits, sizeof(value));
+      return static_cast<double>(value);
+    }
+    throw std::invalid_argument(std::string("unsupported OSC type tag '") +
+                                tag + "'");
+  }
+
+  void skip(std::size_t count) {
+    require(count);
+    offset_ += count;
+  }
+
+  const std::uint8_t *current() const { return data_ + offset_; }
+
+private:
+  void require(std::size_t count) const {
+    if (size_ - offset_ < count) {
+      throw std::invalid_argument("OSC packet is truncated");
+    }
+  }
+
+  const std::uint8_t *data_;
+  std::size_t size_;
+  std::size_t offset_ = 0;
+};
+
+void parse_osc_message(const std::uint8_t *data, std::size_t size,
+                       std::vector<ObstacleMessage> &out) {
+  OscReader reader(data, size);
+  const auto address = reader.read_string();
+  std::string_view tags;
+  if (!reader.done()) {
+    tags = reader.read_string();
+    if (tags.empty() || tags.front() != ',') {
+      throw std::invalid_argument("OSC type tag must start with ','");
+    }
+    tags.remove_prefix(1);
+  }
+
+  ObstacleMessage message;
+  if (address == "/obstacle/clear") {
+    message.kind = ObstacleMessage::Kind::Clear;
+    out.push_back(message);
+    return;
+  }
+  const bool remove = address == "/obstacle/remove";
+  if (address != "/obstacle" && !remove) {
+    return;
+  }
+  const std::size_t required = remove ? 1 : 3;
+  if (tags.size() < required) {
+    throw std::invalid_argument(std::string(address) + " needs " +
+                                std::to_string(required) + " arguments");
+  }
+  double values[6] = {};
+  const auto count = std::min<std::size_t>(tags.size(), 6);
+  for (std::size_t i = 0; i < count; ++i) {
+    values[i] = reader.read_number(tags[i]);
+  }
+  // NaN もここで弾く (uint32_t に直すと未定義動作になる)。
+  if (!(values[0] >= 0.0 &&
+        values[0] <= std::numeric_limits<std::uint32_t>::max())) {
+    throw std::invalid_argument("OSC obstacle id out of range");
+  }
+  message.id = static_cast<std::uint32_t>(values[0]);
+  if (remove) {
+    message.kind = ObstacleMessage::Kind::Remove;
+  } else {
+    message.x = values[1];
+    message.y = values[2];
+    message.radius = values[3];
+    message.vx = values[4];
+    message.vy = values[5];
+  }
+  out.push_back(message);
+}
+
+void parse_osc_packet(const std::uint8_t *data, std::size_t size,
+                      std::vector<ObstacleMessage> &out) {
+  if (size >= kOscBundle.size() &&
+      std::memcmp(data, kOscBundle.data(), kOscBundle.size()) == 0) {
+    OscReader reader(data, size);
+    // "#bundle" と timetag。timetag は見ずに受け取った順に反映する。
+    reader.skip(kOscBundle.size() + 8);
+    while (!reader.done()) {
+      const auto length = reader.read_u32();
+      const auto *element = reader.current();
+      reader.skip(length);
+      parse_osc_packet(element, length, out);
+    }
+    return;
+  }
+  parse_osc_message(data, size, out);
+}
+
+} // namespace
+
+std::vector<ObstacleMessage> parse_obstacle_json(const std::string &text) {
+  std::vector<ObstacleMessage> out;
+  try {
+    const auto root = json::parse(text);
+    const json *items = &root;
+    if (root.is_object() && root.contains("obstacles")) {
+      items = &root.at("obstacles");
+    }
+    if (items->is_array()) {
+      for (const auto &item : *items) {
+        parse_json_item(item, out);
+      }
+    } else {
+      parse_json_item(*items, out);
+    }
+  } catch (const json::exception &ex) {
+    throw std::invalid_argument(std::string("obstacle JSON: ") + ex.what());
+  }
+  return out;
+}
+
+std::vector<ObstacleMessage> parse_obstacle_osc(const std::uint8_t *data,
+                                                std::size_t size) {
+  std::vector<ObstacleMessage> out;
+  parse_osc_packet(data, size, out);
+  return out;
+}
+
+std::vector<ObstacleMessage> parse_obstacle_datagram(const std::uint8_t *data,
+                                                     std::size_t size) {
+  if (size > 0 && (data[0] == '/' || data[0] == '#')) {
+    return parse_obstacle_osc(data, size);
+  }
+  return parse_obstacle_json(
+      std::string(reinterpret_cast<const char *>(data), size));
+}
+
+} // namespace toio::transport
@@ -0,0 +1,115 @@
+#include "toio/transport/obstacle_receiver.hpp"
+
+#include <exception>
+#include <utility>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/post.hpp>
+
+namespace toio::transport {
+
+namespace {
+namespace asio = boost::asio;
+using udp = asio::ip::udp;
+} // namespace
+
+ObstacleReceiver::ObstacleReceiver(std::uint16_t port, std::string address)
+    : address_(std::move(address)), port_(port), socket_(io_context_) {}
+
+ObstacleReceiver::~ObstacleReceiver() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void ObstacleReceiver::open(MessageHandler on_message, LogHandler on_log) {
+  if (running_) {
+    return;
+  }
+  on_message_ = std::move(on_message);
+  log_ = std::move(on_log);
+
+  const udp::endpoint endpoint(asio::ip::make_address(address_), port_);
+  socket_.open(endpoint.protocol());
+  socket_.set_option(udp::socket::reuse_address(true));
+  socket_.bind(endpoint);
+  port_ = socket_.local_endpoint().port();
+
+  io_context_.restart();
+  running_ = true;
+  start_receive();
+  reader_thread_ = std::thread([this] { io_context_.run(); });
+
+  log("obstacle receiver listening on udp://" + address_ + ":" +
+      std::to_string(port_));
+}
+
+void ObstacleReceiver::close() {
+  if (!running_) {
+    if (reader_thread_.joinable()) {
+      reader_thread_.join();
+    }
+    return;
+  }
+  running_ = false;
+  // ソケットは reader スレッドだけが触る。閉じると待っている受信が終わり、
+  // 仕事がなくなった io_context.run が戻る。
+  asio::post(io_context_, [this] {
+    boost::system::error_code ec;
+    socket_.close(ec);
+  });
+  if (reader_thread_.joinable()) {
+    reader_thread_.join();
+  }
+  log("obstacle receiver closed");
+}
+
+bool ObstacleReceiver::is_open() const {
+  return running_;
+}
+
+std::uint16_t ObstacleReceiver::port() const {
+  return port_;
+}
+
+void ObstacleReceiver::start_receive() {
+  socket_.async_receive_from(
+      asio::buffer(buffer_), sender_,
+      [this](const boost::system::error_code &ec, std::size_t size) {
+        if (ec) {
+          if (ec != asio::error::operation_aborted && running_) {
+            log("obstacle receive error: " + ec.message());
+            start_receive();
+          }
+          return;
+        }
+        handle_datagram(size);
+        if (running_) {
+          start_receive();
+        }
+      });
+}
+
+void ObstacleReceiver::handle_datagram(std::size_t size) {
+  // 壊れたデータグラムは捨てて次を待つ。
+  try {
+    for (const auto &message : parse_obstacle_datagram(buffer_.data(), size)) {
+      if (on_message_) {
+        on_message_(message);
+      }
+    }
+  } catch (const std::exception &ex) {
+    log("obstacle datagram from " + sender_.address().to_string() +
+        " ignored: " + ex.what());
+  }
+}
+
+void ObstacleReceiver::log(const std::string &message) const {
+  if (log_) {
+    log_(message);
+  }
+}
+
+} // namespace toio::transport
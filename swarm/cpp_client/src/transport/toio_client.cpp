@@ -1,27 +1,40 @@
 #include "toio/transport/toio_client.hpp"
 
-#include <iostream>
+#include "toio/transport/websocket_connection.hpp"
 
-#include <boost/beast/core.hpp>
-#include <boost/beast/http.hpp>
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
 
 namespace toio::transport {
 
 namespace {
-namespace beast = boost::beast;
-namespace websocket = beast::websocket;
-namespace asio = boost::asio;
-using tcp = asio::ip::tcp;
+
+constexpr const char *kStopAllTarget = "*";
+
+// 停止コマンドで破棄してよい (新しい停止が優先される) コマンド。
+bool is_motion_command(const std::string &cmd) {
+  return cmd == "move" || cmd == "move_to" || cmd == "move_to_multi";
+}
 } // namespace
 
+void check_move_duration(std::chrono::milliseconds duration) {
+  if (duration < kMinMoveDuration || duration > kMaxMoveDuration) {
+    throw std::invalid_argument(
+        "move duration must be between 10 and 2550 ms, got " +
+        std::to_string(duration.count()) + " ms");
+  }
+}
+
 ToioClient::ToioClient(std::string host,
                        std::string port,
                        std::string endpoint)
-    : host_(std::move(host)),
-      port_(std::move(port)),
-      endpoint_(std::move(endpoint)),
-      resolver_(io_context_),
-      websocket_(io_context_) {}
+    : ToioClient(std::make_unique<WebSocketConnection>(
+          std::move(host), std::move(port), std::move(endpoint))) {}
+
+ToioClient::ToioClient(std::unique_ptr<Connection> connection)
+    : connection_(std::move(connection)) {}
 
 ToioClient::~ToioClient() {
   try {
@@ -39,60 +52,29 @@ void ToioClient::set_log_handler(LogHandler handler) {
 }
 
 void ToioClient::connect() {
-  if (connected_) {
+  if (connection_->is_open()) {
     return;
   }
-
-  auto const results = resolver_.resolve(host_, port_);
-  auto const endpoint = asio::connect(websocket_.next_layer(), results);
-  std::string host_header = host_ + ":" + std::to_string(endpoint.port());
-
-  websocket_.set_option(
-      websocket::stream_base::timeout::suggested(beast::role_type::client));
-  websocket_.set_option(websocket::stream_base::decorator(
-      [](websocket::request_type &req) {
-        req.set(beast::http::field::user_agent, "toio-cpp-client/0.1");
-      }));
-  websocket_.handshake(host_header, endpoint_);
-
-  connected_ = true;
-  running_ = true;
-  reader_thread_ = std::thread([this] { reader_loop(); });
-
-  log("WebSocket connected to " + host_header + endpoint_);
+  connection_->open(
+      [this](const std::string &text) { dispatch_message(text); },
+      [this](const std::string &message) { log(message); });
 }
 
 void ToioClient::close() {
-  if (!connected_) {
-    return;
-  }
-
-  running_ = false;
-  beast::error_code ec;
-  websocket_.close(websocket::close_code::normal, ec);
-  if (ec) {
-    log("WebSocket close error: " + ec.message());
-  }
-
-  if (reader_thread_.joinable()) {
-    reader_thread_.join();
-  }
-
-  connected_ = false;
-  log("WebSocket closed");
+  connection_->close();
 }
 
 void ToioClient::ensure_connected() const {
-  if (!connected_) {
+  if (!connection_->is_open()) {
     throw std::runtime_error("WebSocket is not connected");
   }
 }
 
-void ToioClient::send_command(const std::string &cmd,
-                              const std::string &target,
-                              const Json &params,
-                              std::optional<bool> require_result) {
-  ensure_connected();
+ToioClient::Json
+ToioClient::make_command(const std::string &cmd,
+                         const std::string &target,
+                         const Json &params,
+                         std::optional<bool> require_result) const {
   Json payload = {
       {"cmd", cmd},
       {"target", target},
@@ -102,11 +84,21 @@ void ToioClient::send_command(const std::string &cmd,
     payload["require_result"] = *require_result;
   }
 
-  Json message = {
+  return Json{
       {"type", "command"},
       {"payload", std::move(payload)},
   };
-  send_json(message);
+}
+
+void ToioClient::send_command(const std::string &cmd,
+                              const std::string &target,
+                              const Json &params,
+                              std::optional<bool> require_result) {
+  ensure_connected();
+  send_json(make_command(cmd, target, params, require_result),
+            Lane::Normal,
+            target,
+            is_motion_command(cmd));
 }
 
 void ToioClient::send_query(const std::string &info,
@@ -135,12 +127,20 @@ void ToioClient::connect_cube(const std::string &target,
 void ToioClient::disconnect_cube(const std::string &target,
                                  std::optional<bool> require_result) {
   send_command("disconnect", target, Json::object(), require_result);
+  // 切断した Cube の停止 epoch はもう使わない。ID が入れ替わり続けても
+  // cube_stop_epochs_ が増え続けないよう消しておく。
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  cube_stop_epochs_.erase(target);
 }
 
 void ToioClient::send_move(const std::string &target,
                            int left_speed,
                            int right_speed,
                            std::optional<bool> require_result) {
+  if (left_speed == 0 && right_speed == 0) {
+    send_stop(target, require_result);
+    return;
+  }
   Json params = {
       {"left_speed", left_speed},
       {"right_speed", right_speed},
@@ -148,6 +148,72 @@ void ToioClient::send_move(const std::string &target,
   send_command("move", target, params, require_result);
 }
 
+void ToioClient::send_move_for(const std::string &target,
+                               int left_speed,
+                               int right_speed,
+                               std::chrono::milliseconds duration,
+                               std::optional<bool> require_result) {
+  check_move_duration(duration);
+  if (left_speed == 0 && right_speed == 0) {
+    // 止めるだけなら時間指定はいらない。send_move と同じく優先レーンで送る。
+    send_stop(target, require_result);
+    return;
+  }
+  Json params = {
+      {"left_speed", left_speed},
+      {"right_speed", right_speed},
+      {"duration_ms", duration.count()},
+  };
+  send_command("move", target, params, require_result);
+}
+
+void ToioClient::send_move_to(const std::string &target,
+                              const MoveTarget &goal,
+                              int max_speed,
+                              MoveType move_type,
+                              int request_id,
+                              std::optional<bool> require_result) {
+  Json params = {
+      {"x", goal.x},
+      {"y", goal.y},
+      {"max_speed", max_speed},
+      {"move_type", to_string(move_type)},
+      {"request_id", request_id},
+  };
+  if (goal.angle.has_value()) {
+    params["angle"] = *goal.angle;
+  }
+  send_command("move_to", target, params, require_result);
+}
+
+void ToioClient::send_move_to_multi(const std::string &target,
+                                    const std::vector<MoveTarget> &goals,
+                                    int max_speed,
+                                    MoveType move_type,
+                                    bool append,
+                                    int request_id,
+                                    std::optional<bool> require_result) {
+  Json targets = Json::array();
+  for (const auto &goal : goals) {
+    Json point = {
+        {"x", goal.x},
+        {"y", goal.y},
+    };
+    if (goal.angle.has_value()) {
+      point["angle"] = *goal.angle;
+    }
+    targets.push_back(std::move(point));
+  }
+  Json params = {
+      {"targets", std::move(targets)},
+      {"max_speed", max_speed},
+      {"move_type", to_string(move_type)},
+      {"write_mode", append ? "append" : "overwrite"},
+      {"request_id", request_id},
+  };
+  send_command("move_to_multi", target, params, require_result);
+}
+
 void ToioClient::set_led(const std::string &target,
                          int r,
                          int g,
@@ -170,26 +236,33 @@ void ToioClient::query_position(const std::string &target,
   send_query("position", target, notify);
 }
 
-void ToioClient::reader_loop() {
-  beast::flat_buffer buffer;
-  while (running_) {
-    beast::error_code ec;
-    websocket_.read(buffer, ec);
-    if (ec == websocket::error::closed) {
-      break;
-    }
-    if (ec) {
-      log("WebSocket read error: " + ec.message());
-      break;
-    }
+void ToioClient::send_stop(const std::string &target,
+                           std::optional<bool> require_result) {
+  ensure_connected();
+  Json params = {
+      {"left_speed", 0},
+      {"right_speed", 0},
+  };
+  send_json(make_command("move", target, params, require_result),
+            Lane::Priority,
+            target);
+}
 
-    auto payload_text = beast::buffers_to_string(buffer.data());
-    buffer.consume(buffer.size());
-    dispatch_message(payload_text);
+void ToioClient::send_stop_all(const std::vector<std::string> &targets,
+                               std::optional<bool> require_result) {
+  ensure_connected();
+  Json params = Json::object();
+  if (!targets.empty()) {
+    params["targets"] = targets;
   }
+  send_json(make_command("stop_all", kStopAllTarget, params, require_result),
+            Lane::Priority,
+            kStopAllTarget);
+}
 
-  running_ = false;
-  connected_ = false;
+PriorityStats ToioClient::priority_stats() const {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  return priority_stats_;
 }
 
 void ToioClient::dispatch_message(const std::string &payload_text) {
@@ -206,13 +279,65 @@ void ToioClient::dispatch_message(const std::string &payload_text) {
   }
 }
 
-void ToioClient::send_json(const Json &message) {
+void ToioClient::send_json(const Json &message,
+                           Lane lane,
+                           const std::string &target,
+                           bool preemptible) {
   const std::string serialized = message.dump();
-  std::lock_guard<std::mutex> lock(write_mutex_);
-  beast::error_code ec;
-  websocket_.write(boost::asio::buffer(serialized), ec);
-  if (ec) {
-    throw beast::system_error(ec);
+  const auto requested_at = std::chrono::steady_clock::now();
+  // ロック待ちに入る前の epoch。待機中に停止が入ったかどうかの判定に使う。
+  const std::uint64_t observed_epoch = stop_epoch_.load();
+
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  if (lane == Lane::Priority) {
+    const std::uint64_t epoch = stop_epoch_.fetch_add(1) + 1;
+    if (target == kStopAllTarget) {
+      stop_all_epoch_ = epoch;
+    } else {
+      cube_stop_epochs_[target] = epoch;
+    }
+    ++priority_waiting_;
+    write_cv_.wait(lock, [this] { return !writing_; });
+    --priority_waiting_;
+  } else {
+    write_cv_.wait(lock,
+                   [this] { return !writing_ && priority_waiting_ == 0; });
+    if (preemptible) {
+      auto it = cube_stop_epochs_.find(target);
+      const bool stopped =
+          stop_all_epoch_ > observed_epoch ||
+          (it != cube_stop_epochs_.end() && it->second > observed_epoch);
+      if (stopped) {
+        ++priority_stats_.discarded_commands;
+        return;
+      }
+    }
+  }
+  writing_ = true;
+  lock.unlock();
+
+  std::exception_ptr error;
+  try {
+    connection_->write(serialized);
+  } catch (...) {
+    // 送信スロットを解放してから投げ直す。
+    error = std::current_exception();
+  }
+
+  lock.lock();
+  writing_ = false;
+  if (lane == Lane::Priority) {
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - requested_at);
+    ++priority_stats_.priority_writes;
+    priority_stats_.last_latency = latency;
+    priority_stats_.max_latency =
+        std::max(priority_stats_.max_latency, latency);
+  }
+  lock.unlock();
+  write_cv_.notify_all();
+  if (error) {
+    std::rethrow_exception(error);
   }
 }
 
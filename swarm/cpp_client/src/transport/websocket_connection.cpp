@@ -0,0 +1,125 @@
+#include "toio/transport/websocket_connection.hpp"
+
+#include <utility>
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+namespace toio::transport {
+
+namespace {
+namespace beast = boost::beast;
+namespace websocket = beast::websocket;
+namespace asio = boost::asio;
+} // namespace
+
+WebSocketConnection::WebSocketConnection(std::string host,
+                                         std::string port,
+                                         std::string endpoint)
+    : host_(std::move(host)),
+      port_(std::move(port)),
+      endpoint_(std::move(endpoint)),
+      resolver_(io_context_),
+      websocket_(io_context_) {}
+
+WebSocketConnection::~WebSocketConnection() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+void WebSocketConnection::open(ReceiveHandler on_message, LogHandler on_log) {
+  if (connected_) {
+    return;
+  }
+  on_message_ = std::move(on_message);
+  log_ = std::move(on_log);
+
+  auto const results = resolver_.resolve(host_, port_);
+  auto const endpoint = asio::connect(websocket_.next_layer(), results);
+  // 小さなコマンドを続けて書くため、Nagle で次の ACK まで待たせない。
+  websocket_.next_layer().set_option(asio::ip::tcp::no_delay(true));
+  std::string host_header = host_ + ":" + std::to_string(endpoint.port());
+
+  websocket_.set_option(
+      websocket::stream_base::timeout::suggested(beast::role_type::client));
+  websocket_.set_option(websocket::stream_base::decorator(
+      [](websocket::request_type &req) {
+        req.set(beast::http::field::user_agent, "toio-cpp-client/0.1");
+      }));
+  websocket_.handshake(host_header, endpoint_);
+
+  connected_ = true;
+  running_ = true;
+  reader_thread_ = std::thread([this] { reader_loop(); });
+
+  log("WebSocket connected to " + host_header + endpoint_);
+}
+
+void WebSocketConnection::close() {
+  if (!connected_) {
+    if (reader_thread_.joinable()) {
+      reader_thread_.join();
+    }
+    return;
+  }
+
+  running_ = false;
+  beast::error_code ec;
+  websocket_.close(websocket::close_code::normal, ec);
+  if (ec) {
+    log("WebSocket close error: " + ec.message());
+  }
+
+  if (reader_thread_.joinable()) {
+    reader_thread_.join();
+  }
+
+  connected_ = false;
+  log("WebSocket closed");
+}
+
+bool WebSocketConnection::is_open() const {
+  return connected_;
+}
+
+void WebSocketConnection::write(const std::string &text) {
+  beast::error_code ec;
+  websocket_.write(asio::buffer(text), ec);
+  if (ec) {
+    throw beast::system_error(ec);
+  }
+}
+
+void WebSocketConnection::reader_loop() {
+  beast::flat_buffer buffer;
+  while (running_) {
+    beast::error_code ec;
+    websocket_.read(buffer, ec);
+    if (ec == websocket::error::closed) {
+      break;
+    }
+    if (ec) {
+      log("WebSocket read error: " + ec.message());
+      break;
+    }
+
+    auto payload_text = beast::buffers_to_string(buffer.data());
+    buffer.consume(buffer.size());
+    if (on_message_) {
+      on_message_(payload_text);
+    }
+  }
+
+  running_ = false;
+  connected_ = false;
+}
+
+void WebSocketConnection::log(const std::string &message) const {
+  if (log_) {
+    log_(message);
+  }
+}
+
+} // namespace toio::transport
@@ -1,3 +1,5 @@
+import time
+
 from toio import *
 
 class CubeStatus:
@@ -10,11 +12,18 @@ class CubeStatus:
     self.y = None
     self.angle = None
     self.on_mat = False  # キューブがマット上にいるかどうかを保持
+    self.timestamp_ms = None  # 最後に位置通知を受けた時刻 (epoch ms)
+    # 完了待ちの目標指定コマンド (cmd, request_id, websocket, require_result)。
+    # キューブは受け付け順に完了レスポンスを返すため FIFO で対応付ける。
+    self.pending_targets = []
+    # 登録済みのモーター応答ハンドラ。キューブごとに 1 つだけにする。
+    self.motor_response_handler = None
 
   def update(self, x, y, angle):
     self.x = x
     self.y = y
     self.angle = angle
+    self.timestamp_ms = int(time.time() * 1000)
 
   def set_on_mat(self, on_mat):
     # true: マット上、 false: マット外
@@ -78,10 +87,96 @@ async def set_led(cube, r, g, b):
   await cube.api.indicator.turn_on(
     IndicatorParam(duration_ms=0, color=Color(r=r, g=g, b=b)))
 
-async def set_motor(cube, left, right):
-    """Set motor control for a cube."""
-    await cube.api.motor.motor_control(left, right)
+MOVE_TYPES = {
+    "curve": MovementType.Curve,
+    "curve_no_reverse": MovementType.CurveWithoutReverse,
+    "rotate_then_move": MovementType.Linear,
+}
+
+
+def create_motor_response_handler(cube_status: CubeStatus, on_response):
+
+  def handler(payload: bytearray, handler_info):
+    response = Motor.is_my_data(payload)
+    if response is None or not hasattr(response, "response_code"):
+      return
+    code = response.response_code
+    on_response(cube_status, getattr(code, "name", str(code)),
+                int(getattr(code, "value", code)) == 0)
+
+  return handler
+
+async def register_motor_response_handler(cube, cube_status, on_response):
+    """Register handler for target-specified motor control responses.
+
+    At most one handler per cube: a second one would pop pending_targets twice
+    per response and pair later results with the wrong request."""
+    if cube_status.motor_response_handler is not None:
+        return
+    handler = create_motor_response_handler(cube_status, on_response)
+    await cube.api.motor.register_notification_handler(handler)
+    cube_status.motor_response_handler = handler
+
+async def unregister_motor_response_handler(cube_status):
+    """Remove the handler registered by register_motor_response_handler."""
+    handler = cube_status.motor_response_handler
+    if handler is None:
+        return
+    cube_status.motor_response_handler = None
+    try:
+        await cube_status.cube.api.motor.unregister_notification_handler(handler)
+    except Exception as e:
+        print(f"Failed to unregister motor handler of {cube_status.name}: {e}")
+
+async def set_motor_target(cube, x, y, angle, max_speed, move_type,
+                           timeout=0):
+    """Motor control with target specified (firmware closed loop)."""
+    if move_type not in MOVE_TYPES:
+        raise ValueError(f"Unknown move_type: {move_type}")
+    if angle is None:
+        rotation = RotationOption.WithoutRotation
+        angle = 0
+    else:
+        rotation = RotationOption.AbsoluteOptimal
+    await cube.api.motor.motor_control_target(
+        timeout=timeout,
+        movement_type=MOVE_TYPES[move_type],
+        speed=Speed(max=max_speed, speed_change_type=SpeedChangeType.Constant),
+        target=TargetPosition(
+            cube_location=CubeLocation(point=Point(x=x, y=y), angle=angle),
+            rotation_option=rotation))
+
+MAX_MULTI_TARGETS = 29
+
+async def set_motor_multi_target(cube, targets, max_speed, move_type,
+                                 append=False, timeout=0):
+    """Motor control with multiple targets (up to 29 points per command)."""
+    if move_type not in MOVE_TYPES:
+        raise ValueError(f"Unknown move_type: {move_type}")
+    if not targets or len(targets) > MAX_MULTI_TARGETS:
+        raise ValueError(f"targets must contain 1..{MAX_MULTI_TARGETS} points")
+    target_list = []
+    for point in targets:
+        angle = point.get("angle")
+        rotation = (RotationOption.WithoutRotation if angle is None
+                    else RotationOption.AbsoluteOptimal)
+        target_list.append(TargetPosition(
+            cube_location=CubeLocation(
+                point=Point(x=point.get("x", 0), y=point.get("y", 0)),
+                angle=angle or 0),
+            rotation_option=rotation))
+    await cube.api.motor.motor_control_multiple_targets(
+        timeout=timeout,
+        movement_type=MOVE_TYPES[move_type],
+        speed=Speed(max=max_speed, speed_change_type=SpeedChangeType.Constant),
+        mode=WriteMode.Append if append else WriteMode.Overwrite,
+        target_list=target_list)
+
+async def set_motor(cube, left, right, duration_ms=0):
+    """Set motor control for a cube (duration_ms=0 means no time limit)."""
+    await cube.api.motor.motor_control(left, right, duration_ms)
 
 async def disconnect_cube(cube_status):
+    await unregister_motor_response_handler(cube_status)
     res = await cube_status.cube.disconnect()
     return res
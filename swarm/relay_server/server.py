@@ -14,16 +14,22 @@ from .cubes import (
     connect_cube,
     disconnect_cube,
     read_battery_level,
+    register_motor_response_handler,
     register_notification_handler,
     scan_cubes,
     set_led,
     set_motor,
+    set_motor_multi_target,
+    set_motor_target,
 )
 
 app = FastAPI()
 
 # グローバル変数としてキューブの状態を保持
 cube_statuses = {}
+# 接続処理中のキューブ。同じキューブへの connect が重なると CubeStatus と
+# ハンドラが 2 組できるため、後から来たほうは断る。
+connecting_targets: Set[str] = set()
 
 # WebSocket 毎の購読状態 (position 通知)
 target_subscribers: dict[str, Set[WebSocket]] = defaultdict(set)
@@ -62,7 +68,7 @@ async def process_message(message, websocket: WebSocket):
     payload = message.get("payload", {})
 
     if message_type == "command":
-        return await handle_command(payload)
+        return await handle_command(payload, websocket)
     elif message_type == "query":
         return await handle_query(payload, websocket)
     elif message_type == "system":
@@ -70,7 +76,7 @@ async def process_message(message, websocket: WebSocket):
     else:
         return {"type": "error", "payload": {"message": "Unknown message type"}}
 
-async def handle_command(payload):
+async def handle_command(payload, websocket: WebSocket):
     cmd = payload.get("cmd")
     target = payload.get("target")
     params = payload.get("params", {})
@@ -93,23 +99,13 @@ async def handle_command(payload):
         if target in cube_statuses:
             return build_result("success", "Device already connected")
 
-        # キューブをスキャンして接続
-        dev_list = await scan_cubes([target])
-        if not dev_list:
-            return build_result("error", "Device not found")
-        cube = await connect_cube(dev_list[0])
-        if cube is None:
-            return build_result("error", "Failed to connect")
-        # 状態を登録
-        cube_status = CubeStatus(cube, target)
-        cube_statuses[target] = cube_status
-        loop = asyncio.get_running_loop()
-
-        def schedule_push():
-            loop.call_soon_threadsafe(lambda: asyncio.create_task(broadcast_position_update(target)))
-
-        await register_notification_handler(cube_status.cube, cube_status, schedule_push)
-        return build_result("success")
+        if target in connecting_targets:
+            return build_result("error", "Connection already in progress")
+        connecting_targets.add(target)
+        try:
+            return await connect_target(target, build_result)
+        finally:
+            connecting_targets.discard(target)
     elif cmd == "disconnect":
         # キューブを切断
         cube_status = cube_statuses.get(target)
@@ -128,9 +124,59 @@ async def handle_command(payload):
         if cube_status:
             left_speed = params.get("left_speed", 0)
             right_speed = params.get("right_speed", 0)
-            await set_motor(cube_status.cube, left_speed, right_speed)
+            # toio の時間指定は 10ms 単位・最大 2550ms
+            duration_ms = max(0, min(2550, int(params.get("duration_ms", 0))))
+            await set_motor(cube_status.cube, left_speed, right_speed, duration_ms)
             return build_result("success")
         return build_result("error", "Device not connected")
+    elif cmd == "stop_all":
+        # 緊急停止: 指定 (省略時は接続中の全) キューブへ並列に停止を送る
+        targets = params.get("targets") or list(cube_statuses.keys())
+        stopping = [cube_statuses[t] for t in targets if t in cube_statuses]
+        await asyncio.gather(
+            *(set_motor(status.cube, 0, 0) for status in stopping),
+            return_exceptions=True)
+        missing = [t for t in targets if t not in cube_statuses]
+        if missing:
+            return build_result("error", "Device not connected: " + ",".join(missing))
+        return build_result("success")
+    elif cmd == "move_to":
+        # 目標指定付きモーター制御 (完了 result はキューブの応答時に送信)
+        cube_status = cube_statuses.get(target)
+        if not cube_status:
+            return build_result("error", "Device not connected")
+        request_id = params.get("request_id", 0)
+        try:
+            await set_motor_target(
+                cube_status.cube,
+                params.get("x", 0),
+                params.get("y", 0),
+                params.get("angle"),
+                params.get("max_speed", 80),
+                params.get("move_type", "curve"),
+                params.get("timeout", 0))
+        except ValueError as exc:
+            return build_result("error", str(exc))
+        cube_status.pending_targets.append((cmd, request_id, websocket, require_result))
+        return None
+    elif cmd == "move_to_multi":
+        # 複数目標指定付きモーター制御 (write_mode: append で実行中の経路に追加)
+        cube_status = cube_statuses.get(target)
+        if not cube_status:
+            return build_result("error", "Device not connected")
+        request_id = params.get("request_id", 0)
+        try:
+            await set_motor_multi_target(
+                cube_status.cube,
+                params.get("targets", []),
+                params.get("max_speed", 80),
+                params.get("move_type", "curve"),
+                params.get("write_mode", "overwrite") == "append",
+                params.get("timeout", 0))
+        except ValueError as exc:
+            return build_result("error", str(exc))
+        cube_status.pending_targets.append((cmd, request_id, websocket, require_result))
+        return None
     elif cmd == "led":
         # LED制御
         cube_status = cube_statuses.get(target)
@@ -144,6 +190,31 @@ async def handle_command(payload):
     else:
         return build_result("error", "Unknown command")
 
+async def connect_target(target, build_result):
+    # キューブをスキャンして接続
+    dev_list = await scan_cubes([target])
+    if not dev_list:
+        return build_result("error", "Device not found")
+    cube = await connect_cube(dev_list[0])
+    if cube is None:
+        return build_result("error", "Failed to connect")
+    # 状態を登録
+    cube_status = CubeStatus(cube, target)
+    cube_statuses[target] = cube_status
+    loop = asyncio.get_running_loop()
+
+    def schedule_push():
+        loop.call_soon_threadsafe(lambda: asyncio.create_task(broadcast_position_update(target)))
+
+    await register_notification_handler(cube_status.cube, cube_status, schedule_push)
+
+    def on_target_response(responded, code_name, success):
+        loop.call_soon_threadsafe(lambda: asyncio.create_task(
+            send_target_result(responded, code_name, success)))
+
+    await register_motor_response_handler(cube_status.cube, cube_status, on_target_response)
+    return build_result("success")
+
 async def handle_query(payload, websocket: WebSocket):
     info = payload.get("info")
     target = payload.get("target")
@@ -210,7 +281,8 @@ async def handle_query(payload, websocket: WebSocket):
                     "x": cube_status.x,
                     "y": cube_status.y,
                     "angle": cube_status.angle,
-                    "on_mat": cube_status.on_mat
+                    "on_mat": cube_status.on_mat,
+                    "timestamp_ms": cube_status.timestamp_ms
                 }
             }
         }
@@ -283,7 +355,8 @@ async def broadcast_position_update(target: str):
             "x": cube_status.x,
             "y": cube_status.y,
             "angle": cube_status.angle,
-            "on_mat": cube_status.on_mat
+            "on_mat": cube_status.on_mat,
+            "timestamp_ms": cube_status.timestamp_ms
         }
     }
     message = json.dumps({"type": "response", "payload": payload})
@@ -293,6 +366,24 @@ async def broadcast_position_update(target: str):
         except Exception:
             cleanup_websocket(websocket)
 
+async def send_target_result(cube_status, code_name, success):
+    if not cube_status.pending_targets:
+        return
+    cmd, request_id, websocket, require_result = cube_status.pending_targets.pop(0)
+    if success and not require_result:
+        return
+    payload = {
+        "cmd": cmd,
+        "target": cube_status.cube_id,
+        "status": "success" if success else "error",
+        "request_id": request_id,
+        "message": code_name,
+    }
+    try:
+        await websocket.send_text(json.dumps({"type": "result", "payload": payload}))
+    except Exception:
+        cleanup_websocket(websocket)
+
 async def notify_subscription_termination(target: str, reason: str):
     subscribers = list(target_subscribers.get(target, set()))
     if not subscribers: